@@ -0,0 +1,205 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#include "benchmark.h"
+#include "live/datetime.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+namespace{
+
+std::atomic<size_t> totalAllocations(0);
+
+// every global allocation form goes through these, so allocs/message counts them all
+void* countedAllocate(size_t size, size_t alignment) noexcept{
+    totalAllocations.fetch_add(1, std::memory_order_relaxed);
+    if ( size == 0 )
+        size = 1;
+    if ( alignment <= alignof(std::max_align_t) )
+        return std::malloc(size);
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void* countedAllocateOrThrow(size_t size, size_t alignment){
+    void* p = countedAllocate(size, alignment);
+    if ( !p )
+        throw std::bad_alloc();
+    return p;
+}
+
+} // namespace
+
+void* operator new(size_t size){
+    return countedAllocateOrThrow(size, 0);
+}
+void* operator new[](size_t size){
+    return countedAllocateOrThrow(size, 0);
+}
+void* operator new(size_t size, std::align_val_t alignment){
+    return countedAllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment){
+    return countedAllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept{
+    return countedAllocate(size, 0);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept{
+    return countedAllocate(size, 0);
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept{
+    return countedAllocate(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept{
+    return countedAllocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept{ std::free(p); }
+void operator delete[](void* p) noexcept{ std::free(p); }
+void operator delete(void* p, size_t) noexcept{ std::free(p); }
+void operator delete[](void* p, size_t) noexcept{ std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept{ std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept{ std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept{ std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept{ std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept{ std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept{ std::free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept{ std::free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept{ std::free(p); }
+
+/**
+ * \brief Adds a case, \p run is called from each of the \p threads with its share of the messages
+ *
+ * \p setup and \p teardown are called once around each run, from the main thread.
+ */
+void Benchmark::add(const std::string &name, const Run &run, const Step &setup, const Step &teardown, int threads){
+    Case c;
+    c.name     = name;
+    c.threads  = threads;
+    c.setup    = setup;
+    c.run      = run;
+    c.teardown = teardown;
+    m_cases.push_back(c);
+}
+
+/**
+ * \brief Runs the cases matching the filter, returning the fastest of the repetitions of each
+ *
+ * Each case is warmed up with a short run first, so thread caches, pools and files are in their steady
+ * state when measured.
+ */
+std::vector<Benchmark::Result> Benchmark::run(const Options &options) const{
+    std::vector<Result> results;
+    for ( auto it = m_cases.begin(); it != m_cases.end(); ++it ){
+        if ( !options.filter.empty() && it->name.find(options.filter) == std::string::npos )
+            continue;
+
+        runOnce(*it, std::max<size_t>(options.messages / 10, static_cast<size_t>(it->threads)));
+
+        Result best;
+        for ( int i = 0; i < options.repetitions; ++i ){
+            Result current = runOnce(*it, options.messages);
+            if ( i == 0 || current.seconds < best.seconds )
+                best = current;
+        }
+        results.push_back(best);
+    }
+    return results;
+}
+
+Benchmark::Result Benchmark::runOnce(const Benchmark::Case &c, size_t messages) const{
+    Result result;
+    result.name     = c.name;
+    result.threads  = c.threads;
+
+    if ( c.setup )
+        c.setup();
+
+    size_t perThread = messages / static_cast<size_t>(c.threads);
+    result.messages  = perThread * static_cast<size_t>(c.threads);
+
+    std::atomic<int>  ready(0);
+    std::atomic<bool> start(false);
+    std::vector<std::thread> threads;
+    for ( int i = 1; i < c.threads; ++i ){
+        threads.push_back(std::thread([&c, &ready, &start, perThread](){
+            ready.fetch_add(1);
+            while ( !start.load(std::memory_order_acquire) )
+                std::this_thread::yield();
+            c.run(perThread);
+        }));
+    }
+    while ( ready.load() < c.threads - 1 )
+        std::this_thread::yield();
+
+    size_t allocationsBefore = allocations();
+    auto startTime = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+
+    c.run(perThread);
+    for ( auto it = threads.begin(); it != threads.end(); ++it )
+        it->join();
+
+    auto endTime = std::chrono::steady_clock::now();
+    result.allocations = allocations() - allocationsBefore;
+    result.seconds     = std::chrono::duration<double>(endTime - startTime).count();
+
+    if ( c.teardown )
+        c.teardown();
+
+    return result;
+}
+
+/**
+ * \brief Returns the \p results as an MLNode, ready to be written as json
+ */
+lv::MLNode Benchmark::toMLNode(const Options &options, const std::vector<Result> &results){
+    lv::MLNode benchmarks(lv::MLNode::Array);
+    for ( auto it = results.begin(); it != results.end(); ++it ){
+        benchmarks.append(lv::MLNode({
+            {"name",                  it->name},
+            {"threads",               it->threads},
+            {"messages",              static_cast<lv::MLNode::IntType>(it->messages)},
+            {"seconds",               it->seconds},
+            {"nsPerMessage",          it->nsPerMessage()},
+            {"messagesPerSecond",     it->messagesPerSecond()},
+            {"allocationsPerMessage", it->allocationsPerMessage()}
+        }));
+    }
+
+    return lv::MLNode({
+        {"context", {
+            {"date",                lv::DateTime().toString()},
+            {"hardwareConcurrency", static_cast<int>(std::thread::hardware_concurrency())},
+            {"messages",            static_cast<lv::MLNode::IntType>(options.messages)},
+            {"repetitions",         options.repetitions}
+        }},
+        {"benchmarks", benchmarks}
+    });
+}
+
+/**
+ * \brief Returns the number of heap allocations made by the process so far
+ */
+size_t Benchmark::allocations(){
+    return totalAllocations.load(std::memory_order_relaxed);
+}
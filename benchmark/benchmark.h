@@ -0,0 +1,86 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#ifndef LVBENCHMARK_H
+#define LVBENCHMARK_H
+
+#include "live/mlnode.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+
+/**
+ * \brief Minimal benchmark harness
+ *
+ * A case runs a function on a number of threads, each logging its share of the requested messages. The
+ * harness reports the wall time of the run, the messages per second, the nanoseconds per message, and
+ * the heap allocations made per message, counted through a replaced global operator new.
+ */
+class Benchmark{
+
+public:
+    typedef std::function<void()> Step;
+    typedef std::function<void(size_t messages)> Run;
+
+    class Case{
+    public:
+        std::string name;
+        int         threads;
+        Step        setup;
+        Run         run;
+        Step        teardown;
+    };
+
+    class Result{
+    public:
+        Result() : threads(1), messages(0), seconds(0), allocations(0){}
+
+        double nsPerMessage() const{ return messages ? seconds * 1e9 / static_cast<double>(messages) : 0; }
+        double messagesPerSecond() const{ return seconds > 0 ? static_cast<double>(messages) / seconds : 0; }
+        double allocationsPerMessage() const{ return messages ? static_cast<double>(allocations) / static_cast<double>(messages) : 0; }
+
+        std::string name;
+        int         threads;
+        size_t      messages;
+        double      seconds;
+        size_t      allocations;
+    };
+
+    class Options{
+    public:
+        Options() : messages(200000), repetitions(3){}
+
+        size_t      messages;    // messages logged by each case, split between its threads
+        int         repetitions; // timed runs of each case, the fastest one is reported
+        std::string filter;      // only cases with this text in their name are run
+    };
+
+public:
+    void add(const std::string& name, const Run& run, const Step& setup = nullptr, const Step& teardown = nullptr, int threads = 1);
+
+    std::vector<Result> run(const Options& options) const;
+
+    static lv::MLNode toMLNode(const Options& options, const std::vector<Result>& results);
+    static size_t allocations();
+
+private:
+    Result runOnce(const Case& c, size_t messages) const;
+
+    std::vector<Case> m_cases;
+};
+
+#endif // LVBENCHMARK_H
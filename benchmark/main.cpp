@@ -0,0 +1,100 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#include "benchmark.h"
+#include "live/mlnodetojson.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+void addVisualLogBenchmarks(Benchmark& benchmark);
+void addUtf8Benchmarks(Benchmark& benchmark);
+
+namespace{
+
+void printUsage(const char* program){
+    printf(
+        "Usage: %s [options]\n"
+        "  --messages <n>     messages logged by each case, 200000 by default\n"
+        "  --repetitions <n>  timed runs of each case, the fastest is reported, 3 by default\n"
+        "  --filter <text>    only runs cases with the text in their name\n"
+        "  --json <file>      writes the results as json to the file, '-' for the standard output\n",
+        program
+    );
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+    Benchmark::Options options;
+    std::string jsonPath;
+
+    for ( int i = 1; i < argc; ++i ){
+        bool hasValue = i + 1 < argc;
+        if ( strcmp(argv[i], "--messages") == 0 && hasValue ){
+            options.messages = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else if ( strcmp(argv[i], "--repetitions") == 0 && hasValue ){
+            options.repetitions = std::atoi(argv[++i]);
+        } else if ( strcmp(argv[i], "--filter") == 0 && hasValue ){
+            options.filter = argv[++i];
+        } else if ( strcmp(argv[i], "--json") == 0 && hasValue ){
+            jsonPath = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+    if ( options.messages == 0 || options.repetitions < 1 ){
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Benchmark benchmark;
+    addVisualLogBenchmarks(benchmark);
+    addUtf8Benchmarks(benchmark);
+
+    std::vector<Benchmark::Result> results = benchmark.run(options);
+
+    std::string json;
+    lv::ml::toJson(Benchmark::toMLNode(options, results), json);
+
+    if ( jsonPath == "-" ){
+        printf("%s\n", json.c_str());
+        return 0;
+    }
+
+    printf("%-20s %8s %12s %14s %14s\n", "Benchmark", "Threads", "ns/message", "messages/s", "allocs/message");
+    for ( auto it = results.begin(); it != results.end(); ++it ){
+        printf(
+            "%-20s %8d %12.1f %14.0f %14.2f\n",
+            it->name.c_str(), it->threads, it->nsPerMessage(), it->messagesPerSecond(), it->allocationsPerMessage()
+        );
+    }
+
+    if ( !jsonPath.empty() ){
+        std::ofstream file(jsonPath, std::ios::out | std::ios::trunc);
+        if ( !file.is_open() ){
+            fprintf(stderr, "Failed to open json output file: %s\n", jsonPath.c_str());
+            return 1;
+        }
+        file << json << "\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#include "benchmark.h"
+#include "live/utf8.h"
+#include "live/exception.h"
+
+#include <sstream>
+#include <string>
+
+using namespace lv;
+
+namespace{
+
+const char* const formatPattern = "Failed to open file: '%'. Retrying in % ms, attempt % of %.";
+
+// Utf8::format as it was before writing to a FormatBuffer, kept as the baseline of the format cases
+class StreamFormat{
+
+public:
+    StreamFormat(const std::string& pattern) : m_pattern(pattern){}
+
+    template<typename ...Args> std::string format(const Args&... args) const{
+        std::stringstream result;
+        formatImpl(m_pattern.cbegin(), result, args...);
+        return result.str();
+    }
+
+private:
+    void formatImpl(std::string::const_iterator sit, std::stringstream& stream) const{
+        while ( sit != m_pattern.cend() ){
+            char ch = *sit;
+            if ( ch == '%' ){
+                auto sitnext = sit + 1;
+                if ( sitnext != m_pattern.cend() && *(sitnext) == '%' ){
+                    ++sit;
+                } else {
+                    THROW_EXCEPTION(Exception, "Missing arguments in Utf8.format", 0);
+                }
+            }
+            stream << ch;
+            ++sit;
+        }
+    }
+
+    template<typename T, typename... Args>
+    void formatImpl(std::string::const_iterator sit, std::stringstream& stream, const T& value, const Args&... args) const{
+        while ( sit != m_pattern.cend() ){
+            char ch = *sit;
+            if ( ch == '%' ){
+                auto sitnext = sit + 1;
+                if ( sitnext != m_pattern.cend() && *(sitnext) == '%' ){
+                    ++sit;
+                } else {
+                    stream << value;
+                    formatImpl(sit + 1, stream, args...);
+                    return;
+                }
+            }
+            stream << ch;
+            ++sit;
+        }
+        THROW_EXCEPTION(Exception, "Extra arguments provided to Utf8.format.", 0);
+    }
+
+    std::string m_pattern;
+};
+
+// Keeps the compiler from discarding the formatted results
+size_t formattedBytes = 0;
+
+void formatUtf8(size_t messages){
+    Utf8 pattern(formatPattern);
+    std::string path = "/var/log/livekeys/session.log";
+    for ( size_t i = 0; i < messages; ++i )
+        formattedBytes += pattern.format(path, 250, static_cast<int>(i), 5).size();
+}
+
+void formatStream(size_t messages){
+    StreamFormat pattern(formatPattern);
+    std::string path = "/var/log/livekeys/session.log";
+    for ( size_t i = 0; i < messages; ++i )
+        formattedBytes += pattern.format(path, 250, static_cast<int>(i), 5).size();
+}
+
+} // namespace
+
+/**
+ * \brief Registers the Utf8 cases with \p benchmark
+ */
+void addUtf8Benchmarks(Benchmark& benchmark){
+    benchmark.add("utf8/format",        &formatUtf8);
+    benchmark.add("utf8/format/stream", &formatStream);
+}
@@ -0,0 +1,175 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#include "benchmark.h"
+#include "live/visuallog.h"
+#include "live/path.h"
+
+#include <cstdio>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define VLOG_BENCHMARK_POSIX
+#endif
+
+using namespace lv;
+
+namespace{
+
+const char* const benchmarkConfiguration = "benchmark";
+
+const char* const defaultPrefix  = "%p";
+const char* const stampPrefix    = "%Y-%m-%d %H:%M:%S.%i ";
+const char* const locationPrefix = "%V %N:%L %U: ";
+
+std::string benchmarkFilePath(){
+    return Path::join(Path::temporaryDirectory(), "lvbasebenchmark.log");
+}
+
+// Console messages go to the standard error, which is sent to the null device while measuring
+#ifdef VLOG_BENCHMARK_POSIX
+int savedStandardError = -1;
+
+void silenceConsole(){
+    fflush(stderr);
+    savedStandardError = dup(STDERR_FILENO);
+    int nullDevice = open("/dev/null", O_WRONLY);
+    if ( nullDevice >= 0 ){
+        dup2(nullDevice, STDERR_FILENO);
+        close(nullDevice);
+    }
+}
+
+void restoreConsole(){
+    fflush(stderr);
+    if ( savedStandardError >= 0 ){
+        dup2(savedStandardError, STDERR_FILENO);
+        close(savedStandardError);
+        savedStandardError = -1;
+    }
+}
+#else
+void silenceConsole(){}
+void restoreConsole(){}
+#endif
+
+void configureDisabled(){
+    vlog().configure(benchmarkConfiguration, {
+        {"level",     VisualLog::MessageInfo::Info},
+        {"toConsole", false},
+        {"file",      ""}
+    });
+}
+
+void configureConsole(){
+    vlog().configure(benchmarkConfiguration, {
+        {"level",     VisualLog::MessageInfo::Info},
+        {"toConsole", true},
+        {"file",      ""},
+        {"prefix",    defaultPrefix}
+    });
+    silenceConsole();
+}
+
+void configureFile(const std::string& prefix, int bufferSize){
+    std::string path = benchmarkFilePath();
+    std::remove(path.c_str());
+    vlog().configure(benchmarkConfiguration, {
+        {"level",          VisualLog::MessageInfo::Info},
+        {"toConsole",      false},
+        {"file",           path},
+        {"prefix",         prefix},
+        {"fileBufferSize", bufferSize},
+        {"logObjects",     VisualLog::File}
+    });
+}
+
+void configureBufferedFile(){
+    configureFile(defaultPrefix, 64 * 1024);
+}
+
+void closeFile(){
+    VisualLog::flushAll();
+    vlog().configure(benchmarkConfiguration, {{"file", ""}});
+    std::remove(benchmarkFilePath().c_str());
+}
+
+void logDisabled(size_t messages){
+    for ( size_t i = 0; i < messages; ++i )
+        vlog(benchmarkConfiguration).d() << "benchmark message " << i << " value " << 3.14;
+}
+
+void logDisabledIf(size_t messages){
+    for ( size_t i = 0; i < messages; ++i )
+        vlog_if("benchmark", VisualLog::MessageInfo::Debug) << "benchmark message " << i << " value " << 3.14;
+}
+
+void logMessages(size_t messages){
+    for ( size_t i = 0; i < messages; ++i )
+        vlog(benchmarkConfiguration).i() << "benchmark message " << i << " value " << 3.14;
+}
+
+void logObjects(size_t messages){
+    MLNode node = {{"x", 10}, {"y", 20}, {"label", "point"}};
+    for ( size_t i = 0; i < messages; ++i )
+        vlog(benchmarkConfiguration).i().asObject("Point", node);
+}
+
+void logFields(size_t messages){
+    for ( size_t i = 0; i < messages; ++i )
+        vlog(benchmarkConfiguration).i().field("x", 10).field("y", 20).field("label", "point") << "point";
+}
+
+} // namespace
+
+/**
+ * \brief Registers the VisualLog cases with \p benchmark
+ */
+void addVisualLogBenchmarks(Benchmark& benchmark){
+    benchmark.add("disabled/vlog",    &logDisabled,   &configureDisabled);
+    benchmark.add("disabled/vlog_if", &logDisabledIf, &configureDisabled);
+
+    benchmark.add("console", &logMessages, &configureConsole, [](){
+        restoreConsole();
+        vlog().configure(benchmarkConfiguration, {{"toConsole", false}});
+    });
+
+    benchmark.add("file/buffered",   &logMessages, &configureBufferedFile, &closeFile);
+    benchmark.add("file/unbuffered", &logMessages, [](){ configureFile(defaultPrefix, 0); }, &closeFile);
+
+    benchmark.add("prefix/none",     &logMessages, [](){ configureFile("", 64 * 1024); }, &closeFile);
+    benchmark.add("prefix/default",  &logMessages, [](){ configureFile(defaultPrefix, 64 * 1024); }, &closeFile);
+    benchmark.add("prefix/stamp",    &logMessages, [](){ configureFile(stampPrefix, 64 * 1024); }, &closeFile);
+    benchmark.add("prefix/location", &logMessages, [](){ configureFile(locationPrefix, 64 * 1024); }, &closeFile);
+
+    benchmark.add("object/asObject", &logObjects, &configureBufferedFile, &closeFile);
+    benchmark.add("object/fields",   &logFields,  &configureBufferedFile, &closeFile);
+
+    // measures the logging threads only, the writer thread drains the queue in the teardown
+    benchmark.add("async/file", &logMessages, [](){
+        configureBufferedFile();
+        VisualLog::startAsync();
+    }, [](){
+        VisualLog::stopAsync();
+        closeFile();
+    });
+
+    for ( int threads = 1; threads <= 64; threads *= 2 ){
+        benchmark.add("threads/" + std::to_string(threads), &logMessages, &configureBufferedFile, &closeFile, threads);
+    }
+}
@@ -0,0 +1 @@
+#include "../../src/asynctransport.h"
@@ -0,0 +1 @@
+#include "../../src/batchworker.h"
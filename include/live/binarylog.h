@@ -0,0 +1 @@
+#include "../../src/binarylog.h"
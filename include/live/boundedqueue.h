@@ -0,0 +1 @@
+#include "../../src/boundedqueue.h"
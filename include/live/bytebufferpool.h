@@ -0,0 +1 @@
+#include "../../src/bytebufferpool.h"
@@ -0,0 +1 @@
+#include "../../src/datetimeformat.h"
@@ -0,0 +1 @@
+#include "../../src/internedutf8.h"
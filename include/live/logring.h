@@ -0,0 +1 @@
+#include "../../src/logring.h"
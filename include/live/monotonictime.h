@@ -0,0 +1 @@
+#include "../../src/monotonictime.h"
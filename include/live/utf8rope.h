@@ -0,0 +1 @@
+#include "../../src/utf8rope.h"
@@ -0,0 +1,333 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#include "asynctransport.h"
+#include "live/batchworker.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+namespace lv{
+
+namespace{
+
+long long steadyMicroseconds(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+// AsyncTransportDelivery
+// ----------------------------------------------------------------------------
+
+/// \private
+// Hands batches to the handler or the target. Owned by the worker, so it outlives a transport that's
+// freed on the worker thread, i.e. when a batch drops the last reference to it.
+class AsyncTransportDelivery{
+
+public:
+    AsyncTransportDelivery(VisualLog::Transport* t, AsyncTransport::BatchHandler* h, size_t mb)
+        : target(t)
+        , handler(h)
+        , maximumBatch(std::max(mb, size_t(1)))
+        , delivered(0)
+        , batches(0)
+        , totalLatency(0)
+        , maximumLatency(0)
+        , totalBatchTime(0)
+    {
+        batch.reserve(maximumBatch);
+    }
+
+    size_t deliver(BatchWorker<AsyncTransport::Record>& worker);
+    void deliverToTarget();
+
+    std::unique_ptr<VisualLog::Transport>         target;
+    std::unique_ptr<AsyncTransport::BatchHandler> handler;
+    size_t                                        maximumBatch;
+    std::vector<AsyncTransport::Record>           batch;
+
+    std::atomic<size_t>    delivered;
+    std::atomic<size_t>    batches;
+    std::atomic<long long> totalLatency;
+    std::atomic<long long> maximumLatency;
+    std::atomic<long long> totalBatchTime;
+};
+
+/**
+ * Hands the next batch of queued records to the handler or the target, and accounts for their latency.
+ */
+size_t AsyncTransportDelivery::deliver(BatchWorker<AsyncTransport::Record> &worker){
+    batch.clear();
+    AsyncTransport::Record record;
+    while ( batch.size() < maximumBatch && worker.queue().tryPop(record) )
+        batch.push_back(std::move(record));
+    if ( batch.empty() )
+        return 0;
+
+    long long start = steadyMicroseconds();
+    if ( handler ){
+        handler->onBatch(batch);
+    } else if ( target ){
+        deliverToTarget();
+    }
+    long long end = steadyMicroseconds();
+
+    long long latency = 0;
+    long long longest = maximumLatency.load(std::memory_order_relaxed);
+    for ( auto it = batch.begin(); it != batch.end(); ++it ){
+        long long recordLatency = end - it->queued;
+        latency += recordLatency;
+        longest = std::max(longest, recordLatency);
+    }
+
+    totalLatency.fetch_add(latency, std::memory_order_relaxed);
+    maximumLatency.store(longest, std::memory_order_relaxed);
+    totalBatchTime.fetch_add(end - start, std::memory_order_relaxed);
+    delivered.fetch_add(batch.size(), std::memory_order_relaxed);
+    batches.fetch_add(1, std::memory_order_relaxed);
+
+    return batch.size();
+}
+
+void AsyncTransportDelivery::deliverToTarget(){
+    for ( auto it = batch.begin(); it != batch.end(); ++it ){
+        VisualLog::MessageInfo messageInfo(it->level);
+        messageInfo.m_remote       = it->remote;
+        messageInfo.m_file         = it->file;
+        messageInfo.m_line         = it->line;
+        messageInfo.m_functionName = it->functionName;
+        messageInfo.m_stamp        = it->stamp;
+        messageInfo.m_hasStamp     = true;
+        if ( !it->fields.empty() )
+            messageInfo.m_fields = it->fields;
+
+        if ( it->kind == AsyncTransport::Record::Message ){
+            target->onMessage(it->configuration, messageInfo, it->message);
+        } else {
+            target->onObject(it->configuration, messageInfo, it->type, it->object);
+        }
+    }
+}
+
+
+// AsyncTransportPrivate
+// ----------------------------------------------------------------------------
+
+/// \private
+class AsyncTransportPrivate{
+
+public:
+    AsyncTransportPrivate(
+            VisualLog::Transport* target,
+            AsyncTransport::BatchHandler* handler,
+            size_t capacity,
+            VisualLog::OverflowPolicy policy,
+            size_t maximumBatch)
+        : delivery(std::make_shared<AsyncTransportDelivery>(target, handler, maximumBatch))
+    {
+        std::shared_ptr<AsyncTransportDelivery> d = delivery;
+        worker = BatchWorker<AsyncTransport::Record>::create(capacity, policy, [d](BatchWorker<AsyncTransport::Record>& w){
+            return d->deliver(w);
+        });
+    }
+
+    std::shared_ptr<AsyncTransportDelivery>                delivery;
+    std::shared_ptr<BatchWorker<AsyncTransport::Record> > worker;
+};
+
+
+// AsyncTransport::Record
+// ----------------------------------------------------------------------------
+
+AsyncTransport::Record::Record()
+    : kind(AsyncTransport::Record::Message)
+    , configuration(nullptr)
+    , level(VisualLog::MessageInfo::Info)
+    , line(0)
+    , queued(0)
+{
+}
+
+
+// AsyncTransport
+// ----------------------------------------------------------------------------
+
+/**
+ * \class lv::AsyncTransport
+ * \brief Transport that delivers messages and objects in batches, on its own thread
+ *
+ * Messages and objects are copied into records and queued, so logging threads never wait on the
+ * transport. A worker thread hands queued records in batches of at most \p maximumBatch either to a
+ * \p handler, or to each record's \p target transport, so any existing transport can be moved off the
+ * logging threads. The handler or the target is owned by this transport, and is freed after the worker
+ * is stopped.
+ *
+ * When the queue is full, \p policy decides whether the logging thread waits, or which record is
+ * dropped. Records logged from within a batch are dropped instead of waiting, since the worker
+ * cannot wait for itself.
+ *
+ * The transport can be freed from within a batch, i.e. when the handler reconfigures the last snapshot
+ * holding it. Records that are still queued are then dropped.
+ *
+ * \ingroup lvbase
+ */
+
+const size_t AsyncTransport::defaultCapacity;
+const size_t AsyncTransport::defaultMaximumBatch;
+
+/**
+ * \brief Starts the worker thread, delivering each record to \p target
+ */
+AsyncTransport::AsyncTransport(
+        VisualLog::Transport *target,
+        size_t capacity,
+        VisualLog::OverflowPolicy policy,
+        size_t maximumBatch)
+    : m_d(new AsyncTransportPrivate(target, nullptr, capacity, policy, maximumBatch))
+{
+}
+
+/**
+ * \brief Starts the worker thread, delivering batches to \p handler
+ */
+AsyncTransport::AsyncTransport(
+        AsyncTransport::BatchHandler *handler,
+        size_t capacity,
+        VisualLog::OverflowPolicy policy,
+        size_t maximumBatch)
+    : m_d(new AsyncTransportPrivate(nullptr, handler, capacity, policy, maximumBatch))
+{
+}
+
+/**
+ * \brief Stops the worker after delivering the queued records
+ */
+AsyncTransport::~AsyncTransport(){
+    stop();
+    delete m_d;
+}
+
+/**
+ * \brief Queues a copy of the message
+ */
+void AsyncTransport::onMessage(
+        const VisualLog::Configuration *configuration,
+        const VisualLog::MessageInfo &messageInfo,
+        const std::string &message)
+{
+    Record record;
+    record.kind          = Record::Message;
+    record.configuration = configuration;
+    record.level         = messageInfo.m_level;
+    record.stamp         = messageInfo.stamp();
+    record.remote        = messageInfo.m_remote;
+    record.file          = messageInfo.m_file;
+    record.line          = messageInfo.m_line;
+    record.functionName  = messageInfo.m_functionName;
+    record.message       = message;
+    record.fields        = messageInfo.m_fields;
+    push(record);
+}
+
+/**
+ * \brief Queues a copy of the object
+ */
+void AsyncTransport::onObject(
+        const VisualLog::Configuration *configuration,
+        const VisualLog::MessageInfo &messageInfo,
+        const std::string &type,
+        const MLNode &node)
+{
+    Record record;
+    record.kind          = Record::Object;
+    record.configuration = configuration;
+    record.level         = messageInfo.m_level;
+    record.stamp         = messageInfo.stamp();
+    record.remote        = messageInfo.m_remote;
+    record.file          = messageInfo.m_file;
+    record.line          = messageInfo.m_line;
+    record.functionName  = messageInfo.m_functionName;
+    record.type          = type;
+    record.object        = node;
+    push(record);
+}
+
+/**
+ * \brief Waits until every record queued before this call is delivered
+ *
+ * Does nothing when called from within a batch, or after the transport is stopped.
+ */
+void AsyncTransport::flush(){
+    m_d->worker->flush();
+}
+
+/**
+ * \brief Delivers the queued records and stops the worker
+ *
+ * Records queued afterwards are dropped. Calling stop() more than once has no effect.
+ */
+void AsyncTransport::stop(){
+    m_d->worker->stop();
+}
+
+/**
+ * \brief Returns the transport records are delivered to, or null if none was given
+ */
+VisualLog::Transport *AsyncTransport::target() const{
+    return m_d->delivery->target.get();
+}
+
+/**
+ * \brief Returns the handler batches are delivered to, or null if none was given
+ */
+AsyncTransport::BatchHandler *AsyncTransport::handler() const{
+    return m_d->delivery->handler.get();
+}
+
+/**
+ * \brief Returns a snapshot of the transport counters
+ */
+AsyncTransport::Stats AsyncTransport::stats() const{
+    const AsyncTransportDelivery* delivery = m_d->delivery.get();
+
+    Stats st;
+    st.delivered        = delivery->delivered.load(std::memory_order_relaxed);
+    st.dropped          = m_d->worker->dropped();
+    st.batches          = delivery->batches.load(std::memory_order_relaxed);
+    st.queued           = m_d->worker->queued();
+    st.maximumLatency   = delivery->maximumLatency.load(std::memory_order_relaxed);
+    if ( st.delivered > 0 )
+        st.averageLatency = delivery->totalLatency.load(std::memory_order_relaxed) / static_cast<long long>(st.delivered);
+    if ( st.batches > 0 )
+        st.averageBatchTime = delivery->totalBatchTime.load(std::memory_order_relaxed) / static_cast<long long>(st.batches);
+    return st;
+}
+
+void AsyncTransport::push(AsyncTransport::Record &record){
+    BatchWorker<Record>* worker = m_d->worker.get();
+    if ( !worker->enter() ){
+        worker->drop();
+        return;
+    }
+    record.queued = steadyMicroseconds();
+    worker->push(record);
+    worker->leave();
+}
+
+}// namespace
@@ -0,0 +1,183 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#ifndef LVASYNCTRANSPORT_H
+#define LVASYNCTRANSPORT_H
+
+#include "live/lvbaseglobal.h"
+#include "live/visuallog.h"
+#include "live/datetime.h"
+#include "live/mlnode.h"
+
+#include <string>
+#include <vector>
+
+namespace lv{
+
+class AsyncTransportPrivate;
+
+/**
+ * \class lv::AsyncTransport
+ * \brief Transport that delivers messages and objects in batches, on its own thread
+ *
+ * \ingroup lvbase
+ */
+class LV_BASE_EXPORT AsyncTransport : public VisualLog::Transport{
+
+public:
+    /**
+     * \class lv::AsyncTransport::Record
+     * \brief Copy of a message or an object, along with its message info
+     *
+     * \ingroup lvbase
+     */
+    class LV_BASE_EXPORT Record{
+
+    public:
+        /** Kind of the record */
+        enum Kind{
+            /** Text message */
+            Message = 0,
+            /** Object */
+            Object
+        };
+
+    public:
+        Record();
+
+        /** Message or object */
+        Kind kind;
+        /** Configuration the record was logged through */
+        const VisualLog::Configuration* configuration;
+        /** Message level */
+        VisualLog::MessageInfo::Level level;
+        /** Time the record was logged at */
+        DateTime stamp;
+        /** Remote of the source location, if any */
+        std::string remote;
+        /** Source file, if any */
+        std::string file;
+        /** Source line, or 0 */
+        int line;
+        /** Source function, if any */
+        std::string functionName;
+        /** Text of the message, for message records */
+        std::string message;
+        /** Typed fields of the message, for message records */
+        VisualLog::Fields fields;
+        /** Type of the object, for object records */
+        std::string type;
+        /** Value of the object, for object records */
+        MLNode object;
+        /** Steady clock microseconds the record was queued at */
+        long long queued;
+    };
+
+    /**
+     * \class lv::AsyncTransport::Stats
+     * \brief Snapshot of the transport counters
+     *
+     * \ingroup lvbase
+     */
+    class Stats{
+    public:
+        Stats()
+            : delivered(0), dropped(0), batches(0), queued(0)
+            , averageLatency(0), maximumLatency(0), averageBatchTime(0)
+        {}
+
+        /** Records delivered */
+        size_t delivered;
+        /** Records discarded because the queue was full */
+        size_t dropped;
+        /** Batches delivered */
+        size_t batches;
+        /** Records waiting in the queue */
+        size_t queued;
+        /** Average microseconds between queueing a record and the end of its delivery */
+        long long averageLatency;
+        /** Longest microseconds between queueing a record and the end of its delivery */
+        long long maximumLatency;
+        /** Average microseconds spent in onBatch() */
+        long long averageBatchTime;
+    };
+
+    /**
+     * \class lv::AsyncTransport::BatchHandler
+     * \brief Receives the batches of an AsyncTransport, on its worker thread
+     *
+     * \ingroup lvbase
+     */
+    class LV_BASE_EXPORT BatchHandler{
+
+    public:
+        /** Destructor */
+        virtual ~BatchHandler(){}
+
+        /** Called on the worker thread with the next batch of records */
+        virtual void onBatch(const std::vector<Record>& records) = 0;
+    };
+
+    /** Default number of queued records */
+    static const size_t defaultCapacity = 8192;
+    /** Default largest number of records delivered in a batch */
+    static const size_t defaultMaximumBatch = 256;
+
+public:
+    AsyncTransport(
+        VisualLog::Transport* target = nullptr,
+        size_t capacity = defaultCapacity,
+        VisualLog::OverflowPolicy policy = VisualLog::DropNewest,
+        size_t maximumBatch = defaultMaximumBatch
+    );
+    AsyncTransport(
+        BatchHandler* handler,
+        size_t capacity = defaultCapacity,
+        VisualLog::OverflowPolicy policy = VisualLog::DropNewest,
+        size_t maximumBatch = defaultMaximumBatch
+    );
+    virtual ~AsyncTransport() override;
+
+    void onMessage(
+        const VisualLog::Configuration* configuration,
+        const VisualLog::MessageInfo& messageInfo,
+        const std::string& message
+    ) override;
+    void onObject(
+        const VisualLog::Configuration* configuration,
+        const VisualLog::MessageInfo& messageInfo,
+        const std::string& type,
+        const MLNode& node
+    ) override;
+
+    void flush();
+    void stop();
+
+    VisualLog::Transport* target() const;
+    BatchHandler* handler() const;
+    Stats stats() const;
+
+private:
+    DISABLE_COPY(AsyncTransport);
+
+    void push(Record& record);
+
+    AsyncTransportPrivate* m_d;
+};
+
+}// namespace
+
+#endif // LVASYNCTRANSPORT_H
@@ -0,0 +1,286 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+#ifndef LVBATCHWORKER_H
+#define LVBATCHWORKER_H
+
+#include "live/lvbaseglobal.h"
+#include "live/visuallog.h"
+#include "live/boundedqueue.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <chrono>
+
+namespace lv{
+
+/**
+ * \class lv::BatchWorker
+ * \brief Thread handing the values queued by any number of producers to a drain function, in batches
+ *
+ * Producers push values between enter() and leave(). When the queue is full, the overflow policy decides
+ * whether they wait for room, or which value is dropped. The worker thread calls the drain function as
+ * long as values are queued. The function pops and handles a batch of them from queue(), and returns how
+ * many it popped. The worker then sleeps until a push wakes it up, or for at most 10ms.
+ *
+ * The worker is shared with its thread, so stop() can also be called from within the drain function, i.e.
+ * when the owner of the worker is destroyed on the worker thread. The thread cannot join itself, so it's
+ * detached instead, and exits as soon as the drain function returns, dropping the values still queued.
+ * Anything the drain function uses should then be owned by the function itself, so it's freed along with
+ * the worker, on the worker thread.
+ *
+ * \ingroup lvbase
+ */
+template<typename T>
+class BatchWorker{
+
+public:
+    /** Pops and handles a batch of values from the worker's queue, returns the number of values popped */
+    typedef std::function<size_t(BatchWorker<T>&)> Drain;
+
+public:
+    static std::shared_ptr<BatchWorker<T> > create(size_t capacity, VisualLog::OverflowPolicy policy, const Drain& drain);
+
+    bool enter();
+    /** \brief Unregisters a producer registered through enter() */
+    void leave(){ m_producers.fetch_sub(1, std::memory_order_release); }
+    bool push(T& value);
+    /** \brief Counts a value the producer dropped on its own, i.e. because enter() failed */
+    void drop(){ m_dropped.fetch_add(1, std::memory_order_relaxed); }
+    void flush();
+    void stop();
+
+    /** \brief Queue of the worker, for the drain function to pop values from */
+    BoundedQueue<T>& queue(){ return m_queue; }
+    /** \brief Number of queued values, which may already be stale */
+    size_t queued() const{ return m_queue.sizeApproximate(); }
+    /** \brief Number of values dropped because the queue was full or the worker was stopping */
+    size_t dropped() const{ return m_dropped.load(std::memory_order_relaxed); }
+    /** \brief Shows if the caller is running on the worker thread */
+    bool isWorkerThread() const{ return std::this_thread::get_id() == m_threadId; }
+    /** \brief Shows if the worker was stopped from its own thread, so it no longer drains the queue */
+    bool isAbandoned() const{ return m_abandoned.load(std::memory_order_acquire); }
+
+private:
+    BatchWorker(size_t capacity, VisualLog::OverflowPolicy policy, const Drain& drain);
+    DISABLE_COPY(BatchWorker);
+
+    void run();
+    void retire(size_t count);
+    void wake();
+
+    BoundedQueue<T>           m_queue;
+    VisualLog::OverflowPolicy m_policy;
+    Drain                     m_drain;
+    std::atomic<size_t>       m_pushed;
+    std::atomic<size_t>       m_retired;
+    std::atomic<size_t>       m_dropped;
+    std::atomic<size_t>       m_producers;
+    std::atomic<bool>         m_stopping;
+    std::atomic<bool>         m_sleeping;
+    std::atomic<bool>         m_abandoned;
+    bool                      m_stopped;
+    std::mutex                m_mutex;
+    std::condition_variable   m_wake;
+    std::condition_variable   m_drained;
+    std::thread               m_thread;
+    std::thread::id           m_threadId;
+};
+
+template<typename T>
+BatchWorker<T>::BatchWorker(size_t capacity, VisualLog::OverflowPolicy policy, const Drain& drain)
+    : m_queue(capacity)
+    , m_policy(policy)
+    , m_drain(drain)
+    , m_pushed(0)
+    , m_retired(0)
+    , m_dropped(0)
+    , m_producers(0)
+    , m_stopping(false)
+    , m_sleeping(false)
+    , m_abandoned(false)
+    , m_stopped(false)
+{
+}
+
+/**
+ * \brief Creates a worker with a queue of \p capacity values, and starts its thread
+ */
+template<typename T>
+std::shared_ptr<BatchWorker<T> > BatchWorker<T>::create(size_t capacity, VisualLog::OverflowPolicy policy, const Drain& drain){
+    std::shared_ptr<BatchWorker<T> > worker(new BatchWorker<T>(capacity, policy, drain));
+    std::lock_guard<std::mutex> lock(worker->m_mutex);
+    worker->m_thread   = std::thread([worker](){ worker->run(); });
+    worker->m_threadId = worker->m_thread.get_id();
+    return worker;
+}
+
+/**
+ * \brief Registers the calling thread as a producer, returns false if the worker is stopping
+ *
+ * Producers call leave() once their push is done, and stop() waits for them before draining the queue
+ * for the last time.
+ */
+template<typename T>
+bool BatchWorker<T>::enter(){
+    m_producers.fetch_add(1, std::memory_order_seq_cst);
+    if ( m_stopping.load(std::memory_order_seq_cst) ){
+        leave();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \brief Queues \p value, called between enter() and leave(), returns false if it was dropped
+ *
+ * The value is swapped with the one the queue slot held, so the producer gets back storage to reuse.
+ * Values that would wait for room after the worker started stopping are dropped, and so are values
+ * pushed from the worker thread itself, which cannot wait for itself.
+ *
+ * The value is counted as pushed before it's queued, so the worker can never retire it ahead of the
+ * count flush() waits for. Dropped values are retired right away.
+ */
+template<typename T>
+bool BatchWorker<T>::push(T &value){
+    m_pushed.fetch_add(1, std::memory_order_seq_cst);
+
+    if ( !m_queue.tryPushSwap(value) ){
+        if ( m_policy == VisualLog::DropNewest || isWorkerThread() ){
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            retire(1);
+            return false;
+        } else if ( m_policy == VisualLog::DropOldest ){
+            T oldest;
+            while ( !m_queue.tryPushSwap(value) ){
+                if ( m_queue.tryPop(oldest) ){
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    retire(1);
+                }
+            }
+        } else {
+            while ( !m_queue.tryPushSwap(value) ){
+                if ( m_stopping.load(std::memory_order_acquire) ){
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    retire(1);
+                    return false;
+                }
+                wake();
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    if ( m_sleeping.load(std::memory_order_seq_cst) )
+        wake();
+    return true;
+}
+
+/**
+ * \brief Waits until every value pushed before this call is drained
+ *
+ * Does nothing when called from the worker thread, and returns early once the worker is stopped.
+ */
+template<typename T>
+void BatchWorker<T>::flush(){
+    size_t target = m_pushed.load(std::memory_order_acquire);
+    if ( isWorkerThread() )
+        return;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_wake.notify_one();
+    m_drained.wait(lock, [this, target](){
+        return m_retired.load(std::memory_order_acquire) >= target || m_stopped;
+    });
+}
+
+/**
+ * \brief Drains the queued values and stops the worker thread
+ *
+ * Values pushed afterwards are dropped. Calling stop() more than once has no effect.
+ */
+template<typename T>
+void BatchWorker<T>::stop(){
+    if ( m_stopping.exchange(true, std::memory_order_seq_cst) )
+        return;
+
+    if ( isWorkerThread() ){
+        m_abandoned.store(true, std::memory_order_release);
+        m_thread.detach();
+    } else if ( m_thread.joinable() ){
+        wake();
+        m_thread.join();
+    }
+
+    // producers that entered before the stop flag was set are still pushing
+    while ( m_producers.load(std::memory_order_acquire) > 0 )
+        std::this_thread::yield();
+    if ( !isAbandoned() ){
+        size_t count = 0;
+        while ( (count = m_drain(*this)) > 0 )
+            retire(count);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopped = true;
+    m_drained.notify_all();
+}
+
+template<typename T>
+void BatchWorker<T>::run(){
+    {
+        // create() publishes the thread id under the lock
+        std::lock_guard<std::mutex> lock(m_mutex);
+    }
+
+    while ( true ){
+        size_t count = m_drain(*this);
+        if ( isAbandoned() )
+            return;
+        if ( count > 0 ){
+            retire(count);
+            continue;
+        }
+        if ( m_stopping.load(std::memory_order_acquire) )
+            break;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_sleeping.store(true, std::memory_order_seq_cst);
+        if ( m_queue.sizeApproximate() == 0 && !m_stopping.load(std::memory_order_acquire) )
+            m_wake.wait_for(lock, std::chrono::milliseconds(10));
+        m_sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+template<typename T>
+void BatchWorker<T>::retire(size_t count){
+    m_retired.fetch_add(count, std::memory_order_release);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_drained.notify_all();
+}
+
+template<typename T>
+void BatchWorker<T>::wake(){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_wake.notify_one();
+}
+
+}// namespace
+
+#endif // LVBATCHWORKER_H
@@ -0,0 +1,154 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#ifndef LVBINARYENCODING_H
+#define LVBINARYENCODING_H
+
+#include "live/exception.h"
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+
+namespace lv{ namespace binary{
+
+// Little endian fixed size and variable length integer encoding shared by the binary formats
+// ------------------------------------------------------------------------------------------
+
+inline void appendFixed32(std::string& result, uint32_t value){
+    char bytes[4];
+    for ( int i = 0; i < 4; ++i )
+        bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    result.append(bytes, 4);
+}
+
+inline void appendFixed64(std::string& result, uint64_t value){
+    char bytes[8];
+    for ( int i = 0; i < 8; ++i )
+        bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    result.append(bytes, 8);
+}
+
+inline void writeFixed32(char* destination, uint32_t value){
+    for ( int i = 0; i < 4; ++i )
+        destination[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+inline uint32_t readFixed32(const char* source){
+    uint32_t value = 0;
+    for ( int i = 0; i < 4; ++i )
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(source[i])) << (8 * i);
+    return value;
+}
+
+inline uint64_t readFixed64(const char* source){
+    uint64_t value = 0;
+    for ( int i = 0; i < 8; ++i )
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(source[i])) << (8 * i);
+    return value;
+}
+
+inline void appendVarint(std::string& result, uint64_t value){
+    char bytes[10];
+    int size = 0;
+    while ( value >= 0x80 ){
+        bytes[size++] = static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    bytes[size++] = static_cast<char>(value);
+    result.append(bytes, static_cast<size_t>(size));
+}
+
+inline void appendSignedVarint(std::string& result, int64_t value){
+    appendVarint(result, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+inline void appendString(std::string& result, std::string_view value){
+    appendVarint(result, value.size());
+    result.append(value.data(), value.size());
+}
+
+/// \private
+class Cursor{
+
+public:
+    Cursor(const char* data, size_t size) : m_position(data), m_end(data + size){}
+
+    size_t remaining() const{ return static_cast<size_t>(m_end - m_position); }
+    const char* position() const{ return m_position; }
+
+    unsigned char readByte(){
+        require(1);
+        return static_cast<unsigned char>(*m_position++);
+    }
+
+    uint32_t readFixed32(){
+        require(4);
+        uint32_t value = binary::readFixed32(m_position);
+        m_position += 4;
+        return value;
+    }
+
+    uint64_t readFixed64(){
+        require(8);
+        uint64_t value = binary::readFixed64(m_position);
+        m_position += 8;
+        return value;
+    }
+
+    uint64_t readVarint(){
+        uint64_t value = 0;
+        for ( int shift = 0; shift < 64; shift += 7 ){
+            unsigned char byte = readByte();
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ( (byte & 0x80) == 0 )
+                return value;
+        }
+        THROW_EXCEPTION(lv::Exception, "Malformed binary data: variable length integer is too long.", lv::Exception::toCode("~Binary"));
+    }
+
+    int64_t readSignedVarint(){
+        uint64_t value = readVarint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    std::string_view readString(){
+        uint64_t size = readVarint();
+        require(size);
+        std::string_view result(m_position, static_cast<size_t>(size));
+        m_position += size;
+        return result;
+    }
+
+    void skip(size_t size){
+        require(size);
+        m_position += size;
+    }
+
+private:
+    void require(uint64_t size) const{
+        if ( size > remaining() )
+            THROW_EXCEPTION(lv::Exception, "Malformed binary data: unexpected end of data.", lv::Exception::toCode("~Binary"));
+    }
+
+    const char* m_position;
+    const char* m_end;
+};
+
+}} // namespace lv, binary
+
+#endif // LVBINARYENCODING_H
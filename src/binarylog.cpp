@@ -0,0 +1,1028 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#include "binarylog.h"
+#include "binaryencoding.h"
+#include "live/mlnodetobinary.h"
+#include "live/mlnodetojson.h"
+
+#include <fstream>
+#include <mutex>
+#include <map>
+#include <array>
+#include <limits>
+#include <algorithm>
+
+#if defined(__GNUC__) && !defined(__llvm__) && !defined(__INTEL_COMPILER)
+#  if(__GNUC__ > 7)
+#    include <filesystem>
+     namespace fs = std::filesystem;
+#  else
+#    include <experimental/filesystem>
+     namespace fs = std::experimental::filesystem;
+#  endif
+#else
+#  include <filesystem>
+   namespace fs = std::filesystem;
+#endif
+
+/**
+ * \page binarylogformat Binary log format
+ *
+ * A binary log starts with the 8 byte magic `LVBLOG01`, followed by entries. Each entry is a 32 bit little endian
+ * size, followed by that many bytes: a tag byte and the payload of the entry. Sizes and ids are variable length
+ * integers.
+ *
+ * * Block start (1) - 64 bit base stamp, in microseconds since epoch. Starts a new string and location table.
+ * * String (2) - the string bytes, which get the next string id of the block
+ * * Location (3) - remote, file and function string ids plus one (0 for none), and the line number. Gets the
+ *   next location id of the block.
+ * * Message (4) - stamp as a signed offset from the base stamp, a level byte, the configuration string id,
+ *   the location id plus one (0 for none), then the message bytes
+ * * Object (5) - same as a message, with the object type string id in place of the message, followed by the
+ *   object written with ml::toBinary()
+ * * Message with fields (6) - same as a message, with the message bytes prefixed by their size, followed by the
+ *   number of fields and each field: its key string id, a type byte (0 boolean, 1 integer, 2 float, 3 string)
+ *   and its value as a byte, a signed variable length integer, a 64 bit float, or a size prefixed string
+ *
+ * Since strings and locations are only defined within their block, each block can be decoded on its own.
+ * The index lives next to the log, with the `.idx` suffix. It starts with the magic `LVBIDX01` followed by a 40
+ * byte entry per closed block: offset, size, earliest stamp, latest stamp (64 bits each), the mask of levels found
+ * and the number of records (32 bits each). Blocks that were not indexed, for example after a crash, are found by
+ * scanning the log from the end of the last indexed block.
+ */
+
+namespace lv{
+
+namespace{
+
+const char   logMagic[]        = "LVBLOG01";
+const char   indexMagic[]      = "LVBIDX01";
+const size_t magicSize         = 8;
+const size_t entrySizeBytes    = 4;
+const size_t indexEntrySize    = 40;
+const size_t maximumEntrySize  = 256 * 1024 * 1024;
+
+enum EntryTag{
+    BlockStartTag = 1,
+    StringTag,
+    LocationTag,
+    MessageTag,
+    ObjectTag,
+    MessageFieldsTag
+};
+
+unsigned int levelBit(int level){
+    return 1u << static_cast<unsigned int>(level);
+}
+
+void throwCorrupt(const std::string& path, const char* reason){
+    THROW_EXCEPTION(
+        lv::Exception,
+        Utf8("Corrupt binary log \'%\': %").format(path, reason),
+        lv::Exception::toCode("~BinaryLog")
+    );
+}
+
+unsigned long long fileSize(const std::string& path){
+    std::error_code ec;
+    unsigned long long size = static_cast<unsigned long long>(fs::file_size(path, ec));
+    return ec ? 0 : size;
+}
+
+void readMagic(std::ifstream& file, const std::string& path){
+    char magic[magicSize];
+    file.seekg(0);
+    if ( !file.read(magic, magicSize) || std::memcmp(magic, logMagic, magicSize) != 0 ){
+        THROW_EXCEPTION(
+            lv::Exception,
+            Utf8("File is not a binary log: \'%\'").format(path),
+            lv::Exception::toCode("~BinaryLog")
+        );
+    }
+}
+
+void appendIndexEntry(std::string& result, const BinaryLogReader::Block& block){
+    binary::appendFixed64(result, block.offset);
+    binary::appendFixed64(result, block.size);
+    binary::appendFixed64(result, static_cast<uint64_t>(block.firstStamp));
+    binary::appendFixed64(result, static_cast<uint64_t>(block.lastStamp));
+    binary::appendFixed32(result, block.levelMask);
+    binary::appendFixed32(result, block.totalRecords);
+}
+
+/*
+ * Loads the index entries that describe consecutive blocks within the first \p logSize bytes of the log.
+ * Returns false if the index is missing or had to be cut short, in which case it needs to be rewritten.
+ */
+bool loadIndex(const std::string& indexPath, unsigned long long logSize, std::vector<BinaryLogReader::Block>& blocks){
+    std::ifstream index(indexPath, std::ios::in | std::ios::binary);
+    if ( !index.is_open() )
+        return false;
+
+    std::string contents((std::istreambuf_iterator<char>(index)), std::istreambuf_iterator<char>());
+    if ( contents.size() < magicSize || contents.compare(0, magicSize, indexMagic, magicSize) != 0 )
+        return false;
+
+    unsigned long long expectedOffset = magicSize;
+    size_t position = magicSize;
+    while ( position + indexEntrySize <= contents.size() ){
+        const char* data = contents.data() + position;
+        BinaryLogReader::Block block;
+        block.offset       = binary::readFixed64(data);
+        block.size         = binary::readFixed64(data + 8);
+        block.firstStamp   = static_cast<long long>(binary::readFixed64(data + 16));
+        block.lastStamp    = static_cast<long long>(binary::readFixed64(data + 24));
+        block.levelMask    = binary::readFixed32(data + 32);
+        block.totalRecords = binary::readFixed32(data + 36);
+
+        if ( block.offset != expectedOffset || block.size == 0 || block.offset + block.size > logSize )
+            return false;
+
+        blocks.push_back(block);
+        expectedOffset = block.offset + block.size;
+        position += indexEntrySize;
+    }
+    return position == contents.size();
+}
+
+/*
+ * Finds the blocks between \p offset and \p end by reading every entry, which is what the index saves readers
+ * from doing. Returns the offset after the last complete entry.
+ */
+unsigned long long scanBlocks(
+        std::ifstream& file,
+        const std::string& path,
+        unsigned long long offset,
+        unsigned long long end,
+        std::vector<BinaryLogReader::Block>& blocks)
+{
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(offset));
+
+    std::string entry;
+    bool hasBlock = false;
+    long long baseStamp = 0;
+
+    while ( offset + entrySizeBytes <= end ){
+        char sizeBytes[entrySizeBytes];
+        if ( !file.read(sizeBytes, entrySizeBytes) )
+            break;
+        unsigned long long entrySize = binary::readFixed32(sizeBytes);
+        if ( entrySize == 0 || entrySize > maximumEntrySize )
+            throwCorrupt(path, "invalid entry size.");
+        if ( offset + entrySizeBytes + entrySize > end )
+            break;
+
+        entry.resize(static_cast<size_t>(entrySize));
+        if ( !file.read(&entry[0], static_cast<std::streamsize>(entrySize)) )
+            break;
+
+        binary::Cursor cursor(entry.data(), entry.size());
+        unsigned char tag = cursor.readByte();
+        if ( tag == BlockStartTag ){
+            BinaryLogReader::Block block;
+            block.offset = offset;
+            block.firstStamp = std::numeric_limits<long long>::max();
+            block.lastStamp  = std::numeric_limits<long long>::min();
+            blocks.push_back(block);
+            baseStamp = static_cast<long long>(cursor.readFixed64());
+            hasBlock = true;
+        } else if ( !hasBlock ){
+            throwCorrupt(path, "entry found outside of a block.");
+        } else if ( tag == MessageTag || tag == ObjectTag || tag == MessageFieldsTag ){
+            BinaryLogReader::Block& block = blocks.back();
+            long long stamp = baseStamp + cursor.readSignedVarint();
+            block.firstStamp = std::min(block.firstStamp, stamp);
+            block.lastStamp  = std::max(block.lastStamp, stamp);
+            block.levelMask |= levelBit(cursor.readByte() % 8);
+            ++block.totalRecords;
+        }
+
+        offset += entrySizeBytes + entrySize;
+        blocks.back().size = offset - blocks.back().offset;
+    }
+
+    // blocks that only hold definitions are still indexed, with a range matching no query
+    return offset;
+}
+
+} // namespace
+
+
+// BinaryLogRecord
+// ----------------------------------------------------------------------------
+
+/** \brief Default constructor */
+BinaryLogRecord::BinaryLogRecord()
+    : kind(BinaryLogRecord::Message)
+    , level(VisualLog::MessageInfo::Info)
+    , line(0)
+{
+}
+
+/**
+ * \brief Appends the record as text to \p result
+ *
+ * The line starts with the stamp, level, configuration and location. Objects are written the same way
+ * VisualLog::asObject writes them to text files, as their type followed by their json on the next line.
+ */
+void BinaryLogRecord::appendText(std::string &result) const{
+    size_t start = result.size();
+    result.append(stamp.toString());
+    result.push_back(' ');
+    result.append(VisualLog::MessageInfo::levelToString(level));
+    result.append(" [");
+    result.append(configuration);
+    result.append("] ");
+    if ( !remote.empty() ){
+        result.append(remote);
+        result.append("> ");
+    }
+    if ( !file.empty() ){
+        result.append(file);
+        result.push_back(':');
+        result.append(std::to_string(line));
+        result.push_back(' ');
+    }
+    if ( !functionName.empty() ){
+        result.append(functionName);
+        result.append(": ");
+    }
+
+    if ( kind == BinaryLogRecord::Object ){
+        size_t prefixSize = result.size() - start;
+        std::string json;
+        ml::toJson(object, json);
+        result.append("\\@");
+        result.append(type);
+        result.push_back('\n');
+        result.append(prefixSize, ' ');
+        result.append(json);
+    } else {
+        result.append(message);
+        if ( !fields.empty() ){
+            result.push_back(' ');
+            fields.appendText(result);
+        }
+    }
+    result.push_back('\n');
+}
+
+
+// BinaryLogWriterPrivate
+// ----------------------------------------------------------------------------
+
+/// \private
+class BinaryLogWriterPrivate{
+
+public:
+    BinaryLogWriterPrivate(const std::string& p, size_t bs)
+        : path(p)
+        , indexPath(BinaryLogReader::indexPath(p))
+        , blockSize(bs)
+        , offset(0)
+        , blockOpen(false)
+        , baseStamp(0)
+        , entryStart(0)
+    {}
+
+    void open();
+    void closeBlock();
+
+    void beginRecord(
+        EntryTag tag,
+        const DateTime& stamp,
+        VisualLog::MessageInfo::Level level,
+        std::string_view configuration,
+        const BinaryLogWriter::Location& location,
+        std::string_view objectType = std::string_view(),
+        const VisualLog::Fields* fields = nullptr);
+    void appendFields(const VisualLog::Fields& fields);
+    void commit(bool flush);
+
+    uint32_t internString(std::string_view value);
+    uint64_t internOptionalString(std::string_view value){ return value.empty() ? 0 : internString(value) + 1; }
+    uint32_t internLocation(const BinaryLogWriter::Location& location);
+
+    void beginEntry(EntryTag tag);
+    void endEntry();
+
+    std::mutex    mutex;
+    std::string   path;
+    std::string   indexPath;
+    size_t        blockSize;
+    std::ofstream file;
+    std::ofstream index;
+
+    unsigned long long        offset;
+    bool                      blockOpen;
+    BinaryLogReader::Block    block;
+    long long                 baseStamp;
+    std::map<std::string, uint32_t, std::less<> >   strings;
+    std::map<std::array<uint64_t, 4>, uint32_t>     locations;
+    std::vector<uint32_t>                           fieldKeys;
+
+    std::string pending;
+    size_t      entryStart;
+};
+
+/*
+ * Opens the log for appending. Blocks written after the last indexed one, such as the block that was open
+ * when a previous writer crashed, are indexed first, and a partially written trailing entry is cut off.
+ */
+void BinaryLogWriterPrivate::open(){
+    unsigned long long size = fileSize(path);
+
+    std::vector<BinaryLogReader::Block> blocks;
+    bool indexValid = false;
+    unsigned long long indexedBlocks = 0;
+
+    if ( size == 0 ){
+        file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if ( !file.is_open() )
+            THROW_EXCEPTION(lv::Exception, Utf8("Failed to open binary log: \'%\'").format(path), lv::Exception::toCode("~BinaryLog"));
+        file.write(logMagic, magicSize);
+        size = magicSize;
+    } else {
+        std::ifstream input(path, std::ios::in | std::ios::binary);
+        if ( !input.is_open() )
+            THROW_EXCEPTION(lv::Exception, Utf8("Failed to open binary log: \'%\'").format(path), lv::Exception::toCode("~BinaryLog"));
+        readMagic(input, path);
+
+        indexValid = loadIndex(indexPath, size, blocks);
+        indexedBlocks = indexValid ? blocks.size() : 0;
+        if ( !indexValid )
+            blocks.clear();
+
+        unsigned long long indexedEnd = blocks.empty() ? magicSize : blocks.back().offset + blocks.back().size;
+        unsigned long long validEnd = scanBlocks(input, path, indexedEnd, size, blocks);
+        input.close();
+
+        if ( validEnd < size ){
+            fs::resize_file(path, validEnd);
+            size = validEnd;
+        }
+
+        file.open(path, std::ios::out | std::ios::binary | std::ios::app);
+        if ( !file.is_open() )
+            THROW_EXCEPTION(lv::Exception, Utf8("Failed to open binary log: \'%\'").format(path), lv::Exception::toCode("~BinaryLog"));
+    }
+
+    std::string indexEntries;
+    if ( indexValid ){
+        index.open(indexPath, std::ios::out | std::ios::binary | std::ios::app);
+    } else {
+        index.open(indexPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        indexEntries.append(indexMagic, magicSize);
+    }
+    if ( !index.is_open() )
+        THROW_EXCEPTION(lv::Exception, Utf8("Failed to open binary log index: \'%\'").format(indexPath), lv::Exception::toCode("~BinaryLog"));
+
+    for ( size_t i = static_cast<size_t>(indexedBlocks); i < blocks.size(); ++i )
+        appendIndexEntry(indexEntries, blocks[i]);
+    index.write(indexEntries.data(), static_cast<std::streamsize>(indexEntries.size()));
+    index.flush();
+
+    offset = size;
+    blockOpen = false;
+}
+
+void BinaryLogWriterPrivate::closeBlock(){
+    if ( !blockOpen )
+        return;
+
+    std::string entry;
+    appendIndexEntry(entry, block);
+    index.write(entry.data(), static_cast<std::streamsize>(entry.size()));
+    index.flush();
+    blockOpen = false;
+}
+
+void BinaryLogWriterPrivate::beginEntry(EntryTag tag){
+    entryStart = pending.size();
+    pending.append(entrySizeBytes, '\0');
+    pending.push_back(static_cast<char>(tag));
+}
+
+void BinaryLogWriterPrivate::endEntry(){
+    binary::writeFixed32(&pending[entryStart], static_cast<uint32_t>(pending.size() - entryStart - entrySizeBytes));
+}
+
+uint32_t BinaryLogWriterPrivate::internString(std::string_view value){
+    auto it = strings.find(value);
+    if ( it != strings.end() )
+        return it->second;
+
+    uint32_t id = static_cast<uint32_t>(strings.size());
+    strings.emplace(std::string(value), id);
+
+    beginEntry(StringTag);
+    pending.append(value.data(), value.size());
+    endEntry();
+
+    return id;
+}
+
+uint32_t BinaryLogWriterPrivate::internLocation(const BinaryLogWriter::Location &location){
+    std::array<uint64_t, 4> key = {
+        internOptionalString(location.remote),
+        internOptionalString(location.file),
+        static_cast<uint64_t>(location.line),
+        internOptionalString(location.functionName)
+    };
+
+    auto it = locations.find(key);
+    if ( it != locations.end() )
+        return it->second;
+
+    uint32_t id = static_cast<uint32_t>(locations.size());
+    locations.emplace(key, id);
+
+    beginEntry(LocationTag);
+    for ( uint64_t value : key )
+        binary::appendVarint(pending, value);
+    endEntry();
+
+    return id;
+}
+
+void BinaryLogWriterPrivate::beginRecord(
+        EntryTag tag,
+        const DateTime &stamp,
+        VisualLog::MessageInfo::Level level,
+        std::string_view configuration,
+        const BinaryLogWriter::Location &location,
+        std::string_view objectType,
+        const VisualLog::Fields* fields)
+{
+    if ( !file.is_open() )
+        open();
+
+    long long ticks = stamp.usecondsSinceEpoch();
+    if ( !blockOpen ){
+        blockOpen = true;
+        block = BinaryLogReader::Block();
+        block.offset     = offset;
+        block.firstStamp = ticks;
+        block.lastStamp  = ticks;
+        baseStamp = ticks;
+        strings.clear();
+        locations.clear();
+
+        beginEntry(BlockStartTag);
+        binary::appendFixed64(pending, static_cast<uint64_t>(ticks));
+        endEntry();
+    }
+
+    uint32_t configurationId = internString(configuration);
+    uint64_t locationId = 0;
+    if ( !location.file.empty() || !location.functionName.empty() || !location.remote.empty() )
+        locationId = internLocation(location) + 1;
+    uint32_t typeId = tag == ObjectTag ? internString(objectType) : 0;
+
+    // keys are interned before the record starts, since their definitions are entries of their own
+    fieldKeys.clear();
+    if ( fields ){
+        for ( size_t i = 0; i < fields->size(); ++i )
+            fieldKeys.push_back(internString(fields->at(i).key()));
+    }
+
+    beginEntry(tag);
+    binary::appendSignedVarint(pending, ticks - baseStamp);
+    pending.push_back(static_cast<char>(level));
+    binary::appendVarint(pending, configurationId);
+    binary::appendVarint(pending, locationId);
+    if ( tag == ObjectTag )
+        binary::appendVarint(pending, typeId);
+
+    block.firstStamp = std::min(block.firstStamp, ticks);
+    block.lastStamp  = std::max(block.lastStamp, ticks);
+    block.levelMask |= levelBit(level);
+    ++block.totalRecords;
+}
+
+void BinaryLogWriterPrivate::appendFields(const VisualLog::Fields &fields){
+    binary::appendVarint(pending, fields.size());
+    for ( size_t i = 0; i < fields.size(); ++i ){
+        VisualLog::Field field = fields.at(i);
+        binary::appendVarint(pending, fieldKeys[i]);
+        pending.push_back(static_cast<char>(field.type()));
+        switch( field.type() ){
+        case VisualLog::Field::Boolean:
+            pending.push_back(field.asBool() ? 1 : 0);
+            break;
+        case VisualLog::Field::Integer:
+            binary::appendSignedVarint(pending, field.asInt());
+            break;
+        case VisualLog::Field::Float:{
+            double number = field.asFloat();
+            uint64_t bits = 0;
+            std::memcpy(&bits, &number, sizeof(bits));
+            binary::appendFixed64(pending, bits);
+            break;
+        }
+        case VisualLog::Field::String:
+            binary::appendString(pending, field.asString());
+            break;
+        }
+    }
+}
+
+void BinaryLogWriterPrivate::commit(bool flush){
+    endEntry();
+
+    file.write(pending.data(), static_cast<std::streamsize>(pending.size()));
+    offset += pending.size();
+    block.size = offset - block.offset;
+    pending.clear();
+
+    if ( block.size >= blockSize ){
+        file.flush();
+        closeBlock();
+    } else if ( flush ){
+        file.flush();
+    }
+}
+
+
+// BinaryLogWriter
+// ----------------------------------------------------------------------------
+
+/**
+ * \brief Opens the binary log at \p path for appending, creating it if it doesn't exist
+ *
+ * Records are grouped in blocks of about \p blockSize bytes. A block gets indexed once it's full,
+ * or when the writer is flushed through close(). Throws an lv::Exception if the log cannot be opened,
+ * or if the file is not a binary log.
+ */
+BinaryLogWriter::BinaryLogWriter(const std::string &path, size_t blockSize)
+    : m_d(new BinaryLogWriterPrivate(path, blockSize))
+{
+    try{
+        m_d->open();
+    } catch ( ... ){
+        delete m_d;
+        throw;
+    }
+}
+
+/** \brief Destructor, closes the log */
+BinaryLogWriter::~BinaryLogWriter(){
+    close();
+    delete m_d;
+}
+
+/**
+ * \brief Appends a message
+ *
+ * With \p flush set, the message is handed to the operating system before returning.
+ */
+void BinaryLogWriter::writeMessage(
+        const DateTime &stamp,
+        VisualLog::MessageInfo::Level level,
+        std::string_view configuration,
+        const BinaryLogWriter::Location &location,
+        std::string_view message,
+        bool flush)
+{
+    std::lock_guard<std::mutex> guard(m_d->mutex);
+    m_d->beginRecord(MessageTag, stamp, level, configuration, location);
+    m_d->pending.append(message.data(), message.size());
+    m_d->commit(flush);
+}
+
+/**
+ * \brief Appends a message with typed \p fields
+ *
+ * Field keys are stored once per block, values keep their types.
+ */
+void BinaryLogWriter::writeMessage(
+        const DateTime &stamp,
+        VisualLog::MessageInfo::Level level,
+        std::string_view configuration,
+        const BinaryLogWriter::Location &location,
+        std::string_view message,
+        const VisualLog::Fields &fields,
+        bool flush)
+{
+    if ( fields.empty() ){
+        writeMessage(stamp, level, configuration, location, message, flush);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_d->mutex);
+    m_d->beginRecord(MessageFieldsTag, stamp, level, configuration, location, std::string_view(), &fields);
+    binary::appendString(m_d->pending, message);
+    m_d->appendFields(fields);
+    m_d->commit(flush);
+}
+
+/**
+ * \brief Appends an object of type \p type
+ */
+void BinaryLogWriter::writeObject(
+        const DateTime &stamp,
+        VisualLog::MessageInfo::Level level,
+        std::string_view configuration,
+        const BinaryLogWriter::Location &location,
+        std::string_view type,
+        const MLNode &object,
+        bool flush)
+{
+    std::lock_guard<std::mutex> guard(m_d->mutex);
+    m_d->beginRecord(ObjectTag, stamp, level, configuration, location, type);
+    ml::toBinary(object, m_d->pending);
+    m_d->commit(flush);
+}
+
+/**
+ * \brief Appends a decoded record, as read by a BinaryLogReader
+ */
+void BinaryLogWriter::write(const BinaryLogRecord &record, bool flush){
+    BinaryLogWriter::Location location(record.remote, record.file, record.line, record.functionName);
+    if ( record.kind == BinaryLogRecord::Object ){
+        writeObject(record.stamp, record.level, record.configuration, location, record.type, record.object, flush);
+    } else {
+        writeMessage(record.stamp, record.level, record.configuration, location, record.message, record.fields, flush);
+    }
+}
+
+/**
+ * \brief Hands written records to the operating system
+ */
+void BinaryLogWriter::flush(){
+    std::lock_guard<std::mutex> guard(m_d->mutex);
+    if ( m_d->file.is_open() )
+        m_d->file.flush();
+}
+
+/**
+ * \brief Hands written records to the operating system, unless the log is in use
+ *
+ * Returns false without waiting if another thread, or the calling one, is writing to the log.
+ */
+bool BinaryLogWriter::tryFlush(){
+    std::unique_lock<std::mutex> guard(m_d->mutex, std::try_to_lock);
+    if ( !guard.owns_lock() || !m_d->file.is_open() )
+        return false;
+    m_d->file.flush();
+    return true;
+}
+
+/**
+ * \brief Indexes the current block and closes the log
+ *
+ * Writing after close() opens the log again and starts a new block.
+ */
+void BinaryLogWriter::close(){
+    std::lock_guard<std::mutex> guard(m_d->mutex);
+    if ( m_d->file.is_open() ){
+        m_d->file.flush();
+        m_d->closeBlock();
+        m_d->file.close();
+        m_d->index.close();
+    }
+}
+
+/**
+ * \brief Returns the path of the log
+ */
+const std::string &BinaryLogWriter::path() const{
+    return m_d->path;
+}
+
+
+// BinaryLogReader::Query
+// ----------------------------------------------------------------------------
+
+/**
+ * \brief Creates a query matching all records
+ */
+BinaryLogReader::Query::Query()
+    : m_from(std::numeric_limits<long long>::min())
+    , m_to(std::numeric_limits<long long>::max())
+    , m_level(VisualLog::MessageInfo::Verbose)
+{
+}
+
+/**
+ * \brief Skips records logged before \p stamp
+ *
+ * Stamps are compared as the writer received them, which for VisualLog is the local time.
+ */
+BinaryLogReader::Query &BinaryLogReader::Query::from(const DateTime &stamp){
+    m_from = stamp.usecondsSinceEpoch();
+    return *this;
+}
+
+/**
+ * \brief Skips records logged after \p stamp
+ */
+BinaryLogReader::Query &BinaryLogReader::Query::to(const DateTime &stamp){
+    m_to = stamp.usecondsSinceEpoch();
+    return *this;
+}
+
+/**
+ * \brief Skips records less important than \p level
+ */
+BinaryLogReader::Query &BinaryLogReader::Query::level(VisualLog::MessageInfo::Level level){
+    m_level = level;
+    return *this;
+}
+
+/**
+ * \brief Returns true if \p block may hold records matching the query
+ */
+bool BinaryLogReader::Query::matchesBlock(const BinaryLogReader::Block &block) const{
+    unsigned int levels = levelBit(m_level + 1) - 1;
+    return block.lastStamp >= m_from && block.firstStamp <= m_to && (block.levelMask & levels) != 0;
+}
+
+
+// BinaryLogReaderPrivate
+// ----------------------------------------------------------------------------
+
+/// \private
+class BinaryLogReaderPrivate{
+
+public:
+    class Location{
+    public:
+        std::string_view remote;
+        std::string_view file;
+        int              line;
+        std::string_view functionName;
+    };
+
+    bool readBlock(const BinaryLogReader::Block& block, const BinaryLogReader::Query& query, const BinaryLogReader::RecordHandler& handler);
+    void readFields(binary::Cursor& cursor);
+
+    std::string_view stringAt(uint64_t id) const{
+        if ( id >= strings.size() )
+            throwCorrupt(path, "undefined string.");
+        return strings[static_cast<size_t>(id)];
+    }
+    std::string_view optionalStringAt(uint64_t id) const{
+        return id == 0 ? std::string_view() : stringAt(id - 1);
+    }
+
+    std::string                         path;
+    std::ifstream                       file;
+    std::vector<BinaryLogReader::Block> blocks;
+
+    std::string                   buffer;
+    std::vector<std::string_view> strings;
+    std::vector<Location>         locations;
+    BinaryLogRecord               record;
+};
+
+void BinaryLogReaderPrivate::readFields(binary::Cursor &cursor){
+    uint64_t count = cursor.readVarint();
+    for ( uint64_t i = 0; i < count; ++i ){
+        std::string_view key = stringAt(cursor.readVarint());
+        switch( cursor.readByte() ){
+        case VisualLog::Field::Boolean:
+            record.fields.addBoolean(key, cursor.readByte() != 0);
+            break;
+        case VisualLog::Field::Integer:
+            record.fields.addInteger(key, cursor.readSignedVarint());
+            break;
+        case VisualLog::Field::Float:{
+            uint64_t bits = cursor.readFixed64();
+            double number = 0;
+            std::memcpy(&number, &bits, sizeof(number));
+            record.fields.addFloat(key, number);
+            break;
+        }
+        case VisualLog::Field::String:
+            record.fields.addString(key, cursor.readString());
+            break;
+        default:
+            throwCorrupt(path, "unknown field type.");
+        }
+    }
+}
+
+bool BinaryLogReaderPrivate::readBlock(
+        const BinaryLogReader::Block &block,
+        const BinaryLogReader::Query &query,
+        const BinaryLogReader::RecordHandler &handler)
+{
+    buffer.resize(static_cast<size_t>(block.size));
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(block.offset));
+    if ( !file.read(&buffer[0], static_cast<std::streamsize>(block.size)) )
+        throwCorrupt(path, "block is outside of the file.");
+
+    strings.clear();
+    locations.clear();
+    long long baseStamp = 0;
+
+    binary::Cursor blockCursor(buffer.data(), buffer.size());
+    while ( blockCursor.remaining() > 0 ){
+        uint32_t entrySize = blockCursor.readFixed32();
+        binary::Cursor cursor(blockCursor.position(), entrySize);
+        blockCursor.skip(entrySize);
+
+        unsigned char tag = cursor.readByte();
+        switch( tag ){
+        case BlockStartTag:
+            baseStamp = static_cast<long long>(cursor.readFixed64());
+            strings.clear();
+            locations.clear();
+            break;
+        case StringTag:
+            strings.push_back(std::string_view(cursor.position(), cursor.remaining()));
+            break;
+        case LocationTag:{
+            Location location;
+            location.remote       = optionalStringAt(cursor.readVarint());
+            location.file         = optionalStringAt(cursor.readVarint());
+            location.line         = static_cast<int>(cursor.readVarint());
+            location.functionName = optionalStringAt(cursor.readVarint());
+            locations.push_back(location);
+            break;
+        }
+        case MessageTag:
+        case ObjectTag:
+        case MessageFieldsTag:{
+            long long stamp = baseStamp + cursor.readSignedVarint();
+            int level = cursor.readByte();
+            if ( stamp < query.fromStamp() || stamp > query.toStamp() || level > query.level() )
+                break;
+
+            record.kind          = tag == ObjectTag ? BinaryLogRecord::Object : BinaryLogRecord::Message;
+            record.stamp         = DateTime::createFromUs(stamp);
+            record.level         = static_cast<VisualLog::MessageInfo::Level>(level);
+            record.configuration.assign(stringAt(cursor.readVarint()));
+
+            uint64_t locationId = cursor.readVarint();
+            if ( locationId > locations.size() )
+                throwCorrupt(path, "undefined location.");
+            if ( locationId > 0 ){
+                const Location& location = locations[static_cast<size_t>(locationId - 1)];
+                record.remote.assign(location.remote);
+                record.file.assign(location.file);
+                record.line = location.line;
+                record.functionName.assign(location.functionName);
+            } else {
+                record.remote.clear();
+                record.file.clear();
+                record.line = 0;
+                record.functionName.clear();
+            }
+
+            record.fields.clear();
+            if ( tag == ObjectTag ){
+                record.type.assign(stringAt(cursor.readVarint()));
+                record.message.clear();
+                ml::fromBinary(cursor.position(), cursor.remaining(), record.object);
+            } else if ( tag == MessageFieldsTag ){
+                record.type.clear();
+                record.object = MLNode();
+                std::string_view message = cursor.readString();
+                record.message.assign(message.data(), message.size());
+                readFields(cursor);
+            } else {
+                record.type.clear();
+                record.object = MLNode();
+                record.message.assign(cursor.position(), cursor.remaining());
+            }
+
+            if ( !handler(record) )
+                return false;
+            break;
+        }
+        default:
+            throwCorrupt(path, "unknown entry.");
+        }
+    }
+    return true;
+}
+
+
+// BinaryLogReader
+// ----------------------------------------------------------------------------
+
+/**
+ * \brief Opens the binary log at \p path for reading
+ *
+ * The block index is loaded from the index file. Blocks missing from it, i.e. the block a writer is
+ * currently filling, are found by scanning the end of the log. Throws an lv::Exception if the file
+ * cannot be opened or is not a binary log.
+ */
+BinaryLogReader::BinaryLogReader(const std::string &path)
+    : m_d(new BinaryLogReaderPrivate)
+{
+    m_d->path = path;
+    m_d->file.open(path, std::ios::in | std::ios::binary);
+    if ( !m_d->file.is_open() ){
+        delete m_d;
+        THROW_EXCEPTION(lv::Exception, Utf8("Failed to open binary log: \'%\'").format(path), lv::Exception::toCode("~BinaryLog"));
+    }
+
+    try{
+        readMagic(m_d->file, path);
+        unsigned long long size = fileSize(path);
+        if ( !loadIndex(indexPath(path), size, m_d->blocks) )
+            m_d->blocks.clear();
+
+        unsigned long long indexedEnd = m_d->blocks.empty() ? magicSize : m_d->blocks.back().offset + m_d->blocks.back().size;
+        scanBlocks(m_d->file, path, indexedEnd, size, m_d->blocks);
+    } catch ( ... ){
+        delete m_d;
+        throw;
+    }
+}
+
+/** \brief Destructor */
+BinaryLogReader::~BinaryLogReader(){
+    delete m_d;
+}
+
+/**
+ * \brief Returns the blocks of the log, in file order
+ */
+const std::vector<BinaryLogReader::Block> &BinaryLogReader::blocks() const{
+    return m_d->blocks;
+}
+
+/**
+ * \brief Reads all records, in file order
+ */
+void BinaryLogReader::read(const BinaryLogReader::RecordHandler &handler) const{
+    read(BinaryLogReader::Query(), handler);
+}
+
+/**
+ * \brief Reads the records matching \p query, in file order
+ *
+ * Only blocks whose index entry overlaps the time range and holds a matching level are read from disk.
+ * Throws an lv::Exception if a block is malformed.
+ */
+void BinaryLogReader::read(const BinaryLogReader::Query &query, const BinaryLogReader::RecordHandler &handler) const{
+    for ( auto it = m_d->blocks.begin(); it != m_d->blocks.end(); ++it ){
+        if ( query.matchesBlock(*it) && !m_d->readBlock(*it, query, handler) )
+            return;
+    }
+}
+
+/**
+ * \brief Appends the records matching \p query to \p result as text, one line per message
+ */
+void BinaryLogReader::toText(const BinaryLogReader::Query &query, std::string &result) const{
+    read(query, [&result](const BinaryLogRecord& record){
+        record.appendText(result);
+        return true;
+    });
+}
+
+/**
+ * \brief Rebuilds the index of the binary log at \p path by scanning all of its entries
+ *
+ * Returns the number of indexed blocks.
+ */
+size_t BinaryLogReader::buildIndex(const std::string &path){
+    std::ifstream input(path, std::ios::in | std::ios::binary);
+    if ( !input.is_open() )
+        THROW_EXCEPTION(lv::Exception, Utf8("Failed to open binary log: \'%\'").format(path), lv::Exception::toCode("~BinaryLog"));
+    readMagic(input, path);
+
+    std::vector<BinaryLogReader::Block> blocks;
+    scanBlocks(input, path, magicSize, fileSize(path), blocks);
+
+    std::string contents(indexMagic, magicSize);
+    for ( auto it = blocks.begin(); it != blocks.end(); ++it )
+        appendIndexEntry(contents, *it);
+
+    std::ofstream index(indexPath(path), std::ios::out | std::ios::binary | std::ios::trunc);
+    if ( !index.is_open() )
+        THROW_EXCEPTION(lv::Exception, Utf8("Failed to write binary log index: \'%\'").format(indexPath(path)), lv::Exception::toCode("~BinaryLog"));
+    index.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+
+    return blocks.size();
+}
+
+/**
+ * \brief Returns the path of the index file for the log at \p path
+ */
+std::string BinaryLogReader::indexPath(const std::string &path){
+    return path + ".idx";
+}
+
+}// namespace
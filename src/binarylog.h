@@ -0,0 +1,250 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#ifndef LVBINARYLOG_H
+#define LVBINARYLOG_H
+
+#include "live/lvbaseglobal.h"
+#include "live/visuallog.h"
+#include "live/datetime.h"
+#include "live/mlnode.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+
+namespace lv{
+
+/**
+ * \class lv::BinaryLogRecord
+ * \brief Decoded entry of a binary log, either a message or an object
+ *
+ * \ingroup lvbase
+ */
+class LV_BASE_EXPORT BinaryLogRecord{
+
+public:
+    /** Kind of the logged entry */
+    enum Kind{
+        /** Text message */
+        Message = 0,
+        /** Object logged through VisualLog::asObject */
+        Object
+    };
+
+public:
+    BinaryLogRecord();
+
+    void appendText(std::string& result) const;
+
+    /** Message or object */
+    Kind kind;
+    /** Time the entry was logged at, as given to the writer */
+    DateTime stamp;
+    /** Message level */
+    VisualLog::MessageInfo::Level level;
+    /** Name of the logger configuration */
+    std::string configuration;
+    /** Remote of the source location, if any */
+    std::string remote;
+    /** Source file, if any */
+    std::string file;
+    /** Source line, or 0 */
+    int line;
+    /** Source function, if any */
+    std::string functionName;
+    /** Text of the message, for message entries */
+    std::string message;
+    /** Typed fields of the message, for message entries */
+    VisualLog::Fields fields;
+    /** Type of the object, for object entries */
+    std::string type;
+    /** Value of the object, for object entries */
+    MLNode object;
+};
+
+class BinaryLogWriterPrivate;
+
+/**
+ * \class lv::BinaryLogWriter
+ * \brief Appends log entries to a binary log file and keeps its block index up to date
+ *
+ * \ingroup lvbase
+ */
+class LV_BASE_EXPORT BinaryLogWriter{
+
+public:
+    /**
+     * \class lv::BinaryLogWriter::Location
+     * \brief Source location of an entry, referencing the caller's strings
+     *
+     * \ingroup lvbase
+     */
+    class Location{
+    public:
+        Location(std::string_view r = std::string_view(), std::string_view f = std::string_view(), int l = 0, std::string_view fn = std::string_view())
+            : remote(r), file(f), line(l), functionName(fn){}
+
+        /** Remote */
+        std::string_view remote;
+        /** File */
+        std::string_view file;
+        /** Line number */
+        int              line;
+        /** Function name */
+        std::string_view functionName;
+    };
+
+    /** Size after which the current block is closed and indexed */
+    static const size_t defaultBlockSize = 256 * 1024;
+
+public:
+    BinaryLogWriter(const std::string& path, size_t blockSize = defaultBlockSize);
+    ~BinaryLogWriter();
+
+    void writeMessage(
+        const DateTime& stamp,
+        VisualLog::MessageInfo::Level level,
+        std::string_view configuration,
+        const Location& location,
+        std::string_view message,
+        bool flush = false
+    );
+    void writeMessage(
+        const DateTime& stamp,
+        VisualLog::MessageInfo::Level level,
+        std::string_view configuration,
+        const Location& location,
+        std::string_view message,
+        const VisualLog::Fields& fields,
+        bool flush = false
+    );
+    void writeObject(
+        const DateTime& stamp,
+        VisualLog::MessageInfo::Level level,
+        std::string_view configuration,
+        const Location& location,
+        std::string_view type,
+        const MLNode& object,
+        bool flush = false
+    );
+    void write(const BinaryLogRecord& record, bool flush = false);
+
+    void flush();
+    bool tryFlush();
+    void close();
+
+    const std::string& path() const;
+
+private:
+    DISABLE_COPY(BinaryLogWriter);
+
+    BinaryLogWriterPrivate* m_d;
+};
+
+class BinaryLogReaderPrivate;
+
+/**
+ * \class lv::BinaryLogReader
+ * \brief Reads a binary log, seeking through its block index by time range and level
+ *
+ * \ingroup lvbase
+ */
+class LV_BASE_EXPORT BinaryLogReader{
+
+public:
+    /**
+     * \class lv::BinaryLogReader::Block
+     * \brief Index entry of a block of records
+     *
+     * \ingroup lvbase
+     */
+    class Block{
+    public:
+        Block() : offset(0), size(0), firstStamp(0), lastStamp(0), levelMask(0), totalRecords(0){}
+
+        /** Offset of the block within the log file */
+        unsigned long long offset;
+        /** Size of the block in bytes */
+        unsigned long long size;
+        /** Earliest record stamp, in microseconds since epoch */
+        long long          firstStamp;
+        /** Latest record stamp, in microseconds since epoch */
+        long long          lastStamp;
+        /** Bit 1 << level is set for each level found in the block */
+        unsigned int       levelMask;
+        /** Number of message and object records */
+        unsigned int       totalRecords;
+    };
+
+    /**
+     * \class lv::BinaryLogReader::Query
+     * \brief Time range and level filter for reading records
+     *
+     * Both ends of the range are inclusive. Only records at least as important as level() are read.
+     *
+     * \ingroup lvbase
+     */
+    class LV_BASE_EXPORT Query{
+    public:
+        Query();
+
+        Query& from(const DateTime& stamp);
+        Query& to(const DateTime& stamp);
+        Query& level(VisualLog::MessageInfo::Level level);
+
+        /** Start of the range, in microseconds since epoch */
+        long long fromStamp() const{ return m_from; }
+        /** End of the range, in microseconds since epoch */
+        long long toStamp() const{ return m_to; }
+        /** Least important level that's read */
+        VisualLog::MessageInfo::Level level() const{ return m_level; }
+
+        bool matchesBlock(const Block& block) const;
+
+    private:
+        long long                     m_from;
+        long long                     m_to;
+        VisualLog::MessageInfo::Level m_level;
+    };
+
+    /** Called for each record read, returning false stops reading */
+    typedef std::function<bool(const BinaryLogRecord&)> RecordHandler;
+
+public:
+    BinaryLogReader(const std::string& path);
+    ~BinaryLogReader();
+
+    const std::vector<Block>& blocks() const;
+
+    void read(const RecordHandler& handler) const;
+    void read(const Query& query, const RecordHandler& handler) const;
+
+    void toText(const Query& query, std::string& result) const;
+
+    static size_t buildIndex(const std::string& path);
+    static std::string indexPath(const std::string& path);
+
+private:
+    DISABLE_COPY(BinaryLogReader);
+
+    BinaryLogReaderPrivate* m_d;
+};
+
+}// namespace
+
+#endif // LVBINARYLOG_H
@@ -0,0 +1,209 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+#ifndef LVBOUNDEDQUEUE_H
+#define LVBOUNDEDQUEUE_H
+
+#include "live/lvbaseglobal.h"
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace lv{
+
+/**
+ * \class lv::BoundedQueue
+ * \brief Fixed capacity lock-free queue for multiple producers and consumers
+ *
+ * Each slot carries a sequence number that tells producers and consumers whose turn it is to use it,
+ * so a push or a pop costs one compare-and-swap on the shared position plus one store on the slot.
+ * The capacity is rounded up to a power of two. tryPush() and tryPop() never block, they fail when
+ * the queue is full or empty respectively.
+ *
+ * tryPushSwap() and tryPopSwap() exchange values with the slot instead of moving them, so callers
+ * recycling their values get back whatever storage the slot held before, instead of an empty value.
+ *
+ * \ingroup lvbase
+ */
+template<typename T>
+class BoundedQueue{
+
+public:
+    explicit BoundedQueue(size_t capacity);
+    ~BoundedQueue();
+
+    bool tryPush(T&& value);
+    bool tryPop(T& value);
+    bool tryPushSwap(T& value);
+    bool tryPopSwap(T& value);
+
+    size_t capacity() const{ return m_mask + 1; }
+    size_t sizeApproximate() const;
+
+private:
+    DISABLE_COPY(BoundedQueue);
+
+    static const size_t cacheLine = 64;
+
+    class Slot{
+    public:
+        std::atomic<size_t> sequence;
+        T                   value;
+    };
+
+    Slot* claimPush(size_t& position);
+    Slot* claimPop(size_t& position);
+
+    Slot*  m_slots;
+    size_t m_mask;
+
+    alignas(cacheLine) std::atomic<size_t> m_pushPosition;
+    alignas(cacheLine) std::atomic<size_t> m_popPosition;
+};
+
+template<typename T>
+BoundedQueue<T>::BoundedQueue(size_t capacity)
+    : m_slots(nullptr)
+    , m_mask(0)
+    , m_pushPosition(0)
+    , m_popPosition(0)
+{
+    size_t size = 2;
+    while ( size < capacity )
+        size <<= 1;
+
+    m_slots = new Slot[size];
+    m_mask  = size - 1;
+    for ( size_t i = 0; i < size; ++i )
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template<typename T>
+BoundedQueue<T>::~BoundedQueue(){
+    delete[] m_slots;
+}
+
+/**
+ * \brief Moves \p value into the queue, returns false if the queue is full
+ */
+template<typename T>
+bool BoundedQueue<T>::tryPush(T &&value){
+    size_t position;
+    Slot* slot = claimPush(position);
+    if ( !slot )
+        return false;
+    slot->value = std::move(value);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * \brief Moves the oldest value out of the queue into \p value, returns false if the queue is empty
+ */
+template<typename T>
+bool BoundedQueue<T>::tryPop(T &value){
+    size_t position;
+    Slot* slot = claimPop(position);
+    if ( !slot )
+        return false;
+    value = std::move(slot->value);
+    slot->sequence.store(position + m_mask + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * \brief Swaps \p value with the free slot at the back of the queue, returns false if the queue is full
+ *
+ * On success, \p value holds the slot's previous value.
+ */
+template<typename T>
+bool BoundedQueue<T>::tryPushSwap(T &value){
+    size_t position;
+    Slot* slot = claimPush(position);
+    if ( !slot )
+        return false;
+    using std::swap;
+    swap(slot->value, value);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * \brief Swaps the oldest value in the queue with \p value, returns false if the queue is empty
+ *
+ * The slot keeps the previous contents of \p value, for the next push to reuse.
+ */
+template<typename T>
+bool BoundedQueue<T>::tryPopSwap(T &value){
+    size_t position;
+    Slot* slot = claimPop(position);
+    if ( !slot )
+        return false;
+    using std::swap;
+    swap(slot->value, value);
+    slot->sequence.store(position + m_mask + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * \brief Returns the number of queued values, which may already be stale when concurrently used
+ */
+template<typename T>
+size_t BoundedQueue<T>::sizeApproximate() const{
+    size_t pushed = m_pushPosition.load(std::memory_order_relaxed);
+    size_t popped = m_popPosition.load(std::memory_order_relaxed);
+    return pushed > popped ? pushed - popped : 0;
+}
+
+template<typename T>
+typename BoundedQueue<T>::Slot *BoundedQueue<T>::claimPush(size_t &position){
+    position = m_pushPosition.load(std::memory_order_relaxed);
+    while ( true ){
+        Slot& slot = m_slots[position & m_mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+        if ( diff == 0 ){
+            if ( m_pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed) )
+                return &slot;
+        } else if ( diff < 0 ){
+            return nullptr;
+        } else {
+            position = m_pushPosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template<typename T>
+typename BoundedQueue<T>::Slot *BoundedQueue<T>::claimPop(size_t &position){
+    position = m_popPosition.load(std::memory_order_relaxed);
+    while ( true ){
+        Slot& slot = m_slots[position & m_mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+        if ( diff == 0 ){
+            if ( m_popPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed) )
+                return &slot;
+        } else if ( diff < 0 ){
+            return nullptr;
+        } else {
+            position = m_popPosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+}// namespace
+
+#endif // LVBOUNDEDQUEUE_H
@@ -1,4 +1,5 @@
 #include "bytebuffer.h"
+#include "bytebufferpool.h"
 #include "live/visuallog.h"
 
 #include "string.h"
@@ -15,11 +16,16 @@ namespace lv{
 
 class ByteBufferData{
 public:
-    ByteBufferData(){}
-    ~ByteBufferData(){ delete[] buffer; }
+    ByteBufferData() : buffer(nullptr), size(0), capacity(0){}
+    ~ByteBufferData(){ ByteBufferPool::instance().release(buffer, capacity); }
+
+    void allocate(size_t allocSize){
+        buffer = ByteBufferPool::instance().acquire(allocSize, capacity);
+    }
 
     ByteBuffer::Byte* buffer;
     size_t            size;
+    size_t            capacity;
 };
 
 
@@ -39,19 +45,21 @@ public:
  * Params are an array of unsigned chars and its size, both copied.
  */
 ByteBuffer::ByteBuffer(ByteBuffer::Byte *data, size_t size)
-    : m_data(new std::shared_ptr<ByteBufferData>(new ByteBufferData))
+    : m_data(new std::shared_ptr<ByteBufferData>(std::make_shared<ByteBufferData>()))
 {
-    m_data->get()->buffer = new ByteBuffer::Byte[size];
+    m_data->get()->allocate(size);
     m_data->get()->size = size;
-    memcpy((void*)((*m_data)->buffer), (void*)data, size);
+    if ( size )
+        memcpy((void*)((*m_data)->buffer), (void*)data, size);
 }
 
 ByteBuffer::ByteBuffer(const ByteBuffer::Byte *data, size_t size)
-    : m_data(new std::shared_ptr<ByteBufferData>(new ByteBufferData))
+    : m_data(new std::shared_ptr<ByteBufferData>(std::make_shared<ByteBufferData>()))
 {
-    m_data->get()->buffer = new ByteBuffer::Byte[size];
+    m_data->get()->allocate(size);
     m_data->get()->size = size;
-    memcpy((void*)((*m_data)->buffer), (void*)data, size);
+    if ( size )
+        memcpy((void*)((*m_data)->buffer), (void*)data, size);
 }
 
 /**
@@ -71,10 +79,8 @@ ByteBuffer::ByteBuffer(const ByteBuffer& other)
  * Initializes the object with zeroes.
  */
 ByteBuffer::ByteBuffer()
-    : m_data(new std::shared_ptr<ByteBufferData>(new ByteBufferData))
+    : m_data(new std::shared_ptr<ByteBufferData>(std::make_shared<ByteBufferData>()))
 {
-    m_data->get()->buffer = nullptr;
-    m_data->get()->size = 0;
 }
 
 /**
@@ -103,14 +109,34 @@ bool ByteBuffer::operator ==(const ByteBuffer &other) const{
     return data() == other.data() && size() == other.size();
 }
 
+/**
+ * \brief Creates a ByteBuffer of \p size uninitialized bytes
+ *
+ * Storage is drawn from the ByteBufferPool and returned to it once the last copy of the buffer is destroyed.
+ */
+ByteBuffer ByteBuffer::allocate(size_t size){
+    ByteBuffer bf;
+    (*bf.m_data)->allocate(size);
+    (*bf.m_data)->size = size;
+    return bf;
+}
+
 ByteBuffer ByteBuffer::encodeBase64(const ByteBuffer &bf, bool nullTerminate){
     return encodeBase64(bf.data(), bf.size(), nullTerminate);
 }
 
+/**
+ * \brief Encodes \p size \p bytes as base64 text
+ *
+ * The text is always followed by a null byte that is not counted in size(), since pooled storage is
+ * recycled without being cleared, and the result is commonly read as a C string. \p nullTerminate is
+ * kept for compatibility.
+ */
 ByteBuffer ByteBuffer::encodeBase64(const ByteBuffer::Byte *bytes, size_t size, bool nullTerminate){
+    (void)nullTerminate;
     ByteBuffer bf;
-    size_t resultMaxSize = ((size/3) + (size % 3 > 0)) * 4 + (nullTerminate ? 1 : 0);
-    (*bf.m_data)->buffer = new ByteBuffer::Byte[resultMaxSize];
+    size_t resultMaxSize = ((size/3) + (size % 3 > 0)) * 4 + 1;
+    (*bf.m_data)->allocate(resultMaxSize);
     ByteBuffer::Byte* c = (*bf.m_data)->buffer; // track of encoded position
     size_t cnt = 0; // store the number of bytes encoded by a single call
     base64_encodestate s;
@@ -121,9 +147,7 @@ ByteBuffer ByteBuffer::encodeBase64(const ByteBuffer::Byte *bytes, size_t size,
     c += cnt;
     cnt = base64_encode_blockend(c, &s); // finalize encoding
     c += cnt;
-    if ( nullTerminate ){
-        *c = 0;
-    }
+    *c = 0;
 
     (*bf.m_data)->size = c - (*bf.m_data)->buffer;
 
@@ -136,7 +160,7 @@ ByteBuffer ByteBuffer::decodeBase64(const ByteBuffer &bf, bool nullTerminate){
 
 ByteBuffer ByteBuffer::decodeBase64(const ByteBuffer::Byte *bytes, size_t size, bool nullTerminate){
     ByteBuffer bf;
-    (*bf.m_data)->buffer = new ByteBuffer::Byte[size + (nullTerminate ? 1 : 0)];
+    (*bf.m_data)->allocate(size + (nullTerminate ? 1 : 0));
     ByteBuffer::Byte* c = (*bf.m_data)->buffer; // track of decoded position
     size_t cnt = 0; // store the number of bytes encoded by a single call
     base64_decodestate s;
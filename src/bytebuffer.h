@@ -23,6 +23,8 @@ public:
     ByteBuffer& operator=(const ByteBuffer& other);
     bool operator == (const ByteBuffer& other) const;
 
+    static ByteBuffer allocate(size_t size);
+
     static ByteBuffer encodeBase64(const ByteBuffer& bf, bool nullTerminate = false);
     static ByteBuffer encodeBase64(const ByteBuffer::Byte* bytes, size_t size, bool nullTerminate = false);
 
@@ -0,0 +1,338 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+#include "bytebufferpool.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace lv{
+
+namespace{
+
+const int    threadCacheSlots = 8;
+const size_t threadCacheMaxBytes = 1024 * 1024;
+const size_t defaultMaxRetainedBytes = 64 * 1024 * 1024;
+
+int sizeClassIndex(size_t size){
+    size_t capacity = ByteBufferPool::minimumClassSize;
+    int index = 0;
+    while ( capacity < size ){
+        capacity <<= 1;
+        ++index;
+    }
+    return index;
+}
+
+size_t sizeClassCapacity(int index){
+    return ByteBufferPool::minimumClassSize << index;
+}
+
+} // namespace
+
+// ByteBufferPoolPrivate
+// ----------------------------------------------------------------------------
+
+/// \private
+class ByteBufferPoolPrivate{
+
+public:
+    class SizeClass{
+    public:
+        std::mutex                     mutex;
+        std::vector<ByteBuffer::Byte*> buffers;
+    };
+
+    class ThreadCache{
+    public:
+        ThreadCache(ByteBufferPoolPrivate* d) : pool(d), bytes(0){
+            for ( int i = 0; i < ByteBufferPool::totalSizeClasses; ++i )
+                counts[i] = 0;
+        }
+        ~ThreadCache();
+
+        ByteBufferPoolPrivate* pool;
+        ByteBuffer::Byte*      slots[ByteBufferPool::totalSizeClasses][threadCacheSlots];
+        int                    counts[ByteBufferPool::totalSizeClasses];
+        size_t                 bytes;
+    };
+
+    ByteBufferPoolPrivate()
+        : maxRetainedBytes(defaultMaxRetainedBytes)
+        , bytesRetained(0)
+        , hits(0)
+        , misses(0)
+        , releases(0)
+        , discards(0)
+    {}
+
+    bool reserve(size_t capacity);
+    void unreserve(size_t capacity){ bytesRetained.fetch_sub(capacity, std::memory_order_relaxed); }
+
+    void pushGlobal(int index, ByteBuffer::Byte* buffer);
+    ByteBuffer::Byte* popGlobal(int index);
+
+    static ThreadCache* threadCache(ByteBufferPoolPrivate* d);
+
+    SizeClass           sizeClasses[ByteBufferPool::totalSizeClasses];
+    std::atomic<size_t> maxRetainedBytes;
+    std::atomic<size_t> bytesRetained;
+    std::atomic<size_t> hits;
+    std::atomic<size_t> misses;
+    std::atomic<size_t> releases;
+    std::atomic<size_t> discards;
+};
+
+namespace{
+
+// Trivially destructible, so it stays readable while other thread_local
+// objects of the same thread are being destroyed.
+thread_local bool threadCacheDestroyed = false;
+
+} // namespace
+
+ByteBufferPoolPrivate::ThreadCache::~ThreadCache(){
+    threadCacheDestroyed = true;
+    for ( int i = 0; i < ByteBufferPool::totalSizeClasses; ++i ){
+        for ( int j = 0; j < counts[i]; ++j )
+            pool->pushGlobal(i, slots[i][j]);
+        counts[i] = 0;
+    }
+    bytes = 0;
+}
+
+bool ByteBufferPoolPrivate::reserve(size_t capacity){
+    size_t current = bytesRetained.load(std::memory_order_relaxed);
+    do{
+        if ( current + capacity > maxRetainedBytes.load(std::memory_order_relaxed) )
+            return false;
+    } while ( !bytesRetained.compare_exchange_weak(current, current + capacity, std::memory_order_relaxed) );
+    return true;
+}
+
+void ByteBufferPoolPrivate::pushGlobal(int index, ByteBuffer::Byte *buffer){
+    SizeClass& sc = sizeClasses[index];
+    std::lock_guard<std::mutex> guard(sc.mutex);
+    sc.buffers.push_back(buffer);
+}
+
+ByteBuffer::Byte *ByteBufferPoolPrivate::popGlobal(int index){
+    SizeClass& sc = sizeClasses[index];
+    std::lock_guard<std::mutex> guard(sc.mutex);
+    if ( sc.buffers.empty() )
+        return nullptr;
+    ByteBuffer::Byte* result = sc.buffers.back();
+    sc.buffers.pop_back();
+    return result;
+}
+
+ByteBufferPoolPrivate::ThreadCache *ByteBufferPoolPrivate::threadCache(ByteBufferPoolPrivate *d){
+    if ( threadCacheDestroyed )
+        return nullptr;
+    thread_local ThreadCache cache(d);
+    return &cache;
+}
+
+
+// ByteBufferPool
+// ----------------------------------------------------------------------------
+
+/**
+ * \class lv::ByteBufferPool
+ * \brief Size-class based recycler for ByteBuffer storage
+ *
+ * Buffers are grouped in power of two size classes between minimumClassSize and maximumClassSize.
+ * Each thread keeps a small cache per size class, so buffers released and reacquired on the same
+ * thread never touch a lock. Whatever does not fit in the thread cache goes to a shared list per size
+ * class. The total capacity retained by the pool is capped by maxRetainedBytes(), buffers released
+ * above the cap are freed.
+ *
+ * \ingroup lvbase
+ */
+
+const size_t ByteBufferPool::minimumClassSize;
+const size_t ByteBufferPool::maximumClassSize;
+const int    ByteBufferPool::totalSizeClasses;
+
+ByteBufferPool::ByteBufferPool()
+    : m_d(new ByteBufferPoolPrivate)
+{
+}
+
+ByteBufferPool::~ByteBufferPool(){
+    clear();
+    delete m_d;
+}
+
+/**
+ * \brief Returns the process wide pool
+ *
+ * The pool is never destroyed, since ByteBuffers with static storage may still return their data to
+ * it during shutdown.
+ */
+ByteBufferPool &ByteBufferPool::instance(){
+    static ByteBufferPool* pool = new ByteBufferPool;
+    return *pool;
+}
+
+/**
+ * \brief Acquires a buffer of at least \p size bytes
+ *
+ * The actual size of the buffer is stored in \p capacity, and has to be given back on release.
+ * A zero size returns a null buffer.
+ */
+ByteBuffer::Byte *ByteBufferPool::acquire(size_t size, size_t &capacity){
+    if ( size == 0 ){
+        capacity = 0;
+        return nullptr;
+    }
+    if ( size > maximumClassSize ){
+        m_d->misses.fetch_add(1, std::memory_order_relaxed);
+        capacity = size;
+        return new ByteBuffer::Byte[size];
+    }
+
+    int index = sizeClassIndex(size);
+    capacity = sizeClassCapacity(index);
+
+    ByteBufferPoolPrivate::ThreadCache* cache = ByteBufferPoolPrivate::threadCache(m_d);
+    if ( cache && cache->counts[index] > 0 ){
+        ByteBuffer::Byte* result = cache->slots[index][--cache->counts[index]];
+        cache->bytes -= capacity;
+        m_d->unreserve(capacity);
+        m_d->hits.fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    ByteBuffer::Byte* result = m_d->popGlobal(index);
+    if ( result ){
+        m_d->unreserve(capacity);
+        m_d->hits.fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    m_d->misses.fetch_add(1, std::memory_order_relaxed);
+    return new ByteBuffer::Byte[capacity];
+}
+
+/**
+ * \brief Returns a buffer previously given by acquire()
+ */
+void ByteBufferPool::release(ByteBuffer::Byte *buffer, size_t capacity){
+    if ( !buffer )
+        return;
+
+    m_d->releases.fetch_add(1, std::memory_order_relaxed);
+
+    if ( capacity < minimumClassSize || capacity > maximumClassSize || capacityFor(capacity) != capacity || !m_d->reserve(capacity) ){
+        m_d->discards.fetch_add(1, std::memory_order_relaxed);
+        delete[] buffer;
+        return;
+    }
+
+    int index = sizeClassIndex(capacity);
+
+    ByteBufferPoolPrivate::ThreadCache* cache = ByteBufferPoolPrivate::threadCache(m_d);
+    if ( cache && cache->counts[index] < threadCacheSlots && cache->bytes + capacity <= threadCacheMaxBytes ){
+        cache->slots[index][cache->counts[index]++] = buffer;
+        cache->bytes += capacity;
+        return;
+    }
+
+    m_d->pushGlobal(index, buffer);
+}
+
+/**
+ * \brief Returns a snapshot of the pool counters
+ */
+ByteBufferPool::Stats ByteBufferPool::stats() const{
+    Stats st;
+    st.hits          = m_d->hits.load(std::memory_order_relaxed);
+    st.misses        = m_d->misses.load(std::memory_order_relaxed);
+    st.releases      = m_d->releases.load(std::memory_order_relaxed);
+    st.discards      = m_d->discards.load(std::memory_order_relaxed);
+    st.bytesRetained = m_d->bytesRetained.load(std::memory_order_relaxed);
+    return st;
+}
+
+/**
+ * \brief Resets the hit, miss, release and discard counters
+ */
+void ByteBufferPool::resetStats(){
+    m_d->hits.store(0, std::memory_order_relaxed);
+    m_d->misses.store(0, std::memory_order_relaxed);
+    m_d->releases.store(0, std::memory_order_relaxed);
+    m_d->discards.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * \brief Returns the maximum capacity the pool is allowed to retain
+ */
+size_t ByteBufferPool::maxRetainedBytes() const{
+    return m_d->maxRetainedBytes.load(std::memory_order_relaxed);
+}
+
+/**
+ * \brief Caps the capacity retained by the pool
+ *
+ * Lowering the cap does not free buffers already retained, use clear() for that.
+ */
+void ByteBufferPool::setMaxRetainedBytes(size_t bytes){
+    m_d->maxRetainedBytes.store(bytes, std::memory_order_relaxed);
+}
+
+/**
+ * \brief Frees all buffers held in the shared lists and in the calling thread's cache
+ */
+void ByteBufferPool::clear(){
+    ByteBufferPoolPrivate::ThreadCache* cache = ByteBufferPoolPrivate::threadCache(m_d);
+
+    for ( int i = 0; i < totalSizeClasses; ++i ){
+        size_t capacity = sizeClassCapacity(i);
+        if ( cache ){
+            for ( int j = 0; j < cache->counts[i]; ++j ){
+                delete[] cache->slots[i][j];
+                m_d->unreserve(capacity);
+            }
+            cache->counts[i] = 0;
+        }
+
+        std::vector<ByteBuffer::Byte*> buffers;
+        {
+            std::lock_guard<std::mutex> guard(m_d->sizeClasses[i].mutex);
+            buffers.swap(m_d->sizeClasses[i].buffers);
+        }
+        for ( auto it = buffers.begin(); it != buffers.end(); ++it ){
+            delete[] *it;
+            m_d->unreserve(capacity);
+        }
+    }
+    if ( cache )
+        cache->bytes = 0;
+}
+
+/**
+ * \brief Returns the capacity a buffer of \p size bytes will be allocated with
+ */
+size_t ByteBufferPool::capacityFor(size_t size){
+    if ( size == 0 )
+        return 0;
+    if ( size > maximumClassSize )
+        return size;
+    return sizeClassCapacity(sizeClassIndex(size));
+}
+
+}// namespace
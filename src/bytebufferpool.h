@@ -0,0 +1,83 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+#ifndef LVBYTEBUFFERPOOL_H
+#define LVBYTEBUFFERPOOL_H
+
+#include "live/lvbaseglobal.h"
+#include "live/bytebuffer.h"
+
+namespace lv{
+
+class ByteBufferPoolPrivate;
+class LV_BASE_EXPORT ByteBufferPool{
+
+public:
+    /**
+     * \class lv::ByteBufferPool::Stats
+     * \brief Snapshot of the pool counters
+     *
+     * \ingroup lvbase
+     */
+    class Stats{
+    public:
+        Stats() : hits(0), misses(0), releases(0), discards(0), bytesRetained(0){}
+
+        /** Acquisitions served from a retained buffer */
+        size_t hits;
+        /** Acquisitions that required a new allocation */
+        size_t misses;
+        /** Buffers returned to the pool */
+        size_t releases;
+        /** Returned buffers that were freed instead of retained */
+        size_t discards;
+        /** Total capacity currently held by the pool */
+        size_t bytesRetained;
+    };
+
+    /** Capacity of the smallest size class */
+    static const size_t minimumClassSize = 64;
+    /** Capacity of the largest size class, larger buffers are not pooled */
+    static const size_t maximumClassSize = 1024 * 1024;
+    /** Number of size classes */
+    static const int totalSizeClasses = 15;
+
+public:
+    static ByteBufferPool& instance();
+
+    ByteBuffer::Byte* acquire(size_t size, size_t& capacity);
+    void release(ByteBuffer::Byte* buffer, size_t capacity);
+
+    Stats stats() const;
+    void resetStats();
+
+    size_t maxRetainedBytes() const;
+    void setMaxRetainedBytes(size_t bytes);
+
+    void clear();
+
+    static size_t capacityFor(size_t size);
+
+private:
+    ByteBufferPool();
+    ~ByteBufferPool();
+    DISABLE_COPY(ByteBufferPool);
+
+    ByteBufferPoolPrivate* m_d;
+};
+
+}// namespace
+
+#endif // LVBYTEBUFFERPOOL_H
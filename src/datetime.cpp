@@ -1,146 +1,162 @@
 #include "datetime.h"
+#include "datetimeformat.h"
 #include "live/visuallog.h"
 
 #include "date/date.h"
 #include <chrono>
 #include <ctime>
-#include <mutex>
-#include "time.h"
+#include <atomic>
+#include <type_traits>
 
 namespace lv{
 
-// class DateTimePrivate
-// ----------------------------------------------------------------------------
+namespace{
 
+/**
+ * Caches the local UTC offset for one 15 minute UTC slot. Offsets and DST transitions fall on
+ * 15 minute boundaries, so the offset is constant within a slot. Slot and offset are packed into a
+ * single word, so readers need neither a lock nor a consistency check.
+ */
+class LocalOffsetCache{
 
-class DateTimePrivate{
 public:
-    DateTimePrivate(): isLocal(false){}
+    static const long long slotSeconds = 15 * 60;
+    static const int       offsetBits = 20;
+    static const long long offsetBias = 1LL << (offsetBits - 1);
+
+    bool find(long long slot, long long& offset) const{
+        unsigned long long packed = m_value.load(std::memory_order_acquire);
+        if ( packed == 0 || static_cast<long long>(packed >> offsetBits) != slot + 1 )
+            return false;
+        offset = static_cast<long long>(packed & ((1ULL << offsetBits) - 1)) - offsetBias;
+        return true;
+    }
 
-    date::hh_mm_ss<std::chrono::milliseconds> totalMsInDay() const;
-    std::string padNumber(int number, int len, char padChar = ' ');
-    std::string dayOfWeekLongName();
-    std::string dayOfWeekShortName();
-    std::string monthLongName();
-    std::string monthShortName();
+    void store(long long slot, long long offset){
+        unsigned long long packed =
+            (static_cast<unsigned long long>(slot + 1) << offsetBits) | static_cast<unsigned long long>(offset + offsetBias);
+        m_value.store(packed, std::memory_order_release);
+    }
 
-    static std::mutex& localTimeMutex(){ static std::mutex m; return m; }
+    void clear(){ m_value.store(0, std::memory_order_release); }
 
-    bool isLocal;
-    std::chrono::system_clock::time_point tp;
-};
+    static LocalOffsetCache& instance(){ static LocalOffsetCache cache; return cache; }
 
+private:
+    LocalOffsetCache() : m_value(0){}
 
-date::hh_mm_ss<std::chrono::milliseconds> DateTimePrivate::totalMsInDay() const{
-    auto startOfDay = date::floor<date::days>(tp);
-    std::chrono::milliseconds tod = std::chrono::duration_cast<std::chrono::milliseconds>(tp - startOfDay);
-    return date::hh_mm_ss<std::chrono::milliseconds>{tod};
-}
+    std::atomic<unsigned long long> m_value;
+};
 
-std::string DateTimePrivate::padNumber(int number, int len, char padChar){
-    std::string res = std::to_string(number);
-    if ( res.size() < static_cast<size_t>(len) ){
-        return std::string(len - res.size(), padChar) + res;
-    }
-    return res;
+long long floorDivide(long long value, long long divisor){
+    long long result = value / divisor;
+    return (value % divisor < 0) ? result - 1 : result;
 }
 
-std::string DateTimePrivate::dayOfWeekLongName(){
-    std::stringstream ss;
-    char fmt[] = {'%', 'A', 0};
-    date::weekday wd = date::year_month_weekday{date::floor<date::days>(tp)}.weekday();
-    date::to_stream(ss, fmt, wd);
-    return ss.str();
+long long floorModulo(long long value, long long divisor){
+    long long result = value % divisor;
+    return result < 0 ? result + divisor : result;
 }
 
-std::string DateTimePrivate::dayOfWeekShortName(){
-    std::stringstream ss;
-    char fmt[] = {'%', 'a', 0};
-    date::weekday wd = date::year_month_weekday{date::floor<date::days>(tp)}.weekday();
-    date::to_stream(ss, fmt, wd);
-    return ss.str();
+long long daysFromCivil(long long y, unsigned m, unsigned d){
+    y -= m <= 2;
+    long long era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = static_cast<unsigned>(y - era * 400);
+    unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<long long>(doe) - 719468;
 }
 
-std::string DateTimePrivate::monthLongName(){
-    std::stringstream ss;
-    char fmt[] = {'%', 'B', 0};
-    date::month mn = date::year_month_day{date::floor<date::days>(tp)}.month();
-    date::to_stream(ss, fmt, mn);
-    return ss.str();
+/// Returns the local offset from UTC in seconds at \p utcSeconds, using the reentrant system calls
+long long computeLocalOffset(std::time_t utcSeconds){
+    std::tm t;
+#if defined(_WIN32)
+    if ( localtime_s(&t, &utcSeconds) != 0 )
+        return 0;
+#else
+    if ( !localtime_r(&utcSeconds, &t) )
+        return 0;
+#endif
+    long long localSeconds =
+        daysFromCivil(t.tm_year + 1900LL, static_cast<unsigned>(t.tm_mon + 1), static_cast<unsigned>(t.tm_mday)) * 86400 +
+        t.tm_hour * 3600 + t.tm_min * 60 + t.tm_sec;
+    return localSeconds - static_cast<long long>(utcSeconds);
 }
 
-std::string DateTimePrivate::monthShortName(){
-    std::stringstream ss;
-    char fmt[] = {'%', 'b', 0};
-    date::month mn = date::year_month_day{date::floor<date::days>(tp)}.month();
-    date::to_stream(ss, fmt, mn);
-    return ss.str();
+long long localOffset(long long utcSeconds){
+    LocalOffsetCache& cache = LocalOffsetCache::instance();
+    long long slot = utcSeconds >= 0 ? utcSeconds / LocalOffsetCache::slotSeconds : -1;
+
+    long long offset;
+    if ( slot >= 0 && cache.find(slot, offset) )
+        return offset;
+
+    offset = computeLocalOffset(static_cast<std::time_t>(utcSeconds));
+    if ( slot >= 0 && offset > -LocalOffsetCache::offsetBias && offset < LocalOffsetCache::offsetBias )
+        cache.store(slot, offset);
+    return offset;
 }
 
+} // namespace
 
 // class DateTime
 // ----------------------------------------------------------------------------
 
+/**
+ * \class lv::DateTime
+ * \brief Point in time with microsecond precision
+ *
+ * Stored as a trivially copyable value: the number of microseconds since 1970-01-01 and a set of flags.
+ * Local dates are stored shifted by the local offset, so their fields read as local time.
+ *
+ * \ingroup lvbase
+ */
 
-DateTime::DateTime()
-    : m_d(new DateTimePrivate)
-{
-    m_d->tp = std::chrono::system_clock::now();
-}
+static_assert(std::is_trivially_copyable<DateTime>::value, "DateTime needs to stay trivially copyable.");
 
-DateTime::DateTime(size_t msecs)
-    : m_d(new DateTimePrivate)
-{
-    m_d->tp = std::chrono::system_clock::time_point{std::chrono::milliseconds(msecs)};
-}
+const unsigned int DateTime::LocalFlag;
 
-DateTime::DateTime(const DateTime &other)
-    : m_d(new DateTimePrivate)
+/**
+ * \brief Creates a DateTime with the current UTC time
+ */
+DateTime::DateTime()
+    : m_ticks(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count())
+    , m_flags(0)
 {
-    m_d->tp = other.m_d->tp;
-    m_d->isLocal = other.m_d->isLocal;
 }
 
 DateTime::DateTime(int y, int m, int d, int hh, int mm, int ss, int ms)
-    : m_d(new DateTimePrivate)
+    : m_flags(0)
 {
-    auto ymd = (date::year{y}/m/d);
-    m_d->tp =
-        date::sys_days(ymd) +
-        std::chrono::hours(hh) +
-        std::chrono::minutes(mm) +
-        std::chrono::seconds(ss) +
-        std::chrono::milliseconds(ms);
-}
-
-DateTime::~DateTime(){
-    delete m_d;
+    long long seconds =
+        daysFromCivil(y, static_cast<unsigned>(m), static_cast<unsigned>(d)) * 86400LL +
+        hh * 3600LL + mm * 60LL + ss;
+    m_ticks = seconds * 1000000LL + ms * 1000LL;
 }
 
 int DateTime::day() const{
-    return static_cast<int>(static_cast<unsigned>(date::year_month_day{date::floor<date::days>(m_d->tp)}.day()));
+    return DateTimeFormat::Fields(msecondsSinceEpoch()).day;
 }
 
 int DateTime::month() const{
-    return static_cast<int>(static_cast<unsigned>(date::year_month_day{date::floor<date::days>(m_d->tp)}.month()));
+    return DateTimeFormat::Fields(msecondsSinceEpoch()).month;
 }
 
 int DateTime::year() const{
-    return static_cast<int>(date::year_month_day{date::floor<date::days>(m_d->tp)}.year());
+    return DateTimeFormat::Fields(msecondsSinceEpoch()).year;
 }
 
 int DateTime::dayOfWeek() const{
-    return static_cast<int>(date::year_month_weekday{date::floor<date::days>(m_d->tp)}.weekday().c_encoding());
+    return DateTimeFormat::Fields(msecondsSinceEpoch()).dayOfWeek;
 }
 
 int DateTime::dayOfYear() const{
-    std::chrono::system_clock::time_point startOfYear = date::sys_days(date::year{year()} / 1 / 1);
-    auto resultDiff = date::floor<date::days>(m_d->tp - startOfYear);
-    return resultDiff.count() + 1;
+    long long days = floorDivide(m_ticks, 86400000000LL);
+    return static_cast<int>(days - daysFromCivil(year(), 1, 1) + 1);
 }
 
 int DateTime::hour() const{
-    return m_d->totalMsInDay().hours().count();
+    return static_cast<int>(floorModulo(m_ticks, 86400000000LL) / 3600000000LL);
 }
 
 int DateTime::hourAMPM() const{
@@ -162,141 +178,73 @@ bool DateTime::isPM() const{
 }
 
 int DateTime::minute() const{
-    return m_d->totalMsInDay().minutes().count();
+    return static_cast<int>(floorModulo(m_ticks, 3600000000LL) / 60000000LL);
 }
 
 int DateTime::second() const{
-    return m_d->totalMsInDay().seconds().count();
+    return static_cast<int>(floorModulo(m_ticks, 60000000LL) / 1000000LL);
 }
 
 int DateTime::msecond() const{
-    return m_d->totalMsInDay().subseconds().count();
+    return static_cast<int>(floorModulo(m_ticks, 1000000LL) / 1000LL);
 }
 
-bool DateTime::isLocal() const{
-    return m_d->isLocal;
+/**
+ * \brief Returns the number of milliseconds since 1970-01-01 00:00:00
+ *
+ * For local dates, this is measured from the epoch in local time.
+ */
+long long DateTime::msecondsSinceEpoch() const{
+    return floorDivide(m_ticks, 1000LL);
 }
 
 /**
- * \brief Returns a DateTime in local format. This function is not currently
- * thread safe.
+ * \brief Returns a DateTime in local format
+ *
+ * The local offset is cached per 15 minute UTC slot, so conversions within the same slot don't call
+ * into the system timezone functions and don't lock. Use clearLocalTimeCache() after changing the
+ * process timezone.
  */
 DateTime DateTime::toLocal() const{
-    if ( m_d->isLocal )
-        return *this;;
-    std::time_t utcTime = std::chrono::system_clock::to_time_t(m_d->tp);
+    if ( isLocal() )
+        return *this;
 
-    DateTimePrivate::localTimeMutex().lock();
-    std::tm* t = std::localtime(&utcTime);
-    DateTime dt(t->tm_year + 1900, t->tm_mon + 1, t->tm_mday, t->tm_hour, t->tm_min, t->tm_sec, msecond());
-    DateTimePrivate::localTimeMutex().unlock();
-
-    dt.m_d->isLocal = true;
-    return dt;
-}
-
-DateTime &DateTime::operator =(const DateTime &other){
-    m_d->isLocal = other.m_d->isLocal;
-    m_d->tp = other.m_d->tp;
-    return *this;
-}
-
-bool DateTime::operator ==(const DateTime &dateTime) const{
-    return m_d->tp == dateTime.m_d->tp;
-}
-
-bool DateTime::operator !=(const DateTime &dateTime) const{
-    return m_d->tp != dateTime.m_d->tp;
-}
-
-bool DateTime::operator <(const DateTime &dateTime) const{
-    return m_d->tp < dateTime.m_d->tp;
-}
-
-bool DateTime::operator <=(const DateTime &dateTime) const{
-    return m_d->tp <= dateTime.m_d->tp;
-}
-
-bool DateTime::operator >(const DateTime &dateTime) const{
-    return m_d->tp > dateTime.m_d->tp;
+    long long utcSeconds = floorDivide(m_ticks, 1000000LL);
+    return DateTime(m_ticks + localOffset(utcSeconds) * 1000000LL, m_flags | LocalFlag);
 }
 
-bool DateTime::operator >=(const DateTime &dateTime) const{
-    return m_d->tp >= dateTime.m_d->tp;
+/**
+ * \brief Drops the cached local offset used by toLocal()
+ */
+void DateTime::clearLocalTimeCache(){
+    LocalOffsetCache::instance().clear();
 }
 
 std::string DateTime::toString() const{
     return format("%Y-%m-%d %H:%M:%S.%i");
 }
 
+/**
+ * \brief Formats this date according to \p pattern
+ *
+ * Compiles the pattern on each call, use a DateTimeFormat when formatting repeatedly with the same pattern.
+ */
 std::string DateTime::format(const std::string &pattern) const{
-    std::stringstream base;
-
-    std::string::const_iterator it = pattern.begin();
-    while ( it != pattern.end() ){
-         if ( *it == '%' ){
-            ++it;
-            if ( it != pattern.end() ){
-                std::string r = formatSymbol(*it);
-                if ( r.empty() )
-                    base << *it;
-                else
-                    base << r;
-            } else {
-                base << '%';
-                break;
-            }
-        } else {
-            base << *it;
-        }
-        ++it;
-    }
-    return base.str();
+    return DateTimeFormat::compile(pattern).format(*this);
 }
 
 std::string DateTime::formatSymbol(char symbol) const{
-    switch(symbol){
-    case 'w' : return m_d->dayOfWeekShortName();
-    case 'W' : return m_d->dayOfWeekLongName();
-    case 'b': return m_d->monthShortName();
-    case 'B': return m_d->monthLongName();
-    case 'd': return m_d->padNumber(day(), 2, '0');
-    case 'e': return m_d->padNumber(day(), 0);
-    case 'f': return m_d->padNumber(day(), 2);
-    case 'm': return m_d->padNumber(month(), 2, '0');
-    case 'n': return m_d->padNumber(month(), 0);
-    case 'o': return m_d->padNumber(month(), 2);
-    case 'y': return m_d->padNumber(year() % 100, 2, '0');
-    case 'Y': return m_d->padNumber(year(), 4, '0');
-    case 'H': return m_d->padNumber(hour(), 2, '0');
-    case 'I': return m_d->padNumber(hourAMPM() < 1 ? 12 : hourAMPM(), 2, '0');
-    case 'a': return isAM() ? "am" : "pm";
-    case 'A': return isAM() ? "AM" : "PM";
-    case 'M': return m_d->padNumber(minute(), 2, '0');
-    case 'S': return m_d->padNumber(second(), 2, '0');
-    case 's': return m_d->padNumber(second(), 2, '0') + "." + m_d->padNumber(msecond(), 3, '0');
-    case 'i': return m_d->padNumber(msecond(), 3, '0');
-    case 'c': return m_d->padNumber(msecond() / 100, 0);
-    }
-    return "";
+    char buffer[16];
+    size_t size = DateTimeFormat::writeSymbol(DateTimeFormat::Fields(msecondsSinceEpoch()), symbol, buffer);
+    return std::string(buffer, size);
 }
 
 DateTime DateTime::addMSeconds(int count) const{
-    std::chrono::milliseconds msecs(count);
-    std::chrono::system_clock::time_point newTp = m_d->tp + msecs;
-
-    DateTime dt(0);
-    dt.m_d->tp = newTp;
-    return dt;
+    return DateTime(m_ticks + count * 1000LL, m_flags);
 }
 
 DateTime DateTime::addDays(int count) const{
-    date::days days(count);
-    std::chrono::system_clock::time_point newTp = m_d->tp + days;
-
-    DateTime dt(0);
-    dt.m_d->tp = newTp;
-    return dt;
+    return DateTime(m_ticks + count * 86400000000LL, m_flags);
 }
 
 DateTime DateTime::create(int year, int m, int d, int hh, int mm, int ss, int ms){
@@ -311,7 +259,14 @@ DateTime DateTime::create(int year, int m, int d, int hh, int mm, int ss, int ms
 }
 
 DateTime DateTime::createFromMs(size_t timeSinceEpoch){
-    return DateTime(timeSinceEpoch);
+    return DateTime(static_cast<long long>(timeSinceEpoch) * 1000LL, 0);
+}
+
+/**
+ * \brief Creates a UTC DateTime from the number of microseconds since 1970-01-01 00:00:00
+ */
+DateTime DateTime::createFromUs(long long timeSinceEpoch){
+    return DateTime(timeSinceEpoch, 0);
 }
 
 VisualLog &operator <<(VisualLog &vl, const DateTime &value){
@@ -6,15 +6,17 @@
 
 namespace lv{
 
-class DateTimePrivate;
 class LV_BASE_EXPORT DateTime{
 
+public:
+    /** Flag set on dates converted to local time */
+    static const unsigned int LocalFlag = 1;
+
 public:
     DateTime();
     DateTime(int year, int m, int d, int hh = 0, int mm = 0, int ss = 0, int ms = 0);
-    DateTime(const DateTime& other);
-
-    ~DateTime();
+    DateTime(const DateTime& other) = default;
+    ~DateTime() = default;
 
     int day() const;
     int month() const;
@@ -30,17 +32,20 @@ public:
     int second() const;
     int msecond() const;
 
-    bool isLocal() const;
+    long long msecondsSinceEpoch() const;
+    long long usecondsSinceEpoch() const{ return m_ticks; }
+
+    bool isLocal() const{ return (m_flags & LocalFlag) != 0; }
     DateTime toLocal() const;
 
-    DateTime& operator = (const DateTime& other);
+    DateTime& operator = (const DateTime& other) = default;
 
-    bool operator == (const DateTime& dateTime) const;
-    bool operator != (const DateTime& dateTime) const;
-    bool operator <  (const DateTime& dateTime) const;
-    bool operator <= (const DateTime& dateTime) const;
-    bool operator >  (const DateTime& dateTime) const;
-    bool operator >= (const DateTime& dateTime) const;
+    bool operator == (const DateTime& dateTime) const{ return m_ticks == dateTime.m_ticks; }
+    bool operator != (const DateTime& dateTime) const{ return m_ticks != dateTime.m_ticks; }
+    bool operator <  (const DateTime& dateTime) const{ return m_ticks <  dateTime.m_ticks; }
+    bool operator <= (const DateTime& dateTime) const{ return m_ticks <= dateTime.m_ticks; }
+    bool operator >  (const DateTime& dateTime) const{ return m_ticks >  dateTime.m_ticks; }
+    bool operator >= (const DateTime& dateTime) const{ return m_ticks >= dateTime.m_ticks; }
 
     std::string toString() const;
     std::string format(const std::string& fmt) const;
@@ -51,11 +56,15 @@ public:
 
     static DateTime create(int year, int m = 1, int d = 1, int hh = 0, int mm = 0, int ss = 0, int ms = 0);
     static DateTime createFromMs(size_t timeSinceEpoch);
+    static DateTime createFromUs(long long timeSinceEpoch);
+
+    static void clearLocalTimeCache();
 
 private:
-    DateTime(size_t timeSinceEpoch);
+    DateTime(long long ticks, unsigned int flags) : m_ticks(ticks), m_flags(flags){}
 
-    DateTimePrivate* m_d;
+    long long    m_ticks; // microseconds since epoch
+    unsigned int m_flags;
 };
 
 LV_BASE_EXPORT VisualLog &operator <<(VisualLog &vl, const DateTime& value);
@@ -0,0 +1,381 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+#include "datetimeformat.h"
+
+#include <atomic>
+#include <climits>
+#include <cstring>
+
+namespace lv{
+
+namespace{
+
+const char digitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+const char* const dayShortNames[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+const char* const dayLongNames[]  = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
+const char* const monthShortNames[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+const char* const monthLongNames[] = {
+    "January", "February", "March", "April", "May", "June",
+    "July", "August", "September", "October", "November", "December"
+};
+
+const int    maximumCachedSubseconds = 8;
+const int    totalCacheEntries = 4;
+const long long msecondsPerDay = 86400000LL;
+
+inline char* writeTwoDigits(char* out, int value){
+    std::memcpy(out, digitPairs + value * 2, 2);
+    return out + 2;
+}
+
+inline char* writeThreeDigits(char* out, int value){
+    *out++ = static_cast<char>('0' + value / 100);
+    return writeTwoDigits(out, value % 100);
+}
+
+inline char* writeSpacePadded(char* out, int value){
+    if ( value < 10 ){
+        *out++ = ' ';
+        *out++ = static_cast<char>('0' + value);
+        return out;
+    }
+    return writeTwoDigits(out, value);
+}
+
+inline char* writeUnpadded(char* out, int value){
+    if ( value < 10 ){
+        *out++ = static_cast<char>('0' + value);
+        return out;
+    }
+    return writeTwoDigits(out, value);
+}
+
+char* writeYear(char* out, int year){
+    if ( year >= 0 && year < 10000 ){
+        out = writeTwoDigits(out, year / 100);
+        return writeTwoDigits(out, year % 100);
+    }
+    char digits[16];
+    int total = 0;
+    long long value = year < 0 ? -static_cast<long long>(year) : year;
+    while ( value > 0 ){
+        digits[total++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    if ( year < 0 )
+        *out++ = '-';
+    while ( total > 0 )
+        *out++ = digits[--total];
+    return out;
+}
+
+inline char* writeName(char* out, const char* name){
+    size_t size = std::strlen(name);
+    std::memcpy(out, name, size);
+    return out + size;
+}
+
+size_t maximumSymbolSize(char symbol){
+    switch(symbol){
+    case 'W': case 'B': return 9;
+    case 'w': case 'b': return 3;
+    case 'Y': return 11;
+    case 's': return 6;
+    case 'i': return 3;
+    case 'c': return 1;
+    }
+    return 2;
+}
+
+long long floorDivide(long long value, long long divisor){
+    long long result = value / divisor;
+    return (value % divisor < 0) ? result - 1 : result;
+}
+
+/// Formatted output of the last second rendered by a format on the current thread
+class FormatCache{
+public:
+    FormatCache() : formatId(0), second(LLONG_MIN), totalSubseconds(0){}
+
+    unsigned long long formatId;
+    long long          second;
+    std::string        text;
+    size_t             subsecondOffsets[maximumCachedSubseconds];
+    char               subsecondSymbols[maximumCachedSubseconds];
+    size_t             totalSubseconds;
+};
+
+std::atomic<unsigned long long> nextFormatId(1);
+
+} // namespace
+
+// DateTimeFormat::Fields
+// ----------------------------------------------------------------------------
+
+/**
+ * \brief Decomposes the time since epoch into calendar fields
+ */
+DateTimeFormat::Fields::Fields(long long msecondsSinceEpoch){
+    long long days = floorDivide(msecondsSinceEpoch, msecondsPerDay);
+    long long msOfDay = msecondsSinceEpoch - days * msecondsPerDay;
+
+    hour    = static_cast<int>(msOfDay / 3600000);
+    minute  = static_cast<int>(msOfDay / 60000 % 60);
+    second  = static_cast<int>(msOfDay / 1000 % 60);
+    msecond = static_cast<int>(msOfDay % 1000);
+
+    // 1970-01-01 was a thursday
+    dayOfWeek = static_cast<int>(((days % 7) + 11) % 7);
+
+    // days to civil date, see howardhinnant.github.io/date_algorithms.html
+    long long z = days + 719468;
+    long long era = (z >= 0 ? z : z - 146096) / 146097;
+    long long doe = z - era * 146097;
+    long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long long mp = (5 * doy + 2) / 153;
+
+    day   = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    year  = static_cast<int>(yoe + era * 400 + (month <= 2 ? 1 : 0));
+}
+
+// DateTimeFormat
+// ----------------------------------------------------------------------------
+
+/**
+ * \class lv::DateTimeFormat
+ * \brief Date format pattern compiled into segments, for formatting many dates with the same pattern
+ *
+ * The pattern uses the same symbols as DateTime::format(). Formatting computes the calendar fields once
+ * and writes digits from a lookup table. Each thread also remembers the last formatted second per
+ * format, so stamps within the same second only rewrite their sub-second digits.
+ *
+ * \ingroup lvbase
+ */
+
+DateTimeFormat::DateTimeFormat()
+    : m_maximumSize(0)
+    , m_totalSubseconds(0)
+    , m_id(nextFormatId.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+/**
+ * \brief Compiles \p pattern into a reusable format
+ *
+ * Unknown symbols are written as they are, without the \c % prefix.
+ */
+DateTimeFormat DateTimeFormat::compile(const std::string &pattern){
+    DateTimeFormat result;
+    result.m_pattern = pattern;
+
+    auto addLiteral = [&result](char c){
+        if ( !result.m_segments.empty() && result.m_segments.back().symbol == 0 ){
+            result.m_segments.back().length++;
+        } else {
+            result.m_segments.push_back(Segment(0, static_cast<unsigned int>(result.m_literals.size()), 1));
+        }
+        result.m_literals += c;
+        result.m_maximumSize++;
+    };
+
+    for ( size_t i = 0; i < pattern.size(); ++i ){
+        char c = pattern[i];
+        if ( c != '%' ){
+            addLiteral(c);
+        } else if ( i + 1 == pattern.size() ){
+            addLiteral('%');
+        } else {
+            char symbol = pattern[++i];
+            if ( isSymbol(symbol) ){
+                result.m_segments.push_back(Segment(symbol, 0, 0));
+                result.m_maximumSize += maximumSymbolSize(symbol);
+                if ( symbol == 'i' || symbol == 's' || symbol == 'c' )
+                    result.m_totalSubseconds++;
+            } else {
+                addLiteral(symbol);
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * \brief Checks whether \p symbol is a known format symbol
+ */
+bool DateTimeFormat::isSymbol(char symbol){
+    switch(symbol){
+    case 'w': case 'W': case 'b': case 'B':
+    case 'd': case 'e': case 'f':
+    case 'm': case 'n': case 'o':
+    case 'y': case 'Y':
+    case 'H': case 'I': case 'a': case 'A':
+    case 'M': case 'S': case 's': case 'i': case 'c':
+        return true;
+    }
+    return false;
+}
+
+/**
+ * \brief Writes \p dt into \p buffer and returns the formatted size
+ *
+ * Nothing is written if the formatted size exceeds \p capacity. A capacity of at least maximumSize()
+ * always fits.
+ */
+size_t DateTimeFormat::write(const DateTime &dt, char *buffer, size_t capacity) const{
+    if ( capacity >= m_maximumSize )
+        return writeCached(dt.msecondsSinceEpoch(), buffer);
+
+    std::string temp(m_maximumSize, '\0');
+    size_t size = writeCached(dt.msecondsSinceEpoch(), &temp[0]);
+    if ( size <= capacity )
+        std::memcpy(buffer, temp.data(), size);
+    return size;
+}
+
+/**
+ * \brief Appends \p dt formatted to \p result
+ */
+void DateTimeFormat::append(const DateTime &dt, std::string &result) const{
+    size_t start = result.size();
+    result.resize(start + m_maximumSize);
+    size_t size = writeCached(dt.msecondsSinceEpoch(), &result[start]);
+    result.resize(start + size);
+}
+
+std::string DateTimeFormat::format(const DateTime &dt) const{
+    std::string result;
+    append(dt, result);
+    return result;
+}
+
+/**
+ * \brief Writes a single \p symbol into \p buffer, which needs at least 11 bytes available
+ *
+ * Returns the number of bytes written, 0 for unknown symbols.
+ */
+size_t DateTimeFormat::writeSymbol(const DateTimeFormat::Fields &f, char symbol, char *buffer){
+    char* out = buffer;
+    switch(symbol){
+    case 'w': out = writeName(out, dayShortNames[f.dayOfWeek]); break;
+    case 'W': out = writeName(out, dayLongNames[f.dayOfWeek]); break;
+    case 'b': out = writeName(out, monthShortNames[f.month - 1]); break;
+    case 'B': out = writeName(out, monthLongNames[f.month - 1]); break;
+    case 'd': out = writeTwoDigits(out, f.day); break;
+    case 'e': out = writeUnpadded(out, f.day); break;
+    case 'f': out = writeSpacePadded(out, f.day); break;
+    case 'm': out = writeTwoDigits(out, f.month); break;
+    case 'n': out = writeUnpadded(out, f.month); break;
+    case 'o': out = writeSpacePadded(out, f.month); break;
+    case 'y': out = writeTwoDigits(out, ((f.year % 100) + 100) % 100); break;
+    case 'Y': out = writeYear(out, f.year); break;
+    case 'H': out = writeTwoDigits(out, f.hour); break;
+    case 'I': out = writeTwoDigits(out, f.hour == 0 ? 12 : (f.hour > 12 ? f.hour - 12 : f.hour)); break;
+    case 'a': *out++ = f.hour < 12 ? 'a' : 'p'; *out++ = 'm'; break;
+    case 'A': *out++ = f.hour < 12 ? 'A' : 'P'; *out++ = 'M'; break;
+    case 'M': out = writeTwoDigits(out, f.minute); break;
+    case 'S': out = writeTwoDigits(out, f.second); break;
+    case 's': out = writeTwoDigits(out, f.second); *out++ = '.'; out = writeThreeDigits(out, f.msecond); break;
+    case 'i': out = writeThreeDigits(out, f.msecond); break;
+    case 'c': *out++ = static_cast<char>('0' + f.msecond / 100); break;
+    }
+    return static_cast<size_t>(out - buffer);
+}
+
+size_t DateTimeFormat::render(
+        const Fields &fields, char *buffer, size_t *subsecondOffsets, char *subsecondSymbols, size_t &totalSubseconds) const
+{
+    char* out = buffer;
+    totalSubseconds = 0;
+    for ( auto it = m_segments.begin(); it != m_segments.end(); ++it ){
+        if ( it->symbol == 0 ){
+            std::memcpy(out, m_literals.data() + it->start, it->length);
+            out += it->length;
+            continue;
+        }
+        if ( subsecondOffsets ){
+            if ( it->symbol == 'i' || it->symbol == 'c' ){
+                subsecondOffsets[totalSubseconds] = static_cast<size_t>(out - buffer);
+                subsecondSymbols[totalSubseconds++] = it->symbol;
+            } else if ( it->symbol == 's' ){
+                subsecondOffsets[totalSubseconds] = static_cast<size_t>(out - buffer) + 3;
+                subsecondSymbols[totalSubseconds++] = 'i';
+            }
+        }
+        out += writeSymbol(fields, it->symbol, out);
+    }
+    return static_cast<size_t>(out - buffer);
+}
+
+size_t DateTimeFormat::writeCached(long long msecondsSinceEpoch, char *buffer) const{
+    if ( m_totalSubseconds > static_cast<size_t>(maximumCachedSubseconds) ){
+        size_t totalSubseconds = 0;
+        return render(Fields(msecondsSinceEpoch), buffer, nullptr, nullptr, totalSubseconds);
+    }
+
+    thread_local FormatCache cache[totalCacheEntries];
+    thread_local int nextEntry = 0;
+
+    long long second = floorDivide(msecondsSinceEpoch, 1000);
+    int msecond = static_cast<int>(msecondsSinceEpoch - second * 1000);
+
+    FormatCache* entry = nullptr;
+    for ( int i = 0; i < totalCacheEntries; ++i ){
+        if ( cache[i].formatId == m_id ){
+            entry = &cache[i];
+            break;
+        }
+    }
+
+    if ( entry && entry->second == second ){
+        std::memcpy(buffer, entry->text.data(), entry->text.size());
+        for ( size_t i = 0; i < entry->totalSubseconds; ++i ){
+            if ( entry->subsecondSymbols[i] == 'i' ){
+                writeThreeDigits(buffer + entry->subsecondOffsets[i], msecond);
+            } else {
+                buffer[entry->subsecondOffsets[i]] = static_cast<char>('0' + msecond / 100);
+            }
+        }
+        return entry->text.size();
+    }
+
+    if ( !entry ){
+        entry = &cache[nextEntry];
+        nextEntry = (nextEntry + 1) % totalCacheEntries;
+        entry->formatId = m_id;
+    }
+
+    size_t size = render(Fields(msecondsSinceEpoch), buffer, entry->subsecondOffsets, entry->subsecondSymbols, entry->totalSubseconds);
+    entry->second = second;
+    entry->text.assign(buffer, size);
+    return size;
+}
+
+}// namespace
@@ -0,0 +1,87 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+#ifndef LVDATETIMEFORMAT_H
+#define LVDATETIMEFORMAT_H
+
+#include "live/lvbaseglobal.h"
+#include "live/datetime.h"
+
+#include <string>
+#include <vector>
+
+namespace lv{
+
+class LV_BASE_EXPORT DateTimeFormat{
+
+public:
+    /**
+     * \class lv::DateTimeFormat::Fields
+     * \brief Calendar fields of a DateTime, computed once per format call
+     */
+    class LV_BASE_EXPORT Fields{
+    public:
+        Fields(long long msecondsSinceEpoch);
+
+        int year;
+        int month;
+        int day;
+        int dayOfWeek;
+        int hour;
+        int minute;
+        int second;
+        int msecond;
+    };
+
+public:
+    DateTimeFormat();
+
+    static DateTimeFormat compile(const std::string& pattern);
+    static bool isSymbol(char symbol);
+
+    const std::string& pattern() const{ return m_pattern; }
+    size_t maximumSize() const{ return m_maximumSize; }
+
+    size_t write(const DateTime& dt, char* buffer, size_t capacity) const;
+    void append(const DateTime& dt, std::string& result) const;
+    std::string format(const DateTime& dt) const;
+
+    static size_t writeSymbol(const Fields& fields, char symbol, char* buffer);
+
+private:
+    /// \private
+    class Segment{
+    public:
+        Segment(char s, unsigned int st, unsigned int len) : symbol(s), start(st), length(len){}
+
+        char         symbol; // 0 for literals
+        unsigned int start;
+        unsigned int length;
+    };
+
+    size_t render(const Fields& fields, char* buffer, size_t* subsecondOffsets, char* subsecondSymbols, size_t& totalSubseconds) const;
+    size_t writeCached(long long msecondsSinceEpoch, char* buffer) const;
+
+    std::string          m_pattern;
+    std::string          m_literals;
+    std::vector<Segment> m_segments;
+    size_t               m_maximumSize;
+    size_t               m_totalSubseconds;
+    unsigned long long   m_id;
+};
+
+}// namespace
+
+#endif // LVDATETIMEFORMAT_H
@@ -16,6 +16,7 @@
 #include "live/exception.h"
 #include "live/utf8.h"
 #include "live/sourcelocation.h"
+#include "live/logring.h"
 #include <sstream>
 
 namespace lv{
@@ -69,12 +70,23 @@ public:
 
 /**
  * \brief Standard exception constructor with message and code parameters
+ *
+ * When the lv::LogRing is enabled, the message, code and location are recorded in it, so a crash
+ * dump shows the exceptions thrown before the crash.
  */
 Exception::Exception(const lv::Utf8 &message, Code code, const SourceTrace &st)
     : m_d(new ExceptionPrivate(message.data(), code))
 {
     m_d->location = st.location;
     m_d->stackTrace = st.trace;
+
+    LogRing& ring = LogRing::instance();
+    if ( ring.isEnabled() ){
+        std::string entry = m_d->message + " (code " + std::to_string(code) + ")";
+        if ( !m_d->location.fileName().empty() )
+            entry += " at " + m_d->location.toString();
+        ring.write(VisualLog::MessageInfo::Error, DateTime().toLocal(), "exception", entry);
+    }
 }
 
 /**
@@ -0,0 +1,155 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+#include "internedutf8.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <functional>
+
+namespace lv{
+
+namespace{
+
+const size_t totalShards = 16;
+
+/// Entries are never freed, so handles and the views used as keys stay valid for the whole process.
+class InternPool{
+
+public:
+    class Shard{
+    public:
+        std::mutex mutex;
+        std::unordered_map<std::string_view, InternedUtf8::Entry*> entries;
+    };
+
+    static InternPool& instance(){
+        static InternPool* pool = new InternPool;
+        return *pool;
+    }
+
+    const InternedUtf8::Entry* intern(std::string_view str){
+        size_t h = std::hash<std::string_view>()(str);
+        Shard& shard = shardFor(h);
+
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        auto it = shard.entries.find(str);
+        if ( it != shard.entries.end() )
+            return it->second;
+
+        InternedUtf8::Entry* entry = new InternedUtf8::Entry(str, h);
+        shard.entries[entry->value.view()] = entry;
+        return entry;
+    }
+
+    const InternedUtf8::Entry* find(std::string_view str){
+        Shard& shard = shardFor(std::hash<std::string_view>()(str));
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        auto it = shard.entries.find(str);
+        return it != shard.entries.end() ? it->second : nullptr;
+    }
+
+    size_t size(){
+        size_t total = 0;
+        for ( size_t i = 0; i < totalShards; ++i ){
+            std::lock_guard<std::mutex> guard(m_shards[i].mutex);
+            total += m_shards[i].entries.size();
+        }
+        return total;
+    }
+
+    const InternedUtf8::Entry* empty() const{ return m_empty; }
+
+private:
+    InternPool() : m_empty(nullptr){ m_empty = intern(std::string_view()); }
+
+    // the low bits are used by the shard maps themselves
+    Shard& shardFor(size_t h){ return m_shards[(h >> 24) % totalShards]; }
+
+    Shard                      m_shards[totalShards];
+    const InternedUtf8::Entry* m_empty;
+};
+
+} // namespace
+
+/**
+ * \class lv::InternedUtf8
+ * \brief Handle to a string stored once in a process wide pool
+ *
+ * Interning the same contents always yields the same handle, so equality is a pointer compare and the
+ * hash is computed once. Interned strings live until the process exits, which makes them a good fit for
+ * identifiers like package, module and palette names, and a bad one for arbitrary text.
+ *
+ * The pool is sharded by hash and safe to use from multiple threads.
+ *
+ * \ingroup lvbase
+ */
+
+/**
+ * \brief Creates a handle to the empty string
+ */
+InternedUtf8::InternedUtf8()
+    : m_entry(InternPool::instance().empty())
+{
+}
+
+InternedUtf8::InternedUtf8(const Utf8 &str)
+    : m_entry(InternPool::instance().intern(str.view()))
+{
+}
+
+InternedUtf8::InternedUtf8(const std::string &str)
+    : m_entry(InternPool::instance().intern(str))
+{
+}
+
+InternedUtf8::InternedUtf8(const char *str)
+    : m_entry(InternPool::instance().intern(str))
+{
+}
+
+InternedUtf8::InternedUtf8(std::string_view str)
+    : m_entry(InternPool::instance().intern(str))
+{
+}
+
+/**
+ * \brief Finds \p str in the pool without adding it
+ *
+ * Returns false if the string was never interned, in which case it cannot be equal to any handle.
+ */
+bool InternedUtf8::lookup(std::string_view str, InternedUtf8 &result){
+    const Entry* entry = InternPool::instance().find(str);
+    if ( !entry )
+        return false;
+    result = InternedUtf8(entry);
+    return true;
+}
+
+/**
+ * \brief Returns the number of distinct strings in the pool
+ */
+size_t InternedUtf8::totalInterned(){
+    return InternPool::instance().size();
+}
+
+/**
+ * \brief Interns this string \sa InternedUtf8
+ */
+InternedUtf8 Utf8::intern() const{
+    return InternedUtf8(*this);
+}
+
+}// namespace
@@ -0,0 +1,85 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+#ifndef LVINTERNEDUTF8_H
+#define LVINTERNEDUTF8_H
+
+#include "live/lvbaseglobal.h"
+#include "live/utf8.h"
+
+#include <string_view>
+
+namespace lv{
+
+class LV_BASE_EXPORT InternedUtf8{
+
+public:
+    /// \private
+    class Entry{
+    public:
+        Entry(std::string_view str, size_t h) : value(str.data(), str.size()), hash(h){}
+
+        Utf8   value;
+        size_t hash;
+    };
+
+    /**
+     * \class lv::InternedUtf8::Hash
+     * \brief Hash functor returning the precomputed hash of the interned string
+     */
+    class Hash{
+    public:
+        size_t operator()(const InternedUtf8& str) const{ return str.hash(); }
+    };
+
+public:
+    InternedUtf8();
+    InternedUtf8(const Utf8& str);
+    InternedUtf8(const std::string& str);
+    InternedUtf8(const char* str);
+    InternedUtf8(std::string_view str);
+
+    const Utf8& value() const{ return m_entry->value; }
+    const std::string& data() const{ return m_entry->value.data(); }
+    std::string_view view() const{ return m_entry->value.view(); }
+    size_t size() const{ return m_entry->value.size(); }
+    bool isEmpty() const{ return m_entry->value.isEmpty(); }
+    size_t hash() const{ return m_entry->hash; }
+
+    bool operator==(const InternedUtf8& other) const{ return m_entry == other.m_entry; }
+    bool operator!=(const InternedUtf8& other) const{ return m_entry != other.m_entry; }
+    bool operator<(const InternedUtf8& other) const;
+
+    static bool lookup(std::string_view str, InternedUtf8& result);
+    static size_t totalInterned();
+
+private:
+    InternedUtf8(const Entry* entry) : m_entry(entry){}
+
+    const Entry* m_entry;
+};
+
+inline bool InternedUtf8::operator<(const InternedUtf8 &other) const{
+    return m_entry != other.m_entry && m_entry->value.data() < other.m_entry->value.data();
+}
+
+inline std::ostream& operator << (std::ostream& os, const InternedUtf8& str){
+    os << str.data();
+    return os;
+}
+
+}// namespace
+
+#endif // LVINTERNEDUTF8_H
@@ -0,0 +1,343 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#include "logring.h"
+#include "live/exception.h"
+#include "live/visuallog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+namespace lv{
+
+namespace{
+
+const size_t recordWords = LogRing::recordSize / sizeof(unsigned long long) - 1;
+const size_t recordHeaderWords = 2;
+
+std::terminate_handler previousTerminateHandler = nullptr;
+
+void terminateWithDump(){
+    std::string reason = "Terminate called";
+    std::exception_ptr current = std::current_exception();
+    if ( current ){
+        try{
+            std::rethrow_exception(current);
+        } catch ( lv::Exception& e ){
+            reason += " after throwing lv::Exception: " + e.message() + " at " + e.location().toString();
+        } catch ( std::exception& e ){
+            reason += " after throwing: " + std::string(e.what());
+        } catch ( ... ){
+            reason += " after throwing an unknown exception";
+        }
+    }
+    // the ring is lock-free, so it goes first, the files may be locked by the thread that crashed
+    LogRing::instance().dump(reason);
+    try{
+        VisualLog::tryFlushAll();
+    } catch ( ... ){
+    }
+
+    if ( previousTerminateHandler )
+        previousTerminateHandler();
+    std::abort();
+}
+
+} // namespace
+
+// LogRingPrivate
+// ----------------------------------------------------------------------------
+
+/// \private
+class LogRingPrivate{
+
+public:
+    /*
+     * Records are guarded by a sequence number. Writers move it to an odd value while they fill in the
+     * record and to the next even value once done. Readers copy the record and keep it only if the
+     * sequence number did not change in the meantime. The words are atomic, so copying a record that
+     * is being written is not a data race.
+     */
+    class Record{
+    public:
+        std::atomic<unsigned long long> sequence;
+        std::atomic<unsigned long long> words[recordWords];
+    };
+
+    class Buffer{
+    public:
+        Buffer(size_t count) : records(new Record[count]()), mask(count - 1), head(0){}
+
+        Record*                         records;
+        size_t                          mask;
+        std::atomic<unsigned long long> head;
+    };
+
+    LogRingPrivate() : buffer(nullptr), dropped(0), terminateHandlerInstalled(false){}
+
+    std::atomic<Buffer*> buffer;
+    std::atomic<size_t>  dropped;
+    mutable std::mutex   mutex;
+    std::string          dumpFile;
+    bool                 terminateHandlerInstalled;
+};
+
+
+// LogRing
+// ----------------------------------------------------------------------------
+
+/**
+ * \class lv::LogRing
+ * \brief Lock-free in-memory ring of the most recent log messages, written out on crashes
+ *
+ * Once enabled, VisualLog configurations with the \c crashRing option copy every message up to the
+ * given level into the ring, including levels that are otherwise filtered out. Nothing is formatted
+ * or written for those levels, the ring only holds the raw message. Exceptions record their message,
+ * code and location as well.
+ *
+ * The ring is written out with dump(), which happens automatically for Fatal messages and when the
+ * program terminates through std::terminate. The dump goes to dumpFile(), or to the standard error
+ * if no file is set.
+ *
+ * Writers never block. Each record has a fixed size of recordSize bytes, messages are truncated to
+ * fit. A writer that catches up with a record still being written by another thread drops its message,
+ * which is counted by dropped().
+ *
+ * \ingroup lvbase
+ */
+
+const size_t LogRing::recordSize;
+const size_t LogRing::recordTextSize;
+const size_t LogRing::recordConfigurationSize;
+const size_t LogRing::defaultSize;
+
+LogRing::LogRing()
+    : m_d(new LogRingPrivate)
+{
+}
+
+LogRing::~LogRing(){
+    delete m_d;
+}
+
+/**
+ * \brief Returns the process wide ring
+ *
+ * The ring is never destroyed, so messages logged during shutdown still have a place to go.
+ */
+LogRing &LogRing::instance(){
+    static LogRing* ring = new LogRing;
+    return *ring;
+}
+
+/**
+ * \brief Enables the ring, keeping the last \p bytes of messages
+ *
+ * The size is rounded down to a power of two number of records. Enabling an already enabled ring
+ * with a different size starts a new, empty ring. The previous one is kept in memory, since other
+ * threads may still be writing to it, so this is meant to be done once, at startup.
+ *
+ * The first call also installs a std::terminate handler that dumps the ring, then writes out the buffered
+ * log files that are not in use with VisualLog::tryFlushAll(), before passing control to the previous
+ * handler.
+ */
+void LogRing::enable(size_t bytes){
+    size_t count = 1;
+    while ( count * 2 * recordSize <= bytes )
+        count *= 2;
+
+    std::lock_guard<std::mutex> guard(m_d->mutex);
+
+    LogRingPrivate::Buffer* current = m_d->buffer.load(std::memory_order_relaxed);
+    if ( !current || current->mask + 1 != count )
+        m_d->buffer.store(new LogRingPrivate::Buffer(count), std::memory_order_release);
+
+    if ( !m_d->terminateHandlerInstalled ){
+        m_d->terminateHandlerInstalled = true;
+        previousTerminateHandler = std::set_terminate(&terminateWithDump);
+    }
+}
+
+/**
+ * \brief Shows if the ring was enabled
+ */
+bool LogRing::isEnabled() const{
+    return m_d->buffer.load(std::memory_order_relaxed) != nullptr;
+}
+
+/**
+ * \brief Returns the number of bytes the ring holds, 0 if not enabled
+ */
+size_t LogRing::capacity() const{
+    LogRingPrivate::Buffer* buffer = m_d->buffer.load(std::memory_order_acquire);
+    return buffer ? (buffer->mask + 1) * recordSize : 0;
+}
+
+/**
+ * \brief Returns the number of messages dropped because their record was still being written
+ */
+size_t LogRing::dropped() const{
+    return m_d->dropped.load(std::memory_order_relaxed);
+}
+
+/**
+ * \brief Stores a message in the ring, overwriting the oldest one
+ *
+ * Does nothing if the ring is not enabled.
+ */
+void LogRing::write(
+        VisualLog::MessageInfo::Level level,
+        const DateTime &stamp,
+        std::string_view configuration,
+        std::string_view message)
+{
+    LogRingPrivate::Buffer* buffer = m_d->buffer.load(std::memory_order_acquire);
+    if ( !buffer )
+        return;
+
+    unsigned long long index = buffer->head.fetch_add(1, std::memory_order_relaxed);
+    LogRingPrivate::Record& record = buffer->records[index & buffer->mask];
+
+    unsigned long long sequence = record.sequence.load(std::memory_order_relaxed);
+    if ( (sequence & 1) || !record.sequence.compare_exchange_strong(sequence, index * 2 + 1, std::memory_order_relaxed) ){
+        m_d->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size_t configurationSize = std::min(configuration.size(), recordConfigurationSize);
+    size_t messageSize       = std::min(message.size(), recordTextSize - configurationSize);
+    unsigned long long truncated = messageSize < message.size() ? 1 : 0;
+
+    unsigned long long words[recordWords] = {};
+    words[0] = static_cast<unsigned long long>(stamp.usecondsSinceEpoch());
+    words[1] = static_cast<unsigned long long>(level) | (configurationSize << 8) | (messageSize << 16) | (truncated << 32);
+    char* text = reinterpret_cast<char*>(words + recordHeaderWords);
+    std::memcpy(text, configuration.data(), configurationSize);
+    std::memcpy(text + configurationSize, message.data(), messageSize);
+
+    size_t used = recordHeaderWords + (configurationSize + messageSize + sizeof(unsigned long long) - 1) / sizeof(unsigned long long);
+    for ( size_t i = 0; i < used; ++i )
+        record.words[i].store(words[i], std::memory_order_relaxed);
+
+    record.sequence.store(index * 2 + 2, std::memory_order_release);
+}
+
+/**
+ * \brief Appends the messages in the ring to \p result, oldest first, one per line
+ */
+void LogRing::toText(std::string &result) const{
+    LogRingPrivate::Buffer* buffer = m_d->buffer.load(std::memory_order_acquire);
+    if ( !buffer )
+        return;
+
+    class Entry{
+    public:
+        unsigned long long sequence;
+        unsigned long long words[recordWords];
+    };
+
+    std::vector<Entry> entries;
+    entries.reserve(buffer->mask + 1);
+
+    for ( size_t i = 0; i <= buffer->mask; ++i ){
+        LogRingPrivate::Record& record = buffer->records[i];
+        unsigned long long sequence = record.sequence.load(std::memory_order_acquire);
+        if ( sequence == 0 || (sequence & 1) )
+            continue;
+
+        Entry entry;
+        entry.sequence = sequence;
+        for ( size_t w = 0; w < recordWords; ++w )
+            entry.words[w] = record.words[w].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ( record.sequence.load(std::memory_order_relaxed) != sequence )
+            continue;
+
+        entries.push_back(entry);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b){ return a.sequence < b.sequence; });
+
+    for ( auto it = entries.begin(); it != entries.end(); ++it ){
+        unsigned long long meta = it->words[1];
+        int    level             = static_cast<int>(meta & 0xff);
+        size_t configurationSize = static_cast<size_t>((meta >> 8) & 0xff);
+        size_t messageSize       = static_cast<size_t>((meta >> 16) & 0xffff);
+        bool   truncated         = (meta >> 32) & 1;
+        if ( level > VisualLog::MessageInfo::Verbose || configurationSize + messageSize > recordTextSize )
+            continue;
+
+        const char* text = reinterpret_cast<const char*>(it->words + recordHeaderWords);
+
+        result += DateTime::createFromUs(static_cast<long long>(it->words[0])).format("%Y-%m-%d %H:%M:%S.%i");
+        result += " ";
+        result += VisualLog::MessageInfo::levelToString(static_cast<VisualLog::MessageInfo::Level>(level));
+        result += " [";
+        result.append(text, configurationSize);
+        result += "] ";
+        result.append(text + configurationSize, messageSize);
+        if ( truncated )
+            result += "...";
+        result += "\n";
+    }
+}
+
+/**
+ * \brief Writes the ring out to dumpFile(), or to the standard error if there's no file set
+ *
+ * The dump is appended to the file, after a header line with the \p reason.
+ */
+void LogRing::dump(const std::string &reason) const{
+    if ( !isEnabled() )
+        return;
+
+    std::string text = "--- Log ring dump: " + reason + " ---\n";
+    toText(text);
+
+    std::string path = dumpFile();
+    FILE* file = path.empty() ? nullptr : std::fopen(path.c_str(), "ab");
+    FILE* output = file ? file : stderr;
+    std::fwrite(text.data(), 1, text.size(), output);
+    std::fflush(output);
+    if ( file )
+        std::fclose(file);
+}
+
+/**
+ * \brief Sets the file dumps are appended to
+ */
+void LogRing::setDumpFile(const std::string &path){
+    std::lock_guard<std::mutex> guard(m_d->mutex);
+    m_d->dumpFile = path;
+}
+
+/**
+ * \brief Returns the file dumps are appended to, empty for the standard error
+ */
+std::string LogRing::dumpFile() const{
+    std::lock_guard<std::mutex> guard(m_d->mutex);
+    return m_d->dumpFile;
+}
+
+}// namespace
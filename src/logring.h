@@ -0,0 +1,67 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#ifndef LVLOGRING_H
+#define LVLOGRING_H
+
+#include "live/lvbaseglobal.h"
+#include "live/visuallog.h"
+
+#include <string>
+#include <string_view>
+
+namespace lv{
+
+class LogRingPrivate;
+class LV_BASE_EXPORT LogRing{
+
+public:
+    /** Size of a record in the ring, the configuration name and the message share the rest of it */
+    static const size_t recordSize = 256;
+    /** Text stored in a record, longer messages are truncated */
+    static const size_t recordTextSize = 232;
+    /** Longest configuration name stored in a record */
+    static const size_t recordConfigurationSize = 32;
+    /** Ring size used when none is given */
+    static const size_t defaultSize = 4 * 1024 * 1024;
+
+public:
+    static LogRing& instance();
+
+    void enable(size_t bytes = defaultSize);
+    bool isEnabled() const;
+    size_t capacity() const;
+    size_t dropped() const;
+
+    void write(VisualLog::MessageInfo::Level level, const DateTime& stamp, std::string_view configuration, std::string_view message);
+
+    void toText(std::string& result) const;
+    void dump(const std::string& reason) const;
+
+    void setDumpFile(const std::string& path);
+    std::string dumpFile() const;
+
+private:
+    LogRing();
+    ~LogRing();
+    DISABLE_COPY(LogRing);
+
+    LogRingPrivate* m_d;
+};
+
+}// namespace
+
+#endif // LVLOGRING_H
@@ -1310,6 +1310,18 @@ int MLNode::asInt() const{
     return static_cast<int>(m_value.asInt);
 }
 
+/**
+ * \brief Returns the MLNode value as a 64 bit integer, without narrowing it to int.
+ *
+ * If not the appropriate type, an exception is thrown.
+ */
+MLNode::IntType MLNode::asLargeInt() const{
+    if ( m_type != Type::Integer )
+        THROW_EXCEPTION(InvalidMLTypeException, "Node is not of integer type.", 0);
+
+    return m_value.asInt;
+}
+
 /**
  * \brief Returns the MLNode value as bool.
  *
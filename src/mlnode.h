@@ -387,6 +387,7 @@ public:
 
     bool isNull() const;
     int asInt() const;
+    IntType asLargeInt() const;
     bool asBool() const;
     FloatType asFloat() const;
     const StringType& asString() const;
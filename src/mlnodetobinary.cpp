@@ -0,0 +1,169 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#include "mlnodetobinary.h"
+#include "binaryencoding.h"
+
+namespace lv{
+namespace ml{
+
+namespace{
+
+const int maximumDepth = 512;
+
+void recurseSerialize(const MLNode& n, std::string& result){
+    result.push_back(static_cast<char>(n.type()));
+
+    switch( n.type() ){
+    case MLNode::Null:
+        break;
+    case MLNode::Object:{
+        const MLNode::ObjectType& o = n.asObject();
+        binary::appendVarint(result, o.size());
+        for ( auto it = o.begin(); it != o.end(); ++it ){
+            binary::appendString(result, it->first);
+            recurseSerialize(it->second, result);
+        }
+        break;
+    }
+    case MLNode::Array:{
+        const MLNode::ArrayType& a = n.asArray();
+        binary::appendVarint(result, a.size());
+        for ( auto it = a.begin(); it != a.end(); ++it ){
+            recurseSerialize(*it, result);
+        }
+        break;
+    }
+    case MLNode::Bytes:{
+        MLNode::BytesType bytes = n.asBytes();
+        binary::appendString(result, std::string_view(bytes.data(), bytes.size()));
+        break;
+    }
+    case MLNode::String:
+        binary::appendString(result, n.asString());
+        break;
+    case MLNode::Boolean:
+        result.push_back(n.asBool() ? 1 : 0);
+        break;
+    case MLNode::Integer:
+        binary::appendSignedVarint(result, n.asLargeInt());
+        break;
+    case MLNode::Float:{
+        MLNode::FloatType value = n.asFloat();
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        binary::appendFixed64(result, bits);
+        break;
+    }
+    }
+}
+
+void recurseDeserialize(binary::Cursor& cursor, MLNode& n, int depth){
+    if ( depth > maximumDepth )
+        THROW_EXCEPTION(lv::Exception, "Malformed binary data: nodes are nested too deep.", lv::Exception::toCode("~Binary"));
+
+    unsigned char type = cursor.readByte();
+    switch( type ){
+    case MLNode::Null:
+        n = MLNode();
+        break;
+    case MLNode::Object:{
+        n = MLNode(MLNode::Object);
+        uint64_t size = cursor.readVarint();
+        for ( uint64_t i = 0; i < size; ++i ){
+            std::string key(cursor.readString());
+            MLNode value;
+            recurseDeserialize(cursor, value, depth + 1);
+            n[key] = std::move(value);
+        }
+        break;
+    }
+    case MLNode::Array:{
+        n = MLNode(MLNode::Array);
+        uint64_t size = cursor.readVarint();
+        MLNode::ArrayType& a = n.asArray();
+        // every element takes at least a byte, which bounds what corrupt sizes can reserve
+        if ( size <= cursor.remaining() )
+            a.reserve(static_cast<size_t>(size));
+        for ( uint64_t i = 0; i < size; ++i ){
+            a.push_back(MLNode());
+            recurseDeserialize(cursor, a.back(), depth + 1);
+        }
+        break;
+    }
+    case MLNode::Bytes:{
+        std::string_view bytes = cursor.readString();
+        n = MLNode(MLNode::BytesType(bytes.data(), bytes.size()));
+        break;
+    }
+    case MLNode::String:
+        n = MLNode(std::string(cursor.readString()));
+        break;
+    case MLNode::Boolean:
+        n = MLNode(cursor.readByte() != 0);
+        break;
+    case MLNode::Integer:
+        n = MLNode(static_cast<MLNode::IntType>(cursor.readSignedVarint()));
+        break;
+    case MLNode::Float:{
+        uint64_t bits = cursor.readFixed64();
+        MLNode::FloatType value;
+        std::memcpy(&value, &bits, sizeof(value));
+        n = MLNode(value);
+        break;
+    }
+    default:
+        THROW_EXCEPTION(
+            lv::Exception,
+            Utf8("Malformed binary data: unknown node type %.").format(static_cast<int>(type)),
+            lv::Exception::toCode("~Binary")
+        );
+    }
+}
+
+} // namespace
+
+/**
+ * \brief Appends the compact binary form of \p n to \p result
+ *
+ * Each node is written as its type byte followed by its value. Integers and sizes are variable length,
+ * floats are stored as their 8 byte representation and object keys are written in their map order.
+ */
+void toBinary(const MLNode &n, std::string &result){
+    recurseSerialize(n, result);
+}
+
+/**
+ * \brief Reads a node written by toBinary() from \p data
+ *
+ * Throws an lv::Exception if the data is malformed or has trailing bytes.
+ */
+void fromBinary(const char *data, size_t size, MLNode &n){
+    binary::Cursor cursor(data, size);
+    recurseDeserialize(cursor, n, 0);
+    if ( cursor.remaining() != 0 )
+        THROW_EXCEPTION(lv::Exception, "Malformed binary data: unexpected bytes after node.", lv::Exception::toCode("~Binary"));
+}
+
+/**
+ * \brief Reads a node written by toBinary() from \p data
+ */
+void fromBinary(const std::string &data, MLNode &n){
+    fromBinary(data.c_str(), data.size(), n);
+}
+
+}// namespace ml
+}// namespace
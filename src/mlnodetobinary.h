@@ -0,0 +1,34 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#ifndef LVMLNODETOBINARY_H
+#define LVMLNODETOBINARY_H
+
+#include "live/mlnode.h"
+
+namespace lv{
+
+namespace ml{
+
+void LV_BASE_EXPORT toBinary(const MLNode& n, std::string& result);
+void LV_BASE_EXPORT fromBinary(const char* data, size_t size, MLNode& n);
+void LV_BASE_EXPORT fromBinary(const std::string& data, MLNode& n);
+
+}// namespace ml
+
+}// namespace
+
+#endif // LVMLNODETOBINARY_H
@@ -24,6 +24,7 @@
 #include "live/visuallog.h"
 #include "live/path.h"
 #include "live/directory.h"
+#include "live/internedutf8.h"
 #include <list>
 #include <map>
 
@@ -46,10 +47,10 @@ const char* Module::fileName = "live.module.json";
 class ModulePrivate{
 
 public:
-    std::string name;
+    InternedUtf8 name;
     std::string path;
     std::string filePath;
-    std::string package;
+    InternedUtf8 package;
     std::list<std::pair<std::string, std::string> > palettes;
     std::list<std::string> dependencies;
     std::list<std::string> modules;
@@ -217,7 +218,7 @@ Module::Ptr Module::createEmpty(const std::string &name){
 
 /** Name getter */
 const std::string &Module::name() const{
-    return m_d->name;
+    return m_d->name.data();
 }
 
 /** Path getter */
@@ -244,7 +245,7 @@ std::string Module::pathFromPackage() const{
 
 /** Configured package path getter */
 const std::string &Module::package() const{
-    return m_d->package;
+    return m_d->package.data();
 }
 
 /** Dependencies getter */
@@ -343,7 +344,7 @@ void Module::addPalette(const std::string &type, const std::string &path){
     if ( context() ){
         Utf8 extension = Path::suffix(path);
         Utf8 name = Path::baseName(path);
-        Utf8 plugin = m_d->name;
+        const Utf8& plugin = m_d->name.value();
         Utf8 fullPath = Path::join(m_d->path, path);
         context()->packageGraph->paletteContainer()->addPalette(type, fullPath, name, extension, plugin);
     }
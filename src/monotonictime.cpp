@@ -0,0 +1,103 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+#include "monotonictime.h"
+
+#include <chrono>
+
+namespace lv{
+
+/**
+ * \class lv::MonotonicTime
+ * \brief Point on the steady clock, for measuring durations
+ *
+ * Unlike DateTime, it never jumps when the system time changes, but it has no relation to the
+ * calendar either. Only differences between two monotonic times are meaningful.
+ *
+ * \ingroup lvbase
+ */
+
+/**
+ * \brief Returns the current steady clock time
+ */
+MonotonicTime MonotonicTime::now(){
+    return MonotonicTime(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count()
+    );
+}
+
+/**
+ * \class lv::Stopwatch
+ * \brief Accumulates elapsed time between start() and stop() calls
+ *
+ * The stopwatch starts running when it is created.
+ *
+ * \ingroup lvbase
+ */
+
+Stopwatch::Stopwatch()
+    : m_start(MonotonicTime::now())
+    , m_elapsed(0)
+    , m_running(true)
+{
+}
+
+/**
+ * \brief Resumes measuring, keeping the time accumulated so far
+ */
+void Stopwatch::start(){
+    if ( m_running )
+        return;
+    m_start = MonotonicTime::now();
+    m_running = true;
+}
+
+/**
+ * \brief Pauses measuring
+ */
+void Stopwatch::stop(){
+    if ( !m_running )
+        return;
+    m_elapsed += m_start.nsecondsTo(MonotonicTime::now());
+    m_running = false;
+}
+
+/**
+ * \brief Stops the stopwatch and clears the accumulated time
+ */
+void Stopwatch::reset(){
+    m_elapsed = 0;
+    m_running = false;
+}
+
+/**
+ * \brief Clears the accumulated time and starts measuring again
+ */
+void Stopwatch::restart(){
+    m_elapsed = 0;
+    m_start = MonotonicTime::now();
+    m_running = true;
+}
+
+/**
+ * \brief Returns the total measured time in nanoseconds
+ */
+long long Stopwatch::elapsedNSeconds() const{
+    if ( m_running )
+        return m_elapsed + m_start.nsecondsTo(MonotonicTime::now());
+    return m_elapsed;
+}
+
+}// namespace
@@ -0,0 +1,70 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+#ifndef LVMONOTONICTIME_H
+#define LVMONOTONICTIME_H
+
+#include "live/lvbaseglobal.h"
+
+namespace lv{
+
+class LV_BASE_EXPORT MonotonicTime{
+
+public:
+    MonotonicTime() : m_ticks(0){}
+
+    static MonotonicTime now();
+
+    long long nanoseconds() const{ return m_ticks; }
+    long long nsecondsTo(const MonotonicTime& other) const{ return other.m_ticks - m_ticks; }
+    MonotonicTime addNSeconds(long long count) const{ return MonotonicTime(m_ticks + count); }
+
+    bool operator == (const MonotonicTime& other) const{ return m_ticks == other.m_ticks; }
+    bool operator != (const MonotonicTime& other) const{ return m_ticks != other.m_ticks; }
+    bool operator <  (const MonotonicTime& other) const{ return m_ticks <  other.m_ticks; }
+    bool operator <= (const MonotonicTime& other) const{ return m_ticks <= other.m_ticks; }
+    bool operator >  (const MonotonicTime& other) const{ return m_ticks >  other.m_ticks; }
+    bool operator >= (const MonotonicTime& other) const{ return m_ticks >= other.m_ticks; }
+
+private:
+    explicit MonotonicTime(long long ticks) : m_ticks(ticks){}
+
+    long long m_ticks; // nanoseconds from an unspecified point
+};
+
+class LV_BASE_EXPORT Stopwatch{
+
+public:
+    Stopwatch();
+
+    void start();
+    void stop();
+    void reset();
+    void restart();
+    bool isRunning() const{ return m_running; }
+
+    long long elapsedNSeconds() const;
+    long long elapsedUSeconds() const{ return elapsedNSeconds() / 1000; }
+    long long elapsedMSeconds() const{ return elapsedNSeconds() / 1000000; }
+
+private:
+    MonotonicTime m_start;
+    long long     m_elapsed;
+    bool          m_running;
+};
+
+}// namespace
+
+#endif // LVMONOTONICTIME_H
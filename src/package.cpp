@@ -22,6 +22,7 @@
 #include "live/library.h"
 #include "live/path.h"
 #include "live/directory.h"
+#include "live/internedutf8.h"
 
 #include <list>
 #include <map>
@@ -43,7 +44,7 @@ const char* Package::fileName = "live.package.json";
 class PackagePrivate{
 
 public:
-    std::string name;
+    InternedUtf8 name;
     std::string path;
     std::string filePath;
     std::string documentation;
@@ -202,7 +203,7 @@ Package::Ptr Package::createFromNode(const std::string& path, const std::string
 
 /** \brief Returns the package name */
 const std::string &Package::name() const{
-    return m_d->name;
+    return m_d->name.data();
 }
 
 /** \brief Returns the package path */
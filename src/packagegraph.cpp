@@ -21,8 +21,11 @@
 #include "live/palettecontainer.h"
 #include "live/libraryloadpath.h"
 #include "live/visuallog.h"
+#include "live/internedutf8.h"
 
 #include <list>
+#include <unordered_map>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -32,12 +35,8 @@ namespace{
 
     std::vector<std::string> splitString(const std::string &text, char sep) {
         std::vector<std::string> tokens;
-        size_t start = 0, end = 0;
-        while ((end = text.find(sep, start)) != std::string::npos) {
-            tokens.push_back(text.substr(start, end - start));
-            start = end + 1;
-        }
-        tokens.push_back(text.substr(start));
+        for ( std::string_view token : Utf8::splitView(text, std::string_view(&sep, 1)) )
+            tokens.emplace_back(token);
         return tokens;
     }
 }
@@ -46,8 +45,19 @@ namespace{
 class PackageGraphPrivate{
 
 public:
+    typedef std::unordered_map<InternedUtf8, Package::Ptr, InternedUtf8::Hash> PackageMap;
+
+    PackageMap::iterator findLoaded(const std::string& name){
+        InternedUtf8 key;
+        return InternedUtf8::lookup(name, key) ? packages.find(key) : packages.end();
+    }
+    PackageMap::const_iterator findLoaded(const std::string& name) const{
+        InternedUtf8 key;
+        return InternedUtf8::lookup(name, key) ? packages.find(key) : packages.end();
+    }
+
     std::vector<std::string> packageImportPaths;
-    std::map<std::string, Package::Ptr> packages;
+    PackageMap packages;
     std::map<std::string, PackageGraph::LibraryNode*> libraries;
     PaletteContainer* paletteContainer;
 };
@@ -79,7 +89,7 @@ PackageGraph::~PackageGraph(){
 
 /** Loads package in the graph and makes necessary checks */
 void PackageGraph::loadPackage(const Package::Ptr &p, bool addLibraries){
-    auto it = m_d->packages.find(p->name());
+    auto it = m_d->findLoaded(p->name());
     if ( it == m_d->packages.end() ){
         p->assignContext(this);
 
@@ -143,7 +153,7 @@ void PackageGraph::loadPackageWithDependencies(
 
 /** */
 void PackageGraph::addDependency(const Package::Ptr &package, const Package::Ptr &dependsOn){
-    auto packageit = m_d->packages.find(package->name());
+    auto packageit = m_d->findLoaded(package->name());
     if ( packageit == m_d->packages.end() && package->name() != "." )
         THROW_EXCEPTION(lv::Exception, "Failed to find package:" + package->name(), 3);
     if ( package->contextOwner() != this )
@@ -151,7 +161,7 @@ void PackageGraph::addDependency(const Package::Ptr &package, const Package::Ptr
     if ( dependsOn->contextOwner() != this )
         THROW_EXCEPTION(lv::Exception, "Package \'" + dependsOn->name() +"\' is not part of the current package graph.", 3);
 
-    auto dependsOnit = m_d->packages.find(dependsOn->name());
+    auto dependsOnit = m_d->findLoaded(dependsOn->name());
     if ( dependsOnit == m_d->packages.end() ){
         auto internalsIt = internals().find(dependsOn->name());
         if ( internalsIt == internals().end() ){
@@ -201,7 +211,7 @@ void PackageGraph::addDependency(const Package::Ptr &package, const Package::Ptr
 
 /** Check if there are cycles between packages, starting from the given packages */
 PackageGraph::CyclesResult<Package::Ptr> PackageGraph::checkCycles(const Package::Ptr &p){
-    auto it = m_d->packages.find(p->name());
+    auto it = m_d->findLoaded(p->name());
     if ( it == m_d->packages.end() && p->name() != ".")
         THROW_EXCEPTION(lv::Exception, "Failed to find package for cycles: " + p->name(), 2);
 
@@ -386,8 +396,14 @@ std::string PackageGraph::toString() const{
     }
     ss << std::endl;
 
+    // packages are hashed, sorted by name for a stable output
+    std::vector<std::pair<InternedUtf8, Package::Ptr> > packages(d->packages.begin(), d->packages.end());
+    std::sort(packages.begin(), packages.end(), [](const std::pair<InternedUtf8, Package::Ptr>& a, const std::pair<InternedUtf8, Package::Ptr>& b){
+        return a.first < b.first;
+    });
+
     ss << "Packages:" << std::endl;
-    for ( auto it = d->packages.begin(); it != d->packages.end(); ++it ){
+    for ( auto it = packages.begin(); it != packages.end(); ++it ){
         ss << toStringRecurse(it->second, "  ");
     }
 
@@ -463,7 +479,7 @@ Package::Ptr PackageGraph::findPackage(const std::string &packageName) const{
 
 Package::Ptr PackageGraph::findLoadedPackage(const std::string &packageName){
     PackageGraphPrivate* d = m_d;
-    auto it = d->packages.find(packageName); // find in loaded packages
+    auto it = d->findLoaded(packageName); // find in loaded packages
     if ( it != d->packages.end() )
         return it->second;
 
@@ -476,7 +492,7 @@ Package::Ptr PackageGraph::findLoadedPackage(const std::string &packageName){
 
 Package::ConstPtr PackageGraph::findLoadedPackage(const std::string &packageName) const{
     const PackageGraphPrivate* d = m_d;
-    auto it = d->packages.find(packageName); // find in loaded packages
+    auto it = d->findLoaded(packageName); // find in loaded packages
     if ( it != d->packages.end() )
         return it->second;
 
@@ -489,14 +505,14 @@ Package::ConstPtr PackageGraph::findLoadedPackage(const std::string &packageName
 
 /** Returns the package with the given name internally */
 Package::Ptr PackageGraph::package(const std::string &name){
-    auto it = m_d->packages.find(name);
+    auto it = m_d->findLoaded(name);
     if ( it != m_d->packages.end() )
         return it->second;
     return Package::Ptr(nullptr);
 }
 
 Package::ConstPtr PackageGraph::package(const std::string &name) const{
-    auto it = m_d->packages.find(name);
+    auto it = m_d->findLoaded(name);
     if ( it != m_d->packages.end() )
         return it->second;
     return Package::Ptr(nullptr);
@@ -609,7 +625,7 @@ Module::Ptr PackageGraph::loadModule(const std::vector<std::string> &importSegme
         }
     }
 
-    auto it = d->packages.find(packageName); // find in loaded packages
+    auto it = d->findLoaded(packageName); // find in loaded packages
     if ( it != d->packages.end() )
         foundPackage = it->second;
 
@@ -18,27 +18,27 @@
 namespace lv{
 
 const Utf8 &PaletteContainer::PaletteInfo::type() const{
-    return m_type;
+    return m_type.value();
 }
 
 const Utf8 &PaletteContainer::PaletteInfo::path() const{
-    return m_path;
+    return m_path.value();
 }
 
 const Utf8 &PaletteContainer::PaletteInfo::name() const{
-    return m_name;
+    return m_name.value();
 }
 
 const Utf8 &PaletteContainer::PaletteInfo::extension() const{
-    return m_extension;
+    return m_extension.value();
 }
 
 const Utf8 &PaletteContainer::PaletteInfo::plugin() const{
-    return m_plugin;
+    return m_plugin.value();
 }
 
 bool PaletteContainer::PaletteInfo::isValid() const{
-    return m_path.utfLength() > 0;
+    return !m_path.isEmpty();
 }
 
 PaletteContainer::PaletteInfo::PaletteInfo(
@@ -67,7 +67,7 @@ void PaletteContainer::addPalette(const lv::Utf8 &type, const lv::Utf8 &path, co
     auto it = m_palettes->find(type.data());
     if ( it != m_palettes->end() ){
         for ( auto pit = it->second.begin(); pit != it->second.end(); ++pit ){
-            if ( pit->path() == pi.path() )
+            if ( pit->m_path == pi.m_path )
                 return;
         }
         it->second.push_back(pi);
@@ -94,9 +94,13 @@ Utf8 PaletteContainer::toString() const{
 }
 
 PaletteContainer::PaletteInfo PaletteContainer::findPaletteByName(const Utf8 &name) const{
+    InternedUtf8 key;
+    if ( !InternedUtf8::lookup(name.view(), key) )
+        return PaletteContainer::PaletteInfo();
+
     for ( auto it = m_palettes->begin(); it != m_palettes->end(); ++it ){
         for ( auto pit = it->second.begin(); pit != it->second.end(); ++pit ){
-            if ( pit->name() == name ){
+            if ( pit->m_name == key ){
                 return *pit;
             }
         }
@@ -18,6 +18,7 @@
 
 #include "live/lvbaseglobal.h"
 #include "live/utf8.h"
+#include "live/internedutf8.h"
 #include <map>
 #include <list>
 
@@ -42,11 +43,11 @@ public:
         bool isValid() const;
 
     private:
-        Utf8 m_type;
-        Utf8 m_path;
-        Utf8 m_name;
-        Utf8 m_extension;
-        Utf8 m_plugin;
+        InternedUtf8 m_type;
+        InternedUtf8 m_path;
+        InternedUtf8 m_name;
+        InternedUtf8 m_extension;
+        InternedUtf8 m_plugin;
     };
 
 public:
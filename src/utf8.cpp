@@ -23,9 +23,400 @@
 #include <algorithm>
 #include <cctype>
 #include <iomanip>
+#include <cstdio>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LV_UTF8_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace lv{
 
+namespace{
+
+inline unsigned int popCount16(unsigned int v){
+    v = v - ((v >> 1) & 0x5555);
+    v = (v & 0x3333) + ((v >> 2) & 0x3333);
+    v = (v + (v >> 4)) & 0x0F0F;
+    return (v + (v >> 8)) & 0x1F;
+}
+
+inline bool isContinuationByte(unsigned char c){
+    return (c & 0xC0) == 0x80;
+}
+
+/// Counts bytes that are not continuation bytes, which equals the number of code points in valid utf8
+size_t countCodePoints(const char* str, size_t size){
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(str);
+    size_t count = 0;
+    size_t i = 0;
+
+#ifdef LV_UTF8_SSE2
+    const __m128i lastContinuation = _mm_set1_epi8(static_cast<char>(0xBF));
+    while ( i + 16 <= size ){
+        // byte counters overflow after 255 iterations
+        size_t blocks = std::min<size_t>((size - i) / 16, 255);
+        __m128i acc = _mm_setzero_si128();
+        for ( size_t b = 0; b < blocks; ++b, i += 16 ){
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            acc = _mm_sub_epi8(acc, _mm_cmpgt_epi8(v, lastContinuation));
+        }
+        __m128i sums = _mm_sad_epu8(acc, _mm_setzero_si128());
+        count += static_cast<size_t>(_mm_cvtsi128_si32(sums)) + static_cast<size_t>(_mm_extract_epi16(sums, 4));
+    }
+#else
+    while ( i + 8 <= size ){
+        uint64_t x;
+        std::memcpy(&x, p + i, 8);
+        uint64_t continuation = ((x & ~(x << 1)) & 0x8080808080808080ULL) >> 7;
+        count += 8 - static_cast<size_t>((continuation * 0x0101010101010101ULL) >> 56);
+        i += 8;
+    }
+#endif
+
+    for ( ; i < size; ++i )
+        count += !isContinuationByte(p[i]);
+    return count;
+}
+
+/// Returns the byte offset of the code point at \p utfIndex, size if it's one past the last one, npos otherwise
+size_t findCodePointOffset(const char* str, size_t size, size_t utfIndex){
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(str);
+    size_t count = 0;
+    size_t i = 0;
+
+#ifdef LV_UTF8_SSE2
+    const __m128i lastContinuation = _mm_set1_epi8(static_cast<char>(0xBF));
+    while ( i + 16 <= size ){
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpgt_epi8(v, lastContinuation)));
+        size_t blockCount = popCount16(mask);
+        if ( count + blockCount > utfIndex )
+            break;
+        count += blockCount;
+        i += 16;
+    }
+#endif
+
+    for ( ; i < size; ++i ){
+        if ( !isContinuationByte(p[i]) ){
+            if ( count == utfIndex )
+                return i;
+            ++count;
+        }
+    }
+    return count == utfIndex ? size : std::string::npos;
+}
+
+/// Steps \p offset back over continuation bytes, to the first byte of the code point it falls into
+size_t findCodePointStart(const char* str, size_t size, size_t offset){
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(str);
+    while ( offset > 0 && offset < size && isContinuationByte(p[offset]) )
+        --offset;
+    return offset;
+}
+
+bool validateUtf8(const char* str, size_t size){
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(str);
+    size_t i = 0;
+
+    while ( i < size ){
+#ifdef LV_UTF8_SSE2
+        if ( i + 16 <= size ){
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            if ( _mm_movemask_epi8(v) == 0 ){
+                i += 16;
+                continue;
+            }
+        }
+#else
+        if ( i + 8 <= size ){
+            uint64_t x;
+            std::memcpy(&x, p + i, 8);
+            if ( (x & 0x8080808080808080ULL) == 0 ){
+                i += 8;
+                continue;
+            }
+        }
+#endif
+        unsigned char c = p[i];
+        if ( c < 0x80 ){
+            ++i;
+            continue;
+        }
+
+        size_t   length;
+        uint32_t codePoint;
+        uint32_t minimum;
+        if ( (c & 0xE0) == 0xC0 ){
+            length = 2; codePoint = c & 0x1F; minimum = 0x80;
+        } else if ( (c & 0xF0) == 0xE0 ){
+            length = 3; codePoint = c & 0x0F; minimum = 0x800;
+        } else if ( (c & 0xF8) == 0xF0 ){
+            length = 4; codePoint = c & 0x07; minimum = 0x10000;
+        } else {
+            return false;
+        }
+
+        if ( i + length > size )
+            return false;
+        for ( size_t k = 1; k < length; ++k ){
+            if ( !isContinuationByte(p[i + k]) )
+                return false;
+            codePoint = (codePoint << 6) | (p[i + k] & 0x3F);
+        }
+
+        // overlong encodings, surrogates and values outside the unicode range
+        if ( codePoint < minimum || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF) )
+            return false;
+
+        i += length;
+    }
+    return true;
+}
+
+inline char asciiToLower(char c){
+    return (static_cast<unsigned char>(c - 'A') < 26) ? static_cast<char>(c + 32) : c;
+}
+
+inline char asciiToUpper(char c){
+    return (static_cast<unsigned char>(c - 'a') < 26) ? static_cast<char>(c - 32) : c;
+}
+
+/// Writes the case mapped \p input into \p output, returns false on invalid utf8
+bool convertCase(const std::string& input, std::string& output, bool toUpper){
+    const char* src  = input.data();
+    size_t      size = input.size();
+
+    // case mapping can change the encoded size of a code point, so the output grows on demand
+    output.resize(size);
+    size_t w = 0;
+    size_t i = 0;
+
+#ifdef LV_UTF8_SSE2
+    const __m128i rangeStart = _mm_set1_epi8(toUpper ? 'a' - 1 : 'A' - 1);
+    const __m128i rangeEnd   = _mm_set1_epi8(toUpper ? 'z' + 1 : 'Z' + 1);
+    const __m128i caseBit    = _mm_set1_epi8(0x20);
+#endif
+
+    while ( i < size ){
+#ifdef LV_UTF8_SSE2
+        if ( i + 16 <= size ){
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            if ( _mm_movemask_epi8(v) == 0 ){
+                __m128i inRange = _mm_and_si128(_mm_cmpgt_epi8(v, rangeStart), _mm_cmplt_epi8(v, rangeEnd));
+                __m128i flip    = _mm_and_si128(inRange, caseBit);
+                v = toUpper ? _mm_sub_epi8(v, flip) : _mm_add_epi8(v, flip);
+                if ( w + 16 > output.size() )
+                    output.resize(std::max(output.size() * 2, w + 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&output[w]), v);
+                w += 16;
+                i += 16;
+                continue;
+            }
+        }
+#endif
+        char c = src[i];
+        if ( static_cast<unsigned char>(c) < 0x80 ){
+            if ( w + 1 > output.size() )
+                output.resize(std::max(output.size() * 2, w + 1));
+            output[w++] = toUpper ? asciiToUpper(c) : asciiToLower(c);
+            ++i;
+            continue;
+        }
+
+        utf8proc_int32_t codePoint;
+        utf8proc_ssize_t charSize = utf8proc_iterate(
+            reinterpret_cast<const utf8proc_uint8_t*>(src + i), static_cast<utf8proc_ssize_t>(size - i), &codePoint
+        );
+        if ( charSize <= 0 )
+            return false;
+        i += static_cast<size_t>(charSize);
+
+        utf8proc_int32_t mapped = toUpper ? utf8proc_toupper(codePoint) : utf8proc_tolower(codePoint);
+        utf8proc_uint8_t encoded[4];
+        utf8proc_ssize_t encodedSize = utf8proc_encode_char(mapped, encoded);
+        if ( encodedSize == 0 ){
+            encodedSize = utf8proc_encode_char(codePoint, encoded);
+            if ( encodedSize == 0 )
+                return false;
+        }
+
+        if ( w + static_cast<size_t>(encodedSize) > output.size() )
+            output.resize(std::max(output.size() * 2, w + static_cast<size_t>(encodedSize)));
+        std::memcpy(&output[w], encoded, static_cast<size_t>(encodedSize));
+        w += static_cast<size_t>(encodedSize);
+    }
+
+    output.resize(w);
+    return true;
+}
+
+inline unsigned int lowestBitIndex(unsigned int mask){
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned int>(index);
+#else
+    return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
+
+inline unsigned int highestBitIndex(unsigned int mask){
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return static_cast<unsigned int>(index);
+#else
+    return 31u - static_cast<unsigned int>(__builtin_clz(mask));
+#endif
+}
+
+/**
+ * Finds \p needle in \p haystack starting at \p offset. Blocks of 16 candidate positions are filtered by
+ * comparing both the first and the last byte of the needle, only the survivors get a full compare.
+ */
+size_t findSubstring(std::string_view haystack, std::string_view needle, size_t offset){
+    const size_t n = haystack.size();
+    const size_t m = needle.size();
+    if ( offset > n || m > n - offset )
+        return m == 0 && offset <= n ? offset : std::string::npos;
+    if ( m == 0 )
+        return offset;
+
+    const char* h = haystack.data();
+    if ( m == 1 ){
+        const void* found = std::memchr(h + offset, needle[0], n - offset);
+        return found ? static_cast<size_t>(static_cast<const char*>(found) - h) : std::string::npos;
+    }
+
+    const size_t last = n - m; // last candidate position
+    size_t i = offset;
+
+#ifdef LV_UTF8_SSE2
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i tail  = _mm_set1_epi8(needle[m - 1]);
+    int blocksWithoutFirst = 0;
+    while ( i + 15 <= last ){
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i));
+        __m128i blockLast  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i + m - 1));
+        __m128i firstMatches = _mm_cmpeq_epi8(blockFirst, first);
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(
+            _mm_and_si128(firstMatches, _mm_cmpeq_epi8(blockLast, tail))
+        ));
+        if ( mask == 0 ){
+            if ( _mm_movemask_epi8(firstMatches) != 0 ){
+                blocksWithoutFirst = 0;
+            } else if ( ++blocksWithoutFirst >= 4 ){
+                // the first byte is rare, let memchr skip ahead to the next candidate
+                const void* found = std::memchr(h + i + 16, needle[0], last - i - 15);
+                if ( !found )
+                    return std::string::npos;
+                i = static_cast<size_t>(static_cast<const char*>(found) - h);
+                blocksWithoutFirst = 0;
+                continue;
+            }
+            i += 16;
+            continue;
+        }
+
+        while ( mask ){
+            unsigned int bit = lowestBitIndex(mask);
+            if ( std::memcmp(h + i + bit + 1, needle.data() + 1, m - 2) == 0 )
+                return i + bit;
+            mask &= mask - 1;
+        }
+        i += 16;
+    }
+#endif
+
+    for ( ; i <= last; ++i ){
+        if ( h[i] == needle[0] && h[i + m - 1] == needle[m - 1] && std::memcmp(h + i + 1, needle.data() + 1, m - 2) == 0 )
+            return i;
+    }
+    return std::string::npos;
+}
+
+/**
+ * Finds the last occurrence of \p needle in \p haystack starting at or before \p offset, using the same
+ * first and last byte filter as findSubstring, scanning blocks backwards.
+ */
+size_t findLastSubstring(std::string_view haystack, std::string_view needle, size_t offset){
+    const size_t n = haystack.size();
+    const size_t m = needle.size();
+    if ( m > n )
+        return std::string::npos;
+    if ( m == 0 )
+        return std::min(offset, n);
+
+    const char* h = haystack.data();
+    size_t end = std::min(offset, n - m) + 1; // candidates are in [0, end)
+
+#ifdef LV_UTF8_SSE2
+    if ( m > 1 ){
+        const __m128i first = _mm_set1_epi8(needle[0]);
+        const __m128i tail  = _mm_set1_epi8(needle[m - 1]);
+        while ( end >= 16 ){
+            size_t base = end - 16;
+            __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(h + base));
+            __m128i blockLast  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(h + base + m - 1));
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, tail))
+            ));
+            while ( mask ){
+                unsigned int bit = highestBitIndex(mask);
+                if ( std::memcmp(h + base + bit + 1, needle.data() + 1, m - 2) == 0 )
+                    return base + bit;
+                mask &= ~(1u << bit);
+            }
+            end = base;
+        }
+    }
+#endif
+
+    while ( end > 0 ){
+        --end;
+        if ( h[end] == needle[0] && std::memcmp(h + end + 1, needle.data() + 1, m - 1) == 0 )
+            return end;
+    }
+    return std::string::npos;
+}
+
+bool isAsciiSpace(char c){
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/**
+ * Counts the occurrences of \p from first, so the result is sized once and written in a single pass.
+ */
+void replaceAllInto(std::string_view str, std::string_view from, std::string_view to, std::string& result){
+    size_t occurrences = 0;
+    for ( size_t pos = findSubstring(str, from, 0); pos != std::string_view::npos; pos = findSubstring(str, from, pos + from.size()) )
+        ++occurrences;
+
+    result.clear();
+    if ( occurrences == 0 ){
+        result.assign(str.data(), str.size());
+        return;
+    }
+
+    result.reserve(str.size() - occurrences * from.size() + occurrences * to.size());
+
+    size_t start = 0;
+    for ( size_t pos = findSubstring(str, from, 0); pos != std::string_view::npos; pos = findSubstring(str, from, start) ){
+        result.append(str.data() + start, pos - start);
+        result.append(to.data(), to.size());
+        start = pos + from.size();
+    }
+    result.append(str.data() + start, str.size() - start);
+}
+
+} // namespace
+
 
 /**
  * \class lv::Utf8::Range
@@ -44,6 +435,56 @@ std::string Utf8::Range::slice(const std::string &str) const{
     return std::string();
 }
 
+/**
+ * \class lv::Utf8::OffsetIndex
+ * \brief Sparse index mapping code point indexes to byte offsets
+ */
+
+Utf8::OffsetIndex::OffsetIndex(const Utf8 &str, size_t stride)
+    : m_data(str.data().data())
+    , m_size(str.size())
+    , m_stride(stride > 0 ? stride : 1)
+    , m_utfLength(0)
+{
+    size_t offset = 0;
+    m_checkpoints.push_back(0);
+    while ( true ){
+        size_t next = findCodePointOffset(m_data + offset, m_size - offset, m_stride);
+        if ( next == std::string::npos || offset + next == m_size ){
+            m_utfLength = (m_checkpoints.size() - 1) * m_stride + countCodePoints(m_data + offset, m_size - offset);
+            break;
+        }
+        offset += next;
+        m_checkpoints.push_back(offset);
+    }
+}
+
+/**
+ * \brief Returns the byte offset of the code point at \p utfIndex \sa Utf8::utfIndexToByteOffset()
+ */
+size_t Utf8::OffsetIndex::byteOffset(size_t utfIndex) const{
+    if ( utfIndex > m_utfLength )
+        return std::string::npos;
+    if ( utfIndex == m_utfLength )
+        return m_size;
+    size_t checkpoint = utfIndex / m_stride;
+    size_t base = m_checkpoints[checkpoint];
+    return base + findCodePointOffset(m_data + base, m_size - base, utfIndex % m_stride);
+}
+
+/**
+ * \brief Returns the code point index for \p byteOffset \sa Utf8::byteOffsetToUtfIndex()
+ */
+size_t Utf8::OffsetIndex::utfIndex(size_t byteOffset) const{
+    if ( byteOffset > m_size )
+        return std::string::npos;
+    byteOffset = findCodePointStart(m_data, m_size, byteOffset);
+    auto it = std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), byteOffset);
+    size_t checkpoint = static_cast<size_t>(it - m_checkpoints.begin()) - 1;
+    size_t base = m_checkpoints[checkpoint];
+    return checkpoint * m_stride + countCodePoints(m_data + base, byteOffset - base);
+}
+
 /**
  * \class lv::Utf8
  * \brief Encapsulates an Utf8 string
@@ -51,22 +492,26 @@ std::string Utf8::Range::slice(const std::string &str) const{
  */
 
 Utf8::Utf8()
-    : m_data(new std::string)
 {
 }
 
 Utf8::Utf8(const std::string &str)
-    : m_data(new std::string(str))
+    : m_data(str)
+{
+}
+
+Utf8::Utf8(std::string &&str)
+    : m_data(std::move(str))
 {
 }
 
 Utf8::Utf8(const char *str)
-    : m_data(new std::string(str))
+    : m_data(str)
 {
 }
 
 Utf8::Utf8(const char *str, size_t size)
-    : m_data(new std::string(str, size))
+    : m_data(str, size)
 {
 }
 
@@ -74,103 +519,180 @@ Utf8::~Utf8(){
 }
 
 char Utf8::byteAt(size_t pos) const{
-    return (*m_data)[pos];
+    return m_data[pos];
 }
 
 const std::string &Utf8::data() const{
-    return *m_data;
+    return m_data;
+}
+
+/**
+ * \brief Returns a view over this string's bytes, valid as long as the string is unchanged
+ */
+std::string_view Utf8::view() const{
+    return std::string_view(m_data);
 }
 
 size_t Utf8::find(char ch, size_t offset) const{
-    return m_data->find(ch, offset);
+    return m_data.find(ch, offset);
 }
 
 size_t Utf8::find(const char *ch, size_t offset) const{
-    return m_data->find(ch, offset);
+    return findSubstring(m_data, ch, offset);
 }
 
 size_t Utf8::find(const std::string &str, size_t offset) const{
-    return m_data->find(str, offset);
+    return findSubstring(m_data, str, offset);
 }
 
 size_t Utf8::find(const Utf8 &str, size_t offset) const{
-    return m_data->find(str.data(), offset);
+    return findSubstring(m_data, str.data(), offset);
 }
 
 size_t Utf8::findLast(char ch, size_t offset) const{
-    return m_data->rfind(ch, offset);
+    return m_data.rfind(ch, offset);
 }
 
 size_t Utf8::findLast(const char *str, size_t offset) const{
-    return m_data->rfind(str, offset);
+    return findLastSubstring(m_data, str, offset);
 }
 
 size_t Utf8::findLast(const std::string &str, size_t offset) const{
-    return m_data->rfind(str, offset);
+    return findLastSubstring(m_data, str, offset);
 }
 
 size_t Utf8::findLast(const Utf8 &str, size_t offset) const{
-    return m_data->rfind(str.data(), offset);
+    return findLastSubstring(m_data, str.data(), offset);
 }
 
+/**
+ * \brief Finds the first match of any of the \p patterns starting at \p offset
+ */
+Utf8::PatternSet::Match Utf8::findAny(const PatternSet &patterns, size_t offset) const{
+    return patterns.findFirst(m_data, offset);
+}
+
+/**
+ * \brief Finds the first match of any of the \p patterns starting at \p offset
+ *
+ * Compiles the patterns on each call, use a PatternSet directly when searching repeatedly.
+ */
+Utf8::PatternSet::Match Utf8::findAny(const std::vector<Utf8> &patterns, size_t offset) const{
+    return PatternSet(patterns).findFirst(m_data, offset);
+}
+
+/**
+ * \brief Returns a copy of this string with all occurrences of \p from replaced by \p to
+ *
+ * An empty \p from leaves the string unchanged.
+ */
 Utf8 Utf8::replaceAll(const Utf8 &from, const Utf8 &to) const{
-    std::string result = data();
-    size_t start_pos = 0;
+    if ( from.isEmpty() )
+        return *this;
+    std::string result;
+    replaceAllInto(m_data, from.data(), to.data(), result);
+    return Utf8(std::move(result));
+}
 
-    while( (start_pos = result.find(from.data(), start_pos)) != std::string::npos) {
-        result.replace(start_pos, from.length(), to.data());
-        start_pos += to.length(); // Handles case where 'to' is a substring of 'from'
+/**
+ * \brief Replaces all keys of \p replacements with their values in a single pass
+ *
+ * Where keys overlap, the leftmost match is replaced, then the longest.
+ */
+Utf8 Utf8::replaceAll(const std::map<Utf8, Utf8> &replacements) const{
+    std::vector<Utf8> patterns;
+    std::vector<Utf8> values;
+    patterns.reserve(replacements.size());
+    values.reserve(replacements.size());
+    for ( auto it = replacements.begin(); it != replacements.end(); ++it ){
+        patterns.push_back(it->first);
+        values.push_back(it->second);
     }
+    return replaceAll(PatternSet(patterns), values);
+}
 
-    return Utf8(result);
+/**
+ * \brief Replaces each match of \p patterns with the replacement at the same index in a single pass
+ */
+Utf8 Utf8::replaceAll(const PatternSet &patterns, const std::vector<Utf8> &replacements) const{
+    if ( replacements.size() < patterns.totalPatterns() )
+        THROW_EXCEPTION(lv::Exception, "Missing replacements for pattern set.", lv::Exception::toCode("~Replacements"));
+
+    std::vector<PatternSet::Match> matches = patterns.findAll(m_data);
+    if ( matches.empty() )
+        return *this;
+
+    size_t resultSize = m_data.size();
+    for ( auto it = matches.begin(); it != matches.end(); ++it )
+        resultSize = resultSize - it->length + replacements[it->pattern].size();
+
+    std::string result;
+    result.reserve(resultSize);
+    size_t start = 0;
+    for ( auto it = matches.begin(); it != matches.end(); ++it ){
+        result.append(m_data, start, it->position - start);
+        result.append(replacements[it->pattern].data());
+        start = it->position + it->length;
+    }
+    result.append(m_data, start, std::string::npos);
+    return Utf8(std::move(result));
 }
 
 Utf8 Utf8::substr(size_t start, size_t length) const{
-    return Utf8(m_data->substr(start, length));
+    return Utf8(m_data.substr(start, length));
+}
+
+/**
+ * \brief Returns a view of \p length bytes starting at \p start, without copying
+ *
+ * Throws std::out_of_range if \p start is past the end of the string.
+ */
+std::string_view Utf8::substrView(size_t start, size_t length) const{
+    return view().substr(start, length);
 }
 
 char Utf8::operator[](size_t index) const{
-    return m_data->at(index);
+    return m_data.at(index);
 }
 
 int Utf8::compare(const Utf8 &other) const{
-    return m_data->compare(other.data());
+    return m_data.compare(other.data());
 }
 
 int Utf8::compare(const std::string &other) const{
-    return m_data->compare(other);
+    return m_data.compare(other);
 }
 
 int Utf8::compare(const char *other) const{
-    return m_data->compare(other);
+    return m_data.compare(other);
 }
 
 bool Utf8::startsWith(const Utf8 &other) const{
-    return m_data->rfind(other.data(), 0) == 0;
+    return m_data.rfind(other.data(), 0) == 0;
 }
 
 bool Utf8::startsWith(const std::string &str) const{
-    return m_data->rfind(str, 0) == 0;
+    return m_data.rfind(str, 0) == 0;
 }
 
 bool Utf8::startsWith(const char *str) const{
-    return m_data->rfind(str, 0) == 0;
+    return m_data.rfind(str, 0) == 0;
 }
 
 bool Utf8::startsWith(char ch) const{
-    return m_data->rfind(ch, 0) == 0;
+    return m_data.rfind(ch, 0) == 0;
 }
 
 bool Utf8::endsWith(const Utf8 &other) const{
     if ( length() > other.length() ){
-        return (0 == m_data->compare(m_data->length() - other.length(), other.length(), other.data()));
+        return (0 == m_data.compare(m_data.length() - other.length(), other.length(), other.data()));
     }
     return false;
 }
 
 bool Utf8::endsWith(const std::string &str) const{
     if ( length() > str.length() ){
-        return (0 == m_data->compare(m_data->length() - str.length(), str.length(), str));
+        return (0 == m_data.compare(m_data.length() - str.length(), str.length(), str));
     }
     return false;
 }
@@ -181,104 +703,67 @@ bool Utf8::endsWith(const char *str) const{
 
 bool Utf8::endsWith(char ch) const{
     if ( length() > 0 )
-        return m_data->at(m_data->length() - 1) == ch;
+        return m_data.at(m_data.length() - 1) == ch;
     return false;
 }
 
+/**
+ * \brief Returns a copy of this string with all code points mapped to lower case
+ *
+ * ASCII runs are converted in place without decoding, only non-ASCII code points go through utf8proc.
+ * Returns an empty string if this string is not valid utf8.
+ */
 Utf8 Utf8::toLower() const{
-    utf8proc_int32_t nextcodepoint;
-
-    const char* strdata = m_data->c_str();
-    size_t strlength = length();
-
-    utf8proc_uint8_t* lowerCharDst = new utf8proc_uint8_t[4];
-
-    std::string* lowerStr = new std::string;
-    lowerStr->reserve(strlength);
-
-    while ( strlength > 0 ){
-        utf8proc_ssize_t charsize = utf8proc_iterate(reinterpret_cast<const utf8proc_uint8_t*>(strdata), -1, &nextcodepoint);
-        if ( charsize <= 0 ){
-            delete[] lowerCharDst;
-            return "";
-        }
-
-        strlength -= charsize;
-        strdata   += charsize;
-
-        utf8proc_int32_t lowercodepoint = utf8proc_tolower(nextcodepoint);
-        utf8proc_ssize_t encodecharsize = utf8proc_encode_char(lowercodepoint, lowerCharDst);
-        if ( encodecharsize == 0 ){
-            encodecharsize = utf8proc_encode_char(nextcodepoint, lowerCharDst);
-            if ( encodecharsize == 0 ){
-                delete[] lowerCharDst;
-                return "";
-            }
-        }
-        for ( int i = 0; i < encodecharsize; ++i )
-            lowerStr += static_cast<char>(lowerCharDst[i]);
-    }
-
-    delete[] lowerCharDst;
-    return Utf8(lowerStr);
+    std::string result;
+    if ( !convertCase(m_data, result, false) )
+        return "";
+    return Utf8(std::move(result));
 }
 
+/**
+ * \brief Returns a copy of this string with all code points mapped to upper case \sa toLower()
+ */
 Utf8 Utf8::toUpper() const{
-    utf8proc_int32_t nextcodepoint;
-
-    const char* strdata = m_data->c_str();
-    size_t strlength = length();
-
-    utf8proc_uint8_t* upperCharDst = new utf8proc_uint8_t[4];
-
-    std::string* upperStr = new std::string;
-    upperStr->reserve(strlength);
-
-    while ( strlength > 0 ){
-        utf8proc_ssize_t charsize = utf8proc_iterate(reinterpret_cast<const utf8proc_uint8_t*>(strdata), -1, &nextcodepoint);
-        if ( charsize <= 0 ){
-            delete[] upperCharDst;
-            return "";
-        }
-
-        strlength -= charsize;
-        strdata   += charsize;
-
-        utf8proc_int32_t uppercodepoint = utf8proc_toupper(nextcodepoint);
-        utf8proc_ssize_t encodecharsize = utf8proc_encode_char(uppercodepoint, upperCharDst);
-        if ( encodecharsize == 0 ){
-            encodecharsize = utf8proc_encode_char(nextcodepoint, upperCharDst);
-            if ( encodecharsize == 0 ){
-                delete[] upperCharDst;
-                return "";
-            }
-        }
-        for ( int i = 0; i < encodecharsize; ++i )
-            upperStr += static_cast<char>(upperCharDst[i]);
-
-    }
-
-    delete[] upperCharDst;
-    return Utf8(upperStr);
+    std::string result;
+    if ( !convertCase(m_data, result, true) )
+        return "";
+    return Utf8(std::move(result));
 }
 
-std::vector<Utf8> Utf8::split(const char *sep){
+/**
+ * \brief Splits this string by \p sep into separate strings
+ *
+ * Use splitView() to iterate the tokens without copying them.
+ */
+std::vector<Utf8> Utf8::split(const char *sep) const{
     std::vector<Utf8> tokens;
-    std::size_t start = 0, end = 0;
-    while ((end = m_data->find(sep, start)) != std::string::npos) {
-        tokens.push_back(Utf8(m_data->substr(start, end - start)));
-        start = end + 1;
-    }
-    tokens.push_back(Utf8(m_data->substr(start)));
+    for ( std::string_view token : splitView(sep) )
+        tokens.push_back(Utf8(token.data(), token.size()));
     return tokens;
 }
 
+/**
+ * \brief Returns a lazy range over the tokens of this string separated by \p sep
+ *
+ * Not available on temporaries, since the tokens point into the string.
+ */
+Utf8::SplitRange Utf8::splitView(std::string_view sep) const &{
+    return SplitRange(m_data, sep);
+}
+
+/**
+ * \brief Returns a lazy range over the tokens of \p str separated by \p sep
+ */
+Utf8::SplitRange Utf8::splitView(std::string_view str, std::string_view sep){
+    return SplitRange(str, sep);
+}
+
 Utf8 Utf8::join(const std::vector<Utf8> &parts, const Utf8 &delim){
     Utf8 result;
     for( const auto &s : parts ){
         if(!result.isEmpty())
-            *result.m_data += delim.data();
-        *result.m_data += s.data();
+            result.m_data += delim.data();
+        result.m_data += s.data();
     }
     return result;
 }
@@ -287,39 +772,131 @@ Utf8 Utf8::join(const std::vector<std::string> &parts, const std::string &delim)
     Utf8 result;
     for( const auto &s : parts ){
         if(!result.isEmpty())
-            *result.m_data += delim;
-        *result.m_data += s;
+            result.m_data += delim;
+        result.m_data += s;
     }
     return result;
 }
 
 size_t Utf8::size() const{
-    return m_data->size();
+    return m_data.size();
 }
 
 size_t Utf8::length() const{
     return size();
 }
 
+/**
+ * \brief Returns the number of code points in this string
+ *
+ * Counts every byte that is not a utf8 continuation byte, so the result is only meaningful for
+ * valid strings. \sa isValid()
+ */
 size_t Utf8::utfLength() const{
-    utf8proc_int32_t nextcodepoint;
+    return countCodePoints(m_data.data(), m_data.size());
+}
+
+/**
+ * \brief Checks whether this string is well formed utf8
+ *
+ * Overlong encodings, surrogates and code points above U+10FFFF are rejected.
+ */
+bool Utf8::isValid() const{
+    return validateUtf8(m_data.data(), m_data.size());
+}
 
-    const char* strdata = m_data->c_str();
-    size_t strlength = m_data->length();
-    size_t utflength = 0;
+/**
+ * \brief Returns the byte offset of the code point at \p utfIndex
+ *
+ * Returns size() for the index one past the last code point, and std::string::npos for indexes
+ * further out. For repeated lookups into long strings use OffsetIndex.
+ */
+size_t Utf8::utfIndexToByteOffset(size_t utfIndex) const{
+    return findCodePointOffset(m_data.data(), m_data.size(), utfIndex);
+}
 
-    while ( strlength > 0 ){
-        utf8proc_ssize_t size =
-            utf8proc_iterate(reinterpret_cast<const utf8proc_uint8_t*>(strdata), -1, &nextcodepoint);
-        if ( size <= 0 )
-            return 0;
+/**
+ * \brief Returns the index of the code point the \p byteOffset falls into
+ *
+ * Returns std::string::npos if the offset is past size().
+ */
+size_t Utf8::byteOffsetToUtfIndex(size_t byteOffset) const{
+    if ( byteOffset > m_data.size() )
+        return std::string::npos;
+    return countCodePoints(m_data.data(), findCodePointStart(m_data.data(), m_data.size(), byteOffset));
+}
 
-        utflength += size;
-        strlength -= size;
-        strdata   += size;
+/**
+ * \brief Returns the number of code points in the given range \sa utfLength()
+ */
+size_t Utf8::utfLength(const char *str, size_t size){
+    return countCodePoints(str, size);
+}
 
+/**
+ * \brief Checks whether the given range is well formed utf8 \sa isValid()
+ */
+bool Utf8::isValid(const char *str, size_t size){
+    return validateUtf8(str, size);
+}
+
+/**
+ * \brief Returns the byte offset of the code point at \p utfIndex in the given range
+ */
+size_t Utf8::utfIndexToByteOffset(const char *str, size_t size, size_t utfIndex){
+    return findCodePointOffset(str, size, utfIndex);
+}
+
+/**
+ * \brief Compares this string to \p other, ignoring the case of ASCII letters
+ *
+ * Non-ASCII bytes are compared as they are. Returns a negative, zero or positive value, same as compare().
+ */
+int Utf8::compareAsciiNoCase(const Utf8 &other) const{
+    return compareAsciiNoCase(m_data.data(), m_data.size(), other.m_data.data(), other.m_data.size());
+}
+
+int Utf8::compareAsciiNoCase(const std::string &other) const{
+    return compareAsciiNoCase(m_data.data(), m_data.size(), other.data(), other.size());
+}
+
+int Utf8::compareAsciiNoCase(const char *other) const{
+    return compareAsciiNoCase(m_data.data(), m_data.size(), other, std::strlen(other));
+}
+
+/**
+ * \brief Hash of this string that is equal for strings differing only in the case of ASCII letters
+ */
+size_t Utf8::hashAsciiNoCase() const{
+    return hashAsciiNoCase(m_data.data(), m_data.size());
+}
+
+/**
+ * \brief Compares two ranges ignoring the case of ASCII letters \sa compareAsciiNoCase()
+ */
+int Utf8::compareAsciiNoCase(const char *a, size_t aSize, const char *b, size_t bSize){
+    size_t size = std::min(aSize, bSize);
+    for ( size_t i = 0; i < size; ++i ){
+        unsigned char ca = static_cast<unsigned char>(asciiToLower(a[i]));
+        unsigned char cb = static_cast<unsigned char>(asciiToLower(b[i]));
+        if ( ca != cb )
+            return ca < cb ? -1 : 1;
+    }
+    if ( aSize == bSize )
+        return 0;
+    return aSize < bSize ? -1 : 1;
+}
+
+/**
+ * \brief Case insensitive FNV-1a hash of the given range \sa hashAsciiNoCase()
+ */
+size_t Utf8::hashAsciiNoCase(const char *str, size_t size){
+    uint64_t hash = 14695981039346656037ULL;
+    for ( size_t i = 0; i < size; ++i ){
+        hash ^= static_cast<unsigned char>(asciiToLower(str[i]));
+        hash *= 1099511628211ULL;
     }
-    return utflength;
+    return static_cast<size_t>(hash);
 }
 
 bool Utf8::isSpace(uint32_t c){
@@ -344,12 +921,29 @@ void Utf8::trim(std::string &s){
 }
 
 void Utf8::replaceAll(std::string &data, const std::string &from, const std::string &to){
-    size_t start_pos = 0;
+    if ( from.empty() )
+        return;
 
-    while( (start_pos = data.find(from, start_pos)) != std::string::npos) {
-        data.replace(start_pos, from.length(), to);
-        start_pos += to.length(); // Handles case where 'to' is a substring of 'from'
+    if ( from.size() == to.size() ){
+        for ( size_t pos = data.find(from); pos != std::string::npos; pos = data.find(from, pos + to.size()) )
+            data.replace(pos, from.size(), to);
+        return;
     }
+
+    std::string result;
+    replaceAllInto(data, from, to, result);
+    data.swap(result);
+}
+
+/**
+ * \brief Returns \p str with all occurrences of \p from replaced by \p to
+ */
+std::string Utf8::replaceAll(std::string_view str, std::string_view from, std::string_view to){
+    if ( from.empty() )
+        return std::string(str);
+    std::string result;
+    replaceAllInto(str, from, to, result);
+    return result;
 }
 
 Utf8 Utf8::numberToHex(unsigned long long nr){
@@ -361,26 +955,117 @@ Utf8 Utf8::numberToHex(unsigned long long nr){
 }
 
 Utf8 Utf8::trimLeft() const{
-    Utf8 result(*m_data);
-    trimLeft(*result.m_data);
-    return result;
+    std::string_view v = trimLeftView();
+    return Utf8(v.data(), v.size());
 }
 
 Utf8 Utf8::trimRight() const{
-    Utf8 result(*m_data);
-    trimRight(*result.m_data);
-    return result;
+    std::string_view v = trimRightView();
+    return Utf8(v.data(), v.size());
 }
 
 Utf8 Utf8::trim() const{
-    Utf8 result(*m_data);
-    trim(*result.m_data);
-    return result;
+    std::string_view v = trimView();
+    return Utf8(v.data(), v.size());
 }
 
-Utf8::Utf8(std::string *strPtr)
-    : m_data(strPtr)
-{
+std::string_view Utf8::trimLeftView() const{
+    return trimLeftView(m_data);
+}
+
+std::string_view Utf8::trimRightView() const{
+    return trimRightView(m_data);
+}
+
+/**
+ * \brief Returns a view of this string without leading and trailing whitespace
+ */
+std::string_view Utf8::trimView() const{
+    return trimView(m_data);
+}
+
+std::string_view Utf8::trimLeftView(std::string_view str){
+    size_t start = 0;
+    while ( start < str.size() && isAsciiSpace(str[start]) )
+        ++start;
+    return str.substr(start);
+}
+
+std::string_view Utf8::trimRightView(std::string_view str){
+    size_t end = str.size();
+    while ( end > 0 && isAsciiSpace(str[end - 1]) )
+        --end;
+    return str.substr(0, end);
+}
+
+std::string_view Utf8::trimView(std::string_view str){
+    return trimLeftView(trimRightView(str));
+}
+
+void Utf8::FormatBuffer::writeFloating(double value){
+    char number[32];
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    std::to_chars_result r = std::to_chars(number, number + sizeof(number), value, std::chars_format::general, 6);
+    append(number, static_cast<size_t>(r.ptr - number));
+#else
+    int size = snprintf(number, sizeof(number), "%g", value);
+    append(number, static_cast<size_t>(size));
+#endif
+}
+
+void Utf8::FormatBuffer::writeFloating(long double value){
+    char number[48];
+    int size = snprintf(number, sizeof(number), "%Lg", value);
+    append(number, static_cast<size_t>(size));
+}
+
+/**
+ * Writes the pattern from \p position up to the next placeholder, and returns the position
+ * right after it.
+ */
+size_t Utf8::formatNext(Utf8::FormatBuffer &buffer, size_t position) const{
+    const char* begin = m_data.data();
+    const char* end   = begin + m_data.size();
+    const char* it    = begin + position;
+
+    while ( it != end ){
+        const char* found = static_cast<const char*>(std::memchr(it, '%', static_cast<size_t>(end - it)));
+        if ( !found )
+            break;
+
+        if ( found + 1 != end && *(found + 1) == '%' ){
+            buffer.append(it, static_cast<size_t>(found - it) + 1);
+            it = found + 2;
+        } else {
+            buffer.append(it, static_cast<size_t>(found - it));
+            return static_cast<size_t>(found - begin) + 1;
+        }
+    }
+    throwFormatError("Extra arguments provided to Utf8.format.");
+    return std::string::npos;
+}
+
+/**
+ * Writes the rest of the pattern, which must not contain any more placeholders.
+ */
+void Utf8::formatTail(Utf8::FormatBuffer &buffer, size_t position) const{
+    const char* begin = m_data.data();
+    const char* end   = begin + m_data.size();
+    const char* it    = begin + position;
+
+    while ( it != end ){
+        const char* found = static_cast<const char*>(std::memchr(it, '%', static_cast<size_t>(end - it)));
+        if ( !found ){
+            buffer.append(it, static_cast<size_t>(end - it));
+            return;
+        }
+        if ( found + 1 != end && *(found + 1) == '%' ){
+            buffer.append(it, static_cast<size_t>(found - it) + 1);
+            it = found + 2;
+        } else {
+            throwFormatError("Missing arguments in Utf8.format");
+        }
+    }
 }
 
 void Utf8::throwFormatError(const std::string &message) const{
@@ -388,4 +1073,161 @@ void Utf8::throwFormatError(const std::string &message) const{
 }
 
 
+Utf8::PatternSet::PatternSet(const std::vector<Utf8> &patterns){
+    std::vector<std::string_view> views;
+    views.reserve(patterns.size());
+    for ( auto it = patterns.begin(); it != patterns.end(); ++it )
+        views.push_back(it->view());
+    build(views);
+}
+
+Utf8::PatternSet::PatternSet(const std::vector<std::string> &patterns){
+    std::vector<std::string_view> views(patterns.begin(), patterns.end());
+    build(views);
+}
+
+void Utf8::PatternSet::build(const std::vector<std::string_view> &patterns){
+    // bytes that don't appear in any pattern share class 0
+    std::memset(m_byteClass, 0, sizeof(m_byteClass));
+    m_totalClasses = 1;
+    m_maxLength = 0;
+    for ( auto it = patterns.begin(); it != patterns.end(); ++it ){
+        for ( char c : *it ){
+            unsigned char byte = static_cast<unsigned char>(c);
+            if ( m_byteClass[byte] == 0 )
+                m_byteClass[byte] = static_cast<unsigned short>(m_totalClasses++);
+        }
+    }
+
+    const size_t classes = static_cast<size_t>(m_totalClasses);
+    m_transitions.assign(classes, -1);
+    m_output.assign(1, -1);
+
+    for ( size_t i = 0; i < patterns.size(); ++i ){
+        std::string_view pattern = patterns[i];
+        m_patternLengths.push_back(pattern.size());
+        if ( pattern.empty() )
+            continue;
+
+        int state = 0;
+        for ( char c : pattern ){
+            size_t slot = static_cast<size_t>(state) * classes + m_byteClass[static_cast<unsigned char>(c)];
+            if ( m_transitions[slot] == -1 ){
+                m_transitions[slot] = static_cast<int>(m_output.size());
+                m_transitions.resize(m_transitions.size() + classes, -1);
+                m_output.push_back(-1);
+            }
+            state = m_transitions[slot];
+        }
+        if ( m_output[state] == -1 )
+            m_output[state] = static_cast<int>(i);
+        m_maxLength = std::max(m_maxLength, pattern.size());
+    }
+
+    // breadth first, so failure states are complete before the states pointing to them
+    m_fail.assign(m_output.size(), 0);
+    m_dictLink.assign(m_output.size(), 0);
+    std::vector<int> queue;
+    queue.reserve(m_output.size());
+    for ( size_t c = 0; c < classes; ++c ){
+        int next = m_transitions[c];
+        if ( next == -1 ){
+            m_transitions[c] = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+
+    for ( size_t q = 0; q < queue.size(); ++q ){
+        int state = queue[q];
+        int fail = m_fail[state];
+        m_dictLink[state] = m_output[fail] != -1 ? fail : m_dictLink[fail];
+
+        for ( size_t c = 0; c < classes; ++c ){
+            size_t slot = static_cast<size_t>(state) * classes + c;
+            int failNext = m_transitions[static_cast<size_t>(fail) * classes + c];
+            if ( m_transitions[slot] == -1 ){
+                m_transitions[slot] = failNext;
+            } else {
+                m_fail[m_transitions[slot]] = failNext;
+                queue.push_back(m_transitions[slot]);
+            }
+        }
+    }
+}
+
+/**
+ * \brief Returns the leftmost-longest match in \p text starting at \p offset
+ */
+Utf8::PatternSet::Match Utf8::PatternSet::findFirst(std::string_view text, size_t offset) const{
+    Match best;
+    const size_t classes = static_cast<size_t>(m_totalClasses);
+    int state = 0;
+
+    for ( size_t i = offset; i < text.size(); ++i ){
+        // no match ending from here on can start at or before the best one
+        if ( best.isValid() && i >= best.position + m_maxLength )
+            break;
+
+        state = m_transitions[static_cast<size_t>(state) * classes + m_byteClass[static_cast<unsigned char>(text[i])]];
+        for ( int out = m_output[state] != -1 ? state : m_dictLink[state]; out != 0; out = m_dictLink[out] ){
+            size_t pattern = static_cast<size_t>(m_output[out]);
+            size_t length = m_patternLengths[pattern];
+            size_t start = i + 1 - length;
+            if ( !best.isValid() || start < best.position || (start == best.position && length > best.length) )
+                best = Match(start, length, pattern);
+        }
+    }
+    return best;
+}
+
+/**
+ * \brief Returns all non-overlapping matches in \p text starting at \p offset
+ */
+std::vector<Utf8::PatternSet::Match> Utf8::PatternSet::findAll(std::string_view text, size_t offset) const{
+    std::vector<Match> result;
+    while ( offset < text.size() ){
+        Match m = findFirst(text, offset);
+        if ( !m.isValid() )
+            break;
+        result.push_back(m);
+        offset = m.position + m.length;
+    }
+    return result;
+}
+
+Utf8::SplitRange::Iterator::Iterator(std::string_view str, std::string_view separator, size_t start)
+    : m_str(str)
+    , m_separator(separator)
+    , m_start(start)
+    , m_next(std::string_view::npos)
+{
+    size_t end = m_separator.empty() ? std::string_view::npos : m_str.find(m_separator, m_start);
+    if ( end == std::string_view::npos ){
+        m_current = m_str.substr(m_start);
+    } else {
+        m_current = m_str.substr(m_start, end - m_start);
+        m_next = end + m_separator.size();
+    }
+}
+
+Utf8::SplitRange::Iterator &Utf8::SplitRange::Iterator::operator++(){
+    if ( m_next == std::string_view::npos ){
+        *this = Iterator();
+    } else {
+        *this = Iterator(m_str, m_separator, m_next);
+    }
+    return *this;
+}
+
+/**
+ * \brief Collects the tokens into a vector of views
+ */
+std::vector<std::string_view> Utf8::SplitRange::toVector() const{
+    std::vector<std::string_view> result;
+    for ( auto it = begin(); it != end(); ++it )
+        result.push_back(*it);
+    return result;
+}
+
 }// namespace
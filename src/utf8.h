@@ -22,9 +22,15 @@
 #endif
 
 #include <string>
+#include <string_view>
+#include <iterator>
 #include <sstream>
 #include <memory>
 #include <vector>
+#include <map>
+#include <charconv>
+#include <cstring>
+#include <type_traits>
 
 #include "lvbaseglobal.h"
 #include "inttypes.h"
@@ -32,6 +38,7 @@
 namespace lv{
 
 class VisualLog;
+class InternedUtf8;
 
 class LV_BASE_EXPORT Utf8{
 
@@ -56,15 +63,208 @@ public:
         size_t m_length;
     };
 
+    /**
+     * \class lv::Utf8::FormatBuffer
+     * \brief Output buffer used by Utf8::format
+     *
+     * Writes into an inline stack buffer and moves to a heap string only once the inline capacity
+     * is exceeded.
+     */
+    class LV_BASE_EXPORT FormatBuffer{
+    public:
+        static const size_t inlineCapacity = 256;
+
+        FormatBuffer() : m_size(0), m_spilled(false){}
+
+        void append(const char* str, size_t size);
+        void append(char c){ append(&c, 1); }
+
+        void write(const char* str){ append(str, std::strlen(str)); }
+        void write(const std::string& str){ append(str.data(), str.size()); }
+        void write(const Utf8& str){ append(str.data().data(), str.size()); }
+        void write(char c){ append(c); }
+        void write(bool value){ append(value ? '1' : '0'); }
+        template<typename T> void write(const T& value);
+
+        std::string toString();
+
+    private:
+        template<typename T> void writeNumber(const T& value, std::true_type);
+        template<typename T> void writeNumber(const T& value, std::false_type);
+        void writeFloating(double value);
+        void writeFloating(long double value);
+
+        char        m_inline[inlineCapacity];
+        size_t      m_size;
+        bool        m_spilled;
+        std::string m_heap;
+    };
+
+    /**
+     * \class lv::Utf8::OffsetIndex
+     * \brief Sparse code point index for repeated random access into a long string
+     *
+     * Stores the byte offset of every stride-th code point, so conversions only scan a single stride.
+     * The index references the string's data, which needs to outlive the index and stay unchanged.
+     */
+    class LV_BASE_EXPORT OffsetIndex{
+    public:
+        OffsetIndex(const Utf8& str, size_t stride = 256);
+
+        size_t utfLength() const{ return m_utfLength; }
+        size_t byteOffset(size_t utfIndex) const;
+        size_t utfIndex(size_t byteOffset) const;
+
+    private:
+        const char*         m_data;
+        size_t              m_size;
+        size_t              m_stride;
+        size_t              m_utfLength;
+        std::vector<size_t> m_checkpoints;
+    };
+
+    /**
+     * \class lv::Utf8::AsciiNoCaseHash
+     * \brief Hash functor for case insensitive keys \sa Utf8::hashAsciiNoCase()
+     */
+    class AsciiNoCaseHash{
+    public:
+        size_t operator()(const std::string& str) const{ return Utf8::hashAsciiNoCase(str.data(), str.size()); }
+        size_t operator()(const Utf8& str) const{ return str.hashAsciiNoCase(); }
+    };
+
+    /**
+     * \class lv::Utf8::AsciiNoCaseEqual
+     * \brief Equality functor for case insensitive keys \sa Utf8::compareAsciiNoCase()
+     */
+    class AsciiNoCaseEqual{
+    public:
+        bool operator()(const std::string& a, const std::string& b) const{
+            return Utf8::compareAsciiNoCase(a.data(), a.size(), b.data(), b.size()) == 0;
+        }
+        bool operator()(const Utf8& a, const Utf8& b) const{ return a.compareAsciiNoCase(b) == 0; }
+    };
+
+    /**
+     * \class lv::Utf8::SplitRange
+     * \brief Lazy range over the tokens of a string split by a separator
+     *
+     * Tokens are views into the split string, so nothing is allocated while iterating. Both the string
+     * and the separator need to outlive the range and its iterators, but iterators don't refer to the
+     * range itself, so they stay usable after a temporary range is gone. Adjacent separators yield empty
+     * tokens, same as split().
+     */
+    class LV_BASE_EXPORT SplitRange{
+    public:
+        class LV_BASE_EXPORT Iterator{
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef std::string_view          value_type;
+            typedef std::ptrdiff_t            difference_type;
+            typedef const std::string_view*   pointer;
+            typedef const std::string_view&   reference;
+
+            Iterator() : m_start(std::string_view::npos), m_next(std::string_view::npos){}
+
+            reference operator*() const{ return m_current; }
+            pointer operator->() const{ return &m_current; }
+
+            Iterator& operator++();
+            Iterator operator++(int){ Iterator it = *this; ++(*this); return it; }
+
+            bool operator==(const Iterator& other) const{ return m_start == other.m_start; }
+            bool operator!=(const Iterator& other) const{ return m_start != other.m_start; }
+
+        private:
+            friend class SplitRange;
+            Iterator(std::string_view str, std::string_view separator, size_t start);
+
+            std::string_view m_str;
+            std::string_view m_separator;
+            size_t           m_start;
+            size_t           m_next;
+            std::string_view m_current;
+        };
+
+    public:
+        SplitRange(std::string_view str, std::string_view separator) : m_str(str), m_separator(separator){}
+
+        Iterator begin() const{ return Iterator(m_str, m_separator, 0); }
+        Iterator end() const{ return Iterator(); }
+
+        std::vector<std::string_view> toVector() const;
+
+    private:
+        std::string_view m_str;
+        std::string_view m_separator;
+    };
+
+    /**
+     * \class lv::Utf8::PatternSet
+     * \brief Set of byte patterns compiled into an Aho-Corasick automaton
+     *
+     * Searches for all patterns in a single pass over the text. When several patterns match, the leftmost
+     * one wins, and between patterns starting at the same position the longest one. Empty patterns never match.
+     */
+    class LV_BASE_EXPORT PatternSet{
+    public:
+        /**
+         * \class lv::Utf8::PatternSet::Match
+         * \brief Position, length and pattern index of a match
+         */
+        class Match{
+        public:
+            Match() : position(std::string::npos), length(0), pattern(0){}
+            Match(size_t pos, size_t len, size_t pat) : position(pos), length(len), pattern(pat){}
+
+            bool isValid() const{ return position != std::string::npos; }
+
+            /** Byte offset of the match */
+            size_t position;
+            /** Length of the match in bytes */
+            size_t length;
+            /** Index of the matched pattern */
+            size_t pattern;
+        };
+
+    public:
+        PatternSet(const std::vector<Utf8>& patterns);
+        PatternSet(const std::vector<std::string>& patterns);
+
+        size_t totalPatterns() const{ return m_patternLengths.size(); }
+
+        Match findFirst(std::string_view text, size_t offset = 0) const;
+        std::vector<Match> findAll(std::string_view text, size_t offset = 0) const;
+
+    private:
+        void build(const std::vector<std::string_view>& patterns);
+
+        std::vector<int>    m_transitions; // dense table of states x byte classes
+        std::vector<int>    m_fail;
+        std::vector<int>    m_output;      // pattern ending at the state, or -1
+        std::vector<int>    m_dictLink;    // closest suffix state with an output, or 0
+        std::vector<size_t> m_patternLengths;
+        size_t              m_maxLength;
+        int                 m_totalClasses;
+        unsigned short      m_byteClass[256];
+    };
+
 public:
     Utf8();
     Utf8(const std::string& str);
+    Utf8(std::string&& str);
     Utf8(const char* str);
     Utf8(const char* str, size_t size);
+    Utf8(const Utf8& other) = default;
+    Utf8(Utf8&& other) noexcept = default;
     ~Utf8();
 
+    Utf8& operator = (const Utf8& other) = default;
+    Utf8& operator = (Utf8&& other) noexcept = default;
+
     char byteAt(size_t pos) const;
     const std::string& data() const;
+    std::string_view view() const;
 
     size_t find(char ch, size_t offset = 0) const;
     size_t find(const char* str, size_t offset = 0) const;
@@ -76,21 +276,39 @@ public:
     size_t findLast(const std::string& str, size_t offset = std::string::npos) const;
     size_t findLast(const Utf8& str, size_t offset = std::string::npos) const;
 
+    PatternSet::Match findAny(const PatternSet& patterns, size_t offset = 0) const;
+    PatternSet::Match findAny(const std::vector<Utf8>& patterns, size_t offset = 0) const;
+
     Utf8 replaceAll(const Utf8& from, const Utf8& to) const;
+    Utf8 replaceAll(const std::map<Utf8, Utf8>& replacements) const;
+    Utf8 replaceAll(const PatternSet& patterns, const std::vector<Utf8>& replacements) const;
 
     Utf8 substr(size_t start, size_t length) const;
+    std::string_view substrView(size_t start, size_t length = std::string::npos) const;
 
     char operator[](size_t index) const;
 
-    Utf8 operator+(const Utf8& other) const;
-    Utf8 operator+(const std::string& str) const;
-    Utf8 operator+(const char* str) const;
-    Utf8 operator+(char c) const;
+    Utf8 operator+(const Utf8& other) const &;
+    Utf8 operator+(const std::string& str) const &;
+    Utf8 operator+(const char* str) const &;
+    Utf8 operator+(char c) const &;
+    Utf8 operator+(const Utf8& other) &&;
+    Utf8 operator+(const std::string& str) &&;
+    Utf8 operator+(const char* str) &&;
+    Utf8 operator+(char c) &&;
 
     int compare(const Utf8& other) const;
     int compare(const std::string& other) const;
     int compare(const char* other) const;
 
+    int compareAsciiNoCase(const Utf8& other) const;
+    int compareAsciiNoCase(const std::string& other) const;
+    int compareAsciiNoCase(const char* other) const;
+    size_t hashAsciiNoCase() const;
+
+    static int compareAsciiNoCase(const char* a, size_t aSize, const char* b, size_t bSize);
+    static size_t hashAsciiNoCase(const char* str, size_t size);
+
     bool operator==(const Utf8& other) const;
     bool operator==(const char* str) const;
     bool operator!=(const Utf8& other) const;
@@ -118,19 +336,31 @@ public:
     Utf8 toLower() const;
     Utf8 toUpper() const;
 
-    std::vector<Utf8> split(const char* sep);
+    InternedUtf8 intern() const;
+
+    std::vector<Utf8> split(const char* sep) const;
+    SplitRange splitView(std::string_view sep) const &;
+    SplitRange splitView(std::string_view sep) const && = delete;
+    static SplitRange splitView(std::string_view str, std::string_view sep);
     static Utf8 join(const std::vector<Utf8>& parts, const Utf8& delim = ",");
     static Utf8 join(const std::vector<std::string>& parts, const std::string& delim = ",");
 
     bool isEmpty() const;
 
     template<typename ...Args>
-    Utf8 format(Args... args) const;
+    Utf8 format(const Args&... args) const;
 
     size_t size() const;
     size_t length() const;
 
     size_t utfLength() const;
+    bool isValid() const;
+    size_t utfIndexToByteOffset(size_t utfIndex) const;
+    size_t byteOffsetToUtfIndex(size_t byteOffset) const;
+
+    static size_t utfLength(const char* str, size_t size);
+    static bool isValid(const char* str, size_t size);
+    static size_t utfIndexToByteOffset(const char* str, size_t size, size_t utfIndex);
 
     static bool isSpace(uint32_t c);
 
@@ -138,6 +368,7 @@ public:
     static void trimRight(std::string &str);
     static void trim(std::string& str);
     static void replaceAll(std::string& str, const std::string& from, const std::string& to);
+    static std::string replaceAll(std::string_view str, std::string_view from, std::string_view to);
 
     static Utf8 numberToHex(unsigned long long nr);
 
@@ -145,16 +376,22 @@ public:
     Utf8 trimRight() const;
     Utf8 trim() const;
 
-private:
-    Utf8(std::string* strPtr);
+    std::string_view trimLeftView() const;
+    std::string_view trimRightView() const;
+    std::string_view trimView() const;
+
+    static std::string_view trimLeftView(std::string_view str);
+    static std::string_view trimRightView(std::string_view str);
+    static std::string_view trimView(std::string_view str);
 
-    void formatImpl(std::string::const_iterator sit, std::stringstream&) const;
+private:
+    size_t formatNext(FormatBuffer& buffer, size_t position) const;
+    void formatTail(FormatBuffer& buffer, size_t position) const;
+    template<typename T> void formatArgument(FormatBuffer& buffer, size_t& position, const T& value) const;
 
-    template<typename T, typename... Args>
-    void formatImpl(std::string::const_iterator sit, std::stringstream&, const T& value, Args... args) const;
     void throwFormatError(const std::string& message) const;
 
-    std::shared_ptr<std::string> m_data;
+    std::string m_data;
 };
 
 inline std::ostream& operator << (std::ostream& os, const Utf8& str){
@@ -162,63 +399,103 @@ inline std::ostream& operator << (std::ostream& os, const Utf8& str){
     return os;
 }
 
-template<typename ...Args>
-Utf8 Utf8::format(Args... args) const{
-    std::stringstream result;
-    formatImpl(m_data->cbegin(), result, args...);
-    return Utf8(result.str());
-}
-
-inline void Utf8::formatImpl(std::string::const_iterator sit, std::stringstream &stream) const{
-    while (sit != m_data->cend() ) {
-        char ch = *sit;
-        if (ch == '%') {
-            auto sitnext = sit + 1;
-            if (sitnext != m_data->cend() && *(sitnext) == '%') {
-                ++sit;
-            } else {
-                throwFormatError("Missing arguments in Utf8.format");
-            }
+inline void Utf8::FormatBuffer::append(const char *str, size_t size){
+    if ( !m_spilled ){
+        if ( m_size + size <= inlineCapacity ){
+            std::memcpy(m_inline + m_size, str, size);
+            m_size += size;
+            return;
         }
-        stream << ch;
-        ++sit;
+        m_heap.reserve(2 * (m_size + size));
+        m_heap.assign(m_inline, m_size);
+        m_spilled = true;
     }
+    m_heap.append(str, size);
 }
 
-template<typename T, typename... Args>
-void Utf8::formatImpl(std::string::const_iterator sit, std::stringstream &stream, const T &value, Args... args) const{
-    while (sit != m_data->cend() ) {
-        char ch = *sit;
-        if (ch == '%') {
-            auto sitnext = sit + 1;
-            if (sitnext != m_data->cend() && *(sitnext) == '%') {
-                ++sit;
-            } else {
-                stream << value;
-                formatImpl(sit + 1, stream, args...);
-                return;
-            }
-        }
-        stream << ch;
-        ++sit;
+inline std::string Utf8::FormatBuffer::toString(){
+    if ( m_spilled )
+        return std::move(m_heap);
+    return std::string(m_inline, m_size);
+}
+
+template<typename T> void Utf8::FormatBuffer::write(const T &value){
+    writeNumber(value, std::integral_constant<bool, std::is_arithmetic<T>::value>());
+}
+
+template<typename T> void Utf8::FormatBuffer::writeNumber(const T &value, std::true_type){
+    if constexpr ( std::is_floating_point<T>::value ){
+        writeFloating(value);
+    } else if constexpr ( sizeof(T) == 1 ){
+        append(static_cast<char>(value));
+    } else {
+        char number[24];
+        std::to_chars_result r = std::to_chars(number, number + sizeof(number), value);
+        append(number, static_cast<size_t>(r.ptr - number));
     }
-    throwFormatError("Extra arguments provided to Utf8.format.");
 }
 
-inline Utf8 Utf8::operator+(const Utf8 &other) const{
-    return Utf8(*m_data + *other.m_data);
+template<typename T> void Utf8::FormatBuffer::writeNumber(const T &value, std::false_type){
+    std::ostringstream stream;
+    stream << value;
+    write(stream.str());
+}
+
+/**
+ * \brief Replaces each '%' in this string with the next argument, '%%' is written as '%'
+ *
+ * Numbers are converted directly into the output buffer, any other type is written through its
+ * stream operator. Throws if the number of placeholders and arguments differ.
+ */
+template<typename ...Args>
+Utf8 Utf8::format(const Args&... args) const{
+    FormatBuffer buffer;
+    size_t position = 0;
+    (formatArgument(buffer, position, args), ...);
+    formatTail(buffer, position);
+    return Utf8(buffer.toString());
+}
+
+template<typename T>
+void Utf8::formatArgument(FormatBuffer &buffer, size_t &position, const T &value) const{
+    position = formatNext(buffer, position);
+    buffer.write(value);
+}
+
+inline Utf8 Utf8::operator+(const Utf8 &other) const &{
+    return Utf8(m_data + other.m_data);
+}
+
+inline Utf8 Utf8::operator+(const std::string &other) const &{
+    return Utf8(m_data + other);
+}
+
+inline Utf8 Utf8::operator+(const char *str) const &{
+    return Utf8(m_data + str);
+}
+
+inline Utf8 Utf8::operator+(char c) const &{
+    return Utf8(m_data + c);
+}
+
+inline Utf8 Utf8::operator+(const Utf8 &other) &&{
+    m_data += other.m_data;
+    return std::move(*this);
 }
 
-inline Utf8 Utf8::operator+(const std::string &other) const{
-    return Utf8(*m_data + other);
+inline Utf8 Utf8::operator+(const std::string &other) &&{
+    m_data += other;
+    return std::move(*this);
 }
 
-inline Utf8 Utf8::operator+(const char *str) const{
-    return Utf8(*m_data + str);
+inline Utf8 Utf8::operator+(const char *str) &&{
+    m_data += str;
+    return std::move(*this);
 }
 
-inline Utf8 Utf8::operator+(char c) const{
-    return Utf8(*m_data + c);
+inline Utf8 Utf8::operator+(char c) &&{
+    m_data += c;
+    return std::move(*this);
 }
 
 inline bool Utf8::operator ==(const Utf8 &other) const{
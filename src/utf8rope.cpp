@@ -0,0 +1,433 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+#include "utf8rope.h"
+
+#include <cstring>
+#include <vector>
+
+#include "live/exception.h"
+
+namespace lv{
+
+/// \private
+class Utf8RopeNode{
+
+public:
+    typedef std::shared_ptr<const Utf8RopeNode> Ptr;
+    typedef std::shared_ptr<const std::string>  Buffer;
+
+    Utf8RopeNode(const Buffer& b, size_t s, size_t len, size_t nl, unsigned int p, const Ptr& l, const Ptr& r)
+        : buffer(b)
+        , start(s)
+        , length(len)
+        , newlines(nl)
+        , priority(p)
+        , left(l)
+        , right(r)
+        , totalBytes(len + (l ? l->totalBytes : 0) + (r ? r->totalBytes : 0))
+        , totalNewlines(nl + (l ? l->totalNewlines : 0) + (r ? r->totalNewlines : 0))
+    {}
+
+    const char* data() const{ return buffer->data() + start; }
+
+    Buffer       buffer;
+    size_t       start;
+    size_t       length;
+    size_t       newlines;
+    unsigned int priority;
+    Ptr          left;
+    Ptr          right;
+    size_t       totalBytes;
+    size_t       totalNewlines;
+};
+
+namespace{
+
+typedef Utf8RopeNode::Ptr NodePtr;
+
+size_t bytesOf(const NodePtr& node){ return node ? node->totalBytes : 0; }
+size_t newlinesOf(const NodePtr& node){ return node ? node->totalNewlines : 0; }
+
+unsigned int randomPriority(){
+    thread_local unsigned int state = 2463534242u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+size_t countNewlines(const char* str, size_t size){
+    size_t count = 0;
+    const char* end = str + size;
+    while ( (str = static_cast<const char*>(std::memchr(str, '\n', static_cast<size_t>(end - str)))) != nullptr ){
+        ++count;
+        ++str;
+    }
+    return count;
+}
+
+/// Returns the offset right after the n-th newline (1-based) in the given piece
+size_t nthNewlineEnd(const char* str, size_t size, size_t n){
+    const char* p = str;
+    const char* end = str + size;
+    while ( (p = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)))) != nullptr ){
+        ++p;
+        if ( --n == 0 )
+            return static_cast<size_t>(p - str);
+    }
+    return std::string::npos;
+}
+
+NodePtr createPiece(const Utf8RopeNode::Buffer& buffer, size_t start, size_t length, unsigned int priority){
+    return std::make_shared<Utf8RopeNode>(
+        buffer, start, length, countNewlines(buffer->data() + start, length), priority, nullptr, nullptr
+    );
+}
+
+NodePtr withChildren(const NodePtr& node, const NodePtr& left, const NodePtr& right){
+    if ( left == node->left && right == node->right )
+        return node;
+    return std::make_shared<Utf8RopeNode>(
+        node->buffer, node->start, node->length, node->newlines, node->priority, left, right
+    );
+}
+
+NodePtr merge(const NodePtr& a, const NodePtr& b){
+    if ( !a )
+        return b;
+    if ( !b )
+        return a;
+    if ( a->priority > b->priority )
+        return withChildren(a, a->left, merge(a->right, b));
+    return withChildren(b, merge(a, b->left), b->right);
+}
+
+/// Splits into the first \p offset bytes and the rest, sharing every untouched subtree
+std::pair<NodePtr, NodePtr> split(const NodePtr& node, size_t offset){
+    if ( !node )
+        return std::make_pair(NodePtr(), NodePtr());
+
+    size_t leftBytes = bytesOf(node->left);
+    if ( offset <= leftBytes ){
+        std::pair<NodePtr, NodePtr> parts = split(node->left, offset);
+        return std::make_pair(parts.first, withChildren(node, parts.second, node->right));
+    }
+    if ( offset >= leftBytes + node->length ){
+        std::pair<NodePtr, NodePtr> parts = split(node->right, offset - leftBytes - node->length);
+        return std::make_pair(withChildren(node, node->left, parts.first), parts.second);
+    }
+
+    size_t cut = offset - leftBytes;
+    NodePtr head = createPiece(node->buffer, node->start, cut, node->priority);
+    NodePtr tail = createPiece(node->buffer, node->start + cut, node->length - cut, randomPriority());
+    return std::make_pair(merge(node->left, head), merge(tail, node->right));
+}
+
+NodePtr buildPieces(const Utf8RopeNode::Buffer& buffer, size_t from, size_t to){
+    size_t length = to - from;
+    if ( length == 0 )
+        return nullptr;
+    if ( length <= Utf8Rope::maximumPieceSize )
+        return createPiece(buffer, from, length, randomPriority());
+    size_t middle = from + (length / Utf8Rope::maximumPieceSize / 2) * Utf8Rope::maximumPieceSize;
+    if ( middle == from )
+        middle = from + Utf8Rope::maximumPieceSize;
+    return merge(buildPieces(buffer, from, middle), buildPieces(buffer, middle, to));
+}
+
+NodePtr build(std::string_view str){
+    if ( str.empty() )
+        return nullptr;
+    Utf8RopeNode::Buffer buffer = std::make_shared<const std::string>(str.data(), str.size());
+    return buildPieces(buffer, 0, buffer->size());
+}
+
+void collect(const NodePtr& node, size_t from, size_t to, std::string& result){
+    if ( !node || from >= to )
+        return;
+    size_t leftBytes = bytesOf(node->left);
+    if ( from < leftBytes )
+        collect(node->left, from, std::min(to, leftBytes), result);
+
+    size_t pieceFrom = std::max(from, leftBytes);
+    size_t pieceTo = std::min(to, leftBytes + node->length);
+    if ( pieceFrom < pieceTo )
+        result.append(node->data() + pieceFrom - leftBytes, pieceTo - pieceFrom);
+
+    if ( to > leftBytes + node->length )
+        collect(node->right, from > leftBytes + node->length ? from - leftBytes - node->length : 0, to - leftBytes - node->length, result);
+}
+
+void visit(const NodePtr& node, const std::function<void(const char*, size_t)>& callback){
+    if ( !node )
+        return;
+    visit(node->left, callback);
+    callback(node->data(), node->length);
+    visit(node->right, callback);
+}
+
+} // namespace
+
+/**
+ * \class lv::Utf8Rope
+ * \brief Persistent text buffer for large documents that are edited in place
+ *
+ * The text is kept as a balanced tree of pieces that point into immutable shared buffers. Each node
+ * tracks the number of bytes and newlines below it, so inserting, removing and converting between
+ * byte offsets and line/column positions all take O(log n).
+ *
+ * Edits never modify existing nodes, they only create new ones along the changed path. Copying a
+ * rope or taking a snapshot() is O(1), and the copies share all unchanged text.
+ *
+ * Lines and columns are 1-based, the same as SourcePoint. Columns are counted in bytes.
+ *
+ * \ingroup lvbase
+ */
+
+const size_t Utf8Rope::maximumPieceSize;
+
+Utf8Rope::Utf8Rope(){
+}
+
+Utf8Rope::Utf8Rope(std::string_view str)
+    : m_root(build(str))
+{
+}
+
+Utf8Rope::~Utf8Rope(){
+}
+
+/**
+ * \brief Returns the size of the text in bytes
+ */
+size_t Utf8Rope::size() const{
+    return bytesOf(m_root);
+}
+
+bool Utf8Rope::isEmpty() const{
+    return !m_root;
+}
+
+/**
+ * \brief Returns the number of lines, which is the number of newlines plus one
+ */
+size_t Utf8Rope::totalLines() const{
+    return newlinesOf(m_root) + 1;
+}
+
+/**
+ * \brief Returns the byte at \p offset, throws if the offset is out of range
+ */
+char Utf8Rope::byteAt(size_t offset) const{
+    if ( offset >= size() )
+        THROW_EXCEPTION(lv::Exception, Utf8("Offset out of range: %").format(offset), lv::Exception::toCode("~Range"));
+
+    const Utf8RopeNode* node = m_root.get();
+    while ( node ){
+        size_t leftBytes = bytesOf(node->left);
+        if ( offset < leftBytes ){
+            node = node->left.get();
+        } else if ( offset < leftBytes + node->length ){
+            return node->data()[offset - leftBytes];
+        } else {
+            offset -= leftBytes + node->length;
+            node = node->right.get();
+        }
+    }
+    return 0;
+}
+
+/**
+ * \brief Inserts \p str at byte \p offset
+ */
+void Utf8Rope::insert(size_t offset, std::string_view str){
+    if ( offset > size() )
+        THROW_EXCEPTION(lv::Exception, Utf8("Offset out of range: %").format(offset), lv::Exception::toCode("~Range"));
+    if ( str.empty() )
+        return;
+
+    std::pair<NodePtr, NodePtr> parts = split(m_root, offset);
+    m_root = merge(merge(parts.first, build(str)), parts.second);
+}
+
+/**
+ * \brief Removes \p length bytes starting at \p offset
+ */
+void Utf8Rope::remove(size_t offset, size_t length){
+    if ( offset > size() )
+        THROW_EXCEPTION(lv::Exception, Utf8("Offset out of range: %").format(offset), lv::Exception::toCode("~Range"));
+    if ( length == 0 )
+        return;
+
+    std::pair<NodePtr, NodePtr> head = split(m_root, offset);
+    std::pair<NodePtr, NodePtr> tail = split(head.second, length);
+    m_root = merge(head.first, tail.second);
+}
+
+/**
+ * \brief Replaces \p length bytes starting at \p offset with \p str
+ */
+void Utf8Rope::replace(size_t offset, size_t length, std::string_view str){
+    if ( offset > size() )
+        THROW_EXCEPTION(lv::Exception, Utf8("Offset out of range: %").format(offset), lv::Exception::toCode("~Range"));
+
+    std::pair<NodePtr, NodePtr> head = split(m_root, offset);
+    std::pair<NodePtr, NodePtr> tail = split(head.second, length);
+    m_root = merge(merge(head.first, build(str)), tail.second);
+}
+
+void Utf8Rope::append(std::string_view str){
+    m_root = merge(m_root, build(str));
+}
+
+void Utf8Rope::clear(){
+    m_root = nullptr;
+}
+
+/**
+ * \brief Returns an immutable copy of the current text in O(1)
+ */
+Utf8Rope Utf8Rope::snapshot() const{
+    return *this;
+}
+
+/**
+ * \brief Copies \p length bytes starting at \p offset
+ */
+std::string Utf8Rope::substr(size_t offset, size_t length) const{
+    std::string result;
+    size_t total = size();
+    if ( offset >= total )
+        return result;
+    size_t to = length > total - offset ? total : offset + length;
+    result.reserve(to - offset);
+    collect(m_root, offset, to, result);
+    return result;
+}
+
+/**
+ * \brief Copies the text between the start and end points of \p range
+ */
+std::string Utf8Rope::substr(const SourceRange &range) const{
+    size_t from = offsetOf(range.start());
+    size_t to = offsetOf(range.end());
+    if ( from == std::string::npos || to == std::string::npos || to < from )
+        return std::string();
+    return substr(from, to - from);
+}
+
+std::string Utf8Rope::toString() const{
+    return substr(0);
+}
+
+Utf8 Utf8Rope::toUtf8() const{
+    return Utf8(toString());
+}
+
+/**
+ * \brief Returns the byte offset where \p line starts, or npos if there's no such line
+ */
+size_t Utf8Rope::lineOffset(int line) const{
+    if ( line < 1 || static_cast<size_t>(line) > totalLines() )
+        return std::string::npos;
+    if ( line == 1 )
+        return 0;
+
+    size_t n = static_cast<size_t>(line - 1); // newlines to skip
+    size_t offset = 0;
+    const Utf8RopeNode* node = m_root.get();
+    while ( node ){
+        size_t leftNewlines = newlinesOf(node->left);
+        if ( n <= leftNewlines ){
+            node = node->left.get();
+        } else if ( n <= leftNewlines + node->newlines ){
+            return offset + bytesOf(node->left) + nthNewlineEnd(node->data(), node->length, n - leftNewlines);
+        } else {
+            n -= leftNewlines + node->newlines;
+            offset += bytesOf(node->left) + node->length;
+            node = node->right.get();
+        }
+    }
+    return std::string::npos;
+}
+
+/**
+ * \brief Returns the byte offset of \p line and \p column
+ *
+ * Returns npos if the position is outside the text. The column right after the last character of a
+ * line, where the newline is, is still valid.
+ */
+size_t Utf8Rope::offsetOf(int line, int column) const{
+    size_t start = lineOffset(line);
+    if ( start == std::string::npos || column < 1 )
+        return std::string::npos;
+
+    size_t next = lineOffset(line + 1);
+    size_t lineEnd = next == std::string::npos ? size() : next - 1;
+    size_t offset = start + static_cast<size_t>(column - 1);
+    return offset <= lineEnd ? offset : std::string::npos;
+}
+
+/**
+ * \brief Returns the byte offset of \p point
+ *
+ * Uses the line and column if the point has a line, and the offset otherwise.
+ */
+size_t Utf8Rope::offsetOf(const SourcePoint &point) const{
+    if ( point.hasLine() )
+        return offsetOf(point.line(), point.hasColumn() ? point.column() : 1);
+    if ( point.offset() >= 0 && static_cast<size_t>(point.offset()) <= size() )
+        return static_cast<size_t>(point.offset());
+    return std::string::npos;
+}
+
+/**
+ * \brief Returns the line, column and offset of the byte at \p offset
+ */
+SourcePoint Utf8Rope::pointAt(size_t offset) const{
+    if ( offset > size() )
+        return SourcePoint();
+
+    size_t newlines = 0;
+    size_t remaining = offset;
+    const Utf8RopeNode* node = m_root.get();
+    while ( node ){
+        size_t leftBytes = bytesOf(node->left);
+        if ( remaining < leftBytes ){
+            node = node->left.get();
+        } else if ( remaining < leftBytes + node->length ){
+            newlines += newlinesOf(node->left) + countNewlines(node->data(), remaining - leftBytes);
+            break;
+        } else {
+            newlines += newlinesOf(node->left) + node->newlines;
+            remaining -= leftBytes + node->length;
+            node = node->right.get();
+        }
+    }
+
+    int line = static_cast<int>(newlines + 1);
+    size_t start = lineOffset(line);
+    return SourcePoint(line, static_cast<int>(offset - start + 1), static_cast<int>(offset));
+}
+
+/**
+ * \brief Calls \p callback for each contiguous chunk of text, in order
+ */
+void Utf8Rope::readChunks(const std::function<void (const char *, size_t)> &callback) const{
+    visit(m_root, callback);
+}
+
+}// namespace
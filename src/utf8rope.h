@@ -0,0 +1,79 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+#ifndef LVUTF8ROPE_H
+#define LVUTF8ROPE_H
+
+#include "live/lvbaseglobal.h"
+#include "live/utf8.h"
+#include "live/sourcelocation.h"
+
+#include <memory>
+#include <functional>
+#include <string_view>
+
+namespace lv{
+
+class Utf8RopeNode;
+
+class LV_BASE_EXPORT Utf8Rope{
+
+public:
+    /** Maximum size of a single piece, bounds the cost of splitting a piece or scanning it for lines */
+    static const size_t maximumPieceSize = 4096;
+
+public:
+    Utf8Rope();
+    Utf8Rope(std::string_view str);
+    ~Utf8Rope();
+
+    Utf8Rope(const Utf8Rope& other) = default;
+    Utf8Rope(Utf8Rope&& other) noexcept = default;
+    Utf8Rope& operator = (const Utf8Rope& other) = default;
+    Utf8Rope& operator = (Utf8Rope&& other) noexcept = default;
+
+    size_t size() const;
+    bool isEmpty() const;
+    size_t totalLines() const;
+
+    char byteAt(size_t offset) const;
+
+    void insert(size_t offset, std::string_view str);
+    void remove(size_t offset, size_t length);
+    void replace(size_t offset, size_t length, std::string_view str);
+    void append(std::string_view str);
+    void clear();
+
+    Utf8Rope snapshot() const;
+
+    std::string substr(size_t offset, size_t length = std::string::npos) const;
+    std::string substr(const SourceRange& range) const;
+    std::string toString() const;
+    Utf8 toUtf8() const;
+
+    size_t lineOffset(int line) const;
+    size_t offsetOf(int line, int column) const;
+    size_t offsetOf(const SourcePoint& point) const;
+    SourcePoint pointAt(size_t offset) const;
+
+    void readChunks(const std::function<void(const char*, size_t)>& callback) const;
+
+private:
+    std::shared_ptr<const Utf8RopeNode> m_root;
+};
+
+}// namespace
+
+#endif // LVUTF8ROPE_H
@@ -17,9 +17,53 @@
 #include "live/mlnodetojson.h"
 #include "live/utf8.h"
 #include "live/datetime.h"
+#include "live/datetimeformat.h"
+#include "live/batchworker.h"
+#include "live/binarylog.h"
+#include "live/logring.h"
 #include <unordered_map>
+#include <cstring>
 #include <fstream>
 #include <list>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <charconv>
+#include <string_view>
+#include <streambuf>
+#include <vector>
+#include <deque>
+#include <iterator>
+
+#if defined(__GNUC__) && !defined(__llvm__) && !defined(__INTEL_COMPILER)
+#  if(__GNUC__ > 7)
+#    include <filesystem>
+     namespace fs = std::filesystem;
+#  else
+#    include <experimental/filesystem>
+     namespace fs = std::experimental::filesystem;
+#  endif
+#else
+#  include <filesystem>
+   namespace fs = std::filesystem;
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define VLOG_POSIX_FILE
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+#endif
+
+#ifdef ENABLE_LOG_COMPRESSION
+#include <zlib.h>
+#endif
 
 
 /**
@@ -29,7 +73,7 @@
  * The way we primarily use this class is through a predefined macro `vlog`. It's defined in the following way
  *
  * ```
- * lv::VisualLog(__VA_ARGS__).at(__FILE__, __LINE__, __FUNCTION__)
+ * lv::detail::VisualLogMacroAccess::at(lv::VisualLog(__VA_ARGS__), __FILE__, __LINE__, __FUNCTION__)
  * ```
  *
  * This means that we can pass arguments to the vlog macro that are in accordance with the constructors of VisualLog.
@@ -42,7 +86,8 @@
  * ```
  *
  * Therefore, we can pass no arguments, or we can pass a configuration string (also known as tag), or a default message level, or both.
- * The at(...) function arguments provide us with the file, line number and function name of the place we're invoking the vlog call.
+ * The remaining arguments provide us with the file, line number and function name of the place we're invoking the vlog call.
+ * These are referenced rather than copied, so outside the macros the location is set through at(), which copies it.
  *
  * Six levels of logging are available, in order of importance: Fatal, Error, Warning, Info, Debug, Verbose.
  * There's a global configuration of the logger available, but there's also the ability to create a special configuration paired to a user-provided tag.
@@ -61,6 +106,19 @@
  * ```
  * Invoking one of the shorthand functions changes the message level of the logger. The default message level is info, while the application level
  * is debug.
+ * Since `vlog` always creates a logger object, disabled messages in hot code paths are better written with `vlog_if`, which
+ * checks the level before anything is constructed or evaluated:
+ * ```
+ * vlog_if("extension", lv::VisualLog::MessageInfo::Verbose) << "verbose " << expensiveValue();
+ * ```
+ * The configuration is resolved once per call site, so it needs to be a string literal. Levels less important than
+ * `VLOG_MINIMUM_LEVEL`, which can be defined before including this header, are removed at compile time.
+ * Typed values can be attached to a message with field(), without going through an MLNode:
+ * ```
+ * vlog().i().field("latency_us", 42).field("pkg", name) << "loaded";
+ * ```
+ * Text outputs write them after the message as `latency_us=42 pkg=core`, binary logs keep their types, and
+ * transports read them through MessageInfo::fields().
  * An example on how to configure the custom configuration is given below.
  * ```
  * vlog().configure("test", {
@@ -74,6 +132,26 @@
  * * defaultLevel - default level of messages
  * * file - output log file
  * * logDaily - if the log should be created on a daily basis
+ * * maxFileSize - size in bytes after which the log file is rotated, 0 by default for no limit
+ * * rotateInterval - time in seconds after which the log file is rotated, 0 by default for no limit
+ * * maxFiles - number of rotated files to keep, 0 by default to keep all of them
+ * * compress - if rotated files should be compressed with gzip, done on a background thread
+ * * preallocate - if disk space for new files should be reserved up to maxFileSize, on Linux
+ * * fileBufferSize - bytes of messages held in memory before writing them to the file, 0 by default to
+ * write each message as it's logged
+ * * fileFlushInterval - milliseconds buffered messages wait at most before being written, 100 by default
+ * * fileFlushLevel - messages of this level or more important are written right away, Error by default
+ * * fileSyncInterval - milliseconds between syncing the file to disk, 0 by default to leave it to the system
+ * * rateLimit - messages per second each `vlog` call site can log, either as a number or as an object with a
+ * `rate` and a `burst` of messages allowed at once. Dropped messages are summarized in the next message that passes.
+ * * sample - only 1 in this many messages of each `vlog` call site is logged
+ * * crashRing - level up to which messages are also kept in the lv::LogRing, which is written out on Fatal messages
+ * and on std::terminate. Levels less important than `level` go only to the ring, without being formatted or written
+ * anywhere else. Enables the ring if it's not already enabled.
+ * * crashRingSize - bytes of messages the lv::LogRing keeps, 4MB by default
+ * * crashDumpFile - file the lv::LogRing is appended to when dumped, the standard error by default
+ * * binaryFile - output binary log file, read back with BinaryLogReader. Objects are stored as they are instead of
+ * as json, and the log is indexed by time and level.
  * * toConsole - if the log messages should be passed to the console
  * * toExtensions - if the log messages should be passed to other transports
  * * toView - if the log messages should be passed to view
@@ -89,6 +167,13 @@
  * to an external listener, be it a file or a network listener. If object logging isn't enabled, or the object isn't in the correct form, we once again default
  * to a console display.
  *
+ * By default, messages are written from the thread that logs them. After calling startAsync(), console, file and transport output
+ * is handed over to a writer thread through a bounded queue, so logging only costs the formatting of the message. stopAsync()
+ * writes whatever is still queued and goes back to synchronous output.
+ *
+ * Transports that are slow to deliver, such as network forwarders, can be wrapped in an lv::AsyncTransport, or implement
+ * its lv::AsyncTransport::BatchHandler, which queues their messages and delivers them in batches on a thread of its own.
+ *
  * \ingroup lvbase
  */
 
@@ -115,201 +200,2016 @@ namespace lv{
 
 namespace{
 
-    std::string extractFileNameSegment(const std::string& file){
-        std::string::size_type pos = file.rfind('/');
+    const char* const levelNames[]      = {"Fatal", "Error", "Warning", "Info", "Debug", "Verbose"};
+    const char* const levelNamesLower[] = {"fatal", "error", "warning", "info", "debug", "verbose"};
+    const int levelCount = static_cast<int>(std::size(levelNamesLower));
+    static_assert(std::size(levelNames) == std::size(levelNamesLower) && std::size(levelNames) == VisualLog::MessageInfo::Verbose + 1,
+                  "Level names must cover every VisualLog::MessageInfo::Level.");
+
+    std::string_view extractFileNameSegment(std::string_view file){
+        std::string_view::size_type pos = file.rfind('/');
 
         #ifdef Q_OS_WIN
-            if ( pos == std::string::npos ){
+            if ( pos == std::string_view::npos ){
                 pos = file.rfind('\\');
             }
         #endif
 
-        if ( pos != std::string::npos )
+        if ( pos != std::string_view::npos )
             return file.substr(pos + 1);
 
         return file;
     }
 
-    std::string asciiToLower(const std::string& str){
-        std::string base;
-        base.reserve(str.size());
-        for ( const char& c : str ){
-            base.push_back(tolower(c));
+    std::string_view levelName(VisualLog::MessageInfo::Level level, bool lowerCase){
+        int index = static_cast<int>(level);
+        if ( index < 0 || index >= levelCount )
+            return std::string_view();
+        return lowerCase ? levelNamesLower[index] : levelNames[index];
+    }
+
+    void appendNumber(std::string& result, int value){
+        char buffer[16];
+        std::to_chars_result r = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        result.append(buffer, static_cast<size_t>(r.ptr - buffer));
+    }
+
+    const size_t scratchRetainedCapacity = 64 * 1024;
+    const size_t maximumPooledStreams = 4;
+
+    class MessageStreamBuffer : public std::streambuf{
+    public:
+        std::string text;
+
+    protected:
+        int_type overflow(int_type ch) override{
+            if ( !traits_type::eq_int_type(ch, traits_type::eof()) )
+                text.push_back(traits_type::to_char_type(ch));
+            return traits_type::not_eof(ch);
+        }
+        std::streamsize xsputn(const char* data, std::streamsize size) override{
+            text.append(data, static_cast<size_t>(size));
+            return size;
+        }
+    };
+
+    // Writes straight into a std::string that is kept between messages, unlike std::stringstream,
+    // which copies its contents out on every str() call.
+    class MessageStream : private MessageStreamBuffer, public std::ostream{
+    public:
+        MessageStream(bool isPooled)
+            : std::ostream(static_cast<MessageStreamBuffer*>(this))
+            , pooled(isPooled)
+            , inUse(false)
+        {}
+
+        void reset(){
+            clear();
+            flags(std::ios_base::dec | std::ios_base::skipws);
+            precision(6);
+            width(0);
+            fill(' ');
+            if ( text.capacity() > scratchRetainedCapacity )
+                std::string().swap(text);
+            else
+                text.clear();
+        }
+
+        using MessageStreamBuffer::text;
+
+        bool pooled;
+        bool inUse;
+    };
+
+    // Trivially destructible, so it stays readable while other thread_local objects are destroyed.
+    thread_local bool threadScratchDestroyed = false;
+
+    // Per thread storage reused between messages. Loggers nested within a message (i.e. from a stream
+    // operator) take the next free stream, and past maximumPooledStreams or after the thread's storage
+    // was destroyed on thread exit, loggers allocate their own.
+    class ThreadScratch{
+    public:
+        ThreadScratch() : lineInUse(false){}
+        ~ThreadScratch(){
+            threadScratchDestroyed = true;
+            for ( auto it = streams.begin(); it != streams.end(); ++it )
+                delete *it;
+        }
+
+        static ThreadScratch* local(){
+            if ( threadScratchDestroyed )
+                return nullptr;
+            thread_local ThreadScratch scratch;
+            return &scratch;
+        }
+
+        std::vector<MessageStream*> streams;
+        std::string                 line;
+        bool                        lineInUse;
+    };
+
+    // Reuses the thread's line string for assembling lines, or a local one if it's already in use.
+    class LineBuffer{
+    public:
+        LineBuffer() : m_buffer(&m_local), m_scratch(ThreadScratch::local()){
+            if ( m_scratch && !m_scratch->lineInUse ){
+                m_scratch->lineInUse = true;
+                m_scratch->line.clear();
+                m_buffer = &m_scratch->line;
+            } else {
+                m_scratch = nullptr;
+            }
+        }
+        ~LineBuffer(){
+            if ( m_scratch ){
+                if ( m_scratch->line.capacity() > scratchRetainedCapacity )
+                    std::string().swap(m_scratch->line);
+                m_scratch->lineInUse = false;
+            }
+        }
+
+        std::string& str(){ return *m_buffer; }
+
+    private:
+        DISABLE_COPY(LineBuffer);
+
+        std::string*   m_buffer;
+        ThreadScratch* m_scratch;
+        std::string    m_local;
+    };
+} // namespace
+
+// VisualLog::PrefixFormat
+// ---------------------------------------------------------------------
+
+/// \private
+class VisualLog::PrefixFormat{
+
+public:
+    PrefixFormat(){}
+
+    static PrefixFormat compile(const std::string& pattern);
+
+    bool isEmpty() const{ return m_segments.empty(); }
+    void append(const VisualLog::MessageInfo& messageInfo, std::string& result) const;
+
+private:
+    enum Type{
+        Literal,
+        RemotePrompt,
+        Remote,
+        FilePath,
+        FileName,
+        Function,
+        Line,
+        LevelName,
+        LevelNameLower,
+        Stamp
+    };
+
+    class Segment{
+    public:
+        Segment(Type t, size_t i = 0, size_t len = 0) : type(t), index(i), length(len){}
+
+        Type   type;
+        size_t index; // start in m_literals, or position in m_stampFormats
+        size_t length;
+    };
+
+    void addLiteral(const std::string& text);
+    void flushStamp(std::string& stampPattern, std::string& stampLiterals, bool& stampHasSymbols);
+
+    std::string                 m_literals;
+    std::vector<Segment>        m_segments;
+    std::vector<DateTimeFormat> m_stampFormats;
+};
+
+/**
+ * Splits \p pattern into typed segments. Date symbols, together with the literals between them, are grouped
+ * into DateTimeFormats, so each run of date symbols is written in a single call.
+ */
+VisualLog::PrefixFormat VisualLog::PrefixFormat::compile(const std::string &pattern){
+    PrefixFormat result;
+
+    std::string stampPattern;
+    std::string stampLiterals;
+    bool stampHasSymbols = false;
+
+    auto addSegment = [&](Type type){
+        result.flushStamp(stampPattern, stampLiterals, stampHasSymbols);
+        result.m_segments.push_back(Segment(type));
+    };
+    auto addLiteral = [&](char c){
+        stampLiterals.push_back(c);
+        if ( c == '%' )
+            stampPattern.push_back('%');
+        stampPattern.push_back(c);
+    };
+
+    for ( size_t i = 0; i < pattern.size(); ++i ){
+        char c = pattern[i];
+        if ( c != '%' ){
+            addLiteral(c);
+            continue;
+        }
+        if ( i + 1 == pattern.size() ){
+            addLiteral('%');
+            break;
+        }
+
+        char symbol = pattern[++i];
+        switch(symbol){
+        case 'p':
+            addSegment(RemotePrompt);
+            stampPattern = "%Y-%m-%d %H:%M:%S.%i ";
+            stampHasSymbols = true;
+            addSegment(LevelNameLower);
+            addLiteral(' ');
+            addSegment(Function);
+            addLiteral('@');
+            addSegment(Line);
+            addLiteral(':');
+            addLiteral(' ');
+            break;
+        case 'r': addSegment(Remote); break;
+        case 'F': addSegment(FilePath); break;
+        case 'N': addSegment(FileName); break;
+        case 'U': addSegment(Function); break;
+        case 'L': addSegment(Line); break;
+        case 'V': addSegment(LevelName); break;
+        case 'v': addSegment(LevelNameLower); break;
+        default:
+            if ( DateTimeFormat::isSymbol(symbol) ){
+                stampPattern.push_back('%');
+                stampPattern.push_back(symbol);
+                stampHasSymbols = true;
+            } else {
+                addLiteral(symbol);
+            }
+        }
+    }
+    result.flushStamp(stampPattern, stampLiterals, stampHasSymbols);
+
+    return result;
+}
+
+/**
+ * Appends the prefix of \p messageInfo to \p result. The stamp is only created when the pattern contains
+ * date symbols.
+ */
+void VisualLog::PrefixFormat::append(const VisualLog::MessageInfo &messageInfo, std::string &result) const{
+    for ( const Segment& segment : m_segments ){
+        switch(segment.type){
+        case Literal:
+            result.append(m_literals, segment.index, segment.length);
+            break;
+        case RemotePrompt:
+            if ( !messageInfo.m_remote.empty() ){
+                result.append(messageInfo.m_remote);
+                result.append("> ");
+            }
+            break;
+        case Remote:
+            result.append(messageInfo.m_remote);
+            break;
+        case FilePath:
+            result.append(messageInfo.m_file);
+            break;
+        case FileName:
+            result.append(extractFileNameSegment(messageInfo.m_file));
+            break;
+        case Function:
+            result.append(messageInfo.m_functionName);
+            break;
+        case Line:
+            appendNumber(result, messageInfo.m_line);
+            break;
+        case LevelName:
+            result.append(levelName(messageInfo.m_level, false));
+            break;
+        case LevelNameLower:
+            result.append(levelName(messageInfo.m_level, true));
+            break;
+        case Stamp:
+            m_stampFormats[segment.index].append(messageInfo.stamp(), result);
+            break;
+        }
+    }
+}
+
+void VisualLog::PrefixFormat::addLiteral(const std::string &text){
+    if ( text.empty() )
+        return;
+    if ( !m_segments.empty() && m_segments.back().type == Literal ){
+        m_segments.back().length += text.size();
+    } else {
+        m_segments.push_back(Segment(Literal, m_literals.size(), text.size()));
+    }
+    m_literals.append(text);
+}
+
+void VisualLog::PrefixFormat::flushStamp(std::string &stampPattern, std::string &stampLiterals, bool &stampHasSymbols){
+    if ( stampHasSymbols ){
+        m_segments.push_back(Segment(Stamp, m_stampFormats.size()));
+        m_stampFormats.push_back(DateTimeFormat::compile(stampPattern));
+    } else {
+        addLiteral(stampLiterals);
+    }
+    stampPattern.clear();
+    stampLiterals.clear();
+    stampHasSymbols = false;
+}
+
+
+
+// VisualLog::Field
+// ---------------------------------------------------------------------
+
+namespace{
+
+bool requiresQuotes(std::string_view text){
+    if ( text.empty() )
+        return true;
+    for ( char c : text ){
+        if ( c == ' ' || c == '=' || c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20 )
+            return true;
+    }
+    return false;
+}
+
+void appendQuoted(std::string& result, std::string_view text){
+    result.push_back('"');
+    for ( char c : text ){
+        switch(c){
+        case '"':  result.append("\\\""); break;
+        case '\\': result.append("\\\\"); break;
+        case '\n': result.append("\\n"); break;
+        case '\r': result.append("\\r"); break;
+        case '\t': result.append("\\t"); break;
+        default:   result.push_back(c);
+        }
+    }
+    result.push_back('"');
+}
+
+} // namespace
+
+/**
+ * \brief Appends the value as text to \p result
+ *
+ * Strings that are empty or contain spaces, quotes, '=' or control characters are quoted and escaped.
+ */
+void VisualLog::Field::appendValue(std::string &result) const{
+    char buffer[32];
+    switch(m_type){
+    case Boolean:
+        result.append(m_value.boolean ? "true" : "false");
+        break;
+    case Integer:{
+        std::to_chars_result r = std::to_chars(buffer, buffer + sizeof(buffer), m_value.integer);
+        result.append(buffer, static_cast<size_t>(r.ptr - buffer));
+        break;
+    }
+    case Float:{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        std::to_chars_result r = std::to_chars(buffer, buffer + sizeof(buffer), m_value.number);
+        result.append(buffer, static_cast<size_t>(r.ptr - buffer));
+#else
+        int size = snprintf(buffer, sizeof(buffer), "%.17g", m_value.number);
+        result.append(buffer, static_cast<size_t>(std::max(size, 0)));
+#endif
+        break;
+    }
+    case String:
+        if ( requiresQuotes(m_text) ){
+            appendQuoted(result, m_text);
+        } else {
+            result.append(m_text.data(), m_text.size());
+        }
+        break;
+    }
+}
+
+// VisualLog::Fields
+// ---------------------------------------------------------------------
+
+const size_t VisualLog::Fields::inlineSize;
+const size_t VisualLog::Fields::inlineTextSize;
+
+/** \brief Copies the fields of \p other */
+VisualLog::Fields::Fields(const VisualLog::Fields &other)
+    : m_size(0)
+    , m_textSize(0)
+{
+    *this = other;
+}
+
+/** \brief Replaces the fields with the ones of \p other, only the used part of the inline storage is copied */
+VisualLog::Fields &VisualLog::Fields::operator =(const VisualLog::Fields &other){
+    if ( this == &other )
+        return *this;
+
+    m_size = other.m_size;
+    std::copy(other.m_inline, other.m_inline + std::min(m_size, inlineSize), m_inline);
+    m_overflow = other.m_overflow;
+
+    m_textSize = other.m_textSize;
+    std::memcpy(m_inlineText, other.m_inlineText, m_textSize);
+    m_overflowText = other.m_overflowText;
+    return *this;
+}
+
+/**
+ * \brief Returns the field at \p index
+ *
+ * The field views the storage of this object, so it's only valid until the fields are changed.
+ */
+VisualLog::Field VisualLog::Fields::at(size_t index) const{
+    const Entry& entry = index < inlineSize ? m_inline[index] : m_overflow[index - inlineSize];
+    return Field(
+        entry.type,
+        textAt(entry.keyOffset, entry.keySize),
+        entry.value,
+        entry.type == Field::String ? textAt(entry.textOffset, entry.textSize) : std::string_view()
+    );
+}
+
+/** \brief Adds a Boolean field */
+void VisualLog::Fields::addBoolean(std::string_view key, bool value){
+    append(Field::Boolean, key).value.boolean = value;
+}
+
+/** \brief Adds an Integer field */
+void VisualLog::Fields::addInteger(std::string_view key, long long value){
+    append(Field::Integer, key).value.integer = value;
+}
+
+/** \brief Adds a Float field */
+void VisualLog::Fields::addFloat(std::string_view key, double value){
+    append(Field::Float, key).value.number = value;
+}
+
+/** \brief Adds a String field, the value is copied */
+void VisualLog::Fields::addString(std::string_view key, std::string_view value){
+    unsigned int textOffset = storeText(value);
+    Entry& entry = append(Field::String, key);
+    entry.value.integer = 0;
+    entry.textOffset = textOffset;
+    entry.textSize   = static_cast<unsigned int>(value.size());
+}
+
+/** \brief Removes all fields */
+void VisualLog::Fields::clear(){
+    m_size = 0;
+    m_textSize = 0;
+    m_overflow.clear();
+    m_overflowText.clear();
+}
+
+/**
+ * \brief Appends the fields to \p result as space separated `key=value` pairs
+ */
+void VisualLog::Fields::appendText(std::string &result) const{
+    for ( size_t i = 0; i < m_size; ++i ){
+        Field f = at(i);
+        if ( i > 0 )
+            result.push_back(' ');
+        result.append(f.key().data(), f.key().size());
+        result.push_back('=');
+        f.appendValue(result);
+    }
+}
+
+VisualLog::Fields::Entry &VisualLog::Fields::append(Field::Type type, std::string_view key){
+    unsigned int keyOffset = storeText(key);
+
+    Entry* entry = nullptr;
+    if ( m_size < inlineSize ){
+        entry = &m_inline[m_size];
+    } else {
+        m_overflow.emplace_back();
+        entry = &m_overflow.back();
+    }
+    ++m_size;
+
+    entry->type       = type;
+    entry->keyOffset  = keyOffset;
+    entry->keySize    = static_cast<unsigned int>(key.size());
+    entry->textOffset = 0;
+    entry->textSize   = 0;
+    return *entry;
+}
+
+// Offsets past the inline storage point into the overflow text, which keeps copies valid
+unsigned int VisualLog::Fields::storeText(std::string_view text){
+    if ( m_textSize + text.size() <= inlineTextSize ){
+        unsigned int offset = static_cast<unsigned int>(m_textSize);
+        std::memcpy(m_inlineText + m_textSize, text.data(), text.size());
+        m_textSize += text.size();
+        return offset;
+    }
+    unsigned int offset = static_cast<unsigned int>(inlineTextSize + m_overflowText.size());
+    m_overflowText.append(text.data(), text.size());
+    return offset;
+}
+
+std::string_view VisualLog::Fields::textAt(unsigned int offset, unsigned int size) const{
+    if ( offset < inlineTextSize )
+        return std::string_view(m_inlineText + offset, size);
+    return std::string_view(m_overflowText.data() + (offset - inlineTextSize), size);
+}
+
+// EpochReclaimer
+// ---------------------------------------------------------------------
+
+namespace{
+
+/*
+ * Frees configuration snapshots once no thread can be reading them anymore. Readers announce the epoch
+ * they entered in, each retired object is tagged with the epoch it was unpublished in, and is released
+ * after every reader that entered at or before that epoch has left. Readers only write to their own slot.
+ */
+class EpochReclaimer{
+
+public:
+    class Slot{
+    public:
+        Slot() : epoch(0), inUse(true), depth(0), next(nullptr){}
+
+        std::atomic<unsigned long long> epoch;
+        std::atomic<bool>               inUse;
+        int                             depth;
+        Slot*                           next;
+    };
+
+    class Retired{
+    public:
+        unsigned long long    epoch;
+        std::function<void()> release;
+    };
+
+    static EpochReclaimer& instance();
+
+    void enter();
+    void leave();
+    void retire(const std::function<void()>& release);
+
+private:
+    EpochReclaimer() : m_epoch(1), m_slots(nullptr){}
+
+    Slot* threadSlot();
+    Slot* acquireSlot();
+
+    std::atomic<unsigned long long> m_epoch;
+    std::atomic<Slot*>              m_slots;
+    std::mutex                      m_retiredMutex;
+    std::vector<Retired>            m_retired;
+};
+
+// Trivially destructible, so they stay usable while other thread_local objects are destroyed.
+thread_local EpochReclaimer::Slot* epochSlot = nullptr;
+thread_local bool                  epochSlotReleased = false;
+
+class EpochSlotRelease{
+public:
+    ~EpochSlotRelease(){
+        if ( epochSlot ){
+            epochSlot->epoch.store(0, std::memory_order_release);
+            epochSlot->inUse.store(false, std::memory_order_release);
+            epochSlot = nullptr;
+        }
+        epochSlotReleased = true;
+    }
+};
+
+EpochReclaimer &EpochReclaimer::instance(){
+    static EpochReclaimer* reclaimer = new EpochReclaimer;
+    return *reclaimer;
+}
+
+void EpochReclaimer::enter(){
+    Slot* slot = threadSlot();
+    if ( slot->depth++ == 0 )
+        slot->epoch.store(m_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+}
+
+void EpochReclaimer::leave(){
+    Slot* slot = threadSlot();
+    if ( --slot->depth == 0 )
+        slot->epoch.store(0, std::memory_order_release);
+}
+
+void EpochReclaimer::retire(const std::function<void()>& release){
+    unsigned long long epoch = m_epoch.fetch_add(1, std::memory_order_seq_cst);
+
+    unsigned long long oldestReader = ~0ULL;
+    for ( Slot* slot = m_slots.load(std::memory_order_acquire); slot; slot = slot->next ){
+        unsigned long long readerEpoch = slot->epoch.load(std::memory_order_seq_cst);
+        if ( readerEpoch != 0 && readerEpoch < oldestReader )
+            oldestReader = readerEpoch;
+    }
+
+    std::vector<Retired> releasable;
+    {
+        std::lock_guard<std::mutex> guard(m_retiredMutex);
+        m_retired.push_back({epoch, release});
+        auto split = std::partition(m_retired.begin(), m_retired.end(), [oldestReader](const Retired& r){
+            return r.epoch >= oldestReader;
+        });
+        releasable.assign(std::make_move_iterator(split), std::make_move_iterator(m_retired.end()));
+        m_retired.erase(split, m_retired.end());
+    }
+
+    // released outside the lock, destroying a transport may log or reconfigure
+    for ( auto it = releasable.begin(); it != releasable.end(); ++it )
+        it->release();
+}
+
+EpochReclaimer::Slot *EpochReclaimer::threadSlot(){
+    if ( !epochSlot ){
+        epochSlot = acquireSlot();
+        if ( !epochSlotReleased ){
+            thread_local EpochSlotRelease slotRelease;
+            (void)slotRelease;
+        }
+    }
+    return epochSlot;
+}
+
+EpochReclaimer::Slot *EpochReclaimer::acquireSlot(){
+    for ( Slot* slot = m_slots.load(std::memory_order_acquire); slot; slot = slot->next ){
+        bool inUse = false;
+        if ( !slot->inUse.load(std::memory_order_relaxed) &&
+             slot->inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire) )
+        {
+            slot->depth = 0;
+            return slot;
+        }
+    }
+
+    Slot* slot = new Slot;
+    Slot* head = m_slots.load(std::memory_order_relaxed);
+    do{
+        slot->next = head;
+    } while ( !m_slots.compare_exchange_weak(head, slot, std::memory_order_release, std::memory_order_relaxed) );
+    return slot;
+}
+
+class SnapshotReadSection{
+public:
+    SnapshotReadSection(){ EpochReclaimer::instance().enter(); }
+    ~SnapshotReadSection(){ EpochReclaimer::instance().leave(); }
+};
+
+// Name of a rotated log file after the name of the log: "<yyyyMMdd-hhmmss-zzz>[_<counter>][.gz]"
+class RotatedFile{
+public:
+    RotatedFile() : counter(0), compressed(false){}
+
+    static bool parse(const std::string& suffix, RotatedFile& result){
+        const size_t stampSize = 19;
+        if ( suffix.size() < stampSize )
+            return false;
+        for ( size_t i = 0; i < stampSize; ++i ){
+            bool separator = (i == 8 || i == 15);
+            if ( separator ? suffix[i] != '-' : !isdigit(static_cast<unsigned char>(suffix[i])) )
+                return false;
+        }
+        result.stamp = suffix.substr(0, stampSize);
+
+        size_t position = stampSize;
+        result.counter = 0;
+        if ( position < suffix.size() && suffix[position] == '_' ){
+            size_t start = ++position;
+            while ( position < suffix.size() && isdigit(static_cast<unsigned char>(suffix[position])) )
+                ++position;
+            if ( position == start || position - start > 9 )
+                return false;
+            result.counter = std::stoi(suffix.substr(start, position - start));
+        }
+
+        std::string rest = suffix.substr(position);
+        result.compressed = (rest == ".gz");
+        return rest.empty() || result.compressed;
+    }
+
+    bool isSameSegment(const RotatedFile& other) const{
+        return stamp == other.stamp && counter == other.counter;
+    }
+    bool operator < (const RotatedFile& other) const{
+        if ( stamp != other.stamp )
+            return stamp < other.stamp;
+        if ( counter != other.counter )
+            return counter < other.counter;
+        return compressed < other.compressed;
+    }
+
+    std::string path;
+    std::string stamp;
+    int         counter;
+    bool        compressed;
+};
+
+// Removes the oldest files rotated from filePath, keeping the latest maxFiles
+void removeExpiredFiles(const std::string& filePath, int maxFiles){
+    fs::path current(filePath);
+    std::string prefix = current.filename().string() + ".";
+    fs::path directory = current.has_parent_path() ? current.parent_path() : fs::path(".");
+
+    std::vector<RotatedFile> rotated;
+    std::error_code ec;
+    for ( fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec) ){
+        std::string name = it->path().filename().string();
+        RotatedFile file;
+        if ( name.compare(0, prefix.size(), prefix) == 0 && RotatedFile::parse(name.substr(prefix.size()), file) ){
+            file.path = it->path().string();
+            rotated.push_back(file);
+        }
+    }
+
+    // newest first, a file being compressed counts once along with its compressed copy
+    std::sort(rotated.begin(), rotated.end(), [](const RotatedFile& a, const RotatedFile& b){ return b < a; });
+
+    int kept = 0;
+    for ( size_t i = 0; i < rotated.size(); ++i ){
+        if ( i == 0 || !rotated[i].isSameSegment(rotated[i - 1]) )
+            ++kept;
+        if ( kept > maxFiles )
+            fs::remove(rotated[i].path, ec);
+    }
+}
+
+bool compressFile(const std::string& path, std::string& error){
+#ifdef ENABLE_LOG_COMPRESSION
+    std::error_code ec;
+    if ( !fs::exists(path, ec) )
+        return true; // already expired
+
+    std::ifstream input(path, std::ios::in | std::ios::binary);
+    if ( !input.is_open() ){
+        error = "Failed to open file for compression: \'" + path + "\'";
+        return false;
+    }
+
+    // written under a temporary name, so an interrupted compression is not taken for a rotated file
+    std::string partialPath = path + ".gz.part";
+    gzFile output = gzopen(partialPath.c_str(), "wb6");
+    if ( !output ){
+        error = "Failed to create compressed file: \'" + partialPath + "\'";
+        return false;
+    }
+
+    std::vector<char> buffer(64 * 1024);
+    bool written = true;
+    while ( written && input ){
+        input.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        int size = static_cast<int>(input.gcount());
+        if ( size > 0 )
+            written = gzwrite(output, buffer.data(), static_cast<unsigned int>(size)) == size;
+    }
+    written = (gzclose(output) == Z_OK) && written;
+    input.close();
+
+    if ( written )
+        fs::rename(partialPath, path + ".gz", ec);
+    if ( !written || ec ){
+        fs::remove(partialPath, ec);
+        error = "Failed to compress file: \'" + path + "\'";
+        return false;
+    }
+
+    fs::remove(path, ec);
+    return true;
+#else
+    error = "Failed to compress file: \'" + path + "\'. Compression is not available in this build.";
+    return false;
+#endif
+}
+
+// Trivially destructible, so they stay readable after the compressor and the flusher are destroyed at exit.
+// Atomic, since they are set by static destructors while other threads may still be logging.
+std::atomic<bool> logCompressorDestroyed(false);
+std::atomic<bool> fileFlusherDestroyed(false);
+
+// Compresses rotated log files on a background thread, started on first use. Retention of compressed
+// files is applied on the same thread, after each compression.
+class LogCompressor{
+
+public:
+    typedef void(*ErrorHandler)(const std::string& message);
+
+    class Job{
+    public:
+        std::string  path;
+        std::string  filePath;
+        int          maxFiles;
+        ErrorHandler onError;
+    };
+
+    static LogCompressor* instance(){
+        if ( logCompressorDestroyed.load(std::memory_order_acquire) )
+            return nullptr;
+        static LogCompressor compressor;
+        return &compressor;
+    }
+
+    ~LogCompressor(){
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_stopping = true;
+            m_wake.notify_one();
+        }
+        if ( m_thread.joinable() )
+            m_thread.join();
+        logCompressorDestroyed.store(true, std::memory_order_release);
+    }
+
+    void compress(const Job& job){
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_queue.push_back(job);
+        if ( !m_thread.joinable() )
+            m_thread = std::thread(&LogCompressor::run, this);
+        m_wake.notify_one();
+    }
+
+private:
+    LogCompressor() : m_stopping(false){}
+
+    void run(){
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while ( true ){
+            m_wake.wait(lock, [this](){ return m_stopping || !m_queue.empty(); });
+            if ( m_queue.empty() )
+                return;
+
+            Job job = m_queue.front();
+            m_queue.pop_front();
+            lock.unlock();
+
+            std::string error;
+            if ( !compressFile(job.path, error) && job.onError )
+                job.onError(error);
+            if ( job.maxFiles > 0 )
+                removeExpiredFiles(job.filePath, job.maxFiles);
+
+            lock.lock();
+        }
+    }
+
+    std::mutex              m_mutex;
+    std::condition_variable m_wake;
+    std::deque<Job>         m_queue;
+    std::thread             m_thread;
+    bool                    m_stopping;
+};
+
+long long steadyMilliseconds(){
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Append only file. On POSIX systems all the segments of a write go out in a single writev call.
+class LogFile{
+
+public:
+    static const size_t maximumSegments = 8;
+
+public:
+    LogFile(){
+#ifdef VLOG_POSIX_FILE
+        m_fd = -1;
+#else
+        m_file = nullptr;
+#endif
+    }
+    ~LogFile(){ close(); }
+
+    bool open(const std::string& path){
+#ifdef VLOG_POSIX_FILE
+        m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#else
+        m_file = fopen(path.c_str(), "ab");
+#endif
+        return isOpen();
+    }
+
+    bool isOpen() const{
+#ifdef VLOG_POSIX_FILE
+        return m_fd != -1;
+#else
+        return m_file != nullptr;
+#endif
+    }
+
+    bool write(const std::string_view* segments, size_t count){
+#ifdef VLOG_POSIX_FILE
+        iovec vectors[maximumSegments];
+        int total = 0;
+        for ( size_t i = 0; i < count && i < maximumSegments; ++i ){
+            if ( segments[i].empty() )
+                continue;
+            vectors[total].iov_base = const_cast<char*>(segments[i].data());
+            vectors[total].iov_len  = segments[i].size();
+            ++total;
+        }
+
+        iovec* current = vectors;
+        while ( total > 0 ){
+            ssize_t written = ::writev(m_fd, current, total);
+            if ( written < 0 ){
+                if ( errno == EINTR )
+                    continue;
+                return false;
+            }
+            // partial write, skip what went out and resume
+            size_t remaining = static_cast<size_t>(written);
+            while ( total > 0 && remaining >= current->iov_len ){
+                remaining -= current->iov_len;
+                ++current;
+                --total;
+            }
+            if ( total > 0 ){
+                current->iov_base = static_cast<char*>(current->iov_base) + remaining;
+                current->iov_len -= remaining;
+            }
+        }
+        return true;
+#else
+        for ( size_t i = 0; i < count; ++i ){
+            if ( !segments[i].empty() && fwrite(segments[i].data(), 1, segments[i].size(), m_file) != segments[i].size() )
+                return false;
+        }
+        return fflush(m_file) == 0;
+#endif
+    }
+
+    void sync(){
+#if defined(__linux__)
+        ::fdatasync(m_fd);
+#elif defined(VLOG_POSIX_FILE)
+        ::fsync(m_fd);
+#endif
+    }
+
+    bool preallocate(long long size){
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+        // reserves the blocks up front, without moving the end the file is appended at
+        return ::fallocate(m_fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size)) == 0;
+#else
+        (void)size;
+        return false;
+#endif
+    }
+
+    void close(){
+#ifdef VLOG_POSIX_FILE
+        if ( m_fd != -1 ){
+            ::close(m_fd);
+            m_fd = -1;
+        }
+#else
+        if ( m_file ){
+            fclose(m_file);
+            m_file = nullptr;
+        }
+#endif
+    }
+
+private:
+    DISABLE_COPY(LogFile);
+
+#ifdef VLOG_POSIX_FILE
+    int   m_fd;
+#else
+    FILE* m_file;
+#endif
+};
+
+long long steadyMicroseconds(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// State of the messages logged from one source location through one configuration. Sites are
+// registered once and never freed, there are only as many as there are vlog calls in the code.
+class CallSiteState{
+
+public:
+    CallSiteState() : arrival(0), sampled(0), suppressed(0), lastSummary(0){}
+
+    std::atomic<long long>          arrival;     // steady microseconds the next message is due at
+    std::atomic<unsigned long long> sampled;     // messages counted for sampling, from all threads
+    std::atomic<unsigned long long> suppressed;  // messages dropped since the last summary
+    std::atomic<long long>          lastSummary; // steady microseconds of the last summary
+};
+
+// Looks up call sites by configuration and the address and line of a __FILE__ literal, through a small
+// per thread cache first, so the shared map is only locked on the first message of a site on each
+// thread. The cache entry also counts the messages the thread dropped, which are added to the site in
+// batches to keep threads flooding the same site from contending.
+class CallSiteRegistry{
+
+public:
+    // trivially destructible, so it's usable while the thread's other objects are destroyed
+    class Entry{
+    public:
+        void addSuppressed(){
+            if ( ++pendingSuppressed >= maximumPendingSuppressed )
+                flushSuppressed();
+        }
+        void flushSuppressed(){
+            if ( pendingSuppressed > 0 ){
+                site->suppressed.fetch_add(pendingSuppressed, std::memory_order_relaxed);
+                pendingSuppressed = 0;
+            }
+        }
+
+        const void*        configuration;
+        const char*        file;
+        int                line;
+        CallSiteState*     site;
+        unsigned int       pendingSuppressed;
+    };
+
+    static const unsigned int maximumPendingSuppressed = 64;
+
+    static Entry& entry(const void* configuration, const char* file, int line){
+        size_t hash = (reinterpret_cast<size_t>(file) >> 3) ^ (static_cast<size_t>(line) * 31) ^ (reinterpret_cast<size_t>(configuration) >> 4);
+        Entry& entry = threadCache[hash % cacheSize];
+        if ( entry.file == file && entry.line == line && entry.configuration == configuration )
+            return entry;
+
+        if ( entry.site )
+            entry.flushSuppressed();
+
+        CallSiteRegistry& registry = instance();
+        CallSiteState* state = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(registry.m_mutex);
+            CallSiteState*& found = registry.m_sites[Key(configuration, file, line)];
+            if ( !found )
+                found = new CallSiteState;
+            state = found;
+        }
+
+        entry.configuration     = configuration;
+        entry.file              = file;
+        entry.line              = line;
+        entry.site              = state;
+        entry.pendingSuppressed = 0;
+        return entry;
+    }
+
+private:
+    static const size_t cacheSize = 64;
+
+    class Key{
+    public:
+        Key(const void* pconfiguration, const char* pfile, int pline) : configuration(pconfiguration), file(pfile), line(pline){}
+        bool operator == (const Key& other) const{
+            return configuration == other.configuration && file == other.file && line == other.line;
+        }
+
+        const void* configuration;
+        const char* file;
+        int         line;
+    };
+
+    class KeyHash{
+    public:
+        size_t operator()(const Key& key) const{
+            return std::hash<const void*>()(key.file) ^ (std::hash<int>()(key.line) << 1) ^ (std::hash<const void*>()(key.configuration) << 2);
         }
-        return base;
+    };
+
+    static CallSiteRegistry& instance(){
+        static CallSiteRegistry* registry = new CallSiteRegistry;
+        return *registry;
     }
+
+    static thread_local Entry threadCache[cacheSize];
+
+    std::mutex                                       m_mutex;
+    std::unordered_map<Key, CallSiteState*, KeyHash> m_sites;
+};
+
+thread_local CallSiteRegistry::Entry CallSiteRegistry::threadCache[CallSiteRegistry::cacheSize] = {};
+
+const long long callSiteSummaryInterval = 1000000;
+
 } // namespace
 
+// VisualLog::ConfigurationSnapshot
+// ---------------------------------------------------------------------
+
+/// \private
+class VisualLog::ConfigurationSnapshot{
+
+public:
+    class FileRotation{
+    public:
+        FileRotation() : maxFileSize(0), interval(0), maxFiles(0), compress(false), preallocate(false){}
+
+        long long maxFileSize; // bytes, 0 for no limit
+        long long interval;    // seconds, 0 for no limit
+        int       maxFiles;    // rotated files to keep, 0 to keep all
+        bool      compress;
+        bool      preallocate;
+    };
+
+    class FileBuffering{
+    public:
+        FileBuffering() : bufferSize(0), flushInterval(100), flushLevel(VisualLog::MessageInfo::Error), syncInterval(0){}
+
+        size_t    bufferSize;    // bytes held in memory, 0 writes every message through
+        long long flushInterval; // milliseconds buffered data waits at most, 0 waits for the buffer to fill
+        int       flushLevel;    // messages at this level or more important are written right away
+        long long syncInterval;  // milliseconds between syncs to disk, 0 leaves it to the system
+    };
+
+    class FileSink{
+
+    public:
+        FileSink(const std::string& filePath, bool daily, const FileRotation& rotation, const FileBuffering& buffering);
+        ~FileSink();
+
+        void write(const DateTime& stamp, int level, const std::string_view* segments, size_t count);
+        void write(const DateTime& stamp, int level, std::string_view data){ write(stamp, level, &data, 1); }
+        void flush();
+        bool tryFlush();
+        void flushIfDue(long long now);
+        void close();
+        void configure(const FileRotation& rotation, const FileBuffering& buffering);
+
+    private:
+        bool open(const DateTime& stamp);
+        void closeFile();
+        bool writeBuffer(const std::string_view* segments, size_t count);
+        void sync(long long now);
+        bool requiresRotation(const DateTime& stamp, size_t size) const;
+        void rotate(const DateTime& stamp);
+
+        std::mutex    m_mutex;
+        std::string   m_filePathPattern;
+        bool          m_daily;
+        FileRotation  m_rotation;
+        FileBuffering m_buffering;
+        bool          m_failed;
+        bool          m_rotationFailed;
+        int           m_dayOfYear;
+        std::string   m_filePath;
+        long long     m_fileSize;
+        long long     m_openStamp;
+        bool          m_preallocated;
+        LogFile       m_file;
+        std::string   m_buffer;
+        long long     m_bufferStamp;
+        long long     m_syncStamp;
+        bool          m_unsynced;
+    };
+
+    class CallSiteLimit{
+    public:
+        CallSiteLimit() : rate(0), burst(1), sample(0){}
+
+        bool isEnabled() const{ return rate > 0 || sample > 1; }
+
+        double    rate;   // messages per second from each call site, 0 for no limit
+        double    burst;  // messages a call site can log at once before the rate applies
+        long long sample; // 1 in this many messages is logged from each call site, 0 or 1 logs all
+    };
+
+    // Owners of a snapshot: its configuration until the snapshot is replaced, and the asynchronous
+    // records logged through it. Copies of a snapshot start with a single owner.
+    class References{
+    public:
+        References() : count(1){}
+        References(const References&) : count(1){}
+        References& operator = (const References&){ return *this; }
+
+        std::atomic<int> count;
+    };
+
+    ConfigurationSnapshot()
+        : applicationLevel(VisualLog::MessageInfo::Debug)
+        , defaultLevel(VisualLog::MessageInfo::Info)
+        , ringLevel(-1)
+        , captureLevel(applicationLevel)
+        , output(VisualLog::Console | VisualLog::View | VisualLog::Extensions)
+        , logObjects(VisualLog::File | VisualLog::Extensions)
+        , logDaily(false)
+    {}
+
+    VisualLog::MessageInfo::Level applicationLevel;
+    VisualLog::MessageInfo::Level defaultLevel;
+    int         ringLevel;    // least important level kept in the LogRing, -1 if none
+    int         captureLevel; // least important level processed, the larger of applicationLevel and ringLevel
+    std::string filePath;
+    int         output;
+    int         logObjects;
+    bool        logDaily;
+    std::string prefix;
+    VisualLog::PrefixFormat prefixFormat;
+    FileRotation rotation;
+    FileBuffering buffering;
+    CallSiteLimit callSiteLimit;
+
+    std::string binaryFilePath;
+
+    std::vector<std::shared_ptr<VisualLog::Transport> > transports;
+    std::shared_ptr<FileSink> fileSink;
+    std::shared_ptr<BinaryLogWriter> binarySink;
+
+    void retain() const{ references.count.fetch_add(1, std::memory_order_relaxed); }
+    void release() const{
+        if ( references.count.fetch_sub(1, std::memory_order_acq_rel) == 1 )
+            delete this;
+    }
+
+    mutable References references;
+};
+
+VisualLog::ConfigurationSnapshot::FileSink::FileSink(
+        const std::string &filePath,
+        bool daily,
+        const FileRotation &rotation,
+        const FileBuffering &buffering)
+    : m_filePathPattern(filePath)
+    , m_daily(daily)
+    , m_rotation(rotation)
+    , m_buffering(buffering)
+    , m_failed(false)
+    , m_rotationFailed(false)
+    , m_dayOfYear(-1)
+    , m_fileSize(0)
+    , m_openStamp(0)
+    , m_preallocated(false)
+    , m_bufferStamp(0)
+    , m_syncStamp(0)
+    , m_unsynced(false)
+{
+    m_buffer.reserve(m_buffering.bufferSize);
+}
+
+VisualLog::ConfigurationSnapshot::FileSink::~FileSink(){
+    close();
+}
+
+/**
+ * Writes the concatenated \p segments to the file \p stamp belongs to, opening, switching or rotating
+ * files if required.
+ *
+ * Messages are kept in the buffer until it fills up, until they are older than the flush interval, or
+ * until a message of at least the flush level arrives. The buffer and the message are then written
+ * together, with a single call. At most LogFile::maximumSegments - 1 segments can be given.
+ */
+void VisualLog::ConfigurationSnapshot::FileSink::write(const DateTime &stamp, int level, const std::string_view *segments, size_t count){
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if ( m_failed || !open(stamp) )
+        return;
+
+    size_t size = 0;
+    for ( size_t i = 0; i < count; ++i )
+        size += segments[i].size();
+
+    if ( requiresRotation(stamp, size) ){
+        rotate(stamp);
+        if ( !open(stamp) )
+            return;
+    }
+    m_fileSize += static_cast<long long>(size);
+
+    long long now = steadyMilliseconds();
+    bool writeThrough =
+        level <= m_buffering.flushLevel ||
+        m_buffer.size() + size > m_buffering.bufferSize ||
+        fileFlusherDestroyed.load(std::memory_order_acquire);
+
+    if ( writeThrough ){
+        writeBuffer(segments, count);
+    } else {
+        if ( m_buffer.empty() )
+            m_bufferStamp = now;
+        for ( size_t i = 0; i < count; ++i )
+            m_buffer.append(segments[i].data(), segments[i].size());
+        if ( m_buffering.flushInterval > 0 && now - m_bufferStamp >= m_buffering.flushInterval )
+            writeBuffer(nullptr, 0);
+    }
+
+    if ( m_unsynced && m_buffering.syncInterval > 0 && now - m_syncStamp >= m_buffering.syncInterval )
+        sync(now);
+}
+
+/**
+ * Writes out the buffered data. Files with a sync interval are also synced to disk.
+ */
+void VisualLog::ConfigurationSnapshot::FileSink::flush(){
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if ( !m_file.isOpen() )
+        return;
+    writeBuffer(nullptr, 0);
+    if ( m_unsynced && m_buffering.syncInterval > 0 )
+        sync(steadyMilliseconds());
+}
+
+/**
+ * Writes out the buffered data unless another thread, or the calling one, is using the file, in which
+ * case it returns false without waiting.
+ */
+bool VisualLog::ConfigurationSnapshot::FileSink::tryFlush(){
+    std::unique_lock<std::mutex> guard(m_mutex, std::try_to_lock);
+    if ( !guard.owns_lock() || !m_file.isOpen() )
+        return false;
+    return writeBuffer(nullptr, 0);
+}
+
+/**
+ * Writes out data buffered for longer than the flush interval, and syncs the file if its sync
+ * interval passed. \p now is given in steady clock milliseconds.
+ */
+void VisualLog::ConfigurationSnapshot::FileSink::flushIfDue(long long now){
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if ( !m_file.isOpen() )
+        return;
+    if ( !m_buffer.empty() && m_buffering.flushInterval > 0 && now - m_bufferStamp >= m_buffering.flushInterval )
+        writeBuffer(nullptr, 0);
+    if ( m_unsynced && m_buffering.syncInterval > 0 && now - m_syncStamp >= m_buffering.syncInterval )
+        sync(now);
+}
 
+void VisualLog::ConfigurationSnapshot::FileSink::close(){
+    std::lock_guard<std::mutex> guard(m_mutex);
+    closeFile();
+}
+
+/**
+ * Applies new rotation and buffering settings without reopening the file. Buffered data that no longer
+ * fits the new buffer size is written out.
+ */
+void VisualLog::ConfigurationSnapshot::FileSink::configure(const FileRotation &rotation, const FileBuffering &buffering){
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_rotation       = rotation;
+    m_buffering      = buffering;
+    m_rotationFailed = false;
+    if ( m_file.isOpen() && m_buffer.size() > m_buffering.bufferSize )
+        writeBuffer(nullptr, 0);
+    m_buffer.reserve(m_buffering.bufferSize);
+}
+
+bool VisualLog::ConfigurationSnapshot::FileSink::open(const DateTime &stamp){
+    if ( m_file.isOpen() && (!m_daily || stamp.dayOfYear() == m_dayOfYear) )
+        return true;
+
+    closeFile();
+
+    std::string filePath = m_daily ? stamp.format(m_filePathPattern) : m_filePathPattern;
+    if ( filePath != m_filePath ){
+        m_filePath       = filePath;
+        m_rotationFailed = false;
+    }
+    if ( !m_file.open(m_filePath) ){
+        m_failed = true;
+        VisualLog::internalMessageHandler()(
+            VisualLog::MessageInfo::Error, Utf8("Failed to open file: \'%\'. Closing file output stream.").format(m_filePath).data()
+        );
+        return false;
+    }
+
+    std::error_code ec;
+    uintmax_t fileSize = fs::file_size(m_filePath, ec);
+    m_fileSize  = ec ? 0 : static_cast<long long>(fileSize);
+    m_openStamp = stamp.usecondsSinceEpoch();
+    m_dayOfYear = stamp.dayOfYear();
+    m_syncStamp = steadyMilliseconds();
+
+    // reserves the blocks of a new segment up front
+    if ( m_rotation.preallocate && m_rotation.maxFileSize > 0 && m_fileSize == 0 )
+        m_preallocated = m_file.preallocate(m_rotation.maxFileSize);
+
+    return true;
+}
+
+void VisualLog::ConfigurationSnapshot::FileSink::closeFile(){
+    if ( m_file.isOpen() ){
+        writeBuffer(nullptr, 0);
+        if ( m_unsynced && m_buffering.syncInterval > 0 )
+            sync(steadyMilliseconds());
+        m_file.close();
+        if ( m_preallocated ){
+            // releases the blocks reserved past the end of the file
+            std::error_code ec;
+            fs::resize_file(m_filePath, static_cast<uintmax_t>(m_fileSize), ec);
+            m_preallocated = false;
+        }
+    }
+    m_buffer.clear();
+    m_dayOfYear = -1;
+}
+
+/**
+ * Writes the buffer followed by \p segments, and empties the buffer.
+ */
+bool VisualLog::ConfigurationSnapshot::FileSink::writeBuffer(const std::string_view *segments, size_t count){
+    std::string_view vectors[LogFile::maximumSegments];
+    size_t total = 0;
+    if ( !m_buffer.empty() )
+        vectors[total++] = m_buffer;
+    for ( size_t i = 0; i < count && total < LogFile::maximumSegments; ++i )
+        vectors[total++] = segments[i];
+    if ( total == 0 )
+        return true;
+
+    bool written = m_file.write(vectors, total);
+    m_buffer.clear();
+    m_unsynced = true;
+
+    if ( !written ){
+        m_failed = true;
+        m_file.close();
+        VisualLog::internalMessageHandler()(
+            VisualLog::MessageInfo::Error, Utf8("Failed to write file: \'%\'. Closing file output stream.").format(m_filePath).data()
+        );
+    }
+    return written;
+}
+
+void VisualLog::ConfigurationSnapshot::FileSink::sync(long long now){
+    m_file.sync();
+    m_syncStamp = now;
+    m_unsynced  = false;
+}
+
+/**
+ * The size limit is ignored once a rotation of the current file failed, so it isn't retried for every
+ * message. The interval, a switch to the next daily file, or new settings trigger the next attempt.
+ */
+bool VisualLog::ConfigurationSnapshot::FileSink::requiresRotation(const DateTime &stamp, size_t size) const{
+    if ( !m_rotationFailed && m_rotation.maxFileSize > 0 && m_fileSize > 0 && m_fileSize + static_cast<long long>(size) > m_rotation.maxFileSize )
+        return true;
+    if ( m_rotation.interval > 0 && stamp.usecondsSinceEpoch() - m_openStamp >= m_rotation.interval * 1000000LL )
+        return true;
+    return false;
+}
+
+/**
+ * Closes the current file and renames it after \p stamp. The oldest rotated files past the retention
+ * count are removed, after the renamed file is compressed when compression is enabled.
+ */
+void VisualLog::ConfigurationSnapshot::FileSink::rotate(const DateTime &stamp){
+    closeFile();
+
+    std::string rotatedStem = m_filePath + "." + stamp.format("%Y%m%d-%H%M%S-%i");
+    std::string rotatedPath = rotatedStem;
+    std::error_code ec;
+    for ( int i = 1; fs::exists(rotatedPath, ec) || fs::exists(rotatedPath + ".gz", ec); ++i )
+        rotatedPath = rotatedStem + "_" + std::to_string(i);
+
+    fs::rename(m_filePath, rotatedPath, ec);
+    if ( ec ){
+        VisualLog::internalMessageHandler()(
+            VisualLog::MessageInfo::Error, Utf8("Failed to rotate log file: \'%\'. %").format(m_filePath, ec.message()).data()
+        );
+        m_rotationFailed = true;
+        return;
+    }
+    m_rotationFailed = false;
+
+    LogCompressor* compressor = m_rotation.compress ? LogCompressor::instance() : nullptr;
+    if ( compressor ){
+        LogCompressor::Job job;
+        job.path     = rotatedPath;
+        job.filePath = m_filePath;
+        job.maxFiles = m_rotation.maxFiles;
+        job.onError  = [](const std::string& message){
+            VisualLog::internalMessageHandler()(VisualLog::MessageInfo::Error, message);
+        };
+        compressor->compress(job);
+    } else if ( m_rotation.maxFiles > 0 ){
+        removeExpiredFiles(m_filePath, m_rotation.maxFiles);
+    }
+}
+
+namespace{
+
+const long long fileFlusherMinimumPeriod = 5;
+
+// Writes out buffers and syncs files on their intervals, for files that stop receiving messages.
+// Files left are flushed on exit, since configurations are never destroyed.
+class FileFlusher{
+
+public:
+    static FileFlusher* instance(){
+        if ( fileFlusherDestroyed.load(std::memory_order_acquire) )
+            return nullptr;
+        static FileFlusher flusher;
+        return &flusher;
+    }
+
+    ~FileFlusher(){
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_stopping = true;
+            m_wake.notify_one();
+        }
+        if ( m_thread.joinable() )
+            m_thread.join();
+
+        // messages logged from here on are written through
+        fileFlusherDestroyed.store(true, std::memory_order_release);
+        for ( auto it = m_sinks.begin(); it != m_sinks.end(); ++it ){
+            std::shared_ptr<VisualLog::ConfigurationSnapshot::FileSink> sink = it->lock();
+            if ( sink )
+                sink->flush();
+        }
+    }
+
+    void add(
+        const std::shared_ptr<VisualLog::ConfigurationSnapshot::FileSink>& sink,
+        const VisualLog::ConfigurationSnapshot::FileBuffering& buffering)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_sinks.push_back(sink);
+        updatePeriod(buffering);
+        if ( !m_thread.joinable() )
+            m_thread = std::thread(&FileFlusher::run, this);
+        m_wake.notify_one();
+    }
+
+    // Called when the buffering of a sink that was already added changes
+    void reschedule(const VisualLog::ConfigurationSnapshot::FileBuffering& buffering){
+        std::lock_guard<std::mutex> guard(m_mutex);
+        updatePeriod(buffering);
+        m_wake.notify_one();
+    }
+
+private:
+    FileFlusher() : m_period(1000), m_stopping(false){}
+
+    void updatePeriod(const VisualLog::ConfigurationSnapshot::FileBuffering& buffering){
+        long long period = 0;
+        if ( buffering.bufferSize > 0 && buffering.flushInterval > 0 )
+            period = buffering.flushInterval;
+        if ( buffering.syncInterval > 0 && (period == 0 || buffering.syncInterval < period) )
+            period = buffering.syncInterval;
+        if ( period > 0 && period < m_period )
+            m_period = std::max(period, fileFlusherMinimumPeriod);
+    }
+
+    void run(){
+        std::vector<std::shared_ptr<VisualLog::ConfigurationSnapshot::FileSink> > sinks;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while ( !m_stopping ){
+            m_wake.wait_for(lock, std::chrono::milliseconds(m_period));
+            if ( m_stopping )
+                break;
+
+            auto removed = std::remove_if(m_sinks.begin(), m_sinks.end(), [&sinks](const std::weak_ptr<VisualLog::ConfigurationSnapshot::FileSink>& sink){
+                std::shared_ptr<VisualLog::ConfigurationSnapshot::FileSink> current = sink.lock();
+                if ( !current )
+                    return true;
+                sinks.push_back(std::move(current));
+                return false;
+            });
+            m_sinks.erase(removed, m_sinks.end());
+            lock.unlock();
+
+            long long now = steadyMilliseconds();
+            for ( auto it = sinks.begin(); it != sinks.end(); ++it )
+                (*it)->flushIfDue(now);
+            sinks.clear();
+
+            lock.lock();
+        }
+    }
+
+    std::mutex                                                        m_mutex;
+    std::condition_variable                                           m_wake;
+    std::vector<std::weak_ptr<VisualLog::ConfigurationSnapshot::FileSink> > m_sinks;
+    long long                                                         m_period;
+    std::thread                                                       m_thread;
+    bool                                                              m_stopping;
+};
+
+} // namespace
 
 // VisualLog::Configuration
 // ---------------------------------------------------------------------
+
 /// \private
 class VisualLog::Configuration{
 
-public:
-    Configuration(
-        const std::string& name,
-        VisualLog::MessageInfo::Level applicationLevel,
-        VisualLog::MessageInfo::Level defaultLevel,
-        const std::string& filePath,
-        bool dailyFile);
-    Configuration(
-        const std::string& name,
-        const Configuration& other
-    );
+public:
+    Configuration(const std::string& name, VisualLog::ConfigurationSnapshot* snapshot);
+    ~Configuration();
+
+    const VisualLog::ConfigurationSnapshot* snapshot() const{ return m_snapshot.load(std::memory_order_acquire); }
+    void update(const std::function<void(VisualLog::ConfigurationSnapshot*)>& change);
+
+    void closeFile();
+
+public:
+    const std::string m_name;
+    std::atomic<int>  m_applicationLevel;
+
+private:
+    DISABLE_COPY(Configuration);
+
+    std::atomic<VisualLog::ConfigurationSnapshot*> m_snapshot;
+    std::mutex                                     m_updateMutex;
+};
+
+
+VisualLog::Configuration::Configuration(const std::string &name, VisualLog::ConfigurationSnapshot *snapshot)
+    : m_name(name)
+    , m_applicationLevel(snapshot->captureLevel)
+    , m_snapshot(snapshot)
+{
+}
+
+VisualLog::Configuration::~Configuration(){
+    m_snapshot.load()->release();
+}
+
+/**
+ * Publishes a copy of the current snapshot modified by \p change. Threads that are still logging with the
+ * previous snapshot keep it until they are done.
+ */
+void VisualLog::Configuration::update(const std::function<void (VisualLog::ConfigurationSnapshot *)> &change){
+    VisualLog::ConfigurationSnapshot* current = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(m_updateMutex);
+
+        current = m_snapshot.load(std::memory_order_relaxed);
+        std::unique_ptr<VisualLog::ConfigurationSnapshot> next(new VisualLog::ConfigurationSnapshot(*current));
+        change(next.get());
+        next->captureLevel = std::max(static_cast<int>(next->applicationLevel), next->ringLevel);
+
+        m_applicationLevel.store(next->captureLevel, std::memory_order_relaxed);
+        m_snapshot.store(next.release(), std::memory_order_seq_cst);
+    }
+    EpochReclaimer::instance().retire([current](){ current->release(); });
+}
+
+void VisualLog::Configuration::closeFile(){
+    SnapshotReadSection readSection;
+    const VisualLog::ConfigurationSnapshot* current = snapshot();
+    if ( current->fileSink )
+        current->fileSink->close();
+    if ( current->binarySink )
+        current->binarySink->close();
+}
+
+// VisualLog::ConfigurationContainer
+// ---------------------------------------------------------------------
+
+/// \private
+class VisualLog::ConfigurationContainer{
+
+public:
+    ConfigurationContainer(VisualLog::Configuration* global);
+
+    VisualLog::Configuration* globalConfiguration();
+
+    VisualLog::Configuration* configurationAt(std::string_view key);
+    VisualLog::Configuration* configurationAt(int index);
+
+    VisualLog::Configuration* configurationAtOrGlobal(std::string_view key);
+    VisualLog::Configuration* configurationAtOrCreate(const std::string& key);
+
+    int configurationCount();
+
+private:
+    class Index{
+    public:
+        std::vector<VisualLog::Configuration*> configurations;
+        // keys view the names of the configurations, which are never freed
+        std::unordered_map<std::string_view, VisualLog::Configuration*> configurationMap;
+    };
+
+    void publish(Index* index);
+
+    VisualLog::Configuration* m_global;
+    std::atomic<Index*>       m_index;
+    std::mutex                m_updateMutex;
+};
+
+VisualLog::ConfigurationContainer* VisualLog::createDefaultConfigurations(){
+    VisualLog::Configuration* configuration = new VisualLog::Configuration(
+        "global", new VisualLog::ConfigurationSnapshot
+    );
+    return new VisualLog::ConfigurationContainer(configuration);
+}
+
+/**
+ * The container is never destroyed, since messages may still be logged during static destruction.
+ */
+VisualLog::ConfigurationContainer &VisualLog::registeredConfigurations(){
+    static ConfigurationContainer* registeredConfigurations = createDefaultConfigurations();
+    return *registeredConfigurations;
+}
+
+VisualLog::MessageHandlerFunction &VisualLog::internalMessageHandler(){
+    static VisualLog::MessageHandlerFunction m = &VisualLog::defaultInternalMessageHandler;
+    return m;
+}
+
+void VisualLog::defaultInternalMessageHandler(int, const std::string& message){
+    printf("Internal Log: %s\n", message.c_str());
+}
+
+VisualLog::ConfigurationContainer::ConfigurationContainer(VisualLog::Configuration* global)
+    : m_global(global)
+    , m_index(new Index)
+{
+    Index* index = m_index.load();
+    index->configurations.push_back(global);
+    index->configurationMap[global->m_name] = global;
+}
+
+VisualLog::Configuration *VisualLog::ConfigurationContainer::globalConfiguration(){
+    return m_global;
+}
+
+VisualLog::Configuration *VisualLog::ConfigurationContainer::configurationAt(std::string_view key){
+    SnapshotReadSection readSection;
+    Index* index = m_index.load(std::memory_order_acquire);
+    auto it = index->configurationMap.find(key);
+    if ( it == index->configurationMap.end() )
+        return nullptr;
+    return it->second;
+}
+
+VisualLog::Configuration *VisualLog::ConfigurationContainer::configurationAt(int index){
+    SnapshotReadSection readSection;
+    return m_index.load(std::memory_order_acquire)->configurations.at(index);
+}
+
+VisualLog::Configuration *VisualLog::ConfigurationContainer::configurationAtOrGlobal(std::string_view key){
+    VisualLog::Configuration* configuration = configurationAt(key);
+    return configuration ? configuration : m_global;
+}
+
+/**
+ * Returns the configuration registered under \p key, or registers a copy of the global configuration
+ */
+VisualLog::Configuration *VisualLog::ConfigurationContainer::configurationAtOrCreate(const std::string &key){
+    VisualLog::Configuration* configuration = configurationAt(key);
+    if ( configuration )
+        return configuration;
+
+    std::lock_guard<std::mutex> guard(m_updateMutex);
 
-    void closeFile();
+    Index* current = m_index.load(std::memory_order_relaxed);
+    auto it = current->configurationMap.find(key);
+    if ( it != current->configurationMap.end() )
+        return it->second;
 
-public:
-    std::string        m_name;
-    VisualLog::MessageInfo::Level m_applicationLevel;
-    VisualLog::MessageInfo::Level m_defaultLevel;
-    std::string        m_filePath;
-    int            m_output;
-    int            m_logObjects;
-    bool           m_logDaily;
-    std::ofstream* m_logFile;
-    std::string    m_logFilePath;
-    DateTime       m_lastLog;
-    std::string    m_prefix;
-
-    std::list<std::shared_ptr<VisualLog::Transport> > m_transports;
-};
+    {
+        SnapshotReadSection readSection;
+        configuration = new VisualLog::Configuration(key, new VisualLog::ConfigurationSnapshot(*m_global->snapshot()));
+    }
 
+    Index* next = new Index(*current);
+    next->configurations.push_back(configuration);
+    next->configurationMap[configuration->m_name] = configuration;
+    publish(next);
 
-VisualLog::Configuration::Configuration(
-        const std::string &name,
-        VisualLog::MessageInfo::Level applicationLevel,
-        VisualLog::MessageInfo::Level defaultLevel,
-        const std::string &filePath,
-        bool dailyFile)
-    : m_name(name)
-    , m_applicationLevel(applicationLevel)
-    , m_defaultLevel(defaultLevel)
-    , m_filePath(filePath)
-    , m_output(VisualLog::Console | VisualLog::View | VisualLog::Extensions)
-    , m_logObjects(VisualLog::File | VisualLog::Extensions)
-    , m_logDaily(dailyFile)
-    , m_logFile(nullptr)
-    , m_transports()
-{}
-
-VisualLog::Configuration::Configuration(const std::string &name, const VisualLog::Configuration &other)
-    : m_name(name)
-    , m_applicationLevel(other.m_applicationLevel)
-    , m_defaultLevel(other.m_defaultLevel)
-    , m_filePath(other.m_filePath)
-    , m_output(other.m_output)
-    , m_logObjects(other.m_logObjects)
-    , m_logDaily(other.m_logDaily)
-    , m_logFile(other.m_logFile)
-    , m_prefix(other.m_prefix)
-    , m_transports(other.m_transports)
-{
+    return configuration;
 }
 
-void VisualLog::Configuration::closeFile(){
-    if ( m_logFile != nullptr ){
-        m_logFile->close();
-        delete m_logFile;
-        m_logFile = nullptr;
-    }
+int VisualLog::ConfigurationContainer::configurationCount(){
+    SnapshotReadSection readSection;
+    return static_cast<int>(m_index.load(std::memory_order_acquire)->configurations.size());
 }
 
-// VisualLog::ConfigurationContainer
+void VisualLog::ConfigurationContainer::publish(VisualLog::ConfigurationContainer::Index *index){
+    Index* current = m_index.exchange(index, std::memory_order_seq_cst);
+    VisualLog::m_configurationGeneration.fetch_add(1, std::memory_order_release);
+    EpochReclaimer::instance().retire([current](){ delete current; });
+}
+
+// VisualLog::AsyncWriter
 // ---------------------------------------------------------------------
 
 /// \private
-class VisualLog::ConfigurationContainer{
+class VisualLog::AsyncWriter{
 
 public:
-    ConfigurationContainer();
-
-    int addConfiguration(const std::string& key, VisualLog::Configuration* configuration);
-
-    VisualLog::Configuration* globalConfiguration();
-
-    VisualLog::Configuration* configurationAt(const std::string& key);
-    VisualLog::Configuration* configurationAt(int index);
+    // Keeps the snapshot a record was logged with, along with its sinks, until the record is written
+    class SnapshotReference{
+    public:
+        SnapshotReference() : m_snapshot(nullptr){}
+        SnapshotReference(SnapshotReference&& other) : m_snapshot(other.m_snapshot){ other.m_snapshot = nullptr; }
+        ~SnapshotReference(){ reset(); }
+
+        SnapshotReference& operator = (SnapshotReference&& other){
+            std::swap(m_snapshot, other.m_snapshot);
+            return *this;
+        }
 
-    VisualLog::Configuration* configurationAtOrGlobal(const std::string& key);
+        const VisualLog::ConfigurationSnapshot* get() const{ return m_snapshot; }
+        void reset(const VisualLog::ConfigurationSnapshot* snapshot = nullptr){
+            if ( snapshot )
+                snapshot->retain();
+            if ( m_snapshot )
+                m_snapshot->release();
+            m_snapshot = snapshot;
+        }
 
-    int configurationCount() const;
+    private:
+        DISABLE_COPY(SnapshotReference);
+
+        const VisualLog::ConfigurationSnapshot* m_snapshot;
+    };
+
+    class Record{
+    public:
+        Record() : configuration(nullptr), output(0), level(VisualLog::MessageInfo::Info), line(0){}
+
+        VisualLog::Configuration*       configuration;
+        SnapshotReference               snapshot; // as it was when the record was logged
+        int                             output;
+        VisualLog::MessageInfo::Level   level;
+        std::unique_ptr<SourceLocation> location; // owner of the views below, unless they were literals
+        std::string_view                remote;
+        std::string_view                file;
+        std::string_view                functionName;
+        int                             line;
+        DateTime                        stamp;
+        std::string                     prefix;
+        std::string                     message;
+        VisualLog::Fields               fields;
+    };
+
+    AsyncWriter(size_t capacity, VisualLog::OverflowPolicy policy);
+    ~AsyncWriter();
+
+    bool enter(){ return m_worker->enter(); }
+    void leave(){ m_worker->leave(); }
+    void push(Record& record){ m_worker->push(record); }
+    void flush(){ m_worker->flush(); }
+    void stop(){ m_worker->stop(); }
+
+    size_t dropped() const{ return m_worker->dropped(); }
+
+    static std::atomic<AsyncWriter*>& current();
+    static Record* spareRecord();
 
 private:
-    std::vector<VisualLog::Configuration*>                     m_configurations;
-    std::unordered_map<std::string, VisualLog::Configuration*> m_configurationMap;
+    // Writes out batches of records. Owned by the worker, so it outlives a writer stopped and freed by a
+    // transport running on the writer thread.
+    class Batch{
+    public:
+        size_t drain(BatchWorker<Record>& worker);
+        void write(Record& record);
+
+        Record                                                                   record;
+        std::string                                                              console;
+        std::string                                                              fieldText;
+        std::vector<std::shared_ptr<VisualLog::ConfigurationSnapshot::FileSink> > files;
+        std::vector<std::shared_ptr<BinaryLogWriter> >                           binaryFiles;
+    };
+
+    static const size_t maximumBatch = 256;
+
+    std::shared_ptr<BatchWorker<Record> > m_worker;
 };
 
-VisualLog::ConfigurationContainer VisualLog::createDefaultConfigurations(){
-    VisualLog::ConfigurationContainer container;
-
-    VisualLog::Configuration* configuration = new VisualLog::Configuration(
-        "global",
-        VisualLog::MessageInfo::Level::Debug,
-        VisualLog::MessageInfo::Level::Info,
-        "",
-        false
-    );
-
-    container.addConfiguration("global", configuration);
-
-    return container;
+VisualLog::AsyncWriter::AsyncWriter(size_t capacity, VisualLog::OverflowPolicy policy){
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    m_worker = BatchWorker<Record>::create(capacity, policy, [batch](BatchWorker<Record>& worker){
+        return batch->drain(worker);
+    });
 }
 
-VisualLog::ConfigurationContainer &VisualLog::registeredConfigurations(){
-    static ConfigurationContainer registeredConfigurations = createDefaultConfigurations();
-    return registeredConfigurations;
+VisualLog::AsyncWriter::~AsyncWriter(){
+    stop();
 }
 
-VisualLog::MessageHandlerFunction &VisualLog::internalMessageHandler(){
-    static VisualLog::MessageHandlerFunction m = &VisualLog::defaultInternalMessageHandler;
-    return m;
+std::atomic<VisualLog::AsyncWriter *> &VisualLog::AsyncWriter::current(){
+    static std::atomic<VisualLog::AsyncWriter*> writer(nullptr);
+    return writer;
 }
 
-void VisualLog::defaultInternalMessageHandler(int, const std::string& message){
-    printf("Internal Log: %s\n", message.c_str());
-}
+namespace{
 
-VisualLog::ConfigurationContainer::ConfigurationContainer(){
-}
+// Trivially destructible, so it stays readable while other thread_local objects are destroyed.
+thread_local bool spareRecordDestroyed = false;
 
-int VisualLog::ConfigurationContainer::addConfiguration(const std::string &key, VisualLog::Configuration *configuration){
-    if ( m_configurationMap.find(key) != m_configurationMap.end() ){
-        THROW_EXCEPTION(lv::Exception, "Configuration key already exists.", lv::Exception::toCode("~Key"));
-    }
+class SpareRecordHolder{
+public:
+    ~SpareRecordHolder(){ spareRecordDestroyed = true; }
+    VisualLog::AsyncWriter::Record record;
+};
 
-    m_configurations.push_back(configuration);
-    m_configurationMap[key] = configuration;
+} // namespace
 
-    return static_cast<int>(m_configurations.size());
+/**
+ * Returns the calling thread's record to fill in before pushing, or null if the thread is exiting.
+ * Pushing swaps it with a record the writer already consumed, so its strings keep their capacity.
+ */
+VisualLog::AsyncWriter::Record *VisualLog::AsyncWriter::spareRecord(){
+    if ( spareRecordDestroyed )
+        return nullptr;
+    thread_local SpareRecordHolder holder;
+    return &holder.record;
 }
 
-VisualLog::Configuration *VisualLog::ConfigurationContainer::globalConfiguration(){
-    return m_configurations.front();
+/**
+ * Writes out the next batch of queued records. Console output is collected for the batch, and the files
+ * written to are flushed after it.
+ */
+size_t VisualLog::AsyncWriter::Batch::drain(BatchWorker<Record> &worker){
+    console.clear();
+
+    // files are held until the end of the batch, the last record of a snapshot frees it
+    size_t count = 0;
+    while ( count < maximumBatch && worker.queue().tryPopSwap(record) ){
+        write(record);
+        record.location.reset();
+        record.snapshot.reset();
+        ++count;
+        if ( worker.isAbandoned() )
+            break;
+    }
+    if ( count == 0 )
+        return 0;
+
+    if ( !console.empty() )
+        vLoggerConsole(console);
+    for ( auto it = files.begin(); it != files.end(); ++it )
+        (*it)->flush();
+    for ( auto it = binaryFiles.begin(); it != binaryFiles.end(); ++it )
+        (*it)->flush();
+    files.clear();
+    binaryFiles.clear();
+
+    return count;
 }
 
-VisualLog::Configuration *VisualLog::ConfigurationContainer::configurationAt(const std::string &key){
-    auto it = m_configurationMap.find(key);
-    if ( it == m_configurationMap.end() )
-        return nullptr;
-    return it->second;
-}
+/**
+ * Writes \p current to the outputs of the snapshot it was logged with.
+ */
+void VisualLog::AsyncWriter::Batch::write(VisualLog::AsyncWriter::Record &current){
+    VisualLog::Configuration* configuration = current.configuration;
+    const VisualLog::ConfigurationSnapshot* snapshot = current.snapshot.get();
+
+    fieldText.clear();
+    if ( !current.fields.empty() ){
+        fieldText.push_back(' ');
+        current.fields.appendText(fieldText);
+    }
 
-VisualLog::Configuration *VisualLog::ConfigurationContainer::configurationAt(int index){
-    return m_configurations.at(index);
+    if ( current.output & VisualLog::Console ){
+        console.append(current.prefix);
+        console.append(current.message);
+        console.append(fieldText);
+        console.push_back('\n');
+    }
+    if ( current.output & VisualLog::File && snapshot->fileSink ){
+        const std::shared_ptr<VisualLog::ConfigurationSnapshot::FileSink>& file = snapshot->fileSink;
+        std::string_view segments[] = {current.prefix, current.message, fieldText, "\n"};
+        file->write(current.stamp, current.level, segments, 4);
+        if ( std::find(files.begin(), files.end(), file) == files.end() )
+            files.push_back(file);
+    }
+    if ( current.output & VisualLog::File && snapshot->binarySink ){
+        const std::shared_ptr<BinaryLogWriter>& binaryFile = snapshot->binarySink;
+        binaryFile->writeMessage(
+            current.stamp,
+            current.level,
+            configuration->m_name,
+            BinaryLogWriter::Location(current.remote, current.file, current.line, current.functionName),
+            current.message,
+            current.fields
+        );
+        if ( std::find(binaryFiles.begin(), binaryFiles.end(), binaryFile) == binaryFiles.end() )
+            binaryFiles.push_back(binaryFile);
+    }
+    if ( current.output & VisualLog::Extensions && !snapshot->transports.empty() ){
+        VisualLog::MessageInfo messageInfo(current.level);
+        messageInfo.m_remote       = current.remote;
+        messageInfo.m_file         = current.file;
+        messageInfo.m_functionName = current.functionName;
+        messageInfo.m_line         = current.line;
+        messageInfo.m_stamp        = current.stamp;
+        messageInfo.m_hasStamp     = true;
+        if ( !current.fields.empty() )
+            messageInfo.m_fields = current.fields;
+        for ( auto it = snapshot->transports.begin(); it != snapshot->transports.end(); ++it ){
+            (*it)->onMessage(configuration, messageInfo, current.message);
+        }
+    }
 }
 
-VisualLog::Configuration *VisualLog::ConfigurationContainer::configurationAtOrGlobal(const std::string &key){
-    auto it = m_configurationMap.find(key);
-    if ( it == m_configurationMap.end() )
-        return globalConfiguration();
-    return it->second;
-}
+// VisualLog::CallSite
+// ---------------------------------------------------------------------
 
-int VisualLog::ConfigurationContainer::configurationCount() const{
-    return static_cast<int>(m_configurations.size());
+void VisualLog::CallSite::resolve(){
+    unsigned int generation = VisualLog::m_configurationGeneration.load(std::memory_order_acquire);
+    VisualLog::Configuration* configuration = registeredConfigurations().configurationAtOrGlobal(m_configurationKey);
+    m_configuration.store(configuration, std::memory_order_relaxed);
+    m_applicationLevel.store(&configuration->m_applicationLevel, std::memory_order_relaxed);
+    m_generation.store(generation, std::memory_order_release);
 }
 
 // VisualLog
@@ -320,16 +2220,19 @@ VisualLog::ViewTransport* VisualLog::m_model = nullptr;
 
 bool VisualLog::m_globalConfigured = false;
 
+std::atomic<unsigned int> VisualLog::m_configurationGeneration(1);
+
 /**
  * \brief Default constructor of VisualLog
  */
 VisualLog::VisualLog()
     : m_configuration(registeredConfigurations().globalConfiguration())
-    , m_stream(new std::stringstream)
+    , m_stream(nullptr)
     , m_objectOutput(false)
+    , m_limitState(LimitUnchecked)
 {
-    m_messageInfo.m_level = m_configuration->m_defaultLevel;
     init();
+    m_messageInfo.m_level = m_snapshot->defaultLevel;
 }
 
 /**
@@ -338,8 +2241,22 @@ VisualLog::VisualLog()
 VisualLog::VisualLog(VisualLog::MessageInfo::Level level)
     : m_configuration(registeredConfigurations().globalConfiguration())
     , m_messageInfo(level)
-    , m_stream(new std::stringstream)
+    , m_stream(nullptr)
+    , m_objectOutput(false)
+    , m_limitState(LimitUnchecked)
+{
+    init();
+}
+
+/**
+ * \brief Constructor of VisualLog used by vlog_if, with the configuration already resolved by \p site
+ */
+VisualLog::VisualLog(VisualLog::CallSite &site, VisualLog::MessageInfo::Level level)
+    : m_configuration(site.configuration())
+    , m_messageInfo(level)
+    , m_stream(nullptr)
     , m_objectOutput(false)
+    , m_limitState(LimitUnchecked)
 {
     init();
 }
@@ -349,19 +2266,45 @@ VisualLog::VisualLog(VisualLog::MessageInfo::Level level)
 */
 VisualLog::VisualLog(const std::string &configurationKey)
     : m_configuration(registeredConfigurations().configurationAtOrGlobal(configurationKey))
-    , m_stream(new std::stringstream)
+    , m_stream(nullptr)
     , m_objectOutput(false)
+    , m_limitState(LimitUnchecked)
 {
-    m_messageInfo.m_level = m_configuration->m_defaultLevel;
     init();
+    m_messageInfo.m_level = m_snapshot->defaultLevel;
 }
 
 /** \brief Constructor of VisualLog with both configuration and level parameters */
 VisualLog::VisualLog(const std::string &configurationKey, VisualLog::MessageInfo::Level level)
     : m_configuration(registeredConfigurations().configurationAtOrGlobal(configurationKey))
     , m_messageInfo(level)
-    , m_stream(new std::stringstream)
+    , m_stream(nullptr)
+    , m_objectOutput(false)
+    , m_limitState(LimitUnchecked)
+{
+    init();
+}
+
+/**
+* \brief Constructor of VisualLog with configuration parameter, looked up without creating a string
+*/
+VisualLog::VisualLog(const char *configurationKey)
+    : m_configuration(registeredConfigurations().configurationAtOrGlobal(configurationKey))
+    , m_stream(nullptr)
+    , m_objectOutput(false)
+    , m_limitState(LimitUnchecked)
+{
+    init();
+    m_messageInfo.m_level = m_snapshot->defaultLevel;
+}
+
+/** \brief Constructor of VisualLog with both configuration and level parameters */
+VisualLog::VisualLog(const char *configurationKey, VisualLog::MessageInfo::Level level)
+    : m_configuration(registeredConfigurations().configurationAtOrGlobal(configurationKey))
+    , m_messageInfo(level)
+    , m_stream(nullptr)
     , m_objectOutput(false)
+    , m_limitState(LimitUnchecked)
 {
     init();
 }
@@ -369,37 +2312,67 @@ VisualLog::VisualLog(const std::string &configurationKey, VisualLog::MessageInfo
 /** \brief Destructor of VisualLog */
 VisualLog::~VisualLog(){
     flushLine();
-    delete m_stream;
+    releaseStream();
+    EpochReclaimer::instance().leave();
+}
+
+/**
+ * \brief Returns a free stream from the calling thread's pool, or a new one if none is available
+ */
+std::ostream *VisualLog::acquireStream(){
+    ThreadScratch* scratch = ThreadScratch::local();
+    if ( scratch ){
+        for ( auto it = scratch->streams.begin(); it != scratch->streams.end(); ++it ){
+            if ( !(*it)->inUse ){
+                (*it)->inUse = true;
+                return *it;
+            }
+        }
+        if ( scratch->streams.size() < maximumPooledStreams ){
+            MessageStream* stream = new MessageStream(true);
+            stream->inUse = true;
+            scratch->streams.push_back(stream);
+            return stream;
+        }
+    }
+    return new MessageStream(false);
+}
+
+/**
+ * \brief Gives the message stream back to the thread's pool, or frees it if it wasn't pooled
+ */
+void VisualLog::releaseStream(){
+    if ( !m_stream )
+        return;
+
+    MessageStream* stream = static_cast<MessageStream*>(m_stream);
+    m_stream = nullptr;
+    if ( stream->pooled && !threadScratchDestroyed ){
+        stream->reset();
+        stream->inUse = false;
+    } else {
+        delete stream;
+    }
+}
+
+/**
+ * \brief Returns the message written so far
+ */
+const std::string &VisualLog::message() const{
+    static const std::string empty;
+    return m_stream ? static_cast<MessageStream*>(m_stream)->text : empty;
 }
 
 /** Display enum value as string */
 std::string VisualLog::MessageInfo::levelToString(VisualLog::MessageInfo::Level level){
-    switch(level){
-    case VisualLog::MessageInfo::Level::Fatal: return "Fatal";
-    case VisualLog::MessageInfo::Level::Error: return "Error";
-    case VisualLog::MessageInfo::Level::Warning: return "Warning";
-    case VisualLog::MessageInfo::Level::Info: return "Info";
-    case VisualLog::MessageInfo::Level::Debug: return "Debug";
-    case VisualLog::MessageInfo::Level::Verbose: return "Verbose";
-    }
-    return std::string();
+    return std::string(levelName(level, false));
 }
 
 /** Return enum value from string */
 VisualLog::MessageInfo::Level VisualLog::MessageInfo::levelFromString(const std::string &str){
-    std::string strlow = asciiToLower(str);
-    if ( strlow == "fatal" ){
-        return VisualLog::MessageInfo::Level::Fatal;
-    } else if ( strlow == "error" ){
-        return VisualLog::MessageInfo::Level::Error;
-    } else if ( strlow == "warning" ){
-        return VisualLog::MessageInfo::Level::Warning;
-    } else if ( strlow == "info" ){
-        return VisualLog::MessageInfo::Level::Info;
-    } else if ( strlow == "debug" ){
-        return VisualLog::MessageInfo::Level::Debug;
-    } else if ( strlow == "verbose" ){
-        return VisualLog::MessageInfo::Level::Verbose;
+    for ( int i = 0; i < levelCount; ++i ){
+        if ( Utf8::compareAsciiNoCase(str.data(), str.size(), levelNamesLower[i], strlen(levelNamesLower[i])) == 0 )
+            return static_cast<VisualLog::MessageInfo::Level>(i);
     }
     return VisualLog::MessageInfo::Level::Info;
 }
@@ -408,10 +2381,10 @@ VisualLog::MessageInfo::Level VisualLog::MessageInfo::levelFromString(const std:
  * \brief Returns a prefix extracted from a given configuration object
  */
 std::string VisualLog::MessageInfo::prefix(const VisualLog::Configuration *configuration) const{
-    if ( !configuration->m_prefix.empty() ){
-        return expand(configuration->m_prefix);
-    }
-    return "";
+    SnapshotReadSection readSection;
+    std::string result;
+    configuration->snapshot()->prefixFormat.append(*this, result);
+    return result;
 }
 
 /**
@@ -432,17 +2405,16 @@ VisualLog::MessageInfo::Level VisualLog::MessageInfo::level() const{
 void VisualLog::configure(const std::string &configuration, const MLNode& options){
     m_output = 0;
 
-    VisualLog::Configuration* cfg = registeredConfigurations().configurationAt(configuration);
-    if ( !cfg ){
-        cfg = new VisualLog::Configuration(*registeredConfigurations().globalConfiguration());
-        cfg->m_name = configuration;
-        registeredConfigurations().addConfiguration(configuration, cfg);
-    }
-
+    VisualLog::Configuration* cfg = registeredConfigurations().configurationAtOrCreate(configuration);
     configure(cfg, options);
 }
 
-/** \brief Configure VisualLog given the configuration data and options */
+/**
+ * \brief Configure VisualLog given the configuration data and options
+ *
+ * The options are applied to a copy of the configuration, which replaces it once all options are read,
+ * so messages logged from other threads meanwhile see either the previous or the new configuration.
+ */
 void VisualLog::configure(VisualLog::Configuration *configuration, const MLNode &options){
     m_output = 0; // Disable output
 
@@ -450,70 +2422,190 @@ void VisualLog::configure(VisualLog::Configuration *configuration, const MLNode
         THROW_EXCEPTION(Exception, "Null configuration given", 0);
     }
 
-    if ( configuration->m_name == "global" ){
-        if ( m_globalConfigured ){
-            THROW_EXCEPTION(Exception, "Cannot reconfigure global configuration.", 0);
+    configuration->update([configuration, &options](VisualLog::ConfigurationSnapshot* snapshot){
+        if ( configuration->m_name == "global" ){
+            if ( m_globalConfigured ){
+                THROW_EXCEPTION(Exception, "Cannot reconfigure global configuration.", 0);
+            }
+            m_globalConfigured = true;
         }
-        m_globalConfigured = true;
-    }
 
-    for ( auto it = options.begin(); it != options.end(); ++it ){
-        if ( it.key() == "level" ){
-            if ( it.value().type() == MLNode::String ){
-                configuration->m_applicationLevel = VisualLog::MessageInfo::levelFromString(it.value().asString());
-            } else {
-                configuration->m_applicationLevel = static_cast<VisualLog::MessageInfo::Level>(it.value().asInt());
-            }
-        } else if ( it.key() == "defaultLevel" ){
-            if ( it.value().type() == MLNode::String ){
-                configuration->m_defaultLevel = VisualLog::MessageInfo::levelFromString(it.value().asString());
-            } else {
-                configuration->m_defaultLevel = static_cast<VisualLog::MessageInfo::Level>(it.value().asInt());
-            }
-        } else if ( it.key() == "file" ){
-            std::string v = it.value().asString();
-            if ( configuration->m_filePath != v ){
-                configuration->closeFile();
-                configuration->m_filePath = v;
-                if ( !configuration->m_filePath.empty() ){
-                    configuration->m_output = configuration->m_output | VisualLog::File;
+        bool fileChanged = false;
+        bool fileSettingsChanged = false;
+
+        for ( auto it = options.begin(); it != options.end(); ++it ){
+            if ( it.key() == "level" ){
+                if ( it.value().type() == MLNode::String ){
+                    snapshot->applicationLevel = VisualLog::MessageInfo::levelFromString(it.value().asString());
                 } else {
-                    configuration->m_output = removeOutputFlag(configuration->m_output, VisualLog::File);
+                    snapshot->applicationLevel = static_cast<VisualLog::MessageInfo::Level>(it.value().asInt());
                 }
-            }
-        } else if ( it.key() == "logDaily" ){
-            configuration->m_logDaily = it.value().asBool();
-        } else if ( it.key() == "toConsole" ){
-            bool toConsole = it.value().asBool();
-            if ( toConsole ){
-                configuration->m_output = configuration->m_output | VisualLog::Console;
-            } else {
-                configuration->m_output = removeOutputFlag(configuration->m_output, VisualLog::Console);
-            }
-        } else if ( it.key() == "toExtensions"){
-            bool toExtensions = it.value().asBool();
-            if ( toExtensions ){
-                configuration->m_output = configuration->m_output | VisualLog::Extensions;
+            } else if ( it.key() == "defaultLevel" ){
+                if ( it.value().type() == MLNode::String ){
+                    snapshot->defaultLevel = VisualLog::MessageInfo::levelFromString(it.value().asString());
+                } else {
+                    snapshot->defaultLevel = static_cast<VisualLog::MessageInfo::Level>(it.value().asInt());
+                }
+            } else if ( it.key() == "file" ){
+                std::string v = it.value().asString();
+                if ( snapshot->filePath != v ){
+                    fileChanged = true;
+                    snapshot->filePath = v;
+                }
+            } else if ( it.key() == "binaryFile" ){
+                std::string v = it.value().asString();
+                if ( snapshot->binaryFilePath != v ){
+                    snapshot->binaryFilePath = v;
+                    snapshot->binarySink = nullptr;
+                    if ( !v.empty() ){
+                        try{
+                            snapshot->binarySink = std::make_shared<BinaryLogWriter>(v);
+                        } catch ( lv::Exception& e ){
+                            VisualLog::internalMessageHandler()(
+                                VisualLog::MessageInfo::Error,
+                                Utf8("Failed to open binary log: %. Closing binary output.").format(e.message()).data()
+                            );
+                        }
+                    }
+                }
+            } else if ( it.key() == "logDaily" ){
+                bool logDaily = it.value().asBool();
+                if ( snapshot->logDaily != logDaily ){
+                    fileChanged = true;
+                    snapshot->logDaily = logDaily;
+                }
+            } else if ( it.key() == "maxFileSize" ){
+                snapshot->rotation.maxFileSize = it.value().asLargeInt();
+                fileSettingsChanged = true;
+            } else if ( it.key() == "rotateInterval" ){
+                snapshot->rotation.interval = it.value().asLargeInt();
+                fileSettingsChanged = true;
+            } else if ( it.key() == "maxFiles" ){
+                snapshot->rotation.maxFiles = it.value().asInt();
+                fileSettingsChanged = true;
+            } else if ( it.key() == "compress" ){
+                snapshot->rotation.compress = it.value().asBool();
+                fileSettingsChanged = true;
+#ifndef ENABLE_LOG_COMPRESSION
+                if ( snapshot->rotation.compress ){
+                    snapshot->rotation.compress = false;
+                    VisualLog::internalMessageHandler()(
+                        VisualLog::MessageInfo::Warning, "Log compression is not available in this build, rotated files are kept as they are."
+                    );
+                }
+#endif
+            } else if ( it.key() == "preallocate" ){
+                snapshot->rotation.preallocate = it.value().asBool();
+                fileSettingsChanged = true;
+            } else if ( it.key() == "fileBufferSize" ){
+                snapshot->buffering.bufferSize = static_cast<size_t>(std::max(it.value().asLargeInt(), MLNode::IntType(0)));
+                fileSettingsChanged = true;
+            } else if ( it.key() == "fileFlushInterval" ){
+                snapshot->buffering.flushInterval = it.value().asLargeInt();
+                fileSettingsChanged = true;
+            } else if ( it.key() == "fileFlushLevel" ){
+                if ( it.value().type() == MLNode::String ){
+                    snapshot->buffering.flushLevel = VisualLog::MessageInfo::levelFromString(it.value().asString());
+                } else {
+                    snapshot->buffering.flushLevel = it.value().asInt();
+                }
+                fileSettingsChanged = true;
+            } else if ( it.key() == "fileSyncInterval" ){
+                snapshot->buffering.syncInterval = it.value().asLargeInt();
+                fileSettingsChanged = true;
+            } else if ( it.key() == "rateLimit" ){
+                // messages per second, or an object with the rate and the burst
+                auto number = [](const MLNode& node){
+                    return node.type() == MLNode::Float ? node.asFloat() : static_cast<double>(node.asLargeInt());
+                };
+                if ( it.value().type() == MLNode::Object ){
+                    snapshot->callSiteLimit.rate  = number(it.value()["rate"]);
+                    snapshot->callSiteLimit.burst = it.value().hasKey("burst") ? number(it.value()["burst"]) : snapshot->callSiteLimit.rate;
+                } else {
+                    snapshot->callSiteLimit.rate  = number(it.value());
+                    snapshot->callSiteLimit.burst = snapshot->callSiteLimit.rate;
+                }
+            } else if ( it.key() == "sample" ){
+                snapshot->callSiteLimit.sample = it.value().asLargeInt();
+            } else if ( it.key() == "crashRing" ){
+                if ( it.value().type() == MLNode::Boolean ){
+                    snapshot->ringLevel = it.value().asBool() ? VisualLog::MessageInfo::Verbose : -1;
+                } else if ( it.value().type() == MLNode::String ){
+                    snapshot->ringLevel = VisualLog::MessageInfo::levelFromString(it.value().asString());
+                } else {
+                    snapshot->ringLevel = it.value().asInt();
+                }
+            } else if ( it.key() == "crashRingSize" ){
+                LogRing::instance().enable(static_cast<size_t>(it.value().asLargeInt()));
+            } else if ( it.key() == "crashDumpFile" ){
+                LogRing::instance().setDumpFile(it.value().asString());
+            } else if ( it.key() == "toConsole" ){
+                bool toConsole = it.value().asBool();
+                if ( toConsole ){
+                    snapshot->output = snapshot->output | VisualLog::Console;
+                } else {
+                    snapshot->output = removeOutputFlag(snapshot->output, VisualLog::Console);
+                }
+            } else if ( it.key() == "toExtensions"){
+                bool toExtensions = it.value().asBool();
+                if ( toExtensions ){
+                    snapshot->output = snapshot->output | VisualLog::Extensions;
+                } else {
+                    snapshot->output = removeOutputFlag(snapshot->output, VisualLog::Extensions);
+                }
+            } else if ( it.key() == "toView" ){
+                bool toView = it.value().asBool();
+                if ( toView ){
+                    snapshot->output = snapshot->output | VisualLog::View;
+                } else {
+                    snapshot->output = removeOutputFlag(snapshot->output, VisualLog::View);
+                }
+            } else if ( it.key() == "logObjects" ){
+                snapshot->logObjects = it.value().asInt();
+            } else if ( it.key() == "prefix" ){
+                snapshot->prefix = it.value().asString();
+                snapshot->prefixFormat = VisualLog::PrefixFormat::compile(snapshot->prefix);
             } else {
-                configuration->m_output = removeOutputFlag(configuration->m_output, VisualLog::Extensions);
+                VisualLog::internalMessageHandler()(
+                    VisualLog::MessageInfo::Warning, Utf8("Unknown configuration key: %.").format(it.key()).data()
+                );
             }
-        } else if ( it.key() == "toView" ){
-            bool toView = it.value().asBool();
-            if ( toView ){
-                configuration->m_output = configuration->m_output | VisualLog::View;
+        }
+
+        if ( !snapshot->filePath.empty() || snapshot->binarySink ){
+            snapshot->output = snapshot->output | VisualLog::File;
+        } else {
+            snapshot->output = removeOutputFlag(snapshot->output, VisualLog::File);
+        }
+
+        // after all options, so a crashRingSize option is not preceded by a ring of the default size
+        if ( snapshot->ringLevel >= 0 && !LogRing::instance().isEnabled() )
+            LogRing::instance().enable();
+
+        if ( fileChanged ){
+            // the previous sink is freed with the previous snapshot, its buffer has to go out before
+            // the new sink writes
+            if ( snapshot->fileSink )
+                snapshot->fileSink->flush();
+
+            if ( snapshot->filePath.empty() ){
+                snapshot->fileSink = nullptr;
             } else {
-                configuration->m_output = removeOutputFlag(configuration->m_output, VisualLog::View);
+                snapshot->fileSink = std::make_shared<VisualLog::ConfigurationSnapshot::FileSink>(
+                    snapshot->filePath, snapshot->logDaily, snapshot->rotation, snapshot->buffering
+                );
+                FileFlusher* flusher = FileFlusher::instance();
+                if ( flusher )
+                    flusher->add(snapshot->fileSink, snapshot->buffering);
             }
-        } else if ( it.key() == "logObjects" ){
-            configuration->m_logObjects = it.value().asInt();
-        } else if ( it.key() == "prefix" ){
-            configuration->m_prefix = it.value().asString();
-        } else {
-            VisualLog::internalMessageHandler()(
-                VisualLog::MessageInfo::Warning, Utf8("Unknown configuration key: %.").format(it.key()).data()
-            );
+        } else if ( fileSettingsChanged && snapshot->fileSink ){
+            // the sink is shared with the previous snapshot, so the open file and its buffer carry over
+            snapshot->fileSink->configure(snapshot->rotation, snapshot->buffering);
+            FileFlusher* flusher = FileFlusher::instance();
+            if ( flusher )
+                flusher->reschedule(snapshot->buffering);
         }
-    }
+    });
 
     //TODO: Requires parameter validation checking (e.g. log file / path exists)
 }
@@ -522,13 +2614,7 @@ void VisualLog::configure(VisualLog::Configuration *configuration, const MLNode
 void VisualLog::addTransport(const std::string &configuration, VisualLog::Transport *transport){
     m_output = 0; // Disable output
 
-    VisualLog::Configuration* cfg = registeredConfigurations().configurationAt(configuration);
-    if ( !cfg ){
-        cfg = new VisualLog::Configuration(*registeredConfigurations().globalConfiguration());
-        cfg->m_name = configuration;
-        registeredConfigurations().addConfiguration(configuration, cfg);
-    }
-
+    VisualLog::Configuration* cfg = registeredConfigurations().configurationAtOrCreate(configuration);
     addTransport(cfg, transport);
 }
 
@@ -536,7 +2622,10 @@ void VisualLog::addTransport(const std::string &configuration, VisualLog::Transp
 void VisualLog::addTransport(VisualLog::Configuration *configuration, VisualLog::Transport *transport){
     m_output = 0; // Disable output
 
-    configuration->m_transports.push_back(std::shared_ptr<VisualLog::Transport>(transport));
+    std::shared_ptr<VisualLog::Transport> transportPtr(transport);
+    configuration->update([&transportPtr](VisualLog::ConfigurationSnapshot* snapshot){
+        snapshot->transports.push_back(transportPtr);
+    });
 }
 
 /** \brief Removes transport given a predefined configuration */
@@ -552,7 +2641,9 @@ void VisualLog::removeTransports(const std::string &configuration){
 void VisualLog::removeTransports(VisualLog::Configuration *configuration){
     m_output = 0; // Disable output
 
-    configuration->m_transports.clear();
+    configuration->update([](VisualLog::ConfigurationSnapshot* snapshot){
+        snapshot->transports.clear();
+    });
 }
 
 /** \brief Returns total number of configurations */
@@ -562,22 +2653,127 @@ int VisualLog::totalConfigurations(){
     return registeredConfigurations().configurationCount();
 }
 
-/** \brief Flushes the entire buffer to preset outputs */
+/**
+ * \brief Flushes the entire buffer to preset outputs
+ *
+ * Messages within the configuration's crash ring level are copied to the lv::LogRing first. Messages
+ * less important than the application level are only kept there. Fatal messages dump the ring once
+ * they have been written.
+ */
 void VisualLog::flushLine(){
-    if ( canLog() ){
-        std::string pref = prefix();
-        std::string buffer = m_stream->str();
-        if ( m_output & VisualLog::Console )
-            vLoggerConsole(pref + buffer + "\n");
-        if ( m_output & VisualLog::File )
-            flushFile(pref + buffer + "\n");
+    if ( !canLog() )
+        return;
+
+    if ( static_cast<int>(m_messageInfo.m_level) <= m_snapshot->ringLevel ){
+        if ( m_messageInfo.m_fields.empty() ){
+            LogRing::instance().write(m_messageInfo.m_level, m_messageInfo.stamp(), m_configuration->m_name, message());
+        } else {
+            LineBuffer lineBuffer;
+            std::string& text = lineBuffer.str();
+            text.append(message());
+            text.push_back(' ');
+            m_messageInfo.m_fields.appendText(text);
+            LogRing::instance().write(m_messageInfo.m_level, m_messageInfo.stamp(), m_configuration->m_name, text);
+        }
+    }
+    if ( m_messageInfo.m_level <= m_snapshot->applicationLevel )
+        writeLine();
+    if ( m_messageInfo.m_level == VisualLog::MessageInfo::Fatal )
+        LogRing::instance().dump("Fatal message in " + m_configuration->m_name);
+}
+
+/**
+ * \brief Writes the message to the outputs
+ *
+ * In asynchronous mode, the prefix is expanded here and the message is queued for the writer thread,
+ * except for the view output, which is always delivered from the calling thread. Fatal messages wait
+ * for the queue to be written before returning.
+ */
+void VisualLog::writeLine(){
+    AsyncWriter* writer = AsyncWriter::current().load(std::memory_order_acquire);
+    int asyncOutput = m_output & (VisualLog::Console | VisualLog::File | VisualLog::Extensions);
+    if ( writer && asyncOutput && writer->enter() ){
+        // before filling in the spare record, which a logger nested in the view would reuse
         if ( m_output & VisualLog::View && m_model )
-            m_model->onMessage(m_configuration, m_messageInfo, buffer);
-        if ( m_output & VisualLog::Extensions )
-            flushHandler(buffer);
+            m_model->onMessage(m_configuration, m_messageInfo, message());
+
+        AsyncWriter::Record* spare = AsyncWriter::spareRecord();
+        AsyncWriter::Record local;
+        AsyncWriter::Record& record = spare ? *spare : local;
+
+        record.configuration = m_configuration;
+        record.snapshot.reset(m_snapshot);
+        record.output        = asyncOutput;
+        record.level         = m_messageInfo.m_level;
+        record.stamp         = m_messageInfo.stamp();
+        record.prefix.clear();
+        appendPrefix(record.prefix);
+        record.message.assign(message());
+        record.fields = m_messageInfo.m_fields;
+
+        record.location.reset(m_messageInfo.m_location);
+        record.remote            = m_messageInfo.m_remote;
+        record.file              = m_messageInfo.m_file;
+        record.functionName      = m_messageInfo.m_functionName;
+        record.line              = m_messageInfo.m_line;
+        m_messageInfo.m_location = nullptr;
+
+        writer->push(record);
+        writer->leave();
+        record.location.reset();
+        if ( m_messageInfo.m_level == VisualLog::MessageInfo::Fatal )
+            writer->flush();
+
+        return;
+    }
 
-        m_stream->clear();
+    const std::string& buffer = message();
+    bool toTextFile = (m_output & VisualLog::File) && m_snapshot->fileSink;
+    if ( m_output & VisualLog::Console ){
+        LineBuffer lineBuffer;
+        std::string& line = lineBuffer.str();
+        appendPrefix(line);
+        line.append(buffer);
+        if ( !m_messageInfo.m_fields.empty() ){
+            line.push_back(' ');
+            m_messageInfo.m_fields.appendText(line);
+        }
+        line.push_back('\n');
+
+        vLoggerConsole(line);
+        if ( toTextFile )
+            flushFile(line);
+    } else if ( toTextFile ){
+        // the file sink joins the prefix, the message and the fields, no need to build the line
+        LineBuffer lineBuffer;
+        std::string& text = lineBuffer.str();
+        appendPrefix(text);
+        size_t prefixSize = text.size();
+        if ( !m_messageInfo.m_fields.empty() ){
+            text.push_back(' ');
+            m_messageInfo.m_fields.appendText(text);
+        }
+
+        std::string_view prefix(text.data(), prefixSize);
+        std::string_view fields(text.data() + prefixSize, text.size() - prefixSize);
+        std::string_view segments[] = {prefix, buffer, fields, "\n"};
+        m_snapshot->fileSink->write(m_messageInfo.stamp(), m_messageInfo.m_level, segments, 4);
+    }
+    if ( m_output & VisualLog::File && m_snapshot->binarySink ){
+        m_snapshot->binarySink->writeMessage(
+            m_messageInfo.stamp(),
+            m_messageInfo.m_level,
+            m_configuration->m_name,
+            BinaryLogWriter::Location(m_messageInfo.m_remote, m_messageInfo.m_file, m_messageInfo.m_line, m_messageInfo.m_functionName),
+            buffer,
+            m_messageInfo.m_fields,
+            true
+        );
     }
+    if ( m_output & VisualLog::View && m_model )
+        m_model->onMessage(m_configuration, m_messageInfo, buffer);
+    if ( m_output & VisualLog::Extensions )
+        flushHandler(buffer);
 }
 
 /** \brief Closes the internal log file */
@@ -588,23 +2784,44 @@ void VisualLog::closeFile(){
 
 /** \brief Display MLNode as object of given type */
 void VisualLog::asObject(const std::string &type, const MLNode &mlvalue){
-    std::string str;
-    ml::toJson(mlvalue, str);
-    std::string pref = prefix();
-    std::string writeData =
-        pref + "\\@" + type + "\n" +
-        std::string(pref.length(), ' ') + str + "\n";
-
-    if ( m_output & VisualLog::Console && m_configuration->m_logObjects & VisualLog::Console ){
-        flushConsole(writeData);
-        m_output &= ~VisualLog::Console; // remove console flag from text based logging
+    if ( !canWrite() )
+        return;
+
+    bool toConsole = m_output & VisualLog::Console && m_snapshot->logObjects & VisualLog::Console;
+    bool toFile    = m_output & VisualLog::File && m_snapshot->logObjects & VisualLog::File;
+
+    if ( toConsole || (toFile && m_snapshot->fileSink) ){
+        std::string str;
+        ml::toJson(mlvalue, str);
+        std::string pref;
+        appendPrefix(pref);
+        std::string writeData =
+            pref + "\\@" + type + "\n" +
+            std::string(pref.length(), ' ') + str + "\n";
+
+        if ( toConsole )
+            flushConsole(writeData);
+        if ( toFile )
+            flushFile(writeData);
     }
-    if ( m_output & VisualLog::File && m_configuration->m_logObjects & VisualLog::File ){
-        flushFile(writeData);
+    if ( toConsole )
+        m_output &= ~VisualLog::Console; // remove console flag from text based logging
+    if ( toFile ){
+        if ( m_snapshot->binarySink ){
+            m_snapshot->binarySink->writeObject(
+                m_messageInfo.stamp(),
+                m_messageInfo.m_level,
+                m_configuration->m_name,
+                BinaryLogWriter::Location(m_messageInfo.m_remote, m_messageInfo.m_file, m_messageInfo.m_line, m_messageInfo.m_functionName),
+                type,
+                mlvalue,
+                true
+            );
+        }
         m_output &= ~VisualLog::File; // remove file flag from text based logging
     }
-    if ( m_output & VisualLog::Extensions && m_configuration->m_logObjects & VisualLog::Extensions){
-        for ( auto it = m_configuration->m_transports.begin(); it != m_configuration->m_transports.end(); ++it ){
+    if ( m_output & VisualLog::Extensions && m_snapshot->logObjects & VisualLog::Extensions){
+        for ( auto it = m_snapshot->transports.begin(); it != m_snapshot->transports.end(); ++it ){
             (*it)->onObject(m_configuration, m_messageInfo, type, mlvalue);
         }
     }
@@ -620,54 +2837,25 @@ void VisualLog::setViewTransport(VisualLog::ViewTransport *model){
     m_model = model;
 }
 
-/** Initialize the output from the configuration */
+/**
+ * Initialize the output from the configuration
+ *
+ * The snapshot of the configuration taken here stays valid until the destructor.
+ */
 void VisualLog::init(){
-    m_output = m_configuration->m_output;
+    EpochReclaimer::instance().enter();
+    m_snapshot = m_configuration->snapshot();
+    m_output = m_snapshot->output;
 }
 
 void VisualLog::flushFile(const std::string& data){
-    if ( m_configuration->m_logDaily ){
-        DateTime cdt = m_messageInfo.stamp();
-        if ( cdt.dayOfYear() != m_configuration->m_lastLog.dayOfYear() || m_configuration->m_logFile == nullptr ){
-            m_configuration->m_logFile = new std::ofstream;
-            m_configuration->m_logFilePath = cdt.format(m_configuration->m_filePath);
-            m_configuration->m_logFile->open(m_configuration->m_logFilePath, std::ios::out | std::ios::binary | std::ios::app );
-            if ( !m_configuration->m_logFile->is_open() ){
-                m_configuration->m_output = removeOutputFlag(m_configuration->m_output, VisualLog::File);
-                std::string fileName = m_configuration->m_logFilePath;
-                delete m_configuration->m_logFile;
-                m_configuration->m_logFile = nullptr;
-                m_configuration->m_logFilePath = "";
-                VisualLog::internalMessageHandler()(
-                    VisualLog::MessageInfo::Error, Utf8("Failed to open file: \'%\'. Closing file output stream.").format(fileName).data()
-                );
-                return;
-            }
-        }
-    } else if ( m_configuration->m_logFile == nullptr ){
-        m_configuration->m_logFile = new std::ofstream;
-        m_configuration->m_logFilePath = m_configuration->m_filePath;
-        m_configuration->m_logFile->open(m_configuration->m_logFilePath, std::ios::out | std::ios::binary | std::ios::app );
-        if ( !m_configuration->m_logFile->is_open() ){
-            m_configuration->m_output = removeOutputFlag(m_configuration->m_output, VisualLog::File);
-            std::string fileName = m_configuration->m_logFilePath;
-            delete m_configuration->m_logFile;
-            m_configuration->m_logFile = nullptr;
-            m_configuration->m_logFilePath = "";
-            VisualLog::internalMessageHandler()(
-                VisualLog::MessageInfo::Error, Utf8("Failed to open file: \'%\'. Closing file output stream.").format(fileName).data()
-            );
-            return;
-        }
-    }
-
-    m_configuration->m_logFile->write(data.c_str(), data.length());
-    m_configuration->m_logFile->flush();
+    if ( m_snapshot->fileSink )
+        m_snapshot->fileSink->write(m_messageInfo.stamp(), m_messageInfo.m_level, data);
 }
 
 void VisualLog::flushHandler(const std::string &data){
-    if ( !m_configuration->m_transports.empty() ){
-        for ( auto it = m_configuration->m_transports.begin(); it != m_configuration->m_transports.end(); ++it ){
+    if ( !m_snapshot->transports.empty() ){
+        for ( auto it = m_snapshot->transports.begin(); it != m_snapshot->transports.end(); ++it ){
             (*it)->onMessage(m_configuration, m_messageInfo, data);
         }
     }
@@ -683,68 +2871,111 @@ void VisualLog::setInternalMessageHandler(const VisualLog::MessageHandlerFunctio
         VisualLog::internalMessageHandler() = fn;
 }
 
-std::string VisualLog::MessageInfo::expand(const std::string &pattern) const{
+/**
+ * \brief Moves console, file and transport output to a dedicated writer thread
+ *
+ * Messages are expanded on the logging thread and pushed into a lock-free queue holding up to \p capacity
+ * messages, which the writer thread empties in batches, issuing a single console write and file flush per
+ * batch. The \p policy decides what happens when the queue is full. Messages are delivered to transports
+ * from the writer thread. View output and objects are still delivered synchronously.
+ *
+ * Starting while already asynchronous replaces the writer, after flushing the previous one.
+ */
+void VisualLog::startAsync(size_t capacity, VisualLog::OverflowPolicy policy){
+    static std::mutex asyncMutex;
+    std::lock_guard<std::mutex> guard(asyncMutex);
+
+    // joins the writer thread on exit, while the configurations are still alive
+    static class AsyncShutdown{
+    public:
+        ~AsyncShutdown(){ VisualLog::stopAsync(); }
+    } asyncShutdown;
+
+    AsyncWriter* writer = new AsyncWriter(capacity, policy);
+    AsyncWriter* previous = AsyncWriter::current().exchange(writer, std::memory_order_acq_rel);
+    if ( previous ){
+        previous->stop();
+        EpochReclaimer::instance().retire([previous](){ delete previous; });
+    }
+}
+
+/**
+ * \brief Writes all queued messages and returns to synchronous logging
+ *
+ * The writer is freed once no other thread can be using it anymore.
+ */
+void VisualLog::stopAsync(){
+    AsyncWriter* writer = AsyncWriter::current().exchange(nullptr, std::memory_order_acq_rel);
+    if ( writer ){
+        writer->stop();
+        EpochReclaimer::instance().retire([writer](){ delete writer; });
+    }
+}
 
-    std::stringstream base;
-    DateTime dt = stamp();
+/** \brief Shows if messages are currently written by a writer thread */
+bool VisualLog::isAsync(){
+    return AsyncWriter::current().load(std::memory_order_acquire) != nullptr;
+}
 
-    std::string::const_iterator it = pattern.begin();
-    while ( it != pattern.end() ){
-         if ( *it == '%' ){
-            ++it;
-            if ( it != pattern.end() ){
-                switch(*it){
-                case 'p': {
-                    if ( m_location && !m_location->remote.empty() )
-                        base << m_location->remote + "> ";
+/**
+ * \brief Waits until all messages queued so far are written
+ *
+ * Does nothing in synchronous mode.
+ */
+void VisualLog::flushAsync(){
+    SnapshotReadSection readSection;
+    AsyncWriter* writer = AsyncWriter::current().load(std::memory_order_acquire);
+    if ( writer )
+        writer->flush();
+}
 
-                    std::string levelToLower = asciiToLower(levelToString(m_level));
-                    base << dt.format("%Y-%m-%d %H:%M:%S.%i ") << levelToLower << " " << sourceFunctionName() << "@" << sourceLineNumber() << ": ";
-                    break;
-                }
-                case 'r': base << sourceRemoteLocation(); break;
-                case 'F': base << sourceFileName(); break;
-                case 'N': base << extractFileNameSegment(sourceFileName()); break;
-                case 'U': base << sourceFunctionName(); break;
-                case 'L': base << sourceLineNumber(); break;
-                case 'V': base << levelToString(m_level); break;
-                case 'v': base << asciiToLower(levelToString(m_level)); break;
-                case 'w':
-                case 'W':
-                case 'b':
-                case 'B':
-                case 'd':
-                case 'e':
-                case 'f':
-                case 'm':
-                case 'n':
-                case 'o':
-                case 'y':
-                case 'Y':
-                case 'H':
-                case 'I':
-                case 'a':
-                case 'A':
-                case 'M':
-                case 'S':
-                case 's':
-                case 'i':
-                case 'c':
-                    base << dt.formatSymbol(*it);
-                    break;
-                default: base << *it;
-                }
-            } else {
-                base << '%';
-                break;
-            }
-        } else {
-            base << *it;
-        }
-        ++it;
+/**
+ * \brief Writes out all messages logged so far
+ *
+ * Waits for queued messages when asynchronous, then writes the buffers of all log files. Files
+ * configured with a sync interval are also synced to disk.
+ */
+void VisualLog::flushAll(){
+    flushAsync();
+
+    ConfigurationContainer& configurations = registeredConfigurations();
+    int total = configurations.configurationCount();
+    for ( int i = 0; i < total; ++i ){
+        VisualLog::Configuration* configuration = configurations.configurationAt(i);
+        SnapshotReadSection readSection;
+        const ConfigurationSnapshot* snapshot = configuration->snapshot();
+        if ( snapshot->fileSink )
+            snapshot->fileSink->flush();
+        if ( snapshot->binarySink )
+            snapshot->binarySink->flush();
     }
+}
+
+/**
+ * \brief Writes out the buffers of the log files that are not in use, without waiting
+ *
+ * Meant for crash handlers, where the thread that crashed may be holding a file. Messages still in
+ * the asynchronous queue are skipped, and so are files locked by any thread.
+ */
+void VisualLog::tryFlushAll(){
+    ConfigurationContainer& configurations = registeredConfigurations();
+    int total = configurations.configurationCount();
+    for ( int i = 0; i < total; ++i ){
+        VisualLog::Configuration* configuration = configurations.configurationAt(i);
+        SnapshotReadSection readSection;
+        const ConfigurationSnapshot* snapshot = configuration->snapshot();
+        if ( snapshot->fileSink )
+            snapshot->fileSink->tryFlush();
+        if ( snapshot->binarySink )
+            snapshot->binarySink->tryFlush();
+    }
+}
 
-    return base.str();
+/** \brief Returns the number of messages discarded by the current writer because its queue was full */
+size_t VisualLog::droppedMessages(){
+    SnapshotReadSection readSection;
+    AsyncWriter* writer = AsyncWriter::current().load(std::memory_order_acquire);
+    return writer ? writer->dropped() : 0;
 }
 
 int VisualLog::removeOutputFlag(int flags, VisualLog::Output output){
@@ -756,18 +2987,84 @@ int VisualLog::removeOutputFlag(int flags, VisualLog::Output output){
 
 /** \brief Shows if logging is enabled */
 bool VisualLog::canLog(){
-    return m_messageInfo.m_level <= m_configuration->m_applicationLevel;
+    if ( m_messageInfo.m_level > m_snapshot->captureLevel )
+        return false;
+    if ( m_limitState == LimitUnchecked )
+        m_limitState = applyCallSiteLimit();
+    return m_limitState == LimitPassed;
+}
+
+/**
+ * \brief Shows if the message is written to the outputs, and not only kept in the lv::LogRing
+ */
+bool VisualLog::canWrite(){
+    return m_messageInfo.m_level <= m_snapshot->applicationLevel && canLog();
 }
 
-std::string VisualLog::prefix(){
-    if ( !m_configuration->m_prefix.empty() ){
-        return m_messageInfo.expand(m_configuration->m_prefix);
+/**
+ * \brief Applies the rate limit and sampling of the configuration to this message's call site
+ *
+ * Call sites are only known for locations given as literals through the vlog macros, other messages
+ * and Fatal messages are never limited. Sampling counts the messages of the call site from all threads.
+ * A message that passes after others from the same call site were dropped is preceded by a summary of
+ * them, at most once a second. Drops on other threads are counted in batches, so they may show in a
+ * later summary.
+ */
+VisualLog::LimitState VisualLog::applyCallSiteLimit(){
+    const ConfigurationSnapshot::CallSiteLimit& limit = m_snapshot->callSiteLimit;
+    if ( !limit.isEnabled() || m_messageInfo.m_location || m_messageInfo.m_file.empty() || m_messageInfo.m_level == MessageInfo::Fatal )
+        return LimitPassed;
+
+    CallSiteRegistry::Entry& entry = CallSiteRegistry::entry(m_configuration, m_messageInfo.m_file.data(), m_messageInfo.m_line);
+    CallSiteState* site = entry.site;
+
+    if ( limit.sample > 1 && site->sampled.fetch_add(1, std::memory_order_relaxed) % static_cast<unsigned long long>(limit.sample) != 0 ){
+        entry.addSuppressed();
+        return LimitSuppressed;
     }
-    return "";
+
+    long long now = steadyMicroseconds();
+    if ( limit.rate > 0 ){
+        // generic cell rate algorithm, a token bucket kept in a single timestamp
+        long long interval  = std::max(static_cast<long long>(1000000.0 / limit.rate), 1LL);
+        long long tolerance = static_cast<long long>(interval * (std::max(limit.burst, 1.0) - 1));
+        long long arrival   = site->arrival.load(std::memory_order_relaxed);
+        while ( true ){
+            long long next = std::max(arrival, now);
+            if ( next - now > tolerance ){
+                entry.addSuppressed();
+                return LimitSuppressed;
+            }
+            if ( site->arrival.compare_exchange_weak(arrival, next + interval, std::memory_order_relaxed) )
+                break;
+        }
+    }
+
+    entry.flushSuppressed();
+    if ( site->suppressed.load(std::memory_order_relaxed) > 0 ){
+        long long lastSummary = site->lastSummary.load(std::memory_order_relaxed);
+        if ( (lastSummary == 0 || now - lastSummary >= callSiteSummaryInterval) &&
+             site->lastSummary.compare_exchange_strong(lastSummary, now, std::memory_order_relaxed) )
+        {
+            unsigned long long suppressed = site->suppressed.exchange(0, std::memory_order_relaxed);
+            if ( suppressed > 0 ){
+                VisualLog(m_configuration->m_name, m_messageInfo.m_level)
+                    << "Suppressed " << suppressed << " messages from "
+                    << m_messageInfo.m_file << ":" << m_messageInfo.m_line;
+            }
+        }
+    }
+
+    return LimitPassed;
+}
+
+void VisualLog::appendPrefix(std::string &result){
+    m_snapshot->prefixFormat.append(m_messageInfo, result);
 }
 
 bool VisualLog::canLogObjects(VisualLog::Configuration *configuration){
-    return configuration->m_logObjects != 0;
+    SnapshotReadSection readSection;
+    return configuration->snapshot()->logObjects != 0;
 }
 
 /**
@@ -781,33 +3078,39 @@ bool VisualLog::canLogObjects(VisualLog::Configuration *configuration){
 /**
  * \brief MessageInfo desctructor
  *
- * Deletes location and stamp pointers.
+ * Deletes the location, if it was not given as literals.
  */
 VisualLog::MessageInfo::~MessageInfo(){
     delete m_location;
-    delete m_stamp;
+}
+
+/**
+ * \brief Returns the typed fields attached to the message through VisualLog::field()
+ */
+const VisualLog::Fields &VisualLog::MessageInfo::fields() const{
+    return m_fields;
 }
 
 VisualLog::MessageInfo::MessageInfo()
     : m_level(MessageInfo::Info)
     , m_location(nullptr)
-    , m_stamp(nullptr)
+    , m_line(0)
+    , m_hasStamp(false)
 {
 }
 
 VisualLog::MessageInfo::MessageInfo(VisualLog::MessageInfo::Level level)
     : m_level(level)
     , m_location(nullptr)
-    , m_stamp(nullptr)
+    , m_line(0)
+    , m_hasStamp(false)
 {
 }
 
 /** \brief Overrides the previous timestamp with the given one */
 VisualLog &lv::VisualLog::overrideStamp(const DateTime &stamp){
-    if ( !m_messageInfo.m_stamp )
-        m_messageInfo.m_stamp = new DateTime(stamp);
-    else
-        *m_messageInfo.m_stamp = stamp;
+    m_messageInfo.m_stamp = stamp;
+    m_messageInfo.m_hasStamp = true;
     return *this;
 }
 
@@ -817,10 +3120,11 @@ VisualLog &lv::VisualLog::overrideStamp(const DateTime &stamp){
  * If there's none, it takes the current time and sets it as the stamp.
  */
 const DateTime &lv::VisualLog::MessageInfo::stamp() const{
-    if ( !m_stamp ){
-        m_stamp = new DateTime(DateTime().toLocal());
+    if ( !m_hasStamp ){
+        m_stamp = DateTime().toLocal();
+        m_hasStamp = true;
     }
-    return *m_stamp;
+    return m_stamp;
 }
 
 }// namespace
@@ -20,19 +20,31 @@
 #include <sstream>
 #include <ostream>
 #include <functional>
+#include <atomic>
+#include <string_view>
+#include <string>
+#include <vector>
+#include <type_traits>
 
 #include "live/mlnode.h"
+#include "live/datetime.h"
 
 namespace lv{
 
 class Utf8;
-class DateTime;
+class AsyncTransport;
+class AsyncTransportDelivery;
+
+namespace detail{ struct VisualLogMacroAccess; }
 
 class LV_BASE_EXPORT VisualLog{
 
 public:
     class Configuration;
+    class ConfigurationSnapshot;
     class ConfigurationContainer;
+    class PrefixFormat;
+    class AsyncWriter;
 
     typedef std::function<void(int, const std::string&)> MessageHandlerFunction;
 
@@ -50,6 +62,16 @@ public:
         Extensions = 16
     };
 
+    /** What asynchronous logging does with a message when the queue is full */
+    enum OverflowPolicy{
+        /** Wait until the writer thread makes room */
+        Block = 0,
+        /** Discard the new message */
+        DropNewest,
+        /** Discard the oldest queued message */
+        DropOldest
+    };
+
     /**
       \class lv::VisualLog::SourceLocation
       \brief Simple structure containing relevant data about a location of the source
@@ -74,6 +96,124 @@ public:
         std::string functionName;
     };
 
+    class Fields;
+
+    /**
+     * \class lv::VisualLog::Field
+     * \brief Typed key and value attached to a message, viewing the storage of its Fields
+     *
+     * \ingroup lvbase
+     */
+    class LV_BASE_EXPORT Field{
+
+    public:
+        /** Type of the value */
+        enum Type{
+            /** bool */
+            Boolean = 0,
+            /** Signed integer */
+            Integer,
+            /** Floating point number */
+            Float,
+            /** Text */
+            String
+        };
+
+        friend class Fields;
+
+    public:
+        /** Type of the value */
+        Type type() const{ return m_type; }
+        /** Key of the field */
+        std::string_view key() const{ return m_key; }
+        /** Value of a Boolean field */
+        bool asBool() const{ return m_value.boolean; }
+        /** Value of an Integer field */
+        long long asInt() const{ return m_value.integer; }
+        /** Value of a Float field */
+        double asFloat() const{ return m_value.number; }
+        /** Value of a String field */
+        std::string_view asString() const{ return m_text; }
+
+        void appendValue(std::string& result) const;
+
+    private:
+        union Value{
+            bool      boolean;
+            long long integer;
+            double    number;
+        };
+
+        Field(Type type, std::string_view key, Value value, std::string_view text)
+            : m_type(type), m_key(key), m_value(value), m_text(text){}
+
+        Type             m_type;
+        std::string_view m_key;
+        Value            m_value;
+        std::string_view m_text;
+    };
+
+    /**
+     * \class lv::VisualLog::Fields
+     * \brief Typed key value pairs of a message, stored inline
+     *
+     * Up to inlineSize fields, with keys and strings taking up to inlineTextSize bytes together, are kept
+     * within the object, so attaching them to a message does not allocate.
+     *
+     * \ingroup lvbase
+     */
+    class LV_BASE_EXPORT Fields{
+
+    public:
+        /** Number of fields stored without allocating */
+        static const size_t inlineSize = 8;
+        /** Bytes of keys and strings stored without allocating */
+        static const size_t inlineTextSize = 128;
+
+    public:
+        Fields() : m_size(0), m_textSize(0){}
+        Fields(const Fields& other);
+        Fields& operator = (const Fields& other);
+
+        /** Number of fields */
+        size_t size() const{ return m_size; }
+        /** Shows if there are no fields */
+        bool empty() const{ return m_size == 0; }
+        Field at(size_t index) const;
+        /** Returns the field at \p index */
+        Field operator[](size_t index) const{ return at(index); }
+
+        void addBoolean(std::string_view key, bool value);
+        void addInteger(std::string_view key, long long value);
+        void addFloat(std::string_view key, double value);
+        void addString(std::string_view key, std::string_view value);
+        void clear();
+
+        void appendText(std::string& result) const;
+
+    private:
+        class Entry{
+        public:
+            Field::Type  type;
+            Field::Value value;
+            unsigned int keyOffset;
+            unsigned int keySize;
+            unsigned int textOffset;
+            unsigned int textSize;
+        };
+
+        Entry& append(Field::Type type, std::string_view key);
+        unsigned int storeText(std::string_view text);
+        std::string_view textAt(unsigned int offset, unsigned int size) const;
+
+        size_t             m_size;
+        Entry              m_inline[inlineSize];
+        std::vector<Entry> m_overflow;
+        size_t             m_textSize;
+        char               m_inlineText[inlineTextSize];
+        std::string        m_overflowText;
+    };
+
     class LV_BASE_EXPORT MessageInfo{
 
     public:
@@ -90,6 +230,8 @@ public:
         };
 
         friend class VisualLog;
+        friend class AsyncTransport;
+        friend class AsyncTransportDelivery;
 
     public:
         ~MessageInfo();
@@ -105,6 +247,7 @@ public:
         std::string prefix(const VisualLog::Configuration* configuration) const;
         std::string tag(const VisualLog::Configuration* configuration) const;
         Level       level() const;
+        const Fields& fields() const;
 
     private:
         MessageInfo();
@@ -112,11 +255,18 @@ public:
         MessageInfo(const MessageInfo&);
         MessageInfo& operator = (const MessageInfo&);
 
-        std::string expand(const std::string& pattern) const;
+        void setLocation(SourceLocation* location);
+        void setLocation(const char* file, int line, const char* functionName);
 
         Level            m_level;
-        SourceLocation*  m_location;
-        mutable DateTime* m_stamp;
+        SourceLocation*  m_location; // owns the strings of locations not given as literals
+        std::string_view m_remote;
+        std::string_view m_file;
+        std::string_view m_functionName;
+        int              m_line;
+        mutable DateTime m_stamp;
+        mutable bool     m_hasStamp;
+        Fields           m_fields;
     };
 
     /**
@@ -169,13 +319,48 @@ public:
         ) = 0;
     };
 
+    /**
+     * \class lv::VisualLog::CallSite
+     * \brief Caches the configuration and level of a vlog_if call site
+     *
+     * Resolves the configuration key once, and again only after new configurations are registered, so
+     * checking whether a message is enabled costs a few relaxed loads and a compare.
+     *
+     * \ingroup lvbase
+     */
+    class LV_BASE_EXPORT CallSite{
+
+    public:
+        constexpr CallSite(const char* configuration)
+            : m_configurationKey(configuration)
+            , m_configuration(nullptr)
+            , m_applicationLevel(nullptr)
+            , m_generation(0)
+        {}
+
+        bool isEnabled(MessageInfo::Level level);
+        Configuration* configuration() const{ return m_configuration.load(std::memory_order_relaxed); }
+
+    private:
+        void resolve();
+
+        const char*                          m_configurationKey;
+        std::atomic<Configuration*>          m_configuration;
+        std::atomic<const std::atomic<int>*> m_applicationLevel;
+        std::atomic<unsigned int>            m_generation;
+    };
+
 public:
     VisualLog();
     VisualLog(MessageInfo::Level level);
+    VisualLog(CallSite& site, MessageInfo::Level level);
     VisualLog(const std::string& configuration);
     VisualLog(const std::string& configuration, MessageInfo::Level level);
+    VisualLog(const char* configuration);
+    VisualLog(const char* configuration, MessageInfo::Level level);
     ~VisualLog();
 
+    VisualLog& at(const char* file, int line, const char* functionName);
     VisualLog& at(const std::string& file, int line = 0, const std::string& functionName = "");
     VisualLog& at(const std::string& remote, const std::string& file, int line = 0, const std::string& functionName = "");
     VisualLog& overrideStamp(const DateTime &stamp);
@@ -185,6 +370,8 @@ public:
     template<typename T> VisualLog& operator <<( std::ostream& (*f)(std::ios&) );
     template<typename T> VisualLog& operator <<( std::ostream (*f)(std::ios_base& ) );
 
+    template<typename T> VisualLog& field(std::string_view key, const T& value);
+
     VisualLog& f();
     VisualLog& e();
     VisualLog& w();
@@ -223,20 +410,46 @@ public:
     static void flushConsole(const std::string& data);
     static void setInternalMessageHandler(const MessageHandlerFunction& fn);
 
+    static void startAsync(size_t capacity = 8192, OverflowPolicy policy = Block);
+    static void stopAsync();
+    static bool isAsync();
+    static void flushAsync();
+    static void flushAll();
+    static void tryFlushAll();
+    static size_t droppedMessages();
+
 private:
+    enum LimitState{
+        LimitUnchecked = 0,
+        LimitPassed,
+        LimitSuppressed
+    };
+
     DISABLE_COPY(VisualLog);
 
+    friend struct detail::VisualLogMacroAccess;
+
+    template<size_t F, size_t N> VisualLog& atLiteral(const char (&file)[F], int line, const char (&functionName)[N]);
+
     void init();
+    bool canWrite();
+    LimitState applyCallSiteLimit();
+    void writeLine();
+    std::ostream& stream();
+    void releaseStream();
+    const std::string& message() const;
     void flushFile(const std::string &data);
     void flushHandler(const std::string& data);
-    std::string prefix();
+    void appendPrefix(std::string& result);
     bool canLogObjects(VisualLog::Configuration* configuration);
 
     template<typename T> void object(MessageInfo::Level level, const T& value);
 
     static int removeOutputFlag(int flags, VisualLog::Output output);
 
-    static ConfigurationContainer createDefaultConfigurations();
+    static std::ostream* acquireStream();
+
+    static ConfigurationContainer* createDefaultConfigurations();
     static ConfigurationContainer& registeredConfigurations();
     static MessageHandlerFunction& internalMessageHandler();
     static void defaultInternalMessageHandler(int, const std::string& message);
@@ -244,12 +457,15 @@ private:
     static ViewTransport* m_model;
 
     static bool m_globalConfigured;
+    static std::atomic<unsigned int> m_configurationGeneration;
 
-    int                m_output;
-    Configuration*     m_configuration;
-    MessageInfo        m_messageInfo;
-    std::stringstream* m_stream;
-    bool               m_objectOutput;
+    int                          m_output;
+    Configuration*               m_configuration;
+    const ConfigurationSnapshot* m_snapshot;
+    MessageInfo                  m_messageInfo;
+    std::ostream*                m_stream;
+    bool                         m_objectOutput;
+    LimitState                   m_limitState;
 
 };
 
@@ -275,6 +491,18 @@ inline VisualLog::SourceLocation::SourceLocation(
 {
 }
 
+// VisualLog::CallSite
+// ---------------------------------------------------------------------
+
+/**
+ * \brief Shows if messages of the given \p level are logged by this call site's configuration
+ */
+inline bool VisualLog::CallSite::isEnabled(VisualLog::MessageInfo::Level level){
+    if ( m_generation.load(std::memory_order_acquire) != VisualLog::m_configurationGeneration.load(std::memory_order_relaxed) )
+        resolve();
+    return static_cast<int>(level) <= m_applicationLevel.load(std::memory_order_relaxed)->load(std::memory_order_relaxed);
+}
+
 // VisualLog
 // ---------------------------------------------------------------------
 
@@ -294,7 +522,7 @@ template<typename T> void VisualLog::object(VisualLog::MessageInfo::Level level,
 template<typename LogBehavior, typename T>
 VisualLog &VisualLog::behavior(const T &value){
     // as object
-    if ( canLog() && m_objectOutput && canLogObjects(m_configuration) ){
+    if ( canWrite() && m_objectOutput && canLogObjects(m_configuration) ){
         if ( LogBehavior::hasTransport() ){
             MLNode mlvalue;
             LogBehavior::toTransport(value, mlvalue);
@@ -303,7 +531,7 @@ VisualLog &VisualLog::behavior(const T &value){
         }
     }
     // as view
-    if ( canLog() && m_objectOutput && (m_output & VisualLog::View) ){
+    if ( canWrite() && m_objectOutput && (m_output & VisualLog::View) ){
         if ( LogBehavior::hasViewObject() ){
             VisualLog::ViewObject* vo = LogBehavior::toView(value);
             std::string viewDelegate = LogBehavior::defaultViewDelegate(value);
@@ -379,44 +607,111 @@ inline VisualLog &VisualLog::v(){
     return *this;
 }
 
+/** \brief Returns the message stream, taken from the thread's reusable streams on first use */
+inline std::ostream &VisualLog::stream(){
+    if ( !m_stream )
+        m_stream = acquireStream();
+    return *m_stream;
+}
+
+/** \brief Sets the message info location */
+inline VisualLog &VisualLog::at(const char *file, int line, const char *functionName){
+    m_messageInfo.setLocation(new VisualLog::SourceLocation(file ? file : "", line, functionName ? functionName : ""));
+    return *this;
+}
+
+/**
+ * \brief Sets the message info location from \c __FILE__ and \c __FUNCTION__
+ *
+ * Only reachable from the vlog macros. The strings are referenced, not copied, so they need static
+ * storage: in asynchronous mode the message is written after this logger is destroyed.
+ */
+template<size_t F, size_t N>
+inline VisualLog &VisualLog::atLiteral(const char (&file)[F], int line, const char (&functionName)[N]){
+    m_messageInfo.setLocation(file, line, functionName);
+    return *this;
+}
+
 /** \brief Sets the message info location */
 inline VisualLog &VisualLog::at(const std::string &file, int line, const std::string &functionName){
-    m_messageInfo.m_location = new VisualLog::SourceLocation(file, line, functionName);
+    m_messageInfo.setLocation(new VisualLog::SourceLocation(file, line, functionName));
     return *this;
 }
 
 /** \brief Sets the message info location with remote included */
 inline VisualLog &VisualLog::at(const std::string &remote, const std::string &file, int line, const std::string &functionName){
-    m_messageInfo.m_location = new VisualLog::SourceLocation(remote, file, line, functionName);
+    m_messageInfo.setLocation(new VisualLog::SourceLocation(remote, file, line, functionName));
     return *this;
 }
 
+inline void VisualLog::MessageInfo::setLocation(VisualLog::SourceLocation *location){
+    delete m_location;
+    m_location     = location;
+    m_remote       = location->remote;
+    m_file         = location->file;
+    m_functionName = location->functionName;
+    m_line         = location->line;
+}
+
+inline void VisualLog::MessageInfo::setLocation(const char *file, int line, const char *functionName){
+    delete m_location;
+    m_location     = nullptr;
+    m_remote       = std::string_view();
+    m_file         = file ? std::string_view(file) : std::string_view();
+    m_functionName = functionName ? std::string_view(functionName) : std::string_view();
+    m_line         = line;
+}
+
 /**
  * \brief Returns a remote location, if it exists
  */
 inline std::string VisualLog::MessageInfo::sourceRemoteLocation() const{
-    return m_location ? m_location->remote : "";
+    return std::string(m_remote);
 }
 
 /**
  * \brief Returns the file name of the source, if it exists
  */
 inline std::string VisualLog::MessageInfo::sourceFileName() const{
-    return m_location ? m_location->file : "";
+    return std::string(m_file);
 }
 
 /**
  * \brief Returns the line number, if it has been set
  */
 inline int VisualLog::MessageInfo::sourceLineNumber() const{
-    return m_location ? m_location->line : 0;
+    return m_line;
 }
 
 /**
  * \brief Returns the name of the source function, if it has been set
  */
 inline std::string VisualLog::MessageInfo::sourceFunctionName() const{
-    return m_location ? m_location->functionName : "";
+    return std::string(m_functionName);
+}
+
+/**
+ * \brief Attaches a typed field to the message
+ *
+ * Booleans, integers, floating point numbers and strings are stored as they are, without going through
+ * the message text. Text outputs write fields after the message as `key=value`, binary logs keep their
+ * types, and transports read them through MessageInfo::fields().
+ */
+template<typename T> VisualLog& VisualLog::field(std::string_view key, const T& value){
+    if ( !canLog() )
+        return *this;
+
+    if constexpr ( std::is_same<T, bool>::value ){
+        m_messageInfo.m_fields.addBoolean(key, value);
+    } else if constexpr ( std::is_integral<T>::value ){
+        m_messageInfo.m_fields.addInteger(key, static_cast<long long>(value));
+    } else if constexpr ( std::is_floating_point<T>::value ){
+        m_messageInfo.m_fields.addFloat(key, static_cast<double>(value));
+    } else {
+        static_assert(std::is_convertible<const T&, std::string_view>::value, "Fields can be booleans, numbers or strings.");
+        m_messageInfo.m_fields.addString(key, std::string_view(value));
+    }
+    return *this;
 }
 
 /** \brief Stream insertion operator */
@@ -424,7 +719,7 @@ template<typename T> VisualLog& VisualLog::operator<< (const T& x){
     if ( !canLog() )
         return *this;
 
-    *m_stream << x;
+    stream() << x;
 
     return *this;
 }
@@ -436,7 +731,7 @@ template<typename T> VisualLog& VisualLog::operator<< (std::ostream &(*f)(std::o
 
     std::stringstream ss;
     f(ss);
-    *m_stream << ss.str().c_str();
+    stream() << ss.str().c_str();
 
     return *this;
 }
@@ -448,7 +743,7 @@ template<typename T> VisualLog& VisualLog::operator<< ( std::ostream& (*f)(std::
 
     std::stringstream ss;
     f(ss);
-    *m_stream << ss.str().c_str();
+    stream() << ss.str().c_str();
 
     return *this;
 }
@@ -460,22 +755,51 @@ template<typename T> VisualLog& VisualLog::operator<< ( std::ostream (*f)(std::i
 
     std::stringstream ss;
     f(ss);
-    *m_stream << ss.str().c_str();
+    stream() << ss.str().c_str();
 
     return *this;
 }
 
+namespace detail{
+
+/** \brief Gives the vlog macros access to VisualLog::atLiteral(), not meant to be used directly */
+struct VisualLogMacroAccess{
+    template<size_t F, size_t N>
+    static VisualLog& at(VisualLog&& log, const char (&file)[F], int line, const char (&functionName)[N]){
+        return log.atLiteral(file, line, functionName);
+    }
+};
+
+}// namespace detail
+
 }// namespace
 
 #ifndef VLOG_NO_MACROS
 
 #ifndef vlog
-#define vlog(...) lv::VisualLog(__VA_ARGS__).at(__FILE__, __LINE__, __FUNCTION__)
+#define vlog(...) lv::detail::VisualLogMacroAccess::at(lv::VisualLog(__VA_ARGS__), __FILE__, __LINE__, __FUNCTION__)
 #endif // vlog
 
+#ifndef VLOG_MINIMUM_LEVEL
+#define VLOG_MINIMUM_LEVEL 5
+#endif // VLOG_MINIMUM_LEVEL
+
+#ifndef vlog_if
+#define vlog_if(_configuration, _level) \
+    for ( lv::VisualLog::CallSite* _vlogSite = ((_level) <= VLOG_MINIMUM_LEVEL) \
+            ? [](lv::VisualLog::MessageInfo::Level _vlogLevel) -> lv::VisualLog::CallSite* { \
+                static lv::VisualLog::CallSite site(_configuration); \
+                return site.isEnabled(_vlogLevel) ? &site : nullptr; \
+            }(_level) \
+            : nullptr; \
+          _vlogSite; _vlogSite = nullptr ) \
+        lv::detail::VisualLogMacroAccess::at(lv::VisualLog(*_vlogSite, _level), __FILE__, __LINE__, __FUNCTION__)
+#endif // vlog_if
+
 #ifndef vlog_debug
 #ifdef VLOG_DEBUG_BUILD
-#define vlog_debug(_configuration, _message) lv::VisualLog(_configuration).at(__FILE__, __LINE__, __FUNCTION__).v() << (_message)
+#define vlog_debug(_configuration, _message) \
+    lv::detail::VisualLogMacroAccess::at(lv::VisualLog(_configuration), __FILE__, __LINE__, __FUNCTION__).v() << (_message)
 #else
 #define vlog_debug(_configuration, _message)
 #endif // VLOG_DEBUG_BUILD
@@ -0,0 +1,256 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+
+#include "catch_library.h"
+#include "live/asynctransport.h"
+#include "live/visuallog.h"
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+using namespace lv;
+
+namespace{
+
+class AsyncTransportCollector : public AsyncTransport::BatchHandler{
+
+public:
+    AsyncTransportCollector() : open(true), entered(false){}
+
+    void onBatch(const std::vector<AsyncTransport::Record>& records) override{
+        std::unique_lock<std::mutex> lock(mutex);
+        entered = true;
+        changed.notify_all();
+        changed.wait(lock, [this](){ return open; });
+        for ( auto it = records.begin(); it != records.end(); ++it )
+            received.push_back(*it);
+        ++batches;
+    }
+
+    void close(){
+        std::lock_guard<std::mutex> lock(mutex);
+        open = false;
+        entered = false;
+    }
+    void waitForEntry(){
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this](){ return entered; });
+    }
+    void release(){
+        std::lock_guard<std::mutex> lock(mutex);
+        open = true;
+        changed.notify_all();
+    }
+
+    std::mutex                          mutex;
+    std::condition_variable             changed;
+    bool                                open;
+    bool                                entered;
+    int                                 batches = 0;
+    std::vector<AsyncTransport::Record> received;
+};
+
+class AsyncTransportTarget : public VisualLog::Transport{
+
+public:
+    void onMessage(const VisualLog::Configuration*, const VisualLog::MessageInfo& messageInfo, const std::string& message) override{
+        messages.push_back(message);
+        lines.push_back(messageInfo.sourceLineNumber());
+        threads.push_back(std::this_thread::get_id());
+    }
+    void onObject(const VisualLog::Configuration*, const VisualLog::MessageInfo&, const std::string& type, const MLNode& node) override{
+        objects.push_back(std::make_pair(type, node));
+    }
+
+    std::vector<std::string>                     messages;
+    std::vector<int>                             lines;
+    std::vector<std::thread::id>                 threads;
+    std::vector<std::pair<std::string, MLNode> > objects;
+};
+
+// Removes its own transport from the first batch, which frees the transport on its worker thread
+class AsyncTransportRemover : public AsyncTransport::BatchHandler{
+
+public:
+    AsyncTransportRemover(const std::string& configuration, std::atomic<bool>* logged, std::atomic<bool>* freed)
+        : m_configuration(configuration), m_logged(logged), m_freed(freed){}
+    ~AsyncTransportRemover() override{ m_freed->store(true); }
+
+    void onBatch(const std::vector<AsyncTransport::Record>&) override{
+        // waits for the logger to release the snapshot holding this transport
+        while ( !m_logged->load() )
+            std::this_thread::yield();
+        vlog().removeTransports(m_configuration);
+        // the previous snapshot was in use by the call above, the next update frees it
+        vlog().configure(m_configuration, {{"level", VisualLog::MessageInfo::Info}});
+    }
+
+private:
+    std::string        m_configuration;
+    std::atomic<bool>* m_logged;
+    std::atomic<bool>* m_freed;
+};
+
+}// namespace
+
+TEST_CASE( "AsyncTransport Test", "[AsyncTransport]" ){
+    SECTION("Test Batches"){
+        AsyncTransportCollector* collector = new AsyncTransportCollector;
+        AsyncTransport* transport = new AsyncTransport(collector);
+        REQUIRE(transport->handler() == collector);
+        vlog().configure("testasynctransport", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"toConsole",    false}
+        });
+        vlog().addTransport("testasynctransport", transport);
+
+        for ( int i = 0; i < 100; ++i )
+            vlog("testasynctransport") << "message " << i;
+        vlog("testasynctransport").asObject("point", {{"x", 1}, {"y", 2}});
+        transport->flush();
+
+        // the logger of the object also flushes an empty message once destroyed
+        REQUIRE(collector->received.size() == 102);
+        for ( int i = 0; i < 100; ++i ){
+            REQUIRE(collector->received[i].kind == AsyncTransport::Record::Message);
+            REQUIRE(collector->received[i].message == "message " + std::to_string(i));
+            REQUIRE(collector->received[i].level == VisualLog::MessageInfo::Info);
+        }
+        REQUIRE(collector->received[0].line > 0);
+        REQUIRE(collector->received[100].kind == AsyncTransport::Record::Object);
+        REQUIRE(collector->received[100].type == "point");
+        REQUIRE(collector->received[100].object["y"].asInt() == 2);
+
+        AsyncTransport::Stats stats = transport->stats();
+        REQUIRE(stats.delivered == 102);
+        REQUIRE(stats.dropped == 0);
+        REQUIRE(stats.batches == static_cast<size_t>(collector->batches));
+        REQUIRE(stats.maximumLatency >= stats.averageLatency);
+
+        vlog().removeTransports("testasynctransport");
+    }
+    SECTION("Test Target"){
+        AsyncTransportTarget* target = new AsyncTransportTarget;
+        AsyncTransport* transport = new AsyncTransport(target);
+        REQUIRE(transport->target() == target);
+        REQUIRE(transport->handler() == nullptr);
+
+        vlog().configure("testasynctransporttarget", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"toConsole",    false}
+        });
+        vlog().addTransport("testasynctransporttarget", transport);
+
+        vlog("testasynctransporttarget") << "first";
+        vlog("testasynctransporttarget") << "second";
+        vlog("testasynctransporttarget").asObject("value", MLNode(3));
+        transport->flush();
+
+        REQUIRE(target->messages.size() == 3);
+        REQUIRE(target->messages[0] == "first");
+        REQUIRE(target->messages[1] == "second");
+        REQUIRE(target->lines[0] > 0);
+        REQUIRE(target->threads[0] != std::this_thread::get_id());
+        REQUIRE(target->objects.size() == 1);
+        REQUIRE(target->objects[0].first == "value");
+        REQUIRE(target->objects[0].second.asInt() == 3);
+
+        vlog().removeTransports("testasynctransporttarget");
+    }
+    SECTION("Test Backpressure"){
+        AsyncTransportCollector* collector = new AsyncTransportCollector;
+        AsyncTransport* transport = new AsyncTransport(collector, 4, VisualLog::DropNewest);
+        vlog().configure("testasynctransportdrop", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"toConsole",    false}
+        });
+        vlog().addTransport("testasynctransportdrop", transport);
+
+        // holds the worker in its first batch, while the queue fills up
+        collector->close();
+        vlog("testasynctransportdrop") << "held";
+        collector->waitForEntry();
+        for ( int i = 0; i < 20; ++i )
+            vlog("testasynctransportdrop") << "message " << i;
+        collector->release();
+        transport->flush();
+
+        AsyncTransport::Stats stats = transport->stats();
+        REQUIRE(stats.dropped == 16);
+        REQUIRE(stats.delivered == 5);
+        REQUIRE(collector->received.size() == 5);
+        REQUIRE(collector->received[0].message == "held");
+        REQUIRE(collector->received[1].message == "message 0");
+        REQUIRE(collector->received[4].message == "message 3");
+
+        vlog().removeTransports("testasynctransportdrop");
+    }
+    SECTION("Test Stop"){
+        AsyncTransportTarget* target = new AsyncTransportTarget;
+        AsyncTransport* transport = new AsyncTransport(target, 4, VisualLog::Block);
+
+        vlog().configure("testasynctransportstop", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"toConsole",    false}
+        });
+        vlog().addTransport("testasynctransportstop", transport);
+
+        // waits for room instead of dropping
+        for ( int i = 0; i < 64; ++i )
+            vlog("testasynctransportstop") << "message " << i;
+        transport->stop();
+
+        REQUIRE(target->messages.size() == 64);
+        REQUIRE(target->messages[63] == "message 63");
+
+        vlog("testasynctransportstop") << "after stop";
+        transport->flush();
+        REQUIRE(target->messages.size() == 64);
+        REQUIRE(transport->stats().dropped == 1);
+
+        vlog().removeTransports("testasynctransportstop");
+    }
+    SECTION("Test Free From Batch"){
+        std::atomic<bool> logged(false);
+        std::atomic<bool> freed(false);
+        AsyncTransport* transport = new AsyncTransport(new AsyncTransportRemover("testasynctransportfree", &logged, &freed));
+
+        vlog().configure("testasynctransportfree", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"toConsole",    false}
+        });
+        vlog().addTransport("testasynctransportfree", transport);
+        vlog("testasynctransportfree") << "message";
+        logged.store(true);
+
+        // the transport and its handler are freed on the worker thread, which exits on its own
+        auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while ( !freed.load() && std::chrono::steady_clock::now() < timeout )
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        REQUIRE(freed.load());
+    }
+}
@@ -0,0 +1,225 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+#include "catch_library.h"
+#include "live/binarylog.h"
+#include "live/mlnodetobinary.h"
+#include "live/visuallog.h"
+#include "live/path.h"
+
+#include <cstdio>
+#include <fstream>
+
+using namespace lv;
+
+namespace{
+
+std::string freshBinaryLogPath(const std::string& name){
+    std::string path = Path::join(Path::temporaryDirectory(), name);
+    std::remove(path.c_str());
+    std::remove(BinaryLogReader::indexPath(path).c_str());
+    return path;
+}
+
+std::vector<BinaryLogRecord> readRecords(const BinaryLogReader& reader, const BinaryLogReader::Query& query){
+    std::vector<BinaryLogRecord> records;
+    reader.read(query, [&records](const BinaryLogRecord& record){
+        records.push_back(record);
+        return true;
+    });
+    return records;
+}
+
+}// namespace
+
+TEST_CASE( "BinaryLog Test", "[BinaryLog]" ){
+    SECTION("Test MLNode Round Trip"){
+        MLNode n = {
+            {"object", {
+                 {"string", "value1"},
+                 {"key2", 100}
+            }},
+            {"array", { 100, "200", false}},
+            {"bool", true},
+            {"int", 100},
+            {"large", static_cast<MLNode::IntType>(1) << 40},
+            {"negative", -7},
+            {"float", 100.1},
+            {"null", nullptr}
+        };
+
+        std::string serialized;
+        ml::toBinary(n, serialized);
+
+        MLNode rt;
+        ml::fromBinary(serialized, rt);
+
+        REQUIRE(rt["object"]["string"].asString() == MLNode::StringType("value1"));
+        REQUIRE(rt["object"]["key2"].asInt() == 100);
+        REQUIRE(rt["array"].size() == 3);
+        REQUIRE(rt["array"][1].asString() == MLNode::StringType("200"));
+        REQUIRE(rt["array"][2].asBool() == false);
+        REQUIRE(rt["bool"].asBool() == true);
+        REQUIRE(rt["large"].asLargeInt() == static_cast<MLNode::IntType>(1) << 40);
+        REQUIRE(rt["negative"].asInt() == -7);
+        REQUIRE(rt["float"].asFloat() == 100.1);
+        REQUIRE(rt["null"].isNull());
+
+        REQUIRE_THROWS_AS(ml::fromBinary(serialized.c_str(), serialized.size() - 1, rt), lv::Exception);
+    }
+    SECTION("Test Write And Seek"){
+        std::string path = freshBinaryLogPath("seek.blog");
+        DateTime base = DateTime::create(2024, 5, 1, 10);
+
+        {
+            BinaryLogWriter writer(path, 512);
+            for ( int i = 0; i < 100; ++i ){
+                writer.writeMessage(
+                    base.addMSeconds(i * 1000),
+                    i % 10 == 0 ? VisualLog::MessageInfo::Error : VisualLog::MessageInfo::Info,
+                    "test",
+                    BinaryLogWriter::Location("", "/src/file.cpp", 10 + i % 3, "run"),
+                    "message " + std::to_string(i)
+                );
+            }
+            writer.writeObject(base.addMSeconds(100000), VisualLog::MessageInfo::Warning, "test", BinaryLogWriter::Location(), "Point", {{"x", 1}, {"y", 2}});
+        }
+
+        BinaryLogReader reader(path);
+        REQUIRE(reader.blocks().size() > 2);
+
+        std::vector<BinaryLogRecord> all = readRecords(reader, BinaryLogReader::Query());
+        REQUIRE(all.size() == 101);
+        REQUIRE(all[7].message == "message 7");
+        REQUIRE(all[7].file == "/src/file.cpp");
+        REQUIRE(all[7].line == 11);
+        REQUIRE(all[100].kind == BinaryLogRecord::Object);
+        REQUIRE(all[100].type == "Point");
+        REQUIRE(all[100].object["y"].asInt() == 2);
+
+        std::vector<BinaryLogRecord> errors = readRecords(
+            reader,
+            BinaryLogReader::Query().from(base.addMSeconds(30000)).to(base.addMSeconds(60000)).level(VisualLog::MessageInfo::Error)
+        );
+        REQUIRE(errors.size() == 4);
+        REQUIRE(errors[0].message == "message 30");
+        REQUIRE(errors[3].message == "message 60");
+        REQUIRE(errors[3].stamp == base.addMSeconds(60000));
+
+        std::string text;
+        reader.toText(BinaryLogReader::Query().from(base.addMSeconds(100000)), text);
+        std::string prefix = "2024-05-01 10:01:40.000 Warning [test] ";
+        REQUIRE(text == prefix + "\\@Point\n" + std::string(prefix.size(), ' ') + "{\"x\":1,\"y\":2}\n");
+    }
+    SECTION("Test Recovery"){
+        std::string path = freshBinaryLogPath("recovery.blog");
+        DateTime base = DateTime::create(2024, 5, 1, 10);
+
+        {
+            BinaryLogWriter writer(path);
+            for ( int i = 0; i < 10; ++i )
+                writer.writeMessage(base.addMSeconds(i), VisualLog::MessageInfo::Info, "test", BinaryLogWriter::Location(), "first");
+        }
+
+        // an unindexed block followed by an entry cut short, as left by a crash
+        {
+            std::ofstream log(path, std::ios::out | std::ios::binary | std::ios::app);
+            log.write("\x09\x00\x00\x00\x01\x00\x00\x00\x00", 9);
+            log.write("\x40\x00\x00\x00\x04", 5);
+        }
+
+        {
+            BinaryLogWriter writer(path);
+            for ( int i = 0; i < 10; ++i )
+                writer.writeMessage(base.addMSeconds(100 + i), VisualLog::MessageInfo::Info, "test", BinaryLogWriter::Location(), "second");
+        }
+
+        BinaryLogReader reader(path);
+        REQUIRE(reader.blocks().size() == 3);
+        std::vector<BinaryLogRecord> records = readRecords(reader, BinaryLogReader::Query());
+        REQUIRE(records.size() == 20);
+        REQUIRE(records[19].message == "second");
+
+        std::remove(BinaryLogReader::indexPath(path).c_str());
+        REQUIRE(BinaryLogReader::buildIndex(path) == 3);
+        REQUIRE(BinaryLogReader(path).blocks().size() == 3);
+    }
+    SECTION("Test VisualLog Output"){
+        std::string path = freshBinaryLogPath("visuallog.blog");
+
+        vlog().configure("testbinary", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"toConsole",    false},
+            {"binaryFile",   path}
+        });
+        vlog("testbinary").asObject("Point", {{"x", 3}});
+        vlog("testbinary").at("file.cpp", 12, "main") << "message";
+        vlog("testbinary").d() << "debug";
+        vlog().configure("testbinary", {{"binaryFile", ""}});
+
+        BinaryLogReader reader(path);
+        std::vector<BinaryLogRecord> records = readRecords(reader, BinaryLogReader::Query());
+        REQUIRE(records.size() == 2);
+        REQUIRE(records[0].kind == BinaryLogRecord::Object);
+        REQUIRE(records[0].configuration == "testbinary");
+        REQUIRE(records[0].object["x"].asInt() == 3);
+        REQUIRE(records[1].message == "message");
+        REQUIRE(records[1].file == "file.cpp");
+        REQUIRE(records[1].line == 12);
+        REQUIRE(records[1].functionName == "main");
+    }
+    SECTION("Test Fields"){
+        std::string path = freshBinaryLogPath("fields.blog");
+
+        vlog().configure("testbinaryfields", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"toConsole",    false},
+            {"binaryFile",   path}
+        });
+        vlog("testbinaryfields").field("latency_us", 42).field("ratio", 0.25).field("cached", true).field("pkg", "core") << "loaded";
+        vlog("testbinaryfields").field("latency_us", -7) << "second";
+        vlog("testbinaryfields") << "plain";
+        vlog().configure("testbinaryfields", {{"binaryFile", ""}});
+
+        BinaryLogReader reader(path);
+        std::vector<BinaryLogRecord> records = readRecords(reader, BinaryLogReader::Query());
+        REQUIRE(records.size() == 3);
+
+        const VisualLog::Fields& fields = records[0].fields;
+        REQUIRE(records[0].message == "loaded");
+        REQUIRE(fields.size() == 4);
+        REQUIRE(fields[0].key() == "latency_us");
+        REQUIRE(fields[0].type() == VisualLog::Field::Integer);
+        REQUIRE(fields[0].asInt() == 42);
+        REQUIRE(fields[1].type() == VisualLog::Field::Float);
+        REQUIRE(fields[1].asFloat() == 0.25);
+        REQUIRE(fields[2].type() == VisualLog::Field::Boolean);
+        REQUIRE(fields[2].asBool());
+        REQUIRE(fields[3].type() == VisualLog::Field::String);
+        REQUIRE(fields[3].asString() == "core");
+
+        REQUIRE(records[1].fields.size() == 1);
+        REQUIRE(records[1].fields[0].asInt() == -7);
+        REQUIRE(records[2].message == "plain");
+        REQUIRE(records[2].fields.empty());
+
+        std::string text;
+        records[0].appendText(text);
+        REQUIRE(text.find(": loaded latency_us=42 ratio=0.25 cached=true pkg=core\n") != std::string::npos);
+    }
+}
@@ -17,6 +17,7 @@
 #include "catch_library.h"
 #include "live/visuallog.h"
 #include "live/datetime.h"
+#include "live/bytebufferpool.h"
 
 using namespace lv;
 
@@ -46,5 +47,51 @@ TEST_CASE( "ByteBuffer Test", "[ByteBuffer]" ) {
             REQUIRE(decoded.data()[i] == s[i]);
         }
     }
-}
+    SECTION("Test Pool Recycling"){
+        ByteBufferPool& pool = ByteBufferPool::instance();
+        pool.clear();
+        pool.resetStats();
+
+        REQUIRE(ByteBufferPool::capacityFor(1) == ByteBufferPool::minimumClassSize);
+        REQUIRE(ByteBufferPool::capacityFor(65) == 128);
+        REQUIRE(ByteBufferPool::capacityFor(ByteBufferPool::maximumClassSize + 1) == ByteBufferPool::maximumClassSize + 1);
+
+        {
+            ByteBuffer bf = ByteBuffer::allocate(100);
+            REQUIRE(bf.size() == 100);
+        }
+        REQUIRE(pool.stats().misses == 1);
+        REQUIRE(pool.stats().bytesRetained == 128);
+
+        {
+            ByteBuffer bf = ByteBuffer::allocate(120);
+            ByteBuffer copy = bf;
+            REQUIRE(copy.data() == bf.data());
+            REQUIRE(pool.stats().bytesRetained == 0);
+        }
+        REQUIRE(pool.stats().hits == 1);
+        REQUIRE(pool.stats().releases == 2);
 
+        pool.clear();
+        REQUIRE(pool.stats().bytesRetained == 0);
+    }
+    SECTION("Test Pool Retention Cap"){
+        ByteBufferPool& pool = ByteBufferPool::instance();
+        pool.clear();
+        pool.resetStats();
+
+        size_t previousCap = pool.maxRetainedBytes();
+        pool.setMaxRetainedBytes(64);
+        {
+            ByteBuffer small = ByteBuffer::allocate(10);
+            ByteBuffer large = ByteBuffer::allocate(1000);
+        }
+        ByteBufferPool::Stats st = pool.stats();
+        REQUIRE(st.releases == 2);
+        REQUIRE(st.discards == 1);
+        REQUIRE(st.bytesRetained == 64);
+
+        pool.setMaxRetainedBytes(previousCap);
+        pool.clear();
+    }
+}
@@ -17,6 +17,11 @@
 #include "catch_amalgamated.hpp"
 #include "live/visuallog.h"
 #include "live/datetime.h"
+#include "live/datetimeformat.h"
+#include "live/monotonictime.h"
+
+#include <ctime>
+#include <type_traits>
 
 using namespace lv;
 
@@ -100,4 +105,88 @@ TEST_CASE( "DateTime Test", "[DateTime]" ) {
         REQUIRE(dt2.addMSeconds(1000 * 60 * 60) == DateTime(2002, 1, 1, 16, 0, 0, 0));
         REQUIRE(dt2.addMSeconds(1000 * 60 * 60 * 10) == DateTime(2002, 1, 2, 1, 0, 0, 0));
     }
+    SECTION("Test Compiled Format"){
+        DateTimeFormat fmt = DateTimeFormat::compile("[%Y-%m-%d %H:%M:%S.%i] %W %B %c%%");
+        REQUIRE(fmt.format(DateTime(2002, 2, 3, 4, 5, 6, 7)) == "[2002-02-03 04:05:06.007] Sunday February 0%");
+
+        // same second, the cached prefix only gets its milliseconds rewritten
+        REQUIRE(fmt.format(DateTime(2002, 2, 3, 4, 5, 6, 987)) == "[2002-02-03 04:05:06.987] Sunday February 9%");
+        REQUIRE(fmt.format(DateTime(2002, 2, 3, 4, 5, 7, 1)) == "[2002-02-03 04:05:07.001] Sunday February 0%");
+
+        char buffer[64];
+        size_t size = fmt.write(DateTime(1999, 12, 31, 23, 59, 59, 999), buffer, sizeof(buffer));
+        REQUIRE(std::string(buffer, size) == "[1999-12-31 23:59:59.999] Friday December 9%");
+        REQUIRE(size <= fmt.maximumSize());
+        REQUIRE(fmt.write(DateTime(1999, 12, 31), buffer, 4) == size);
+
+        DateTimeFormat::Fields f(DateTime(1969, 12, 31, 23, 0, 0, 5).msecondsSinceEpoch());
+        REQUIRE(f.year == 1969);
+        REQUIRE(f.month == 12);
+        REQUIRE(f.day == 31);
+        REQUIRE(f.hour == 23);
+        REQUIRE(f.msecond == 5);
+        REQUIRE(f.dayOfWeek == 3);
+
+        DateTime leap(2024, 2, 29, 12);
+        REQUIRE(DateTimeFormat::compile("%d/%m/%y %I%a %w %b").format(leap) == "29/02/24 12pm Thu Feb");
+    }
+    SECTION("Test Local Time"){
+        DateTime::clearLocalTimeCache();
+        DateTime utc(2021, 3, 28, 0, 30, 0, 250);
+        for ( int i = 0; i < 48; ++i ){
+            DateTime dt = utc.addMSeconds(i * 30 * 60 * 1000);
+            std::time_t seconds = static_cast<std::time_t>(dt.msecondsSinceEpoch() / 1000);
+            std::tm expected = *std::localtime(&seconds);
+
+            DateTime local = dt.toLocal();
+            REQUIRE(local.isLocal());
+            REQUIRE(local.year() == expected.tm_year + 1900);
+            REQUIRE(local.month() == expected.tm_mon + 1);
+            REQUIRE(local.day() == expected.tm_mday);
+            REQUIRE(local.hour() == expected.tm_hour);
+            REQUIRE(local.minute() == expected.tm_min);
+            REQUIRE(local.msecond() == 250);
+            REQUIRE(local.toLocal() == local);
+        }
+    }
+    SECTION("Test Value Type"){
+        REQUIRE(std::is_trivially_copyable<DateTime>::value);
+
+        DateTime dt(2002, 2, 3, 4, 5, 6, 7);
+        DateTime copy = dt;
+        REQUIRE(copy == dt);
+        REQUIRE(dt.usecondsSinceEpoch() == dt.msecondsSinceEpoch() * 1000);
+        REQUIRE(DateTime::createFromUs(dt.usecondsSinceEpoch() + 999).msecond() == 7);
+        REQUIRE(DateTime::createFromMs(static_cast<size_t>(dt.msecondsSinceEpoch())) == dt);
+
+        DateTime before(1969, 12, 31, 23, 59, 59, 1);
+        REQUIRE(before.msecondsSinceEpoch() == -999);
+        REQUIRE(before.year() == 1969);
+        REQUIRE(before.second() == 59);
+        REQUIRE(before.msecond() == 1);
+        REQUIRE(before.dayOfYear() == 365);
+
+        DateTime local = dt.toLocal();
+        REQUIRE(local.addMSeconds(10).isLocal());
+    }
+    SECTION("Test Stopwatch"){
+        MonotonicTime start = MonotonicTime::now();
+        Stopwatch sw;
+        REQUIRE(sw.isRunning());
+        volatile long long sink = 0;
+        for ( int i = 0; i < 100000; ++i )
+            sink = sink + i;
+        sw.stop();
+        long long elapsed = sw.elapsedNSeconds();
+        REQUIRE(elapsed > 0);
+        REQUIRE(sw.elapsedNSeconds() == elapsed);
+        REQUIRE(start <= MonotonicTime::now());
+        REQUIRE(start.nsecondsTo(MonotonicTime::now()) >= elapsed);
+
+        sw.start();
+        REQUIRE(sw.elapsedNSeconds() >= elapsed);
+        sw.reset();
+        REQUIRE(sw.elapsedNSeconds() == 0);
+        REQUIRE_FALSE(sw.isRunning());
+    }
 }
@@ -0,0 +1,144 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+
+
+
+#include "catch_library.h"
+#include "live/logring.h"
+#include "live/visuallog.h"
+#include "live/exception.h"
+#include "live/fileio.h"
+#include "live/path.h"
+
+#include <vector>
+#include <string>
+#include <memory>
+
+using namespace lv;
+
+namespace{
+
+class LogRingTransportStub : public VisualLog::Transport{
+
+public:
+    void onMessage(const VisualLog::Configuration*, const VisualLog::MessageInfo&, const std::string& message) override{
+        messages.push_back(message);
+    }
+    void onObject(const VisualLog::Configuration*, const VisualLog::MessageInfo&, const std::string&, const MLNode&) override{}
+
+public:
+    std::vector<std::string> messages;
+};
+
+std::vector<std::string> ringLines(){
+    std::string text;
+    LogRing::instance().toText(text);
+
+    std::vector<std::string> lines;
+    size_t start = 0;
+    for ( size_t end = text.find('\n'); end != std::string::npos; end = text.find('\n', start) ){
+        lines.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    return lines;
+}
+
+bool endsWith(const std::string& str, const std::string& suffix){
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+TEST_CASE( "LogRing Test", "[LogRing]" ){
+    std::unique_ptr<FileIO> fio = std::make_unique<FileIO>();
+    std::string dumpPath = Path::join(Path::temporaryDirectory(), "logringdump.txt");
+    REQUIRE(fio->writeToFile(dumpPath, ""));
+
+    LogRingTransportStub* ts = new LogRingTransportStub;
+    vlog().addTransport("testring", ts);
+    vlog().configure("testring", {
+        {"level",         VisualLog::MessageInfo::Info},
+        {"toConsole",     false},
+        {"crashRing",     "Verbose"},
+        {"crashRingSize", static_cast<int>(256 * LogRing::recordSize)},
+        {"crashDumpFile", dumpPath}
+    });
+
+    LogRing& ring = LogRing::instance();
+    REQUIRE(ring.isEnabled());
+    REQUIRE(ring.capacity() == 256 * LogRing::recordSize);
+
+    SECTION("Filtered Levels Are Captured"){
+        vlog("testring").v() << "verbose " << 1;
+        vlog("testring").d() << "debug " << 2;
+        vlog("testring").i() << "info " << 3;
+        vlog_if("testring", VisualLog::MessageInfo::Verbose) << "verbose if " << 4;
+
+        REQUIRE(ts->messages.size() == 1);
+        REQUIRE(ts->messages[0] == "info 3");
+
+        std::vector<std::string> lines = ringLines();
+        REQUIRE(lines.size() >= 4);
+        size_t last = lines.size() - 1;
+        REQUIRE(endsWith(lines[last - 3], "Verbose [testring] verbose 1"));
+        REQUIRE(endsWith(lines[last - 2], "Debug [testring] debug 2"));
+        REQUIRE(endsWith(lines[last - 1], "Info [testring] info 3"));
+        REQUIRE(endsWith(lines[last],     "Verbose [testring] verbose if 4"));
+    }
+    SECTION("Oldest Records Are Overwritten"){
+        for ( int i = 0; i < 300; ++i )
+            ring.write(VisualLog::MessageInfo::Debug, DateTime(), "direct", "record " + std::to_string(i));
+        ring.write(VisualLog::MessageInfo::Info, DateTime(), "direct", std::string(LogRing::recordTextSize, 'x'));
+
+        std::vector<std::string> lines = ringLines();
+        REQUIRE(lines.size() == 256);
+        REQUIRE(endsWith(lines[0], "Debug [direct] record 45"));
+        REQUIRE(endsWith(lines[254], "Debug [direct] record 299"));
+        REQUIRE(endsWith(lines[255], "[direct] " + std::string(LogRing::recordTextSize - 6, 'x') + "..."));
+    }
+    SECTION("Exceptions Are Captured"){
+        vlog("testring").d() << "before exception";
+        try{
+            THROW_EXCEPTION(Exception, "ring test error", 7);
+        } catch ( Exception& ){}
+
+        std::vector<std::string> lines = ringLines();
+        REQUIRE(lines.size() >= 2);
+        REQUIRE(lines.back().find("Error [exception] ring test error (code 7) at ") != std::string::npos);
+
+        // stamped in local time, like messages, so the entries stay in order
+        const std::string& message = lines[lines.size() - 2];
+        REQUIRE(endsWith(message, "Debug [testring] before exception"));
+        std::string messageStamp   = message.substr(0, message.find(" Debug"));
+        std::string exceptionStamp = lines.back().substr(0, lines.back().find(" Error"));
+        REQUIRE(messageStamp <= exceptionStamp);
+    }
+    SECTION("Fatal Messages Dump The Ring"){
+        vlog("testring").d() << "before fatal";
+        vlog("testring").f() << "fatal";
+
+        REQUIRE(ts->messages.size() == 1);
+        REQUIRE(ts->messages[0] == "fatal");
+
+        std::string contents = fio->readFromFile(dumpPath);
+        REQUIRE(contents.find("--- Log ring dump: Fatal message in testring ---\n") == 0);
+        size_t beforeFatal = contents.find("Debug [testring] before fatal\n");
+        REQUIRE(beforeFatal != std::string::npos);
+        REQUIRE(contents.find("Fatal [testring] fatal\n") > beforeFatal);
+    }
+
+    vlog().removeTransports("testring");
+}
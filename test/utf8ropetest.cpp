@@ -0,0 +1,108 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+**
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+#include "catch_library.h"
+#include "live/utf8rope.h"
+#include "live/exception.h"
+
+using namespace lv;
+
+TEST_CASE( "Utf8Rope Test", "[Utf8Rope]" ) {
+    SECTION("Test Edits"){
+        Utf8Rope rope("hello world");
+        REQUIRE(rope.size() == 11);
+        rope.insert(5, ",");
+        rope.insert(rope.size(), "!");
+        rope.insert(0, ">> ");
+        REQUIRE(rope.toString() == ">> hello, world!");
+        rope.remove(0, 3);
+        REQUIRE(rope.toString() == "hello, world!");
+        rope.replace(7, 5, "rope");
+        REQUIRE(rope.toString() == "hello, rope!");
+        REQUIRE(rope.substr(7, 4) == "rope");
+        REQUIRE(rope.byteAt(0) == 'h');
+        REQUIRE(rope.byteAt(11) == '!');
+        REQUIRE_THROWS_AS(rope.byteAt(12), lv::Exception);
+        REQUIRE_THROWS_AS(rope.insert(13, "x"), lv::Exception);
+        rope.remove(0, rope.size());
+        REQUIRE(rope.isEmpty());
+    }
+    SECTION("Test Against String"){
+        std::string reference;
+        for ( int i = 0; i < 3000; ++i )
+            reference += "line " + std::to_string(i) + "\n";
+        Utf8Rope rope(reference);
+        REQUIRE(rope.toString() == reference);
+
+        unsigned int seed = 7;
+        for ( int i = 0; i < 2000; ++i ){
+            seed = seed * 1103515245u + 12345u;
+            size_t offset = (seed >> 8) % (reference.size() + 1);
+            if ( i % 3 == 0 && offset < reference.size() ){
+                size_t length = std::min<size_t>((seed >> 4) % 50, reference.size() - offset);
+                reference.erase(offset, length);
+                rope.remove(offset, length);
+            } else {
+                std::string text = (i % 5 == 0) ? "x\ny" : "abc";
+                reference.insert(offset, text);
+                rope.insert(offset, text);
+            }
+        }
+        REQUIRE(rope.size() == reference.size());
+        REQUIRE(rope.toString() == reference);
+
+        size_t chunked = 0;
+        rope.readChunks([&chunked](const char*, size_t size){ chunked += size; });
+        REQUIRE(chunked == reference.size());
+    }
+    SECTION("Test Lines"){
+        Utf8Rope rope("first\nsecond\n\nfourth");
+        REQUIRE(rope.totalLines() == 4);
+        REQUIRE(rope.lineOffset(1) == 0);
+        REQUIRE(rope.lineOffset(2) == 6);
+        REQUIRE(rope.lineOffset(4) == 14);
+        REQUIRE(rope.lineOffset(5) == std::string::npos);
+        REQUIRE(rope.offsetOf(2, 3) == 8);
+        REQUIRE(rope.offsetOf(2, 7) == 12);
+        REQUIRE(rope.offsetOf(2, 8) == std::string::npos);
+        REQUIRE(rope.offsetOf(SourcePoint(4, 7)) == rope.size());
+
+        SourcePoint p = rope.pointAt(8);
+        REQUIRE(p.line() == 2);
+        REQUIRE(p.column() == 3);
+        REQUIRE(p.offset() == 8);
+        REQUIRE(rope.pointAt(rope.size()).line() == 4);
+
+        REQUIRE(rope.substr(SourceRange(SourcePoint(2, 1), SourcePoint(2, 7))) == "second");
+
+        std::string big;
+        for ( int i = 0; i < 5000; ++i )
+            big += std::to_string(i) + "\n";
+        Utf8Rope bigRope(big);
+        REQUIRE(bigRope.totalLines() == 5001);
+        REQUIRE(bigRope.substr(bigRope.lineOffset(4001), 5) == "4000\n");
+        REQUIRE(bigRope.pointAt(bigRope.lineOffset(4321) + 2).line() == 4321);
+    }
+    SECTION("Test Snapshots"){
+        Utf8Rope rope("abc\ndef");
+        Utf8Rope snapshot = rope.snapshot();
+        rope.insert(3, "123");
+        rope.remove(0, 1);
+        REQUIRE(rope.toString() == "bc123\ndef");
+        REQUIRE(snapshot.toString() == "abc\ndef");
+        REQUIRE(snapshot.totalLines() == 2);
+    }
+}
@@ -0,0 +1,277 @@
+/****************************************************************************
+**
+** Copyright (C) 2022 Dinu SV.
+**
+** This file is part of Livekeys Application.
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+****************************************************************************/
+
+#include "catch_library.h"
+#include "live/utf8.h"
+#include "live/internedutf8.h"
+#include "live/exception.h"
+
+#include <unordered_map>
+
+using namespace lv;
+
+TEST_CASE( "Utf8 Test", "[Utf8]" ) {
+    SECTION("Test Value Semantics"){
+        Utf8 a("first");
+        Utf8 b = a;
+        REQUIRE(a == b);
+        REQUIRE(a.data().data() != b.data().data());
+
+        Utf8 c(std::move(b));
+        REQUIRE(c == "first");
+
+        std::string longStr(100, 'x');
+        Utf8 d(longStr);
+        const char* longData = d.data().data();
+        Utf8 e(std::move(d));
+        REQUIRE(e.data().data() == longData);
+    }
+    SECTION("Test Concatenation"){
+        Utf8 a("a");
+        Utf8 result = a + "b" + std::string("c") + 'd' + Utf8("e");
+        REQUIRE(result == "abcde");
+        REQUIRE(a == "a");
+    }
+    SECTION("Test Case"){
+        REQUIRE(Utf8("AbC").toLower() == "abc");
+        REQUIRE(Utf8("AbC").toUpper() == "ABC");
+        REQUIRE(Utf8("").toLower() == "");
+
+        Utf8 mixed("The Quick Brown Fox @[`{ Jumps Over \xC3\x89T\xC3\x89 The Lazy Dog");
+        REQUIRE(mixed.toLower() == "the quick brown fox @[`{ jumps over \xC3\xA9t\xC3\xA9 the lazy dog");
+        REQUIRE(mixed.toUpper() == "THE QUICK BROWN FOX @[`{ JUMPS OVER \xC3\x89T\xC3\x89 THE LAZY DOG");
+        REQUIRE(Utf8("abc\xC3").toLower() == "");
+    }
+    SECTION("Test Ascii Case Insensitive"){
+        REQUIRE(Utf8("Warning").compareAsciiNoCase("wARNING") == 0);
+        REQUIRE(Utf8("abc").compareAsciiNoCase("ABD") < 0);
+        REQUIRE(Utf8("abcd").compareAsciiNoCase("ABC") > 0);
+        REQUIRE(Utf8("Package.Name").hashAsciiNoCase() == Utf8("package.name").hashAsciiNoCase());
+        REQUIRE(Utf8::AsciiNoCaseEqual()(std::string("Info"), std::string("INFO")));
+    }
+    SECTION("Test Format"){
+        REQUIRE(Utf8("% + % = %").format(1, 2u, 3LL) == "1 + 2 = 3");
+        REQUIRE(Utf8("%, %, %").format("str", std::string("std"), Utf8("utf8")) == "str, std, utf8");
+        REQUIRE(Utf8("%%% %%").format(-10) == "%-10 %");
+        REQUIRE(Utf8("%|%|%").format(1.5, 0.1f, 1e20) == "1.5|0.1|1e+20");
+        REQUIRE(Utf8("%%").format() == "%");
+        REQUIRE(Utf8("[% %]").format('c', true) == "[c 1]");
+        REQUIRE(Utf8("").format() == "");
+
+        std::string longArg(1000, 'a');
+        REQUIRE(Utf8("<%>").format(longArg) == "<" + longArg + ">");
+
+        bool missingArgs = false;
+        try{
+            Utf8("% and %").format(1);
+        } catch ( lv::Exception& e ){
+            REQUIRE(e.code() == Exception::toCode("Format"));
+            missingArgs = true;
+        }
+        REQUIRE(missingArgs);
+
+        bool extraArgs = false;
+        try{
+            Utf8("%").format(1, 2);
+        } catch ( lv::Exception& ){
+            extraArgs = true;
+        }
+        REQUIRE(extraArgs);
+    }
+    SECTION("Test Validation"){
+        REQUIRE(Utf8("").isValid());
+        REQUIRE(Utf8("plain ascii text that spans more than sixteen bytes").isValid());
+        REQUIRE(Utf8("\xC3\xA9t\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80").isValid());
+        REQUIRE(!Utf8("\xC3").isValid());
+        REQUIRE(!Utf8("abc\x80").isValid());
+        REQUIRE(!Utf8("\xC0\xAF").isValid());
+        REQUIRE(!Utf8("\xED\xA0\x80").isValid());
+        REQUIRE(!Utf8("\xF4\x90\x80\x80").isValid());
+        REQUIRE(!Utf8("0123456789abcdef0123456789\xFF").isValid());
+    }
+    SECTION("Test Code Points"){
+        Utf8 str("a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80" "b");
+        REQUIRE(str.utfLength() == 5);
+        REQUIRE(str.utfIndexToByteOffset(0) == 0);
+        REQUIRE(str.utfIndexToByteOffset(1) == 1);
+        REQUIRE(str.utfIndexToByteOffset(2) == 3);
+        REQUIRE(str.utfIndexToByteOffset(3) == 6);
+        REQUIRE(str.utfIndexToByteOffset(4) == 10);
+        REQUIRE(str.utfIndexToByteOffset(5) == 11);
+        REQUIRE(str.utfIndexToByteOffset(6) == std::string::npos);
+        REQUIRE(str.byteOffsetToUtfIndex(6) == 3);
+        REQUIRE(str.byteOffsetToUtfIndex(11) == 5);
+        REQUIRE(str.byteOffsetToUtfIndex(2) == 1);
+        REQUIRE(str.byteOffsetToUtfIndex(5) == 2);
+        REQUIRE(str.byteOffsetToUtfIndex(7) == 3);
+        REQUIRE(str.byteOffsetToUtfIndex(9) == 3);
+        REQUIRE(str.byteOffsetToUtfIndex(12) == std::string::npos);
+        REQUIRE(Utf8("a\xC3\xA9").byteOffsetToUtfIndex(2) == 1);
+
+        std::string longStr;
+        for ( int i = 0; i < 1000; ++i )
+            longStr += (i % 3 == 0) ? "\xC3\xA9" : "x";
+        Utf8 longUtf(longStr);
+        REQUIRE(longUtf.utfLength() == 1000);
+
+        Utf8::OffsetIndex index(longUtf, 64);
+        REQUIRE(index.utfLength() == 1000);
+        for ( size_t i = 0; i <= 1000; i += 7 ){
+            size_t offset = longUtf.utfIndexToByteOffset(i);
+            REQUIRE(index.byteOffset(i) == offset);
+            REQUIRE(index.utfIndex(offset) == i);
+            if ( i < 1000 && i % 3 == 0 )
+                REQUIRE(index.utfIndex(offset + 1) == i);
+        }
+        REQUIRE(index.utfIndex(longUtf.size() + 1) == std::string::npos);
+        REQUIRE(index.byteOffset(1000) == longUtf.size());
+        REQUIRE(index.byteOffset(1001) == std::string::npos);
+    }
+    SECTION("Test Split"){
+        Utf8 str("a::b::::c");
+        std::vector<Utf8> parts = str.split("::");
+        REQUIRE(parts.size() == 4);
+        REQUIRE(parts[0] == "a");
+        REQUIRE(parts[1] == "b");
+        REQUIRE(parts[2] == "");
+        REQUIRE(parts[3] == "c");
+
+        std::vector<std::string_view> views = str.splitView("::").toVector();
+        REQUIRE(views.size() == 4);
+        REQUIRE(views[3] == "c");
+        REQUIRE(views[3].data() == str.data().data() + 8);
+
+        REQUIRE(Utf8::splitView("a.b.", ".").toVector() == std::vector<std::string_view>{"a", "b", ""});
+        REQUIRE(Utf8::splitView("", ".").toVector() == std::vector<std::string_view>{""});
+        REQUIRE(Utf8::splitView("abc", "").toVector() == std::vector<std::string_view>{"abc"});
+
+        // iterators outlive the temporary range they were taken from
+        auto it = Utf8::splitView("x,y", ",").begin();
+        REQUIRE(*it == "x");
+        ++it;
+        REQUIRE(*it == "y");
+        ++it;
+        REQUIRE(it == Utf8::SplitRange::Iterator());
+    }
+    SECTION("Test Views"){
+        Utf8 str(" \t value \n");
+        REQUIRE(str.trimView() == "value");
+        REQUIRE(str.trimLeftView() == "value \n");
+        REQUIRE(str.trimRightView() == " \t value");
+        REQUIRE(str.trim() == "value");
+        REQUIRE(Utf8::trimView("   ").empty());
+        REQUIRE(str.substrView(3, 5) == "value");
+        REQUIRE(str.substrView(3).size() == str.size() - 3);
+    }
+    SECTION("Test Replace All"){
+        REQUIRE(Utf8("a.b.c").replaceAll(".", "::") == "a::b::c");
+        REQUIRE(Utf8("aaa").replaceAll("a", "aa") == "aaaaaa");
+        REQUIRE(Utf8("abab").replaceAll("ab", "") == "");
+        REQUIRE(Utf8("abc").replaceAll("", "x") == "abc");
+        REQUIRE(Utf8::replaceAll(std::string_view("x/y/z"), "/", "\\") == "x\\y\\z");
+
+        std::string path = "a/b/c";
+        Utf8::replaceAll(path, "/", ".");
+        REQUIRE(path == "a.b.c");
+        Utf8::replaceAll(path, ".", "--");
+        REQUIRE(path == "a--b--c");
+    }
+    SECTION("Test Find"){
+        std::string text(100, 'a');
+        text += "needle";
+        text += std::string(50, 'b');
+        text += "needle";
+        Utf8 str(text);
+        REQUIRE(str.find("needle") == 100);
+        REQUIRE(str.find("needle", 101) == 156);
+        REQUIRE(str.find("needle", 157) == std::string::npos);
+        REQUIRE(str.find("aan") == 98);
+        REQUIRE(str.find("") == 0);
+        REQUIRE(str.find("", str.size() + 1) == std::string::npos);
+        REQUIRE(str.findLast("needle") == 156);
+        REQUIRE(str.findLast("needle", 155) == 100);
+        REQUIRE(str.findLast("needle", 99) == std::string::npos);
+        REQUIRE(str.findLast("ab") == std::string::npos);
+        REQUIRE(str.findLast("a") == 99);
+
+        for ( size_t i = 0; i + 3 <= text.size(); i += 13 ){
+            std::string needle = text.substr(i, 3);
+            REQUIRE(str.find(needle) == text.find(needle));
+            REQUIRE(str.findLast(needle) == text.rfind(needle));
+            REQUIRE(str.findLast(needle, i) == text.rfind(needle, i));
+        }
+    }
+    SECTION("Test Find Any"){
+        Utf8 str("user=admin password=hunter2 token=abc");
+        Utf8::PatternSet patterns(std::vector<std::string>{"password=", "token=", "pass", "user"});
+
+        Utf8::PatternSet::Match m = str.findAny(patterns);
+        REQUIRE(m.isValid());
+        REQUIRE(m.position == 0);
+        REQUIRE(m.pattern == 3);
+
+        m = str.findAny(patterns, 1);
+        REQUIRE(m.position == 11);
+        REQUIRE(m.length == 9);
+        REQUIRE(m.pattern == 0);
+
+        REQUIRE(patterns.findAll(str.view()).size() == 3);
+        REQUIRE_FALSE(str.findAny(std::vector<Utf8>{"missing", ""}).isValid());
+        REQUIRE(Utf8("ushers").findAny(std::vector<Utf8>{"he", "she", "hers"}).position == 1);
+    }
+    SECTION("Test Replace Map"){
+        std::map<Utf8, Utf8> replacements;
+        replacements["a"] = "b";
+        replacements["b"] = "a";
+        replacements["abc"] = "X";
+        REQUIRE(Utf8("ab abc cba").replaceAll(replacements) == "ba X cab");
+        REQUIRE(Utf8("none").replaceAll(replacements) == "none");
+
+        Utf8::PatternSet patterns(std::vector<Utf8>{"/", "\\"});
+        REQUIRE(Utf8("a/b\\c").replaceAll(patterns, {".", "."}) == "a.b.c");
+        REQUIRE_THROWS_AS(Utf8("a").replaceAll(patterns, {"."}), lv::Exception);
+    }
+    SECTION("Test Interning"){
+        InternedUtf8 a = Utf8("lv.base").intern();
+        InternedUtf8 b(std::string("lv.") + "base");
+        InternedUtf8 c("lv.other");
+        REQUIRE(a == b);
+        REQUIRE(a != c);
+        REQUIRE(&a.value() == &b.value());
+        REQUIRE(a.hash() == b.hash());
+        REQUIRE(a.data() == "lv.base");
+        REQUIRE(a < c);
+        REQUIRE_FALSE(c < a);
+        REQUIRE_FALSE(a < b);
+        REQUIRE(InternedUtf8() == InternedUtf8(""));
+        REQUIRE(InternedUtf8().isEmpty());
+
+        InternedUtf8 found;
+        REQUIRE(InternedUtf8::lookup("lv.base", found));
+        REQUIRE(found == a);
+        REQUIRE_FALSE(InternedUtf8::lookup("lv.never.interned.name", found));
+
+        size_t total = InternedUtf8::totalInterned();
+        InternedUtf8 again("lv.other");
+        REQUIRE(InternedUtf8::totalInterned() == total);
+
+        std::unordered_map<InternedUtf8, int, InternedUtf8::Hash> counts;
+        counts[a] = 1;
+        counts[InternedUtf8("lv.base")] += 1;
+        REQUIRE(counts.size() == 1);
+        REQUIRE(counts[b] == 2);
+    }
+}
@@ -14,18 +14,94 @@
 **
 ****************************************************************************/
 
+// Verbose messages logged through vlog_if are compiled out in this file
+#define VLOG_MINIMUM_LEVEL 4
+
 #include "catch_library.h"
 #include "live/visuallog.h"
 #include "live/exception.h"
 #include "live/fileio.h"
+#include "live/datetime.h"
+#include "live/directory.h"
 
 #include <vector>
 #include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
 
 using namespace lv;
 
 namespace{
 
+// allocations are only counted on the thread that sets the flag, while it's set
+thread_local bool countAllocations = false;
+std::atomic<size_t> countedAllocations(0);
+
+void* testAllocate(size_t size, size_t alignment) noexcept{
+    if ( countAllocations )
+        countedAllocations.fetch_add(1, std::memory_order_relaxed);
+    if ( size == 0 )
+        size = 1;
+    if ( alignment <= alignof(std::max_align_t) )
+        return std::malloc(size);
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void* testAllocateOrThrow(size_t size, size_t alignment){
+    void* p = testAllocate(size, alignment);
+    if ( !p )
+        throw std::bad_alloc();
+    return p;
+}
+
+} // namespace
+
+void* operator new(size_t size){
+    return testAllocateOrThrow(size, 0);
+}
+void* operator new[](size_t size){
+    return testAllocateOrThrow(size, 0);
+}
+void* operator new(size_t size, std::align_val_t alignment){
+    return testAllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment){
+    return testAllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept{
+    return testAllocate(size, 0);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept{
+    return testAllocate(size, 0);
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept{
+    return testAllocate(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept{
+    return testAllocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept{ std::free(p); }
+void operator delete[](void* p) noexcept{ std::free(p); }
+void operator delete(void* p, size_t) noexcept{ std::free(p); }
+void operator delete[](void* p, size_t) noexcept{ std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept{ std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept{ std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept{ std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept{ std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept{ std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept{ std::free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept{ std::free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept{ std::free(p); }
+
+namespace{
+
 class VisualLogTransportStub : public VisualLog::Transport{
 
     // Transport interface
@@ -35,6 +111,7 @@ public:
                    const std::string&message) override
     {
         messages.push_back(std::make_pair(messageInfo.prefix(configuration), message));
+        fields.push_back(messageInfo.fields());
     }
 
     void onObject(const VisualLog::Configuration *configuration,
@@ -50,8 +127,60 @@ public:
 public:
     std::vector<std::pair<std::string, std::string> > messages;
     std::vector<std::pair<std::string, MLNode> >  objects;
+    std::vector<VisualLog::Fields> fields;
+};
+
+class VisualLogGateTransport : public VisualLog::Transport{
+
+public:
+    VisualLogGateTransport() : entered(false), open(false){}
+
+    void onMessage(const VisualLog::Configuration*, const VisualLog::MessageInfo&, const std::string& message) override{
+        std::unique_lock<std::mutex> lock(mutex);
+        entered = true;
+        changed.notify_all();
+        changed.wait(lock, [this](){ return open; });
+        messages.push_back(message);
+    }
+
+    void onObject(const VisualLog::Configuration*, const VisualLog::MessageInfo&, const std::string&, const MLNode&) override{}
+
+    void waitForEntry(){
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this](){ return entered; });
+    }
+
+    void release(){
+        std::lock_guard<std::mutex> lock(mutex);
+        open = true;
+        changed.notify_all();
+    }
+
+public:
+    std::mutex               mutex;
+    std::condition_variable  changed;
+    bool                     entered;
+    bool                     open;
+    std::vector<std::string> messages;
 };
 
+class VisualLogCountingTransport : public VisualLog::Transport{
+
+public:
+    VisualLogCountingTransport() : total(0){}
+
+    void onMessage(const VisualLog::Configuration*, const VisualLog::MessageInfo&, const std::string&) override{
+        ++total;
+    }
+    void onObject(const VisualLog::Configuration*, const VisualLog::MessageInfo&, const std::string&, const MLNode&) override{}
+
+    std::atomic<int> total;
+};
+
+int countEvaluation(int& evaluations){
+    return ++evaluations;
+}
+
 class RunOnce{
 public:
     static void setup(){
@@ -142,6 +271,29 @@ TEST_CASE( "VisualLog Test", "[VisualLog]" ) {
         vlog().configure("test", {{"prefix", ""}});
         vlog().removeTransports("test");
     }
+    SECTION("Test Prefix Date And Remote"){
+        VisualLogTransportStub* ts = new VisualLogTransportStub;
+
+        vlog().addTransport("test", ts);
+        vlog().configure("test", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"prefix",       "[%Y-%m-%d %H:%M] %r|100%%|%"}
+        });
+
+        DateTime stamp = DateTime::create(2021, 3, 14, 15, 9, 26);
+        vlog("test").at("remote", "file.cpp", 7, "fn").overrideStamp(stamp) << "message";
+
+        vlog().configure("test", {{"prefix", "%p"}});
+        vlog("test").at("remote", "file.cpp", 7, "fn").overrideStamp(stamp).w() << "message";
+
+        REQUIRE(ts->messages.size() == 2);
+        REQUIRE(ts->messages[0].first == "[2021-03-14 15:09] remote|100%|%");
+        REQUIRE(ts->messages[1].first == "remote> 2021-03-14 15:09:26.000 warning fn@7: ");
+
+        vlog().configure("test", {{"prefix", ""}});
+        vlog().removeTransports("test");
+    }
     SECTION("Test File Output"){
         std::unique_ptr<FileIO> fio = std::make_unique<FileIO>();
 
@@ -185,5 +337,547 @@ TEST_CASE( "VisualLog Test", "[VisualLog]" ) {
         std::string contents = fio->readFromFile(workPath + "/_temp_.txt");
         REQUIRE(contents == "test info\n");
     }
-}
+    SECTION("Test Buffered File Output"){
+        std::unique_ptr<FileIO> fio = std::make_unique<FileIO>();
+        std::string tempFilePath = Path::join(Path::temporaryDirectory(), "bufferedfile.txt");
+        REQUIRE(fio->writeToFile(tempFilePath, ""));
+
+        vlog().configure("testbuffered", {
+            {"level",             VisualLog::MessageInfo::Info},
+            {"defaultLevel",      VisualLog::MessageInfo::Info},
+            {"file",              tempFilePath},
+            {"fileBufferSize",    64 * 1024},
+            {"fileFlushInterval", 0}
+        });
+
+        // held until an error arrives
+        vlog("testbuffered") << "first";
+        vlog("testbuffered") << "second";
+        REQUIRE(fio->readFromFile(tempFilePath) == "");
+        vlog("testbuffered").e() << "third";
+        REQUIRE(fio->readFromFile(tempFilePath) == "first\nsecond\nthird\n");
+
+        vlog("testbuffered") << "fourth";
+        REQUIRE(fio->readFromFile(tempFilePath) == "first\nsecond\nthird\n");
+
+        // the file stays open and keeps its buffer when only the buffering changes
+        vlog().configure("testbuffered", {
+            {"fileFlushLevel", "Warning"}
+        });
+        REQUIRE(fio->readFromFile(tempFilePath) == "first\nsecond\nthird\n");
+        VisualLog::flushAll();
+        REQUIRE(fio->readFromFile(tempFilePath) == "first\nsecond\nthird\nfourth\n");
+
+        // written by the flusher thread once the interval passes
+        vlog().configure("testbuffered", {
+            {"fileFlushInterval", 20},
+            {"fileSyncInterval",  20}
+        });
+        vlog("testbuffered") << "fifth";
+
+        auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        std::string contents = fio->readFromFile(tempFilePath);
+        while ( contents.size() < 30 && std::chrono::steady_clock::now() < timeout ){
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            contents = fio->readFromFile(tempFilePath);
+        }
+        REQUIRE(contents == "first\nsecond\nthird\nfourth\nfifth\n");
+
+        // written through
+        vlog().configure("testbuffered", {
+            {"fileBufferSize", 0}
+        });
+        vlog("testbuffered") << "sixth";
+        REQUIRE(fio->readFromFile(tempFilePath) == "first\nsecond\nthird\nfourth\nfifth\nsixth\n");
+
+        vlog().configure("testbuffered", {
+            {"file", ""}
+        });
+    }
+    SECTION("Test File Rotation"){
+        std::unique_ptr<FileIO> fio = std::make_unique<FileIO>();
+
+        std::string workPath = Path::join(Path::temporaryDirectory(), "_vlogrotation_");
+        if ( Path::exists(workPath) ){
+            REQUIRE(Path::remove(workPath));
+        }
+        REQUIRE(Path::createDirectory(workPath));
+
+        std::string filePath = Path::join(workPath, "rotation.txt");
+
+        auto rotatedFiles = [&workPath](){
+            std::vector<std::string> result;
+            Directory::Iterator dit = Directory::iterate(workPath);
+            while ( !dit.isEnd() ){
+                std::string name = Path::name(dit.path());
+                if ( name.find("rotation.txt.") == 0 && name.find(".part") == std::string::npos )
+                    result.push_back(name);
+                dit.next();
+            }
+            return result;
+        };
+
+        vlog().configure("testrotation", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"file",         filePath},
+            {"maxFileSize",  64},
+            {"maxFiles",     2}
+        });
+
+        for ( int i = 0; i < 10; ++i )
+            vlog("testrotation") << "rotation message " << i << " with some padding";
+        VisualLog::flushAll();
+
+        REQUIRE(fio->readFromFile(filePath) == "rotation message 9 with some padding\n");
+        REQUIRE(rotatedFiles().size() == 2);
+
+        vlog().configure("testrotation", {
+            {"compress", true}
+        });
+        for ( int i = 0; i < 4; ++i )
+            vlog("testrotation") << "compressed message " << i << " with some padding";
+        vlog().configure("testrotation", {
+            {"file", ""}
+        });
+
+        // compression runs in the background, when available
+        auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        std::vector<std::string> rotated = rotatedFiles();
+        auto isCompressed = [](const std::string& name){ return name.size() > 3 && name.substr(name.size() - 3) == ".gz"; };
+        while ( std::chrono::steady_clock::now() < timeout ){
+            rotated = rotatedFiles();
+            if ( rotated.size() == 2 && isCompressed(rotated[0]) && isCompressed(rotated[1]) )
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE(rotated.size() == 2);
+
+        REQUIRE(Path::remove(workPath));
+    }
+    SECTION("Test Async Output"){
+        std::unique_ptr<FileIO> fio = std::make_unique<FileIO>();
+        std::string tempFilePath = Path::join(Path::temporaryDirectory(), "asyncfile.txt");
+        REQUIRE(fio->writeToFile(tempFilePath, ""));
+
+        VisualLogTransportStub* ts = new VisualLogTransportStub;
+        vlog().addTransport("testasync", ts);
+        vlog().configure("testasync", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"file",         tempFilePath},
+            {"prefix",       "%v:"}
+        });
+
+        VisualLog::startAsync(64, VisualLog::Block);
+        REQUIRE(VisualLog::isAsync());
+
+        std::vector<std::thread> producers;
+        for ( int t = 0; t < 4; ++t ){
+            producers.push_back(std::thread([t](){
+                for ( int i = 0; i < 100; ++i )
+                    vlog("testasync") << t << " " << i;
+            }));
+        }
+        for ( auto& producer : producers )
+            producer.join();
+
+        VisualLog::flushAsync();
+        REQUIRE(ts->messages.size() == 400);
+        REQUIRE(ts->messages[0].first == "info:");
+        REQUIRE(VisualLog::droppedMessages() == 0);
+
+        VisualLog::stopAsync();
+        REQUIRE_FALSE(VisualLog::isAsync());
+
+        std::string contents = fio->readFromFile(tempFilePath);
+        REQUIRE(Utf8(contents).split("\n").size() == 401);
+        REQUIRE(contents.find("info:3 99\n") != std::string::npos);
+
+        vlog().configure("testasync", {{"file", ""}});
+        vlog().removeTransports("testasync");
+    }
+    SECTION("Test Async Location"){
+        VisualLogTransportStub* ts = new VisualLogTransportStub;
+        vlog().addTransport("testasynclocation", ts);
+        vlog().configure("testasynclocation", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"toConsole",    false},
+            {"prefix",       "%N:%L:%U: "}
+        });
+
+        VisualLog::startAsync(64, VisualLog::Block);
+        {
+            std::string file = "location.cpp";
+            std::string functionName = "locate";
+            vlog("testasynclocation").at(file.c_str(), 12, functionName.c_str()) << "message";
+            file.assign("overwritten.cpp");
+            functionName.assign("overwritten");
+        }
+        VisualLog::flushAsync();
+        VisualLog::stopAsync();
+
+        REQUIRE(ts->messages.size() == 1);
+        REQUIRE(ts->messages[0].first == "location.cpp:12:locate: ");
+
+        vlog().removeTransports("testasynclocation");
+    }
+    SECTION("Test Async Overflow"){
+        VisualLog::OverflowPolicy policies[] = {VisualLog::DropNewest, VisualLog::DropOldest};
+        for ( VisualLog::OverflowPolicy policy : policies ){
+            VisualLogGateTransport* ts = new VisualLogGateTransport;
+            vlog().addTransport("testoverflow", ts);
+            vlog().configure("testoverflow", {
+                {"level",        VisualLog::MessageInfo::Info},
+                {"defaultLevel", VisualLog::MessageInfo::Info}
+            });
+
+            VisualLog::startAsync(4, policy);
+
+            vlog("testoverflow") << "first";
+            ts->waitForEntry();
+            for ( int i = 0; i < 7; ++i )
+                vlog("testoverflow") << i;
+            REQUIRE(VisualLog::droppedMessages() == 3);
+
+            ts->release();
+            VisualLog::flushAsync();
+            VisualLog::stopAsync();
+
+            REQUIRE(ts->messages.size() == 5);
+            REQUIRE(ts->messages[0] == "first");
+            if ( policy == VisualLog::DropNewest ){
+                REQUIRE(ts->messages[1] == "0");
+                REQUIRE(ts->messages[4] == "3");
+            } else {
+                REQUIRE(ts->messages[1] == "3");
+                REQUIRE(ts->messages[4] == "6");
+            }
+
+            vlog().removeTransports("testoverflow");
+        }
+    }
+    SECTION("Test Async Reconfiguration"){
+        std::unique_ptr<FileIO> fio = std::make_unique<FileIO>();
+        std::string firstPath  = Path::join(Path::temporaryDirectory(), "asyncfirst.txt");
+        std::string secondPath = Path::join(Path::temporaryDirectory(), "asyncsecond.txt");
+        REQUIRE(fio->writeToFile(firstPath, ""));
+        REQUIRE(fio->writeToFile(secondPath, ""));
+
+        VisualLogGateTransport* ts = new VisualLogGateTransport;
+        vlog().addTransport("testasyncreconfigure", ts);
+        vlog().configure("testasyncreconfigure", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"toConsole",    false},
+            {"file",         firstPath}
+        });
+
+        VisualLog::startAsync(64, VisualLog::Block);
+
+        // messages queued before the file changes are written with the configuration they were logged with
+        vlog("testasyncreconfigure") << "first";
+        ts->waitForEntry();
+        vlog("testasyncreconfigure") << "second";
+        vlog().configure("testasyncreconfigure", {{"file", secondPath}});
+        vlog("testasyncreconfigure") << "third";
+
+        ts->release();
+        VisualLog::stopAsync();
+        VisualLog::flushAll();
+
+        REQUIRE(ts->messages == std::vector<std::string>{"first", "second", "third"});
+        REQUIRE(fio->readFromFile(firstPath) == "first\nsecond\n");
+        REQUIRE(fio->readFromFile(secondPath) == "third\n");
+
+        vlog().configure("testasyncreconfigure", {{"file", ""}});
+        vlog().removeTransports("testasyncreconfigure");
+    }
+    SECTION("Test Async Restart"){
+        VisualLogCountingTransport* ts = new VisualLogCountingTransport;
+        vlog().addTransport("testasyncrestart", ts);
+        vlog().configure("testasyncrestart", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"toConsole",    false}
+        });
+
+        // producers keep logging into a small queue while writers are started and stopped
+        std::atomic<bool> running(true);
+        std::atomic<int> logged(0);
+        std::vector<std::thread> producers;
+        for ( int t = 0; t < 4; ++t ){
+            producers.push_back(std::thread([&running, &logged](){
+                while ( running.load() ){
+                    vlog("testasyncrestart") << "message";
+                    logged.fetch_add(1);
+                }
+            }));
+        }
+
+        for ( int i = 0; i < 50; ++i ){
+            VisualLog::startAsync(4, VisualLog::Block);
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            VisualLog::stopAsync();
+        }
+
+        running = false;
+        for ( auto& producer : producers )
+            producer.join();
+
+        REQUIRE_FALSE(VisualLog::isAsync());
+        REQUIRE(ts->total.load() > 0);
+        REQUIRE(ts->total.load() <= logged.load());
+
+        int total = ts->total.load();
+        vlog("testasyncrestart") << "message";
+        REQUIRE(ts->total.load() == total + 1);
+
+        vlog().removeTransports("testasyncrestart");
+    }
+    SECTION("Test Concurrent Configuration"){
+        std::unique_ptr<FileIO> fio = std::make_unique<FileIO>();
+        std::string tempFilePath = Path::join(Path::temporaryDirectory(), "concurrentfile.txt");
+        REQUIRE(fio->writeToFile(tempFilePath, ""));
+
+        VisualLogCountingTransport* ts = new VisualLogCountingTransport;
+        vlog().addTransport("testconcurrent", ts);
+        vlog().configure("testconcurrent", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"file",         tempFilePath},
+            {"prefix",       "<"}
+        });
+
+        std::atomic<bool> running(true);
+        std::vector<std::thread> producers;
+        for ( int t = 0; t < 4; ++t ){
+            producers.push_back(std::thread([&running](){
+                while ( running.load() )
+                    vlog("testconcurrent") << "message>";
+            }));
+        }
+
+        for ( int i = 0; i < 200; ++i ){
+            vlog().configure("testconcurrent", {
+                {"level",  i % 2 == 0 ? VisualLog::MessageInfo::Error : VisualLog::MessageInfo::Info},
+                {"prefix", i % 2 == 0 ? "[" : "<"}
+            });
+            vlog().addTransport("testconcurrent" + std::to_string(i % 3), new VisualLogCountingTransport);
+        }
+        vlog().configure("testconcurrent", {{"level", VisualLog::MessageInfo::Info}, {"prefix", "<"}});
 
+        running = false;
+        for ( auto& producer : producers )
+            producer.join();
+
+        int total = ts->total.load();
+        vlog("testconcurrent") << "message>";
+        REQUIRE(ts->total.load() == total + 1);
+
+        vlog().configure("testconcurrent", {{"file", ""}});
+
+        std::vector<Utf8> lines = Utf8(fio->readFromFile(tempFilePath)).split("\n");
+        REQUIRE(static_cast<int>(lines.size()) == total + 2);
+        for ( size_t i = 0; i + 1 < lines.size(); ++i )
+            REQUIRE(lines[i] == "<message>");
+
+        vlog().removeTransports("testconcurrent");
+    }
+    SECTION("Test Conditional Logging"){
+        VisualLogTransportStub* ts = new VisualLogTransportStub;
+        vlog().addTransport("testconditional", ts);
+        vlog().configure("testconditional", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info}
+        });
+
+        int evaluations = 0;
+        for ( int i = 0; i < 3; ++i ){
+            vlog_if("testconditional", VisualLog::MessageInfo::Info) << "info " << countEvaluation(evaluations);
+            vlog_if("testconditional", VisualLog::MessageInfo::Debug) << "debug " << countEvaluation(evaluations);
+        }
+        REQUIRE(evaluations == 3);
+        REQUIRE(ts->messages.size() == 3);
+        REQUIRE(ts->messages[2].second == "info 3");
+
+        vlog().configure("testconditional", {{"level", VisualLog::MessageInfo::Verbose}});
+        vlog_if("testconditional", VisualLog::MessageInfo::Debug) << "debug " << countEvaluation(evaluations);
+        vlog_if("testconditional", VisualLog::MessageInfo::Verbose) << "verbose " << countEvaluation(evaluations);
+        REQUIRE(evaluations == 4);
+        REQUIRE(ts->messages.size() == 4);
+        REQUIRE(ts->messages[3].second == "debug 4");
+
+        if ( evaluations > 0 )
+            vlog_if("testconditional", VisualLog::MessageInfo::Info) << "branch";
+        else
+            REQUIRE(false);
+        REQUIRE(ts->messages.size() == 5);
+
+        // registering the configuration after the first use picks it up on the next call
+        VisualLogTransportStub* lateTs = new VisualLogTransportStub;
+        for ( int i = 0; i < 2; ++i ){
+            vlog_if("testconditionallate", VisualLog::MessageInfo::Error) << "late";
+            if ( i == 0 )
+                vlog().addTransport("testconditionallate", lateTs);
+        }
+        REQUIRE(lateTs->messages.size() == 1);
+
+        vlog().removeTransports("testconditional");
+        vlog().removeTransports("testconditionallate");
+    }
+    SECTION("Test Fields"){
+        std::unique_ptr<FileIO> fio = std::make_unique<FileIO>();
+        std::string tempFilePath = Path::join(Path::temporaryDirectory(), "fieldsfile.txt");
+        REQUIRE(fio->writeToFile(tempFilePath, ""));
+
+        VisualLogTransportStub* ts = new VisualLogTransportStub;
+        vlog().addTransport("testfields", ts);
+        vlog().configure("testfields", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"toConsole",    false},
+            {"file",         tempFilePath}
+        });
+
+        std::string name = "core";
+        vlog("testfields").field("latency_us", 42).field("pkg", name).field("ok", true) << "loaded";
+        vlog("testfields").field("note", "two words").field("quote", "a\"b") << "quoted";
+        vlog("testfields").d().field("skipped", 1) << "debug";
+
+        // more than the inline capacity
+        {
+            VisualLog overflow("testfields");
+            for ( int i = 0; i < 10; ++i )
+                overflow.field("key" + std::to_string(i), std::string(20, static_cast<char>('a' + i)));
+            overflow << "overflow";
+        }
+
+        VisualLog::flushAll();
+        std::string contents = fio->readFromFile(tempFilePath);
+        REQUIRE(contents.find("loaded latency_us=42 pkg=core ok=true\n") == 0);
+        REQUIRE(contents.find("quoted note=\"two words\" quote=\"a\\\"b\"\n") != std::string::npos);
+        REQUIRE(contents.find("skipped") == std::string::npos);
+        REQUIRE(contents.find("key9=" + std::string(20, 'j')) != std::string::npos);
+
+        REQUIRE(ts->fields.size() == 3);
+        REQUIRE(ts->fields[0].size() == 3);
+        REQUIRE(ts->fields[0][0].key() == "latency_us");
+        REQUIRE(ts->fields[0][0].asInt() == 42);
+        REQUIRE(ts->fields[0][1].asString() == "core");
+        REQUIRE(ts->fields[0][2].asBool());
+        REQUIRE(ts->fields[1].size() == 2);
+        REQUIRE(ts->fields[2].size() == 10);
+        REQUIRE(ts->fields[2][9].key() == "key9");
+        REQUIRE(ts->fields[2][9].asString() == std::string(20, 'j'));
+
+        // through the writer thread
+        VisualLog::startAsync();
+        vlog("testfields").field("async", 1.5) << "queued";
+        VisualLog::stopAsync();
+        VisualLog::flushAll();
+        REQUIRE(fio->readFromFile(tempFilePath).find("queued async=1.5\n") != std::string::npos);
+        REQUIRE(ts->fields.size() == 4);
+        REQUIRE(ts->fields[3][0].asFloat() == 1.5);
+
+        vlog().configure("testfields", {{"file", ""}});
+        vlog().removeTransports("testfields");
+    }
+    SECTION("Test Call Site Limits"){
+        VisualLogTransportStub* ts = new VisualLogTransportStub;
+        vlog().addTransport("testlimit", ts);
+        vlog().configure("testlimit", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"sample",       10}
+        });
+
+        for ( int i = 0; i < 25; ++i )
+            vlog("testlimit") << "sampled " << i;
+
+        // the first message passing after a drop is preceded by a summary
+        REQUIRE(ts->messages.size() == 4);
+        REQUIRE(ts->messages[0].second == "sampled 0");
+        REQUIRE(ts->messages[1].second.find("Suppressed 9 messages from ") == 0);
+        REQUIRE(ts->messages[2].second == "sampled 10");
+        REQUIRE(ts->messages[3].second == "sampled 20");
+
+        // each call site is limited separately
+        vlog("testlimit") << "other site";
+        REQUIRE(ts->messages.size() == 5);
+
+        // threads share the count of the call site
+        ts->messages.clear();
+        for ( int t = 0; t < 3; ++t ){
+            std::thread producer([t](){
+                for ( int i = 0; i < 5; ++i )
+                    vlog("testlimit") << "thread " << t << " sampled " << i;
+            });
+            producer.join();
+        }
+        REQUIRE(ts->messages.size() == 2);
+        REQUIRE(ts->messages[0].second == "thread 0 sampled 0");
+        REQUIRE(ts->messages[1].second == "thread 2 sampled 0");
+
+        ts->messages.clear();
+        vlog().configure("testlimit", {
+            {"sample",    0},
+            {"rateLimit", {{"rate", 1}, {"burst", 3}}}
+        });
+        for ( int i = 0; i < 100; ++i )
+            vlog("testlimit") << "limited " << i;
+        vlog("testlimit").f() << "fatal";
+        REQUIRE(ts->messages.size() == 4);
+        REQUIRE(ts->messages[2].second == "limited 2");
+        REQUIRE(ts->messages[3].second == "fatal");
+
+        vlog().removeTransports("testlimit");
+    }
+    SECTION("Test Steady State Allocations"){
+        std::unique_ptr<FileIO> fio = std::make_unique<FileIO>();
+        std::string tempFilePath = Path::join(Path::temporaryDirectory(), "allocationfile.txt");
+        REQUIRE(fio->writeToFile(tempFilePath, ""));
+
+        VisualLogCountingTransport* ts = new VisualLogCountingTransport;
+        vlog().addTransport("testallocation", ts);
+        vlog().configure("testallocation", {
+            {"level",        VisualLog::MessageInfo::Info},
+            {"defaultLevel", VisualLog::MessageInfo::Info},
+            {"toConsole",    false},
+            {"file",         tempFilePath},
+            {"prefix",       "%v:%N:%L: "}
+        });
+
+        auto logMessages = [](int total){
+            for ( int i = 0; i < total; ++i ){
+                vlog("testallocation") << "steady state message number " << i << " of " << 1.5 * total;
+                vlog_if("testallocation", VisualLog::MessageInfo::Info) << "conditional message number " << i;
+            }
+        };
+
+        auto countLogAllocations = [&logMessages](int total){
+            size_t before = countedAllocations.load();
+            countAllocations = true;
+            logMessages(total);
+            countAllocations = false;
+            return countedAllocations.load() - before;
+        };
+
+        logMessages(10);
+        REQUIRE(countLogAllocations(100) == 0);
+        REQUIRE(ts->total.load() == 220);
+
+        VisualLog::startAsync(16, VisualLog::Block);
+        logMessages(64);
+        VisualLog::flushAsync();
+        size_t asyncAllocations = countLogAllocations(100);
+        VisualLog::flushAsync();
+        VisualLog::stopAsync();
+        REQUIRE(asyncAllocations == 0);
+        REQUIRE(ts->total.load() == 548);
+
+        vlog().configure("testallocation", {{"file", ""}});
+        vlog().removeTransports("testallocation");
+    }
+}